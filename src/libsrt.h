@@ -14,10 +14,17 @@ extern "C" {
  */
 
 #include "sbitset.h"
+#include "sfmap.h"
 #include "shmap.h"
 #include "shset.h"
+#include "sintern.h"
+#include "sivmap.h"
+#include "slz.h"
 #include "smap.h"
+#include "smpattern.h"
 #include "smset.h"
+#include "spmap.h"
+#include "srope.h"
 #include "sstring.h"
 #include "svector.h"
 
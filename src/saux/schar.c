@@ -22,12 +22,48 @@
  * In most cases the code will perform better with this enabled, as most
  * frequently used separators and arithmetics characters already use one
  * byte, even if you're using e.g. Asian languages.
+ *
+ * S_ENABLE_UTF8_VECTOR_COUNT: SSE2 UTF-8 character counting (16 bytes per
+ * step, 64 for ASCII), selected at run time. Each block is structurally
+ * validated (continuation bytes must match exactly the ones required by
+ * the preceding lead bytes), so it is counted as its number of non
+ * continuation bytes. Blocks not passing the check (stray continuation
+ * bytes, overlapped or truncated characters) are processed with the
+ * scalar code, so the result and the encoding error count are the same.
+ *
+ * S_ENABLE_ASCII_VECTOR_CASE: SSE2/AVX2 ASCII case conversion and
+ * case-insensitive comparison (16/32 bytes per step), selected at run
+ * time. Blocks having non-ASCII bytes go through the Unicode code path.
  */
 
 #define S_ENABLE_UTF8_CHAR_COUNT_HEURISTIC_OPTIMIZATION
+#define S_ENABLE_UTF8_VECTOR_COUNT
+#define S_ENABLE_ASCII_VECTOR_CASE
 
 #ifdef S_MINIMAL
 #undef S_ENABLE_UTF8_CHAR_COUNT_HEURISTIC_OPTIMIZATION
+#undef S_ENABLE_UTF8_VECTOR_COUNT
+#undef S_ENABLE_ASCII_VECTOR_CASE
+#endif
+
+#if defined(S_SIMD_X86_GNUC) || defined(S_SIMD_X64_MSVC)
+#ifdef S_ENABLE_UTF8_VECTOR_COUNT
+#define SC_UTF8_VEC
+#endif
+#ifdef S_ENABLE_ASCII_VECTOR_CASE
+#define SC_ASCII_VEC
+#endif
+#endif
+
+#if defined(SC_UTF8_VEC) || defined(SC_ASCII_VEC)
+#ifdef S_SIMD_X86_GNUC
+#include <immintrin.h>
+#define SC_HAS_SSE2 __builtin_cpu_supports("sse2")
+#define SC_HAS_AVX2 __builtin_cpu_supports("avx2")
+#else
+#include <emmintrin.h>
+#define SC_HAS_SSE2 1 /* x64: SSE2 always */
+#endif
 #endif
 
 /*
@@ -93,6 +129,137 @@ size_t sc_utf8_char_size(const char *s, size_t off, size_t max_off,
 }
 /* clang-format on */
 
+#ifdef SC_UTF8_VEC
+
+S_INLINE size_t sc_popcount16(unsigned m)
+{
+	m = m - ((m >> 1) & 0x5555);
+	m = (m & 0x3333) + ((m >> 2) & 0x3333);
+	m = (m + (m >> 4)) & 0x0f0f;
+	return (m + (m >> 8)) & 0x1f;
+}
+
+/* Scalar counting from 'i' until reaching 'end' (or the string end) */
+static size_t sc_utf8_walk(const char *s, size_t i, size_t end, size_t s_size,
+			   size_t *unicode_sz, size_t *enc_errors)
+{
+	for (; i < end && i < s_size; (*unicode_sz)++)
+		i += sc_utf8_char_size(s, i, s_size, enc_errors);
+	return i;
+}
+
+/*
+ * Scalar resume point for the block at 'i': if a character counted by
+ * the previous blocks is not complete before 'i', go back to its lead byte
+ * (uncounting it). Blocks since 'vstart' passed the structural check.
+ */
+static size_t sc_utf8_resync(const char *s, size_t i, size_t vstart,
+			     size_t *unicode_sz)
+{
+	size_t j = i;
+	while (j > vstart && i - j < 5) {
+		j--;
+		if ((s[j] & 0xc0) == 0x80)
+			continue;
+		if (j + sc_utf8_char_size(s, j, S_NPOS, NULL) <= i)
+			break;
+		(*unicode_sz)--;
+		return j;
+	}
+	return i;
+}
+
+/* Previous block bytes shifted into the current one by 'd' bytes */
+#define SC_U8V_SHL(c, p, d)                                                    \
+	_mm_or_si128(_mm_slli_si128(c, d), _mm_srli_si128(p, 16 - (d)))
+
+#define SC_U8V_NEED(n, w, lo)                                                  \
+	n = _mm_cmpeq_epi8(_mm_max_epu8(w, lo), w)
+
+S_SSE2_ATTR static size_t sc_utf8_count_sse2(const char *s, size_t s_size,
+					     size_t *enc_errors)
+{
+	size_t i = 0, vstart = 0, unicode_sz = 0;
+	unsigned m;
+	srt_bool no_pending = S_TRUE;
+	__m128i a, w, req, cont, n1, n2, n3, n4, n5, p1, p2, p3, p4, p5;
+	const __m128i cont_lim = _mm_set1_epi8(-64),
+		      max_lead = _mm_set1_epi8((char)0xfd),
+		      lo2 = _mm_set1_epi8((char)0xc0),
+		      lo3 = _mm_set1_epi8((char)0xe0),
+		      lo4 = _mm_set1_epi8((char)0xf0),
+		      lo5 = _mm_set1_epi8((char)0xf8),
+		      lo6 = _mm_set1_epi8((char)0xfc);
+	p1 = p2 = p3 = p4 = p5 = _mm_setzero_si128();
+	while (i + 16 <= s_size) {
+		if (no_pending && i + 64 <= s_size) {
+			a = _mm_or_si128(
+				_mm_or_si128(
+					_mm_loadu_si128((const __m128i *)(s + i)),
+					_mm_loadu_si128(
+						(const __m128i *)(s + i + 16))),
+				_mm_or_si128(
+					_mm_loadu_si128(
+						(const __m128i *)(s + i + 32)),
+					_mm_loadu_si128(
+						(const __m128i *)(s + i + 48))));
+			if (!_mm_movemask_epi8(a)) {
+				i += 64;
+				unicode_sz += 64;
+				continue;
+			}
+		}
+		a = _mm_loadu_si128((const __m128i *)(s + i));
+		m = (unsigned)_mm_movemask_epi8(a);
+		if (!m && no_pending) {
+			i += 16;
+			unicode_sz += 16;
+			continue;
+		}
+		/*
+		 * nX: bytes being lead of a character of size >= X (0xc0-0xfd),
+		 * requiring continuation bytes X - 1 positions after them
+		 */
+		w = _mm_and_si128(a, _mm_cmpeq_epi8(_mm_min_epu8(a, max_lead), a));
+		SC_U8V_NEED(n1, w, lo2);
+		SC_U8V_NEED(n2, w, lo3);
+		SC_U8V_NEED(n3, w, lo4);
+		SC_U8V_NEED(n4, w, lo5);
+		SC_U8V_NEED(n5, w, lo6);
+		req = _mm_or_si128(
+			_mm_or_si128(SC_U8V_SHL(n1, p1, 1), SC_U8V_SHL(n2, p2, 2)),
+			_mm_or_si128(
+				_mm_or_si128(SC_U8V_SHL(n3, p3, 3),
+					     SC_U8V_SHL(n4, p4, 4)),
+				SC_U8V_SHL(n5, p5, 5)));
+		cont = _mm_cmplt_epi8(a, cont_lim);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(req, cont)) == 0xffff) {
+			unicode_sz += 16
+				      - sc_popcount16((unsigned)_mm_movemask_epi8(
+					      cont));
+			p1 = n1;
+			p2 = n2;
+			p3 = n3;
+			p4 = n4;
+			p5 = n5;
+			no_pending = m ? S_FALSE : S_TRUE;
+			i += 16;
+			continue;
+		}
+		/* Irregular block: scalar counting, then restart after it */
+		i = sc_utf8_walk(s, sc_utf8_resync(s, i, vstart, &unicode_sz),
+				 i + 16, s_size, &unicode_sz, enc_errors);
+		vstart = i;
+		no_pending = S_TRUE;
+		p1 = p2 = p3 = p4 = p5 = _mm_setzero_si128();
+	}
+	sc_utf8_walk(s, sc_utf8_resync(s, i, vstart, &unicode_sz), s_size,
+		     s_size, &unicode_sz, enc_errors);
+	return unicode_sz;
+}
+
+#endif /* #ifdef SC_UTF8_VEC */
+
 size_t sc_utf8_count_chars(const char *s, size_t s_size, size_t *enc_errors)
 {
 #ifdef S_ENABLE_UTF8_CHAR_COUNT_HEURISTIC_OPTIMIZATION
@@ -102,6 +269,10 @@ size_t sc_utf8_count_chars(const char *s, size_t s_size, size_t *enc_errors)
 	size_t i, unicode_sz;
 	if (!s || !s_size)
 		return 0;
+#ifdef SC_UTF8_VEC
+	if (s_size >= 16 && SC_HAS_SSE2)
+		return sc_utf8_count_sse2(s, s_size, enc_errors);
+#endif
 	i = unicode_sz = 0;
 #ifdef S_ENABLE_UTF8_CHAR_COUNT_HEURISTIC_OPTIMIZATION
 	size_cutted = s_size >= 6 ? s_size - 6 : 0;
@@ -268,13 +439,154 @@ size_t sc_unicode_count_to_utf8_size(const char *s, size_t off, size_t max_off,
 	return i - off;
 }
 
+/*
+ * ASCII case helpers
+ */
+
+#define SC_ASCII_TOLOWER(c) ((c) >= 'A' && (c) <= 'Z' ? (c) + 0x20 : (c))
+
+#ifdef SC_ASCII_VEC
+
+S_SSE2_ATTR static size_t sc_ascii_span_sse2(const char *s, size_t off,
+					     size_t max)
+{
+	__m128i a;
+	for (; off + 64 <= max; off += 64) {
+		a = _mm_or_si128(
+			_mm_or_si128(_mm_loadu_si128((const __m128i *)(s + off)),
+				     _mm_loadu_si128(
+					     (const __m128i *)(s + off + 16))),
+			_mm_or_si128(
+				_mm_loadu_si128((const __m128i *)(s + off + 32)),
+				_mm_loadu_si128(
+					(const __m128i *)(s + off + 48))));
+		if (_mm_movemask_epi8(a))
+			break;
+	}
+	for (; off + 16 <= max; off += 16)
+		if (_mm_movemask_epi8(
+			    _mm_loadu_si128((const __m128i *)(s + off))))
+			break;
+	return off;
+}
+
+/* Case conversion: XOR 0x20 on bytes in the [lo, hi] range */
+S_SSE2_ATTR static size_t sc_ascii_toX_sse2(const char *s, size_t off,
+					    size_t max, char *o, char lo,
+					    char hi)
+{
+	__m128i a, m;
+	const __m128i l = _mm_set1_epi8(lo - 1), h = _mm_set1_epi8(hi + 1),
+		      b = _mm_set1_epi8(0x20);
+	for (; off + 16 <= max; off += 16, o += 16) {
+		a = _mm_loadu_si128((const __m128i *)(s + off));
+		if (_mm_movemask_epi8(a))
+			break;
+		m = _mm_and_si128(_mm_cmpgt_epi8(a, l), _mm_cmplt_epi8(a, h));
+		_mm_storeu_si128((__m128i *)o,
+				 _mm_xor_si128(a, _mm_and_si128(m, b)));
+	}
+	return off;
+}
+
+#ifdef S_SIMD_X86_GNUC
+S_AVX2_ATTR static size_t sc_ascii_toX_avx2(const char *s, size_t off,
+					    size_t max, char *o, char lo,
+					    char hi)
+{
+	__m256i a, m;
+	const __m256i l = _mm256_set1_epi8(lo - 1), h = _mm256_set1_epi8(hi + 1),
+		      b = _mm256_set1_epi8(0x20);
+	for (; off + 32 <= max; off += 32, o += 32) {
+		a = _mm256_loadu_si256((const __m256i *)(s + off));
+		if (_mm256_movemask_epi8(a))
+			break;
+		m = _mm256_and_si256(_mm256_cmpgt_epi8(a, l),
+				     _mm256_cmpgt_epi8(h, a));
+		_mm256_storeu_si256((__m256i *)o,
+				    _mm256_xor_si256(a, _mm256_and_si256(m, b)));
+	}
+	return off;
+}
+#endif
+
+/* Equal (ASCII, case-insensitive) 16-byte blocks */
+S_SSE2_ATTR static size_t sc_ascii_ncmpi_sse2(const char *a, const char *b,
+					      size_t n)
+{
+	size_t k;
+	__m128i x, y;
+	const __m128i l = _mm_set1_epi8('A' - 1), h = _mm_set1_epi8('Z' + 1),
+		      c = _mm_set1_epi8(0x20);
+	for (k = 0; k + 16 <= n; k += 16) {
+		x = _mm_loadu_si128((const __m128i *)(a + k));
+		y = _mm_loadu_si128((const __m128i *)(b + k));
+		if (_mm_movemask_epi8(_mm_or_si128(x, y)))
+			break;
+		x = _mm_or_si128(x, _mm_and_si128(_mm_and_si128(
+						      _mm_cmpgt_epi8(x, l),
+						      _mm_cmplt_epi8(x, h)),
+					      c));
+		y = _mm_or_si128(y, _mm_and_si128(_mm_and_si128(
+						      _mm_cmpgt_epi8(y, l),
+						      _mm_cmplt_epi8(y, h)),
+					      c));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff)
+			break;
+	}
+	return k;
+}
+
+#endif /* #ifdef SC_ASCII_VEC */
+
+static size_t sc_ascii_span(const char *s, size_t off, size_t max)
+{
+#ifdef SC_ASCII_VEC
+	if (max - off >= 16 && SC_HAS_SSE2)
+		off = sc_ascii_span_sse2(s, off, max);
+#endif
+	for (; off < max && !(s[off] & 0x80); off++)
+		;
+	return off;
+}
+
+size_t sc_ascii_ncmpi(const char *a, const char *b, size_t n, int *res)
+{
+	size_t k = 0;
+	int c1, c2;
+	*res = 0;
+#ifdef SC_ASCII_VEC
+	if (n >= 16 && SC_HAS_SSE2)
+		k = sc_ascii_ncmpi_sse2(a, b, n);
+#endif
+	for (; k < n; k++) {
+		c1 = (unsigned char)a[k];
+		c2 = (unsigned char)b[k];
+		if ((c1 | c2) & 0x80)
+			break;
+		c1 = SC_ASCII_TOLOWER(c1);
+		c2 = SC_ASCII_TOLOWER(c2);
+		if (c1 != c2) {
+			*res = c1 - c2;
+			break;
+		}
+	}
+	return k;
+}
+
 ssize_t sc_utf8_calc_case_extra_size(const char *s, size_t off, size_t s_size,
 				     int32_t (*ssc_toX)(int32_t))
 {
 	int uchr = 0;
 	size_t i = off, char_size;
 	ssize_t caseXsize = 0;
+	/* ASCII characters keep the size, except for the Turkish mode */
+	srt_bool ascii_same_size = ssc_toX == sc_tolower || ssc_toX == sc_toupper;
 	for (; i < s_size;) {
+		if (ascii_same_size && !(s[i] & 0x80)) {
+			i = sc_ascii_span(s, i + 1, s_size);
+			continue;
+		}
 		char_size = sc_utf8_to_wc(s, i, s_size, &uchr, NULL);
 		i += char_size;
 		caseXsize += ((ssize_t)sc_wc_to_utf8_size(ssc_toX(uchr))
@@ -986,9 +1298,19 @@ size_t sc_parallel_toX(const char *s, size_t off, size_t max, char *o,
 	int op_mod = ssc_toX == sc_tolower ? 1 : 0;
 	uint32_t msk1 = 0x7f7f7f7f, msk2 = 0x1a1a1a1a, msk3 = 0x20202020;
 	uint32_t msk4 = op_mod ? 0x25252525 : 0x05050505;
-	size_t szm4 = max & (size_t)(~3);
+#ifdef SC_ASCII_VEC
+	size_t off0 = off;
+	char lo = op_mod ? 'A' : 'a', hi = op_mod ? 'Z' : 'z';
+#ifdef S_SIMD_X86_GNUC
+	if (max - off >= 32 && SC_HAS_AVX2)
+		off = sc_ascii_toX_avx2(s, off, max, o, lo, hi);
+#endif
+	if (max - off >= 16 && SC_HAS_SSE2)
+		off = sc_ascii_toX_sse2(s, off, max, o + (off - off0), lo, hi);
+	o += off - off0;
+#endif
 	m1.b[0] = m1.b[1] = m1.b[2] = m1.b[3] = SSU8_SX;
-	for (; off < szm4; off += 4) {
+	for (; off + 4 <= max; off += 4) {
 		a = S_LD_U32(s + off);
 		if ((a & m1.a32) == 0) {
 			b = (msk1 & a) + msk4;
@@ -89,6 +89,7 @@ int32_t sc_tolower_tr(int32_t c);
 int32_t sc_toupper_tr(int32_t c);
 size_t sc_parallel_toX(const char *s, size_t off, size_t max, char *o,
 		       int32_t (*ssc_toX)(int32_t));
+size_t sc_ascii_ncmpi(const char *a, const char *b, size_t n, int *res);
 
 #ifdef __cplusplus
 } /* extern "C" { */
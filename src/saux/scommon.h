@@ -132,6 +132,64 @@ extern "C" {
 #define S_LIKELY(expr) S_EXPECT((expr) != 0, 1)
 #define S_UNLIKELY(expr) S_EXPECT((expr) != 0, 0)
 
+#if defined(__GNUC__) && __GNUC__ >= 4 || defined(__clang__)                   \
+	|| defined(__INTEL_COMPILER)
+#define S_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define S_PREFETCH(addr)
+#endif
+
+/*
+ * x86 SIMD kernels (vectorized code paths, selected at run time):
+ * S_SIMD_X86_GNUC: GCC >= 4.9 or clang, with per-function target attributes
+ * and __builtin_cpu_supports() for CPU feature detection.
+ * S_SIMD_X64_MSVC: Visual Studio x64 (SSE2 always available).
+ */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#if defined(__clang__)                                                         \
+	|| (defined(__GNUC__)                                                  \
+	    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define S_SIMD_X86_GNUC
+#define S_SSE2_ATTR __attribute__((target("sse2")))
+#define S_SSSE3_ATTR __attribute__((target("ssse3")))
+#define S_AVX2_ATTR __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define S_SIMD_X64_MSVC
+#define S_SSE2_ATTR
+#endif
+#endif
+
+/*
+ * Atomic counters (reference counting of data shared between threads).
+ * S_ATOMIC_INC/DEC return the updated value. S_SPIN_TRYLOCK/UNLOCK operate
+ * on a 'volatile long' lock (0: unlocked), see s_spin_lock(). Without
+ * compiler support (S_ATOMIC_NONE) these are plain operations, not
+ * thread-safe.
+ */
+#if defined(__GNUC__)                                                          \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))            \
+	|| defined(__clang__) || defined(__INTEL_COMPILER)
+#define S_ATOMIC_INC(p) __sync_add_and_fetch(p, 1)
+#define S_ATOMIC_DEC(p) __sync_sub_and_fetch(p, 1)
+#define S_ATOMIC_GET(p) __sync_add_and_fetch(p, 0)
+#define S_SPIN_TRYLOCK(p) (__sync_lock_test_and_set(p, 1) == 0)
+#define S_SPIN_UNLOCK(p) __sync_lock_release(p)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define S_ATOMIC_INC(p) _InterlockedIncrement(p)
+#define S_ATOMIC_DEC(p) _InterlockedDecrement(p)
+#define S_ATOMIC_GET(p) _InterlockedOr(p, 0)
+#define S_SPIN_TRYLOCK(p) (_InterlockedExchange(p, 1) == 0)
+#define S_SPIN_UNLOCK(p) _InterlockedExchange(p, 0)
+#else
+#define S_ATOMIC_NONE
+#define S_ATOMIC_INC(p) (++*(p))
+#define S_ATOMIC_DEC(p) (--*(p))
+#define S_ATOMIC_GET(p) (*(p))
+#define S_SPIN_TRYLOCK(p) ((*(p) = 1) != 0)
+#define S_SPIN_UNLOCK(p) (*(p) = 0)
+#endif
+
 #if defined(S_C99_SUPPORT) || defined(__TINYC__)
 #define S_MODERN_COMPILER
 #ifndef S_NO_VARGS
@@ -309,6 +367,19 @@ S_INLINE srt_bool s_varg_tail_ptr_tag(const void *p)
 	return p == S_INVALID_PTR_VARG_TAIL ? S_TRUE : S_FALSE;
 }
 
+/* Spin lock, for short critical sections */
+S_INLINE void s_spin_lock(volatile long *l)
+{
+	while (!S_SPIN_TRYLOCK(l))
+		while (*l)
+			;
+}
+
+S_INLINE void s_spin_unlock(volatile long *l)
+{
+	S_SPIN_UNLOCK(l);
+}
+
 	/*
 	 * Artificial memory allocation limits (tests/debug)
 	 */
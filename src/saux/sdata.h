@@ -33,11 +33,13 @@ extern "C" {
  * Macros
  */
 
-#define SD_BUILDFUNCS_COMMON(pfix, t, tail_bytes)                              \
+#define SD_BUILDFUNCS_SHRINK(pfix, t, tail_bytes)                              \
 	S_INLINE t *pfix##_shrink(t **c)                                       \
 	{                                                                      \
 		return (t *)sd_shrink((srt_data **)c, tail_bytes);             \
-	}                                                                      \
+	}
+
+#define SD_BUILDFUNCS_COMMON0(pfix, t)                                         \
 	S_INLINE srt_bool pfix##_empty(const t *c)                             \
 	{                                                                      \
 		return pfix##_size(c) == 0 ? S_TRUE : S_FALSE;                 \
@@ -55,6 +57,10 @@ extern "C" {
 		return sd_alloc_errors((srt_data *)c);                         \
 	}
 
+#define SD_BUILDFUNCS_COMMON(pfix, t, tail_bytes)                              \
+	SD_BUILDFUNCS_SHRINK(pfix, t, tail_bytes)                              \
+	SD_BUILDFUNCS_COMMON0(pfix, t)
+
 #define SD_BUILDFUNCS_ST(pfix, t, stpfix)                                      \
 	S_INLINE size_t pfix##_size(const t *c)                                \
 	{                                                                      \
@@ -113,10 +119,14 @@ extern "C" {
 	SD_BUILDFUNCS_ST(pfix, t, sdx)                                         \
 	SD_BUILDFUNCS_COMMON(pfix, t, tail_bytes)
 
-#define SD_BUILDFUNCS_FULL_ST(pfix, t, tail_bytes)                             \
+/*
+ * Same as SD_BUILDFUNCS_FULL_ST(), except pfix_shrink(), for containers
+ * requiring their own (e.g. releasing or compacting associated memory)
+ */
+#define SD_BUILDFUNCS_FULL_ST0(pfix, t, tail_bytes)                            \
 	SD_BUILDFUNCS_ST(pfix, t, sd)                                          \
 	SD_BUILDFUNCS_ST2(pfix, t, sd)                                         \
-	SD_BUILDFUNCS_COMMON(pfix, t, tail_bytes)                              \
+	SD_BUILDFUNCS_COMMON0(pfix, t)                                         \
 	S_INLINE size_t pfix##_grow(t **c, size_t extra_elems)                 \
 	{                                                                      \
 		return sd_grow((srt_data **)c, extra_elems, tail_bytes);       \
@@ -126,6 +136,10 @@ extern "C" {
 		return sd_reserve((srt_data **)c, max_elems, tail_bytes);      \
 	}
 
+#define SD_BUILDFUNCS_FULL_ST(pfix, t, tail_bytes)                             \
+	SD_BUILDFUNCS_FULL_ST0(pfix, t, tail_bytes)                            \
+	SD_BUILDFUNCS_SHRINK(pfix, t, tail_bytes)
+
 #define SD_FREE_AUX(pfix, t)                                                   \
 	S_INLINE void pfix##_free_aux(t **c, ...)                              \
 	{                                                                      \
@@ -9,8 +9,58 @@
 
 #include "senc.h"
 #include "shash.h"
+#include "shuff.h"
 #include <stdlib.h>
 
+/*
+ * S_ENABLE_B64_VECTOR: SSSE3/AVX2 base64 encoding (12/24 input bytes per
+ * step) and decoding (16/32 input bytes per step), selected at run time.
+ *
+ * S_ENABLE_HEX_ESC_VECTOR: SSSE3/AVX2 hexadecimal encoding/decoding, and
+ * SSE2/AVX2 escape encoding (XML, JSON, URL, quotes): 16/32-byte blocks are
+ * classified at once, copying the spans not requiring escaping in bulk.
+ */
+
+#define S_ENABLE_B64_VECTOR
+#define S_ENABLE_HEX_ESC_VECTOR
+
+#ifdef S_MINIMAL
+#undef S_ENABLE_B64_VECTOR
+#undef S_ENABLE_HEX_ESC_VECTOR
+#endif
+
+#ifdef S_SIMD_X86_GNUC
+#ifdef S_ENABLE_B64_VECTOR
+#define SENC_B64_VEC
+#endif
+#ifdef S_ENABLE_HEX_ESC_VECTOR
+#define SENC_HEX_VEC
+#define SENC_ESC_VEC
+#endif
+#elif defined(S_SIMD_X64_MSVC) && defined(S_ENABLE_HEX_ESC_VECTOR)
+#define SENC_ESC_VEC /* SSE2 only */
+#endif
+
+#if defined(SENC_B64_VEC) || defined(SENC_HEX_VEC) || defined(SENC_ESC_VEC)
+#ifdef S_SIMD_X86_GNUC
+#include <immintrin.h>
+#define SENC_HAS_SSE2 __builtin_cpu_supports("sse2")
+#define SENC_HAS_SSSE3 __builtin_cpu_supports("ssse3")
+#define SENC_HAS_AVX2 __builtin_cpu_supports("avx2")
+#define SENC_BSR(m) (31 - __builtin_clz(m))
+#else
+#include <emmintrin.h>
+#include <intrin.h>
+#define SENC_HAS_SSE2 1 /* x64: SSE2 always */
+S_INLINE int SENC_BSR(unsigned m)
+{
+	unsigned long r;
+	_BitScanReverse(&r, m);
+	return (int)r;
+}
+#endif
+#endif
+
 #ifndef SDEBUG_LZ
 #define SDEBUG_LZ 0
 #endif
@@ -40,6 +90,15 @@
 #endif
 #endif
 
+/*
+ * Compression levels above 1 (match hash chains) require heap memory:
+ * window of up to 2^22 positions (4 MiB window, 32 MiB of heap for 64-bit
+ * mode), and, for optimal parsing, a cost table of 2^14 + 1 positions
+ */
+#define S_LZ_CHAIN_WBITS 22
+#define S_LZ_CHAIN_HBITS 20
+#define S_LZ_OPT_BLK 16384
+
 #if SDEBUG_LZ
 #define SZLOG(...) fprintf(stderr, __VA_ARGS__)
 #else
@@ -80,15 +139,25 @@ static const uint8_t b64e[64] = {
 	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
 	'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
 	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'};
+static const uint8_t b64e_url[64] = {
+	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+	'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+	'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '-', '_'};
+/* 6-bit value | SB64_STD (standard alphabet) | SB64_URL (URL alphabet) */
 static const uint8_t b64d[128] = {
-	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  62, 0,  0,  0,  63,
-	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 0,  0,  0,  0,  0,  0,
-	0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14,
-	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 0,  0,  0,  0,  0,
-	0,  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 0,  0,  0,  0,  0};
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x00, 0xbe, 0x00, 0x7f,
+	0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+	0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf, 0xd0, 0xd1, 0xd2,
+	0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0x00, 0x00, 0x00, 0x00, 0xbf,
+	0x00, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf, 0xe0, 0xe1, 0xe2, 0xe3, 0xe4,
+	0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef, 0xf0,
+	0xf1, 0xf2, 0xf3, 0x00, 0x00, 0x00, 0x00, 0x00};
 static const uint8_t n2h_l[16] = {48, 49, 50, 51, 52, 53,  54,  55,
 				  56, 57, 97, 98, 99, 100, 101, 102};
 static const uint8_t n2h_u[16] = {48, 49, 50, 51, 52, 53, 54, 55,
@@ -110,6 +179,9 @@ static const uint8_t h2n[64] = {
 #define DB64C1(a, b) ((uint8_t)(a << 2 | b >> 4))
 #define DB64C2(b, c) ((uint8_t)(b << 4 | c >> 2))
 #define DB64C3(c, d) ((uint8_t)(c << 6 | d))
+#define SB64_STD 0x40
+#define SB64_URL 0x80
+#define SB64_V(c) (b64d[(c)&0x7f] & 0x3f)
 
 /*
  * Internal functions
@@ -120,6 +192,122 @@ S_INLINE uint8_t hex2nibble(int h)
 	return h2n[(h - 48) & 0x3f];
 }
 
+#ifdef SENC_HEX_VEC
+
+/*
+ * Hexadecimal encoding: nibbles to characters with a 16-byte table shuffle,
+ * going backwards (in-place safe, as the scalar code)
+ */
+S_SSSE3_ATTR static size_t senc_hex_ssse3(const uint8_t *s, size_t i,
+					  uint8_t *o, const uint8_t *t)
+{
+	__m128i a, h, l;
+	const __m128i lut = _mm_loadu_si128((const __m128i *)t),
+		      m = _mm_set1_epi8(0x0f);
+	for (; i >= 16; i -= 16) {
+		a = _mm_loadu_si128((const __m128i *)(s + i - 16));
+		h = _mm_shuffle_epi8(lut,
+				     _mm_and_si128(_mm_srli_epi16(a, 4), m));
+		l = _mm_shuffle_epi8(lut, _mm_and_si128(a, m));
+		_mm_storeu_si128((__m128i *)(o + i * 2 - 32),
+				 _mm_unpacklo_epi8(h, l));
+		_mm_storeu_si128((__m128i *)(o + i * 2 - 16),
+				 _mm_unpackhi_epi8(h, l));
+	}
+	return i;
+}
+
+S_AVX2_ATTR static size_t senc_hex_avx2(const uint8_t *s, size_t i,
+					uint8_t *o, const uint8_t *t)
+{
+	__m256i a, h, l, x, y;
+	const __m256i lut = _mm256_broadcastsi128_si256(
+			      _mm_loadu_si128((const __m128i *)t)),
+		      m = _mm256_set1_epi8(0x0f);
+	for (; i >= 32; i -= 32) {
+		a = _mm256_loadu_si256((const __m256i *)(s + i - 32));
+		h = _mm256_shuffle_epi8(
+			lut, _mm256_and_si256(_mm256_srli_epi16(a, 4), m));
+		l = _mm256_shuffle_epi8(lut, _mm256_and_si256(a, m));
+		x = _mm256_unpacklo_epi8(h, l);
+		y = _mm256_unpackhi_epi8(h, l);
+		_mm256_storeu_si256((__m256i *)(o + i * 2 - 64),
+				    _mm256_permute2x128_si256(x, y, 0x20));
+		_mm256_storeu_si256((__m256i *)(o + i * 2 - 32),
+				    _mm256_permute2x128_si256(x, y, 0x31));
+	}
+	return i;
+}
+
+/*
+ * Hexadecimal decoding (0-9, A-F, a-f): character pairs to bytes with a
+ * multiply-add, going forwards. Stops at the first block having other
+ * characters (BEHAVIOR: decoded by the scalar code, as before)
+ */
+#define SDEC_HEX_NIBBLES(P, T, V, a, v, ok)                                    \
+	{                                                                      \
+		V d = P##_sub_epi8(a, P##_set1_epi8('0')),                     \
+		  x = P##_sub_epi8(P##_or_##T(a, P##_set1_epi8(0x20)),         \
+				   P##_set1_epi8('a' - 10)),                   \
+		  vd = P##_and_##T(P##_cmpgt_epi8(d, P##_set1_epi8(-1)),       \
+				   P##_cmpgt_epi8(P##_set1_epi8(10), d)),      \
+		  vx = P##_and_##T(P##_cmpgt_epi8(x, P##_set1_epi8(9)),        \
+				   P##_cmpgt_epi8(P##_set1_epi8(16), x));      \
+		v = P##_or_##T(P##_and_##T(vd, d), P##_and_##T(vx, x));        \
+		ok = P##_and_##T(ok, P##_or_##T(vd, vx));                      \
+	}
+
+S_SSSE3_ATTR static size_t sdec_hex_ssse3(const uint8_t *s, size_t i,
+					  size_t ss, uint8_t *o)
+{
+	__m128i a, b, ok;
+	const __m128i k = _mm_set1_epi16(0x0110);
+	for (; i + 32 <= ss; i += 32) {
+		ok = _mm_set1_epi8(-1);
+		SDEC_HEX_NIBBLES(_mm, si128, __m128i,
+				 _mm_loadu_si128((const __m128i *)(s + i)), a,
+				 ok);
+		SDEC_HEX_NIBBLES(_mm, si128, __m128i,
+				 _mm_loadu_si128((const __m128i *)(s + i + 16)),
+				 b, ok);
+		if (_mm_movemask_epi8(ok) != 0xffff)
+			break;
+		_mm_storeu_si128((__m128i *)(o + i / 2),
+				 _mm_packus_epi16(_mm_maddubs_epi16(a, k),
+						  _mm_maddubs_epi16(b, k)));
+	}
+	return i;
+}
+
+S_AVX2_ATTR static size_t sdec_hex_avx2(const uint8_t *s, size_t i,
+					size_t ss, uint8_t *o)
+{
+	__m256i a, b, ok;
+	const __m256i k = _mm256_set1_epi16(0x0110);
+	for (; i + 64 <= ss; i += 64) {
+		ok = _mm256_set1_epi8(-1);
+		SDEC_HEX_NIBBLES(
+			_mm256, si256, __m256i,
+			_mm256_loadu_si256((const __m256i *)(s + i)), a, ok);
+		SDEC_HEX_NIBBLES(
+			_mm256, si256, __m256i,
+			_mm256_loadu_si256((const __m256i *)(s + i + 32)), b,
+			ok);
+		if (_mm256_movemask_epi8(ok) != -1)
+			break;
+		/* packus works per 128-bit lane: 64-bit blocks reordered */
+		_mm256_storeu_si256(
+			(__m256i *)(o + i / 2),
+			_mm256_permute4x64_epi64(
+				_mm256_packus_epi16(_mm256_maddubs_epi16(a, k),
+						    _mm256_maddubs_epi16(b, k)),
+				0xd8));
+	}
+	return i;
+}
+
+#endif /* #ifdef SENC_HEX_VEC */
+
 static size_t senc_hex_aux(const uint8_t *s, size_t ss, uint8_t *o,
 			   const uint8_t *t)
 {
@@ -128,14 +316,22 @@ static size_t senc_hex_aux(const uint8_t *s, size_t ss, uint8_t *o,
 	RETURN_IF(!s, 0);
 	out_size = ss * 2;
 	i = ss;
-	j = out_size;
+#ifdef SENC_HEX_VEC
+	if (i >= 16) {
+		if (i >= 32 && SENC_HAS_AVX2)
+			i = senc_hex_avx2(s, i, o, t);
+		if (SENC_HAS_SSSE3)
+			i = senc_hex_ssse3(s, i, o, t);
+	}
+#endif
+	j = i * 2;
 #define ENCHEX_LOOP(ox, ix)                                                    \
 	{                                                                      \
 		int next = s[ix - 1];                                          \
 		o[ox - 2] = t[next >> 4];                                      \
 		o[ox - 1] = t[next & 0x0f];                                    \
 	}
-	if (ss % 2) {
+	if (i % 2) {
 		ENCHEX_LOOP(j, i);
 		i--;
 		j -= 2;
@@ -149,77 +345,365 @@ static size_t senc_hex_aux(const uint8_t *s, size_t ss, uint8_t *o,
 
 /*
  * Base64 encoding/decoding
+ *
+ * Encoding goes backwards and decoding forwards, so both work in-place.
+ * The vector kernels keep that order, loading every block before storing
+ * its output.
  */
 
-size_t senc_b64(const uint8_t *s, size_t ss, uint8_t *o)
+#ifdef SENC_B64_VEC
+
+/* 12 input bytes (loaded at positions 4 to 15) per 16 output characters */
+#define SENC_B64_SHUF                                                          \
+	_mm_setr_epi8(5, 4, 6, 5, 8, 7, 9, 8, 11, 10, 12, 11, 14, 13, 15, 14)
+/* Offset to be added to the 6-bit values, per range (see senc_b64_ssse3) */
+#define SENC_B64_LUT(t)                                                        \
+	_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,        \
+		      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,        \
+		      '0' - 52, (char)(t[62] - 62), (char)(t[63] - 63), 'A',   \
+		      0, 0)
+/* 4 x 6-bit values per 32-bit element to 3 bytes (bytes 0 to 11) */
+#define SDEC_B64_SHUF                                                          \
+	_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+#define SENC_M256X2(a) _mm256_inserti128_si256(_mm256_castsi128_si256(a), a, 1)
+
+#define SDEC_B64_ST12(o, a)                                                    \
+	{                                                                      \
+		uint32_t w = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(a, 8));\
+		_mm_storel_epi64((__m128i *)(o), a);                           \
+		memcpy((o) + 8, &w, 4);                                        \
+	}
+
+/*
+ * Shuffle-based encoding: the input bytes are placed so 16-bit multiplies
+ * move every 6-bit group to its own byte, and the byte range (A-Z, a-z,
+ * 0-9, 62, 63) selects the offset to ASCII from a 16-byte table.
+ */
+S_SSSE3_ATTR static size_t senc_b64_ssse3(const uint8_t *s, size_t i,
+					  uint8_t *o, const uint8_t *t)
+{
+	__m128i a, b;
+	const __m128i shuf = SENC_B64_SHUF, lut = SENC_B64_LUT(t),
+		      m0 = _mm_set1_epi32(0x0fc0fc00),
+		      k0 = _mm_set1_epi32(0x04000040),
+		      m1 = _mm_set1_epi32(0x003f03f0),
+		      k1 = _mm_set1_epi32(0x01000010), n51 = _mm_set1_epi8(51),
+		      n26 = _mm_set1_epi8(26), n13 = _mm_set1_epi8(13);
+	for (; i >= 16; i -= 12) {
+		a = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(s + i - 16)), shuf);
+		a = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(a, m0), k0),
+				 _mm_mullo_epi16(_mm_and_si128(a, m1), k1));
+		b = _mm_or_si128(_mm_subs_epu8(a, n51),
+				 _mm_and_si128(_mm_cmpgt_epi8(n26, a), n13));
+		_mm_storeu_si128((__m128i *)(o + i / 3 * 4 - 16),
+				 _mm_add_epi8(a, _mm_shuffle_epi8(lut, b)));
+	}
+	return i;
+}
+
+S_AVX2_ATTR static size_t senc_b64_avx2(const uint8_t *s, size_t i,
+					uint8_t *o, const uint8_t *t)
+{
+	__m256i a, b;
+	const __m256i shuf = SENC_M256X2(SENC_B64_SHUF),
+		      lut = SENC_M256X2(SENC_B64_LUT(t)),
+		      m0 = _mm256_set1_epi32(0x0fc0fc00),
+		      k0 = _mm256_set1_epi32(0x04000040),
+		      m1 = _mm256_set1_epi32(0x003f03f0),
+		      k1 = _mm256_set1_epi32(0x01000010),
+		      n51 = _mm256_set1_epi8(51), n26 = _mm256_set1_epi8(26),
+		      n13 = _mm256_set1_epi8(13);
+	for (; i >= 28; i -= 24) {
+		a = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(
+				(const __m128i *)(s + i - 28))),
+			_mm_loadu_si128((const __m128i *)(s + i - 16)), 1);
+		a = _mm256_shuffle_epi8(a, shuf);
+		a = _mm256_or_si256(
+			_mm256_mulhi_epu16(_mm256_and_si256(a, m0), k0),
+			_mm256_mullo_epi16(_mm256_and_si256(a, m1), k1));
+		b = _mm256_or_si256(
+			_mm256_subs_epu8(a, n51),
+			_mm256_and_si256(_mm256_cmpgt_epi8(n26, a), n13));
+		_mm256_storeu_si256(
+			(__m256i *)(o + i / 3 * 4 - 32),
+			_mm256_add_epi8(a, _mm256_shuffle_epi8(lut, b)));
+	}
+	return i;
+}
+
+/*
+ * Range-based decoding (c: accepted characters for 62 and 63, two each),
+ * stopping at the first block having invalid characters
+ */
+S_SSSE3_ATTR static size_t sdec_b64_ssse3(const uint8_t *s, size_t i,
+					  size_t n, uint8_t *o, const char *c)
+{
+	__m128i a, v, m, x, y, z;
+	const __m128i ua = _mm_set1_epi8('A' - 1), uz = _mm_set1_epi8('Z' + 1),
+		      la = _mm_set1_epi8('a' - 1), lz = _mm_set1_epi8('z' + 1),
+		      d0 = _mm_set1_epi8('0' - 1), d9 = _mm_set1_epi8('9' + 1),
+		      ku = _mm_set1_epi8(-65), kl = _mm_set1_epi8(-71),
+		      kd = _mm_set1_epi8(4), c62a = _mm_set1_epi8(c[0]),
+		      c62b = _mm_set1_epi8(c[1]), c63a = _mm_set1_epi8(c[2]),
+		      c63b = _mm_set1_epi8(c[3]), v62 = _mm_set1_epi8(62),
+		      v63 = _mm_set1_epi8(63),
+		      k0 = _mm_set1_epi32(0x01400140),
+		      k1 = _mm_set1_epi32(0x00011000), shuf = SDEC_B64_SHUF;
+	for (; i + 16 <= n; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(s + i));
+		x = _mm_and_si128(_mm_cmpgt_epi8(a, ua), _mm_cmpgt_epi8(uz, a));
+		y = _mm_and_si128(_mm_cmpgt_epi8(a, la), _mm_cmpgt_epi8(lz, a));
+		z = _mm_and_si128(_mm_cmpgt_epi8(a, d0), _mm_cmpgt_epi8(d9, a));
+		m = _mm_or_si128(_mm_or_si128(x, y), z);
+		v = _mm_or_si128(_mm_or_si128(_mm_and_si128(x, ku),
+					      _mm_and_si128(y, kl)),
+				 _mm_and_si128(z, kd));
+		v = _mm_and_si128(m, _mm_add_epi8(a, v));
+		x = _mm_or_si128(_mm_cmpeq_epi8(a, c62a),
+				 _mm_cmpeq_epi8(a, c62b));
+		y = _mm_or_si128(_mm_cmpeq_epi8(a, c63a),
+				 _mm_cmpeq_epi8(a, c63b));
+		if (_mm_movemask_epi8(_mm_or_si128(m, _mm_or_si128(x, y)))
+		    != 0xffff)
+			break;
+		a = _mm_or_si128(v,
+				 _mm_or_si128(_mm_and_si128(x, v62),
+					      _mm_and_si128(y, v63)));
+		a = _mm_madd_epi16(_mm_maddubs_epi16(a, k0), k1);
+		a = _mm_shuffle_epi8(a, shuf);
+		SDEC_B64_ST12(o + i / 4 * 3, a);
+	}
+	return i;
+}
+
+S_AVX2_ATTR static size_t sdec_b64_avx2(const uint8_t *s, size_t i,
+					size_t n, uint8_t *o, const char *c)
+{
+	__m256i a, v, m, x, y, z;
+	const __m256i ua = _mm256_set1_epi8('A' - 1),
+		      uz = _mm256_set1_epi8('Z' + 1),
+		      la = _mm256_set1_epi8('a' - 1),
+		      lz = _mm256_set1_epi8('z' + 1),
+		      d0 = _mm256_set1_epi8('0' - 1),
+		      d9 = _mm256_set1_epi8('9' + 1),
+		      ku = _mm256_set1_epi8(-65), kl = _mm256_set1_epi8(-71),
+		      kd = _mm256_set1_epi8(4), c62a = _mm256_set1_epi8(c[0]),
+		      c62b = _mm256_set1_epi8(c[1]),
+		      c63a = _mm256_set1_epi8(c[2]),
+		      c63b = _mm256_set1_epi8(c[3]),
+		      v62 = _mm256_set1_epi8(62), v63 = _mm256_set1_epi8(63),
+		      k0 = _mm256_set1_epi32(0x01400140),
+		      k1 = _mm256_set1_epi32(0x00011000),
+		      shuf = SENC_M256X2(SDEC_B64_SHUF);
+	for (; i + 32 <= n; i += 32) {
+		a = _mm256_loadu_si256((const __m256i *)(s + i));
+		x = _mm256_and_si256(_mm256_cmpgt_epi8(a, ua),
+				     _mm256_cmpgt_epi8(uz, a));
+		y = _mm256_and_si256(_mm256_cmpgt_epi8(a, la),
+				     _mm256_cmpgt_epi8(lz, a));
+		z = _mm256_and_si256(_mm256_cmpgt_epi8(a, d0),
+				     _mm256_cmpgt_epi8(d9, a));
+		m = _mm256_or_si256(_mm256_or_si256(x, y), z);
+		v = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(x, ku),
+						    _mm256_and_si256(y, kl)),
+				    _mm256_and_si256(z, kd));
+		v = _mm256_and_si256(m, _mm256_add_epi8(a, v));
+		x = _mm256_or_si256(_mm256_cmpeq_epi8(a, c62a),
+				    _mm256_cmpeq_epi8(a, c62b));
+		y = _mm256_or_si256(_mm256_cmpeq_epi8(a, c63a),
+				    _mm256_cmpeq_epi8(a, c63b));
+		if (_mm256_movemask_epi8(
+			    _mm256_or_si256(m, _mm256_or_si256(x, y)))
+		    != -1)
+			break;
+		a = _mm256_or_si256(
+			v, _mm256_or_si256(_mm256_and_si256(x, v62),
+					_mm256_and_si256(y, v63)));
+		a = _mm256_madd_epi16(_mm256_maddubs_epi16(a, k0), k1);
+		a = _mm256_shuffle_epi8(a, shuf);
+		SDEC_B64_ST12(o + i / 4 * 3, _mm256_castsi256_si128(a));
+		SDEC_B64_ST12(o + i / 4 * 3 + 12,
+			      _mm256_extracti128_si256(a, 1));
+	}
+	return i;
+}
+
+#endif /* #ifdef SENC_B64_VEC */
+
+static size_t senc_b64_aux(const uint8_t *s, size_t ss, uint8_t *o,
+			   const uint8_t *t, srt_bool pad)
 {
 	unsigned si0, si1, si2;
-	size_t ssod4, ssd3, tail, i, j, out_size;
-	RETURN_IF(!o, (ss / 3 + (ss % 3 ? 1 : 0)) * 4);
-	RETURN_IF(!s, 0);
-	ssod4 = (ss / 3) * 4;
+	size_t ssd3, tail, i, j, out_size;
 	ssd3 = ss - (ss % 3);
 	tail = ss - ssd3;
+	out_size = (ssd3 / 3) * 4 + (!tail ? 0 : pad ? 4 : tail + 1);
+	RETURN_IF(!o, out_size);
+	RETURN_IF(!s, 0);
 	i = ssd3;
-	j = ssod4 + (tail ? 4 : 0);
-	out_size = j;
+	j = (ssd3 / 3) * 4;
 	switch (tail) {
 	case 2:
 		si0 = s[ssd3];
 		si1 = s[ssd3 + 1];
-		o[j - 4] = b64e[EB64C1(si0)];
-		o[j - 3] = b64e[EB64C2(si0, si1)];
-		o[j - 2] = b64e[EB64C3(si1, 0)];
-		o[j - 1] = '=';
-		j -= 4;
+		o[j] = t[EB64C1(si0)];
+		o[j + 1] = t[EB64C2(si0, si1)];
+		o[j + 2] = t[EB64C3(si1, 0)];
+		if (pad)
+			o[j + 3] = '=';
 		break;
 	case 1:
 		si0 = s[ssd3];
-		o[j - 4] = b64e[EB64C1(si0)];
-		o[j - 3] = b64e[EB64C2(si0, 0)];
-		o[j - 2] = '=';
-		o[j - 1] = '=';
-		j -= 4;
+		o[j] = t[EB64C1(si0)];
+		o[j + 1] = t[EB64C2(si0, 0)];
+		if (pad) {
+			o[j + 2] = '=';
+			o[j + 3] = '=';
+		}
+	}
+#ifdef SENC_B64_VEC
+	if (i >= 16) {
+		if (i >= 28 && SENC_HAS_AVX2)
+			i = senc_b64_avx2(s, i, o, t);
+		if (SENC_HAS_SSSE3)
+			i = senc_b64_ssse3(s, i, o, t);
+		j = (i / 3) * 4;
 	}
+#endif
 	for (; i > 0; i -= 3, j -= 4) {
 		si0 = s[i - 3];
 		si1 = s[i - 2];
 		si2 = s[i - 1];
-		o[j - 4] = b64e[EB64C1(si0)];
-		o[j - 3] = b64e[EB64C2(si0, si1)];
-		o[j - 2] = b64e[EB64C3(si1, si2)];
-		o[j - 1] = b64e[EB64C4(si2)];
+		o[j - 4] = t[EB64C1(si0)];
+		o[j - 3] = t[EB64C2(si0, si1)];
+		o[j - 2] = t[EB64C3(si1, si2)];
+		o[j - 1] = t[EB64C4(si2)];
 	}
 	return out_size;
 }
 
-size_t sdec_b64(const uint8_t *s, size_t ss, uint8_t *o)
+/* First character not valid for the alphabet (n if all are valid) */
+static size_t sdec_b64_inv(const uint8_t *s, size_t n, int amask)
 {
-	size_t i, j, ssd4, tail;
-	RETURN_IF(!o, (ss / 4) * 3);
-	RETURN_IF(!s, 0);
-	i = 0;
-	j = 0;
-	ssd4 = ss - (ss % 4);
-	tail = s[ss - 2] == '=' || s[ss - 1] == '=' ? 4 : 0;
-	for (; i < ssd4 - tail; i += 4, j += 3) {
-		int a = b64d[s[i]], b = b64d[s[i + 1]], c = b64d[s[i + 2]],
-		    d = b64d[s[i + 3]];
-		o[j] = DB64C1(a, b);
-		o[j + 1] = DB64C2(b, c);
-		o[j + 2] = DB64C3(c, d);
+	size_t k = 0;
+	for (; k < n && !(s[k] & 0x80) && (b64d[s[k]] & amask); k++)
+		;
+	return k;
+}
+
+/*
+ * amask: accepted alphabets. Validation is done when 'inv_off' is not NULL,
+ * otherwise invalid characters are decoded as zero (BEHAVIOR: legacy mode)
+ */
+static size_t sdec_b64_aux(const uint8_t *s, size_t ss, uint8_t *o, int amask,
+			   size_t *inv_off)
+{
+	int a, b, c, d;
+	size_t i, j, k, body, tail, dtail;
+#ifdef SENC_B64_VEC
+	int vl;
+	const char *vc = amask == SB64_STD ? "++//"
+				: amask == SB64_URL ? "--__" : "+-/_";
+#endif
+	RETURN_IF(!o, (ss / 4) * 3 + (ss % 4 > 1 ? ss % 4 - 1 : 0));
+	if (inv_off)
+		*inv_off = S_NPOS;
+	RETURN_IF(!s || !ss, 0);
+	/* Last quantum: padded, unpadded (2 or 3 characters), or invalid */
+	tail = ss % 4;
+	if (!tail && (s[ss - 2] == '=' || s[ss - 1] == '='))
+		tail = 4;
+	body = ss - tail;
+	i = j = 0;
+#ifdef SENC_B64_VEC
+	vl = body < 16 ? 0 : SENC_HAS_AVX2 ? 2 : SENC_HAS_SSSE3 ? 1 : 0;
+#endif
+	while (i < body) {
+#ifdef SENC_B64_VEC
+		if (vl > 1)
+			i = sdec_b64_avx2(s, i, body, o, vc);
+		if (vl > 0)
+			i = sdec_b64_ssse3(s, i, body, o, vc);
+		j = (i / 4) * 3;
+#endif
+		/* Scalar: remaining data, or a block with invalid data */
+		for (k = S_MIN(i + 16, body); i < k; i += 4, j += 3) {
+			a = b64d[s[i] & 0x7f];
+			b = b64d[s[i + 1] & 0x7f];
+			c = b64d[s[i + 2] & 0x7f];
+			d = b64d[s[i + 3] & 0x7f];
+			if (inv_off
+			    && (((s[i] | s[i + 1] | s[i + 2] | s[i + 3]) & 0x80)
+				|| !(a & b & c & d & amask))) {
+				*inv_off = i + sdec_b64_inv(s + i, 4, amask);
+				return j;
+			}
+			a &= 0x3f;
+			b &= 0x3f;
+			c &= 0x3f;
+			d &= 0x3f;
+			o[j] = DB64C1(a, b);
+			o[j + 1] = DB64C2(b, c);
+			o[j + 2] = DB64C3(c, d);
+		}
+	}
+	if (tail == 1) {
+		if (inv_off)
+			*inv_off = i;
+		return j;
 	}
 	if (tail) {
-		int a = b64d[s[i] & 0x7f], b = b64d[s[i + 1] & 0x7f];
+		dtail = tail < 4 ? tail : s[i + 2] == '=' ? 2 : 3;
+		if (inv_off) {
+			k = sdec_b64_inv(s + i, dtail, amask);
+			if (k == dtail && tail == 4 && s[i + 3] != '=')
+				k = 3; /* "xx=x" */
+			if (k != dtail) {
+				*inv_off = i + k;
+				return j;
+			}
+		}
+		a = SB64_V(s[i]);
+		b = SB64_V(s[i + 1]);
 		o[j++] = DB64C1(a, b);
-		if (s[i + 2] != '=') {
-			int c = b64d[s[i + 2] & 0x7f];
+		if (dtail > 2) {
+			c = SB64_V(s[i + 2]);
 			o[j++] = DB64C2(b, c);
 		}
 	}
 	return j;
 }
 
+size_t senc_b64(const uint8_t *s, size_t ss, uint8_t *o)
+{
+	return senc_b64_aux(s, ss, o, b64e, S_TRUE);
+}
+
+size_t senc_b64_nopad(const uint8_t *s, size_t ss, uint8_t *o)
+{
+	return senc_b64_aux(s, ss, o, b64e, S_FALSE);
+}
+
+size_t senc_b64url(const uint8_t *s, size_t ss, uint8_t *o)
+{
+	return senc_b64_aux(s, ss, o, b64e_url, S_FALSE);
+}
+
+size_t sdec_b64(const uint8_t *s, size_t ss, uint8_t *o)
+{
+	return sdec_b64_aux(s, ss, o, SB64_STD | SB64_URL, NULL);
+}
+
+size_t sdec_b64_chk(const uint8_t *s, size_t ss, uint8_t *o, srt_bool url,
+		    size_t *inv_off)
+{
+	size_t inv_off_aux;
+	return sdec_b64_aux(s, ss, o, url ? SB64_URL : SB64_STD,
+			    inv_off ? inv_off : &inv_off_aux);
+}
+
 /*
  * Hexadecimal encoding/decoding
  */
@@ -236,28 +720,245 @@ size_t senc_HEX(const uint8_t *s, size_t ss, uint8_t *o)
 
 size_t sdec_hex(const uint8_t *s, size_t ss, uint8_t *o)
 {
-	size_t ssd2, ssd4, i, j;
+	size_t ssd2, ssd4, i, j, k;
+#ifdef SENC_HEX_VEC
+	int vl;
+#endif
 	RETURN_IF(!o, ss / 2);
 	ssd2 = ss - (ss % 2);
-	ssd4 = ss - (ss % 4);
 	ASSERT_RETURN_IF(!ssd2, 0);
 	i = 0;
 	j = 0;
+#ifdef SENC_HEX_VEC
+	vl = ssd2 < 32 ? 0 : SENC_HAS_AVX2 ? 2 : SENC_HAS_SSSE3 ? 1 : 0;
+#endif
 #define SDEC_HEX_L(n, m)                                                       \
 	o[j + n] = (uint8_t)(hex2nibble(s[i + m]) << 4)                        \
 		   | hex2nibble(s[i + m + 1]);
-	for (; i < ssd4; i += 4, j += 2) {
-		SDEC_HEX_L(0, 0);
-		SDEC_HEX_L(1, 2);
+	while (i < ssd2) {
+#ifdef SENC_HEX_VEC
+		if (vl > 1)
+			i = sdec_hex_avx2(s, i, ssd2, o);
+		if (vl > 0)
+			i = sdec_hex_ssse3(s, i, ssd2, o);
+		j = i / 2;
+#endif
+		/* Scalar: remaining data, or a block with other characters */
+		k = S_MIN(i + 32, ssd2);
+		ssd4 = k - ((k - i) % 4);
+		for (; i < ssd4; i += 4, j += 2) {
+			SDEC_HEX_L(0, 0);
+			SDEC_HEX_L(1, 2);
+		}
+		for (; i < k; i += 2, j += 1)
+			SDEC_HEX_L(0, 0);
 	}
-	for (; i < ssd2; i += 2, j += 1)
-		SDEC_HEX_L(0, 0);
 	return j;
 }
 
+/*
+ * Escape encoding
+ *
+ * Every byte gets a weight (the bytes added by its escape sequence, zero
+ * for bytes copied as-is). The vector kernels compute the weights of
+ * 16/32-byte blocks, adding them for the output size, and looking for the
+ * last byte requiring escaping (the encoders go backwards, as the output
+ * is larger than the input, so they work in-place).
+ */
+
+#ifdef SENC_ESC_VEC
+
+#define SENC_EQ(P, a, c) P##_cmpeq_epi8(a, P##_set1_epi8(c))
+#define SENC_IN(P, T, a, lo, hi)                                               \
+	P##_and_##T(P##_cmpgt_epi8(a, P##_set1_epi8((lo)-1)),                  \
+		    P##_cmpgt_epi8(P##_set1_epi8((hi) + 1), a))
+#define SENC_W(P, T, m, w) P##_and_##T(m, P##_set1_epi8(w))
+
+/* '"', '\\', and 8 to 13 except 11 ('\v'): 1 */
+#define SENC_ESC_W_JSON(P, T, a, tgt)                                          \
+	SENC_W(P, T,                                                           \
+	       P##_or_##T(P##_or_##T(SENC_EQ(P, a, '"'), SENC_EQ(P, a, '\\')), \
+			  P##_andnot_##T(SENC_EQ(P, a, 11),                    \
+					 SENC_IN(P, T, a, 8, 13))),            \
+	       1)
+
+/* '"', '\'': 5, '&': 4, '<', '>': 3 */
+#define SENC_ESC_W_XML(P, T, a, tgt)                                           \
+	P##_or_##T(                                                            \
+		P##_or_##T(SENC_W(P, T,                                        \
+				  P##_or_##T(SENC_EQ(P, a, '"'),               \
+					     SENC_EQ(P, a, '\'')),             \
+				  5),                                          \
+			   SENC_W(P, T, SENC_EQ(P, a, '&'), 4)),               \
+		SENC_W(P, T,                                                   \
+		       P##_or_##T(SENC_EQ(P, a, '<'), SENC_EQ(P, a, '>')), 3))
+
+/* Not in A-Z, a-z, 0-9, '-', '_', '.', '~': 2 */
+#define SENC_ESC_W_URL(P, T, a, tgt)                                           \
+	P##_andnot_##T(                                                        \
+		P##_or_##T(                                                    \
+			P##_or_##T(SENC_IN(P, T, a, 'A', 'Z'),                 \
+				   SENC_IN(P, T, a, 'a', 'z')),                \
+			P##_or_##T(                                            \
+				P##_or_##T(SENC_IN(P, T, a, '0', '9'),         \
+					   SENC_EQ(P, a, '~')),                \
+				P##_or_##T(SENC_IN(P, T, a, '-', '.'),         \
+					   SENC_EQ(P, a, '_')))),              \
+		P##_set1_epi8(2))
+
+/* 'tgt': 1 */
+#define SENC_ESC_W_BYTE(P, T, a, tgt) SENC_W(P, T, SENC_EQ(P, a, (char)tgt), 1)
+
+/*
+ * Per escape kind: span (start of the block not requiring escaping ending
+ * at 'i'), and extra (output bytes added by [0, *i), *i being set to the
+ * offset where the vector processing stopped)
+ */
+#define SENC_ESC_VEC_SSE2(kind, wf)                                            \
+	S_SSE2_ATTR static size_t senc_esc_##kind##_span_sse2(                 \
+		const uint8_t *s, size_t i, uint8_t tgt)                       \
+	{                                                                      \
+		int m;                                                         \
+		const __m128i z = _mm_setzero_si128();                         \
+		(void)tgt;                                                     \
+		for (; i >= 16; i -= 16) {                                     \
+			m = _mm_movemask_epi8(_mm_cmpeq_epi8(                  \
+				    wf(_mm, si128,                             \
+				       _mm_loadu_si128(                        \
+					       (const __m128i *)(s + i - 16)), \
+				       tgt),                                   \
+				    z))                                        \
+			    ^ 0xffff;                                          \
+			if (m)                                                 \
+				return i - 15 + SENC_BSR(m);                   \
+		}                                                              \
+		return i;                                                      \
+	}                                                                      \
+	S_SSE2_ATTR static size_t senc_esc_##kind##_extra_sse2(                \
+		const uint8_t *s, size_t ss, uint8_t tgt, size_t *i)           \
+	{                                                                      \
+		size_t k;                                                      \
+		uint64_t r[2];                                                 \
+		__m128i acc = _mm_setzero_si128();                             \
+		const __m128i z = _mm_setzero_si128();                         \
+		(void)tgt;                                                     \
+		for (k = 0; k + 16 <= ss; k += 16)                             \
+			acc = _mm_add_epi64(                                   \
+				acc,                                           \
+				_mm_sad_epu8(                                  \
+					wf(_mm, si128,                         \
+					   _mm_loadu_si128(                    \
+						   (const __m128i *)(s + k)),  \
+					   tgt),                               \
+					z));                                   \
+		_mm_storeu_si128((__m128i *)r, acc);                           \
+		*i = k;                                                        \
+		return (size_t)(r[0] + r[1]);                                  \
+	}
+
+#define SENC_ESC_VEC_AVX2(kind, wf)                                            \
+	S_AVX2_ATTR static size_t senc_esc_##kind##_span_avx2(                 \
+		const uint8_t *s, size_t i, uint8_t tgt)                       \
+	{                                                                      \
+		unsigned m;                                                    \
+		const __m256i z = _mm256_setzero_si256();                      \
+		(void)tgt;                                                     \
+		for (; i >= 32; i -= 32) {                                     \
+			m = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8( \
+				wf(_mm256, si256,                              \
+				   _mm256_loadu_si256(                         \
+					   (const __m256i *)(s + i - 32)),     \
+				   tgt),                                       \
+				z));                                           \
+			if (m)                                                 \
+				return i - 31 + SENC_BSR(m);                   \
+		}                                                              \
+		return senc_esc_##kind##_span_sse2(s, i, tgt);                 \
+	}                                                                      \
+	S_AVX2_ATTR static size_t senc_esc_##kind##_extra_avx2(                \
+		const uint8_t *s, size_t ss, uint8_t tgt, size_t *i)           \
+	{                                                                      \
+		size_t k, r;                                                   \
+		uint64_t r4[4];                                                \
+		__m256i acc = _mm256_setzero_si256();                          \
+		const __m256i z = _mm256_setzero_si256();                      \
+		(void)tgt;                                                     \
+		for (k = 0; k + 32 <= ss; k += 32)                             \
+			acc = _mm256_add_epi64(                                \
+				acc,                                           \
+				_mm256_sad_epu8(                               \
+					wf(_mm256, si256,                      \
+					   _mm256_loadu_si256(                 \
+						   (const __m256i *)(s + k)),  \
+					   tgt),                               \
+					z));                                   \
+		_mm256_storeu_si256((__m256i *)r4, acc);                       \
+		r = senc_esc_##kind##_extra_sse2(s + k, ss - k, tgt, i);       \
+		*i += k;                                                       \
+		return (size_t)(r4[0] + r4[1] + r4[2] + r4[3]) + r;            \
+	}
+
+#ifdef S_SIMD_X86_GNUC
+#define SENC_ESC_VEC_GEN(kind, wf)                                             \
+	SENC_ESC_VEC_SSE2(kind, wf)                                            \
+	SENC_ESC_VEC_AVX2(kind, wf)
+#define SENC_VL(n)                                                             \
+	((n) < 16 ? 0 : SENC_HAS_AVX2 ? 2 : SENC_HAS_SSE2 ? 1 : 0)
+#define SENC_ESC_SPAN(kind, s, i, tgt, vl)                                     \
+	((vl) > 1 ? senc_esc_##kind##_span_avx2(s, i, tgt)                     \
+		  : (vl) ? senc_esc_##kind##_span_sse2(s, i, tgt) : (i))
+#define SENC_ESC_EXTRA(kind, s, ss, tgt, i, vl)                                \
+	((vl) > 1 ? senc_esc_##kind##_extra_avx2(s, ss, tgt, i)                \
+		  : (vl) ? senc_esc_##kind##_extra_sse2(s, ss, tgt, i) : 0)
+#else
+#define SENC_ESC_VEC_GEN(kind, wf) SENC_ESC_VEC_SSE2(kind, wf)
+#define SENC_VL(n) ((n) < 16 ? 0 : 1)
+#define SENC_ESC_SPAN(kind, s, i, tgt, vl)                                     \
+	((vl) ? senc_esc_##kind##_span_sse2(s, i, tgt) : (i))
+#define SENC_ESC_EXTRA(kind, s, ss, tgt, i, vl)                                \
+	((vl) ? senc_esc_##kind##_extra_sse2(s, ss, tgt, i) : 0)
+#endif
+
+SENC_ESC_VEC_GEN(json, SENC_ESC_W_JSON)
+SENC_ESC_VEC_GEN(xml, SENC_ESC_W_XML)
+SENC_ESC_VEC_GEN(url, SENC_ESC_W_URL)
+SENC_ESC_VEC_GEN(byte, SENC_ESC_W_BYTE)
+
+#else
+#define SENC_VL(n) 0
+#define SENC_ESC_SPAN(kind, s, i, tgt, vl) ((void)(vl), (i))
+#define SENC_ESC_EXTRA(kind, s, ss, tgt, i, vl) ((void)(vl), 0)
+#endif /* #ifdef SENC_ESC_VEC */
+
+/*
+ * Bulk copy of the bytes not requiring escaping ending at 'i' (memmove, as
+ * encoding can be done in-place), leaving 'i' at the byte before them.
+ * After a short run (dense escaping) the next SENC_ESC_SCALAR bytes are
+ * handled by the scalar code, so the same block is not classified again
+ * once per output byte
+ */
+#define SENC_ESC_MIN_RUN 8
+#define SENC_ESC_SCALAR 32
+#define SENC_ESC_COPY(kind, tgt)                                               \
+	if (sk) {                                                              \
+		sk--;                                                          \
+	} else {                                                               \
+		k = SENC_ESC_SPAN(kind, s, i + 1, tgt, vl);                    \
+		if (i + 1 - k < SENC_ESC_MIN_RUN)                              \
+			sk = SENC_ESC_SCALAR;                                  \
+		if (k <= i) {                                                  \
+			j -= i + 1 - k;                                        \
+			memmove(o + j, s + k, i + 1 - k);                      \
+			if (!k)                                                \
+				break;                                         \
+			i = k - 1;                                             \
+		}                                                              \
+	}
+
 S_INLINE size_t senc_esc_xml_req_size(const uint8_t *s, size_t ss)
 {
-	size_t i = 0, sso = ss;
+	int vl = SENC_VL(ss);
+	size_t i = 0, sso = ss + SENC_ESC_EXTRA(xml, s, ss, 0, &i, vl);
 	for (; i < ss; i++)
 		switch (s[i]) {
 		case '"':
@@ -279,14 +980,17 @@ S_INLINE size_t senc_esc_xml_req_size(const uint8_t *s, size_t ss)
 
 size_t senc_esc_xml(const uint8_t *s, size_t ss, uint8_t *o, size_t known_sso)
 {
-	size_t sso, i, j;
+	size_t i, j, k, sk = 0, sso;
+	int vl;
 	RETURN_IF(!s, 0);
 	sso = known_sso ? known_sso : senc_esc_xml_req_size(s, ss);
 	RETURN_IF(!o, sso);
 	RETURN_IF(!ss, 0);
+	vl = SENC_VL(ss);
 	i = ss - 1;
 	j = sso;
 	for (; i != (size_t)-1; i--) {
+		SENC_ESC_COPY(xml, 0);
 		switch (s[i]) {
 		case '"':
 			j -= 6;
@@ -379,7 +1083,8 @@ size_t sdec_esc_xml(const uint8_t *s, size_t ss, uint8_t *o)
 
 S_INLINE size_t senc_esc_json_req_size(const uint8_t *s, size_t ss)
 {
-	size_t i = 0, sso = ss;
+	int vl = SENC_VL(ss);
+	size_t i = 0, sso = ss + SENC_ESC_EXTRA(json, s, ss, 0, &i, vl);
 	for (; i < ss; i++)
 		switch (s[i]) {
 		case '\b':
@@ -400,14 +1105,17 @@ S_INLINE size_t senc_esc_json_req_size(const uint8_t *s, size_t ss)
 /* BEHAVIOR: slash ('/') is not escaped (intentional) */
 size_t senc_esc_json(const uint8_t *s, size_t ss, uint8_t *o, size_t known_sso)
 {
-	size_t i, j, sso;
+	size_t i, j, k, sk = 0, sso;
+	int vl;
 	RETURN_IF(!s, 0);
 	sso = known_sso ? known_sso : senc_esc_json_req_size(s, ss);
 	RETURN_IF(!o, sso);
 	RETURN_IF(!ss, 0);
+	vl = SENC_VL(ss);
 	i = ss - 1;
 	j = sso;
 	for (; i != (size_t)-1; i--) {
+		SENC_ESC_COPY(json, 0);
 		switch (s[i]) {
 		case '\b':
 			j -= 2;
@@ -493,7 +1201,8 @@ size_t sdec_esc_json(const uint8_t *s, size_t ss, uint8_t *o)
 
 S_INLINE size_t senc_esc_url_req_size(const uint8_t *s, size_t ss)
 {
-	size_t i = 0, sso = ss;
+	int vl = SENC_VL(ss);
+	size_t i = 0, sso = ss + SENC_ESC_EXTRA(url, s, ss, 0, &i, vl);
 	for (; i < ss; i++) {
 		if ((s[i] >= 'A' && s[i] <= 'Z') || (s[i] >= 'a' && s[i] <= 'z')
 		    || (s[i] >= '0' && s[i] <= '9'))
@@ -514,14 +1223,17 @@ S_INLINE size_t senc_esc_url_req_size(const uint8_t *s, size_t ss)
 
 size_t senc_esc_url(const uint8_t *s, size_t ss, uint8_t *o, size_t known_sso)
 {
-	size_t i, j, sso;
+	size_t i, j, k, sk = 0, sso;
+	int vl;
 	RETURN_IF(!s, 0);
 	sso = known_sso ? known_sso : senc_esc_url_req_size(s, ss);
 	RETURN_IF(!o, sso);
 	RETURN_IF(!ss, 0);
+	vl = SENC_VL(ss);
 	i = ss - 1;
 	j = sso;
 	for (; i != (size_t)-1; i--) {
+		SENC_ESC_COPY(url, 0);
 		if ((s[i] >= 'A' && s[i] <= 'Z') || (s[i] >= 'a' && s[i] <= 'z')
 		    || (s[i] >= '0' && s[i] <= '9')) {
 			o[--j] = s[i];
@@ -564,7 +1276,8 @@ size_t sdec_esc_url(const uint8_t *s, size_t ss, uint8_t *o)
 
 S_INLINE size_t senc_esc_byte_req_size(const uint8_t *s, uint8_t tgt, size_t ss)
 {
-	size_t i = 0, sso = ss;
+	int vl = SENC_VL(ss);
+	size_t i = 0, sso = ss + SENC_ESC_EXTRA(byte, s, ss, tgt, &i, vl);
 	for (; i < ss; i++)
 		if (s[i] == tgt)
 			sso++;
@@ -574,14 +1287,17 @@ S_INLINE size_t senc_esc_byte_req_size(const uint8_t *s, uint8_t tgt, size_t ss)
 static size_t senc_esc_byte(const uint8_t *s, size_t ss, uint8_t tgt,
 			    uint8_t *o, size_t known_sso)
 {
-	size_t i, j, sso;
+	size_t i, j, k, sk = 0, sso;
+	int vl;
 	RETURN_IF(!s, 0);
 	sso = known_sso ? known_sso : senc_esc_byte_req_size(s, tgt, ss);
 	RETURN_IF(!o, sso);
 	RETURN_IF(!ss, 0);
+	vl = SENC_VL(ss);
 	i = ss - 1;
 	j = sso;
 	for (; i != (size_t)-1; i--) {
+		SENC_ESC_COPY(byte, tgt);
 		if (s[i] == tgt)
 			o[--j] = s[i];
 		o[--j] = s[i];
@@ -686,29 +1402,58 @@ S_INLINE size_t senc_lz_hash(size_t a)
 	return (a >> 24) + (a >> 20) + (a >> 13) + a;
 }
 
-static size_t senc_lz_aux(const uint8_t *s, size_t ss, uint8_t *o0,
-			  size_t hash_max_bits)
+/*
+ * Context hash table setup: reused if large enough, with entries from
+ * previous calls invalidated by moving the base forward (no clearing)
+ */
+static size_t *senc_lz_ctx_refs(struct SLzCtx *c, size_t hash_size,
+				size_t ss)
+{
+	size_t hash_elems = (size_t)1 << hash_size;
+	if (hash_size > c->hbits) {
+		if (c->refs)
+			s_free(c->refs);
+		c->refs = (size_t *)s_malloc(sizeof(size_t) * hash_elems);
+		c->hbits = c->refs ? hash_size : 0;
+		RETURN_IF(!c->refs, NULL); /* BEHAVIOR: out of memory */
+		c->base = S_SIZET_MAX; /* force clearing */
+	}
+	if (c->base > S_SIZET_MAX - ss) { /* base overflow */
+		memset(c->refs, 0, sizeof(size_t) << c->hbits);
+		c->base = 0;
+	}
+	return c->refs;
+}
+
+/*
+ * Encode s[start, ss), with s[0, start) as dictionary (matches are searched
+ * there, too). With 'sbits' != 0 (stream mode, see senc_lz_blk()), the hash
+ * table size is fixed, and the context entries are kept for the next call.
+ */
+static size_t senc_lz_aux(const uint8_t *s, size_t start, size_t ss,
+			  uint8_t *o0, size_t hash_max_bits, struct SLzCtx *c,
+			  size_t sbits)
 {
 	uint8_t *o;
 	const uint8_t *src, *tgt;
-	size_t dist, h, hash_elems, hash_size, hash_size0, i, last, len, plit,
-		*refs, *refsx, sm4, w32, xl, hash_mask;
+	size_t base, dist, h, hash_elems, hash_size, hash_size0, i, last, len,
+		plit, *refs, *refsx, sm4, w32, xl, hash_mask, n = ss - start;
 	/*
 	 * Max out bytes = (input size) * 1.125
 	 * (0 in case of edge case size_t overflow)
 	 */
-	RETURN_IF(!o0 && ss > 0, s_size_t_add(ss, ((ss / 8) * 10) + 32, 0));
-	RETURN_IF(!s || !o0 || !ss, 0);
+	RETURN_IF(!o0 && n > 0, s_size_t_add(n, ((n / 8) * 10) + 32, 0));
+	RETURN_IF(!s || !o0 || !n, 0);
 	/*
 	 * Header: unpacked length (compressed u64)
 	 */
 	o = o0;
-	s_st_pk_u64(&o, ss);
+	s_st_pk_u64(&o, n);
 	/*
 	 * Case of small input: store uncompresed if smaller than 5 bytes
 	 */
-	if (ss < 5) {
-		senc_lz_store_lit(&o, s, ss);
+	if (n < 5) {
+		senc_lz_store_lit(&o, s + start, n);
 		return (size_t)(o - o0);
 	}
 	/*
@@ -716,41 +1461,60 @@ static size_t senc_lz_aux(const uint8_t *s, size_t ss, uint8_t *o0,
 	 * ensure the hash initialization time don't hurt the case of small
 	 * inputs.
 	 */
-	hash_size0 = slog2((uint64_t)ss);
-	hash_size0 = S_MAX(10, hash_size0) - 2;
-	hash_size = S_RANGE(hash_size0, 3, hash_max_bits);
+	if (sbits) {
+		hash_size = sbits;
+	} else {
+		hash_size0 = slog2((uint64_t)ss);
+		hash_size0 = S_MAX(10, hash_size0) - 2;
+		hash_size = S_RANGE(hash_size0, 3, hash_max_bits);
+	}
 	hash_elems = (size_t)1 << hash_size;
 	hash_mask = hash_elems - 1;
 	/*
-	 * LUT allocation and initialization
+	 * LUT allocation and initialization. LUT entries are stored as 'base'
+	 * + offset, entries below 'base' being equivalent to offset 0
 	 */
-	/* If using more than 4 LUTs, avoid stack allocation */
-	if (hash_size > S_LZ_MAX_HASH_BITS_STACK) {
-		refsx = (size_t *)s_malloc(sizeof(*refs) * hash_elems);
-		RETURN_IF(!refsx, 0); /* BEHAVIOR: out of memory */
+	refsx = NULL;
+	if (c) {
+		refs = senc_lz_ctx_refs(c, hash_size, ss);
+		RETURN_IF(!refs, 0);
+		base = c->base;
 	} else {
-		refsx = NULL;
+		/* If using more than 4 LUTs, avoid stack allocation */
+		if (hash_size > S_LZ_MAX_HASH_BITS_STACK) {
+			refsx = (size_t *)s_malloc(sizeof(*refs) * hash_elems);
+			RETURN_IF(!refsx, 0); /* BEHAVIOR: out of memory */
+		}
+		refs = refsx ? refsx
+			     : (size_t *)s_alloca(sizeof(*refs) * hash_elems);
+		RETURN_IF(!refs, 0);
+		memset(refs, 0, sizeof(*refs) * hash_elems);
+		base = 0;
 	}
-	refs = refsx ? refsx : (size_t *)s_alloca(sizeof(*refs) * hash_elems);
-	RETURN_IF(!refs, 0);
-	memset(refs, 0, sizeof(*refs) * hash_elems);
+	/*
+	 * Dictionary positions (in stream mode these are already in the LUT)
+	 */
+	if (!sbits)
+		for (i = 0; i < start && i <= ss - 4; i++)
+			refs[senc_lz_hash(S_LD_U32(s + i)) & hash_mask] =
+				base + i;
 	/*
 	 * Compression loop
 	 */
-	plit = 0;
+	plit = start;
 	sm4 = ss - 4;
-	i = 0;
+	i = start;
 	w32 = S_LD_U32(s + i);
 	h = senc_lz_hash(w32) & hash_mask;
-	refs[h] = i;
-	for (i = 1; i <= sm4;) {
+	refs[h] = base + i;
+	for (i = start + 1; i <= sm4;) {
 		/*
 		 * Load 32-bit chunk and locate it into the LUT
 		 */
 		w32 = S_LD_U32(s + i);
 		h = senc_lz_hash(w32) & hash_mask;
-		last = refs[h];
-		refs[h] = i;
+		last = refs[h] >= base ? refs[h] - base : 0;
+		refs[h] = base + i;
 		/*
 		 * Locate matches in the LUT[s]
 		 */
@@ -789,17 +1553,412 @@ static size_t senc_lz_aux(const uint8_t *s, size_t ss, uint8_t *o0,
 		senc_lz_store_lit(&o, s + plit, ss - plit);
 	if (refsx)
 		s_free(refsx);
+	if (c && !sbits)
+		c->base = base + ss;
 	return (size_t)(o - o0);
 }
 
 size_t senc_lz(const uint8_t *s, size_t ss, uint8_t *o0)
 {
-	return senc_lz_aux(s, ss, o0, S_LZ_MAX_HASH_BITS_STACK);
+	return senc_lz_aux(s, 0, ss, o0, S_LZ_MAX_HASH_BITS_STACK, NULL, 0);
 }
 
 size_t senc_lzh(const uint8_t *s, size_t ss, uint8_t *o0)
 {
-	return senc_lz_aux(s, ss, o0, S_LZ_MAX_HASH_BITS);
+	return senc_lz_aux(s, 0, ss, o0, S_LZ_MAX_HASH_BITS, NULL, 0);
+}
+
+struct SLzCtx *senc_lz_ctx_alloc(void)
+{
+	struct SLzCtx *c = (struct SLzCtx *)s_malloc(sizeof(struct SLzCtx));
+	if (c) {
+		c->refs = NULL;
+		c->hbits = 0;
+		c->base = 0;
+	}
+	return c;
+}
+
+void senc_lz_ctx_free(struct SLzCtx *c)
+{
+	if (c) {
+		if (c->refs)
+			s_free(c->refs);
+		s_free(c);
+	}
+}
+
+size_t senc_lz_ctx(struct SLzCtx *c, const uint8_t *s, size_t ss, uint8_t *o0)
+{
+	return senc_lz_aux(s, 0, ss, o0, S_LZ_MAX_HASH_BITS_STACK, c, 0);
+}
+
+size_t senc_lzh_ctx(struct SLzCtx *c, const uint8_t *s, size_t ss,
+		    uint8_t *o0)
+{
+	return senc_lz_aux(s, 0, ss, o0, S_LZ_MAX_HASH_BITS, c, 0);
+}
+
+size_t senc_lz_blk(struct SLzCtx *c, const uint8_t *s, size_t start,
+		   size_t ss, uint8_t *o0, size_t max_ss)
+{
+	/* Hash table size from the maximum buffer size (same for every call) */
+	size_t sbits = S_MAX((size_t)slog2((uint64_t)max_ss), 12) - 2;
+	sbits = S_MIN(sbits, S_LZ_MAX_HASH_BITS);
+	RETURN_IF(!c || start > ss, 0);
+	return senc_lz_aux(s, start, ss, o0, sbits, c, sbits);
+}
+
+size_t senc_lz_dict(const uint8_t *s, size_t start, size_t ss, uint8_t *o0,
+		    srt_bool lzh)
+{
+	RETURN_IF(start > ss, 0);
+	return senc_lz_aux(s, start, ss, o0,
+			   lzh ? S_LZ_MAX_HASH_BITS : S_LZ_MAX_HASH_BITS_STACK,
+			   NULL, 0);
+}
+
+/*
+ * Compression levels: 0 and 1 are senc_lz() and senc_lzh() (greedy parsing,
+ * one match candidate per position). Levels 2 to 8 search hash chains of
+ * increasing depth, with lazy matching (a reference is delayed if the next
+ * position gives a better one). Level 9 uses optimal parsing: the cheapest
+ * sequence of literals and references (encoded size) is computed for every
+ * S_LZ_OPT_BLK positions, from all the match lengths found in the chains.
+ * All levels use the same opcodes, so sdec_lz() decodes any of them.
+ */
+struct SLzLevel {
+	uint16_t depth; /* maximum match candidates checked per position */
+	uint16_t nice;	/* match length stopping the search */
+	uint8_t lazy;	/* positions checked after a match (0: greedy) */
+	uint8_t opt;	/* optimal parsing */
+};
+
+static const struct SLzLevel senc_lz_levels[S_LZ_LEVEL_MAX + 1] = {
+	{0, 0, 0, 0},	  {0, 0, 0, 0},	    {4, 32, 0, 0},
+	{8, 64, 1, 0},	  {16, 64, 1, 0},   {32, 128, 1, 0},
+	{64, 128, 2, 0},  {256, 256, 2, 0}, {1024, 512, 2, 0},
+	{256, 512, 0, 1}};
+
+/* Match finder: hash chains over a window of 'wmask' + 1 positions */
+struct SLzChain {
+	const uint8_t *s;
+	size_t ss;
+	size_t *head; /* last position + 1 per hash (0: empty) */
+	size_t *prev; /* previous position + 1 with the same hash */
+	size_t hmask, wmask, depth, nice;
+};
+
+S_INLINE size_t senc_lz_pk_size(uint64_t v)
+{
+	size_t n = 1;
+	for (; n < 8 && (v >> (7 * n)); n++)
+		;
+	return n == 8 && (v >> 56) ? 9 : n;
+}
+
+/* Encoded reference size (same opcode selection as senc_lz_store_ref()) */
+static size_t senc_lz_ref_size(size_t dist, size_t len)
+{
+	uint64_t dm1 = (uint64_t)dist - 1, lm4 = (uint64_t)len - 4;
+	if (dm1 < LZOP_REFVX_DRANGE && lm4 < LZOP_REFVX_LRANGE)
+		return senc_lz_pk_size((dm1 << LZOP_REFVX_DSHIFT)
+				       | (lm4 << LZOP_REFVX_LSHIFT)
+				       | LZOP_REFVX);
+	return senc_lz_pk_size((lm4 << LZOP_REFVV_NBITS) | LZOP_REFVV)
+	       + senc_lz_pk_size(dm1);
+}
+
+/* Literal opcode size for a run of 'n' literals (0 for no literals) */
+static size_t senc_lz_lit_size(size_t n)
+{
+	return n ? senc_lz_pk_size(((uint64_t)(n - 1) << LZOP_LITV_NBITS)
+				   | LZOP_LITV)
+		 : 0;
+}
+
+/*
+ * Bytes saved by a reference (0 if not worth it: it must save at least
+ * two bytes, as it could split a literal run)
+ */
+static size_t senc_lz_gain(size_t len, size_t dist)
+{
+	size_t rs;
+	RETURN_IF(len < 4, 0);
+	rs = senc_lz_ref_size(dist, len);
+	return len > rs + 1 ? len - rs : 0;
+}
+
+S_INLINE void senc_lzc_ins(struct SLzChain *m, size_t i)
+{
+	size_t h = senc_lz_hash(S_LD_U32(m->s + i)) & m->hmask;
+	m->prev[i & m->wmask] = m->head[h];
+	m->head[h] = i + 1;
+}
+
+/*
+ * Longest match for s[i, ss) (0 if none), 'i' not being inserted yet. If
+ * 'cl' is not NULL, every match longer than the previous ones is stored
+ * (length in 'cl', distance in 'cd', count in '*nc', up to 'nice' entries)
+ */
+static size_t senc_lzc_find(const struct SLzChain *m, size_t i, size_t *dist,
+			    size_t *cl, size_t *cd, size_t *nc)
+{
+	const uint8_t *s = m->s;
+	size_t cand, p, len, best = 3, depth = m->depth, xl = m->ss - i,
+		nice = S_MIN(m->nice, xl), w32 = S_LD_U32(s + i);
+	cand = m->head[senc_lz_hash(w32) & m->hmask];
+	for (; cand && depth > 0; depth--) {
+		p = cand - 1;
+		if (i - p > m->wmask)
+			break;
+		if (s[p + best] == s[i + best] && S_LD_U32(s + p) == w32) {
+			len = senc_lz_match(s + p + 4, s + i + 4, xl - 4) + 4;
+			if (len > best) {
+				best = len;
+				*dist = i - p;
+				if (cl) {
+					cl[*nc] = len;
+					cd[*nc] = i - p;
+					(*nc)++;
+				}
+				if (len >= nice)
+					break;
+			}
+		}
+		cand = m->prev[p & m->wmask];
+	}
+	return best > 3 ? best : 0;
+}
+
+/* Hash chain setup, inserting the dictionary s[0, start) tail */
+static srt_bool senc_lzc_init(struct SLzChain *m, const uint8_t *s,
+			      size_t start, size_t ss,
+			      const struct SLzLevel *lv)
+{
+	size_t i, wbits, hbits;
+	wbits = S_MIN((size_t)slog2((uint64_t)ss) + 1, S_LZ_CHAIN_WBITS);
+	hbits = S_MIN(wbits, S_LZ_CHAIN_HBITS);
+	m->head = (size_t *)s_malloc(sizeof(size_t)
+				     * (((size_t)1 << hbits)
+					+ ((size_t)1 << wbits)));
+	RETURN_IF(!m->head, S_FALSE); /* BEHAVIOR: out of memory */
+	memset(m->head, 0, sizeof(size_t) << hbits);
+	m->prev = m->head + ((size_t)1 << hbits);
+	m->s = s;
+	m->ss = ss;
+	m->hmask = ((size_t)1 << hbits) - 1;
+	m->wmask = ((size_t)1 << wbits) - 1;
+	m->depth = lv->depth;
+	m->nice = lv->nice;
+	for (i = start > m->wmask ? start - m->wmask : 0;
+	     i < start && i + 4 <= ss; i++)
+		senc_lzc_ins(m, i);
+	return S_TRUE;
+}
+
+/* Greedy/lazy parsing */
+static void senc_lzc_lazy(struct SLzChain *m, size_t start, uint8_t **o,
+			  size_t lazy)
+{
+	const uint8_t *s = m->s;
+	size_t i, j, k, plit, len, len2, gain, gain2, dist = 0, dist2 = 0,
+		sm4 = m->ss - 4;
+	for (i = plit = start; i <= sm4;) {
+		len = senc_lzc_find(m, i, &dist, NULL, NULL, NULL);
+		senc_lzc_ins(m, i);
+		gain = senc_lz_gain(len, dist);
+		if (!gain) {
+			i++;
+			continue;
+		}
+		/*
+		 * Lazy matching: if the next position gives a better
+		 * reference, the current one is stored as literal
+		 */
+		for (k = 0; k < lazy && i < sm4; k++) {
+			len2 = senc_lzc_find(m, i + 1, &dist2, NULL, NULL,
+					     NULL);
+			gain2 = senc_lz_gain(len2, dist2);
+			if (gain2 <= gain)
+				break;
+			i++;
+			senc_lzc_ins(m, i);
+			len = len2;
+			dist = dist2;
+			gain = gain2;
+		}
+		if (i > plit)
+			senc_lz_store_lit(o, s + plit, i - plit);
+		senc_lz_store_ref(o, dist, len);
+		for (j = i + 1; j < i + len && j <= sm4; j++)
+			senc_lzc_ins(m, j);
+		i += len;
+		plit = i;
+	}
+	if (m->ss > plit)
+		senc_lz_store_lit(o, s + plit, m->ss - plit);
+}
+
+/*
+ * Optimal parsing: minimum encoded size for reaching every position of the
+ * block ('price'), from the previous position (literal) or from any match
+ * found for the previous positions ('step' and 'sdist' being the last
+ * operation, 'run' the literal run length). Matches of 'nice' length or
+ * longer end the block, and are stored directly.
+ */
+static srt_bool senc_lzc_opt(struct SLzChain *m, size_t start, uint8_t **o)
+{
+	const uint8_t *s = m->s;
+	size_t *mem, *price, *step, *sdist, *run, *cl, *cd, blk, c, e, i, j, k,
+		kend, l, l0, ml, md = 0, nc, p, plit, r, sm4 = m->ss - 4;
+	blk = S_LZ_OPT_BLK;
+	mem = (size_t *)s_malloc(sizeof(size_t)
+				 * (4 * (blk + 1) + 2 * m->nice));
+	RETURN_IF(!mem, S_FALSE); /* BEHAVIOR: out of memory */
+	price = mem;
+	step = price + blk + 1;
+	sdist = step + blk + 1;
+	run = sdist + blk + 1;
+	cl = run + blk + 1;
+	cd = cl + m->nice;
+	for (p = plit = start; p <= sm4;) {
+		e = S_MIN(p + blk, m->ss);
+		price[0] = 0;
+		run[0] = p - plit;
+		for (k = 1; k <= e - p; k++)
+			price[k] = S_SIZET_MAX;
+		ml = 0;
+		for (k = 0; p + k < e; k++) {
+			i = p + k;
+			r = run[k];
+			c = price[k] + 1 + senc_lz_lit_size(r + 1)
+			    - senc_lz_lit_size(r);
+			if (c < price[k + 1]) {
+				price[k + 1] = c;
+				step[k + 1] = 1;
+				run[k + 1] = r + 1;
+			}
+			if (i > sm4)
+				continue;
+			nc = 0;
+			ml = senc_lzc_find(m, i, &md, cl, cd, &nc);
+			senc_lzc_ins(m, i);
+			if (ml >= m->nice)
+				break;
+			for (j = 0, l0 = 4; j < nc; j++) {
+				l = S_MIN(cl[j], e - i);
+				for (; l0 <= l; l0++) {
+					c = price[k]
+					    + senc_lz_ref_size(cd[j], l0);
+					if (c < price[k + l0]) {
+						price[k + l0] = c;
+						step[k + l0] = l0;
+						sdist[k + l0] = cd[j];
+						run[k + l0] = 0;
+					}
+				}
+			}
+			ml = 0;
+		}
+		/*
+		 * Backtracking ('run' is reused for the links to the next
+		 * position), and output
+		 */
+		kend = k;
+		for (k = kend; k > 0; k -= step[k])
+			run[k - step[k]] = k;
+		for (k = 0; k < kend; k = j) {
+			j = run[k];
+			if (step[j] == 1)
+				continue;
+			if (p + k > plit)
+				senc_lz_store_lit(o, s + plit, p + k - plit);
+			senc_lz_store_ref(o, sdist[j], step[j]);
+			plit = p + j;
+		}
+		p += kend;
+		if (ml) { /* long match */
+			if (p > plit)
+				senc_lz_store_lit(o, s + plit, p - plit);
+			senc_lz_store_ref(o, md, ml);
+			for (j = p + 1; j < p + ml && j <= sm4; j++)
+				senc_lzc_ins(m, j);
+			p += ml;
+			plit = p;
+		}
+	}
+	if (m->ss > plit)
+		senc_lz_store_lit(o, s + plit, m->ss - plit);
+	s_free(mem);
+	return S_TRUE;
+}
+
+static size_t senc_lz_lvl_aux(const uint8_t *s, size_t start, size_t ss,
+			      uint8_t *o0, int level)
+{
+	uint8_t *o;
+	srt_bool ok;
+	struct SLzChain m;
+	const struct SLzLevel *lv;
+	size_t n = ss - start;
+	level = S_RANGE(level, 0, S_LZ_LEVEL_MAX);
+#ifndef S_LZ_ALLOW_HEAP_USAGE
+	level = S_MIN(level, 1);
+#endif
+	if (level < 2)
+		return senc_lz_aux(s, start, ss, o0,
+				   level ? S_LZ_MAX_HASH_BITS
+					 : S_LZ_MAX_HASH_BITS_STACK,
+				   NULL, 0);
+	/* Same output size limit and header as senc_lz_aux() */
+	RETURN_IF(!o0 && n > 0, s_size_t_add(n, ((n / 8) * 10) + 32, 0));
+	RETURN_IF(!s || !o0 || !n, 0);
+	o = o0;
+	s_st_pk_u64(&o, n);
+	if (n < 5) {
+		senc_lz_store_lit(&o, s + start, n);
+		return (size_t)(o - o0);
+	}
+	lv = &senc_lz_levels[level];
+	RETURN_IF(!senc_lzc_init(&m, s, start, ss, lv), 0);
+	if (lv->opt) {
+		ok = senc_lzc_opt(&m, start, &o);
+	} else {
+		senc_lzc_lazy(&m, start, &o, lv->lazy);
+		ok = S_TRUE;
+	}
+	s_free(m.head);
+	return ok ? (size_t)(o - o0) : 0;
+}
+
+size_t senc_lz_lvl(const uint8_t *s, size_t ss, uint8_t *o0, int level)
+{
+	return senc_lz_lvl_aux(s, 0, ss, o0, level);
+}
+
+#define MK_SENC_LZ_LVL(n)                                                      \
+	static size_t senc_lz##n(const uint8_t *s, size_t ss, uint8_t *o0)     \
+	{                                                                      \
+		return senc_lz_lvl_aux(s, 0, ss, o0, n);                       \
+	}
+
+MK_SENC_LZ_LVL(2)
+MK_SENC_LZ_LVL(3)
+MK_SENC_LZ_LVL(4)
+MK_SENC_LZ_LVL(5)
+MK_SENC_LZ_LVL(6)
+MK_SENC_LZ_LVL(7)
+MK_SENC_LZ_LVL(8)
+MK_SENC_LZ_LVL(9)
+
+static const srt_enc_f senc_lz_lvl_fs[S_LZ_LEVEL_MAX + 1] = {
+	senc_lz,  senc_lzh, senc_lz2, senc_lz3, senc_lz4,
+	senc_lz5, senc_lz6, senc_lz7, senc_lz8, senc_lz9};
+
+srt_enc_f senc_lz_lvl_f(int level)
+{
+	return senc_lz_lvl_fs[S_RANGE(level, 0, S_LZ_LEVEL_MAX)];
 }
 
 S_INLINE void s_reccpy1(uint8_t *o, size_t dist, size_t n)
@@ -809,13 +1968,17 @@ S_INLINE void s_reccpy1(uint8_t *o, size_t dist, size_t n)
 		o[j] = o[j - dist];
 }
 
-S_INLINE void s_reccpy(uint8_t *o, size_t dist, size_t n)
+/*
+ * 'room': output bytes available, so short copies write 16 bytes only if
+ * not writing after the output (e.g. blocks decoded in parallel)
+ */
+S_INLINE void s_reccpy(uint8_t *o, size_t dist, size_t n, size_t room)
 {
 	size_t i, n2, chunk;
 	const uint8_t *s = o - dist;
-	/* non-overlapped copy */
+	/* non-overlapped copy (16 bytes at once only if not overlapping) */
 	if (dist >= n) {
-		memcpy(o, s, n <= 16 ? 16 : n);
+		memcpy(o, s, n <= 16 && dist >= 16 && room >= 16 ? 16 : n);
 		return;
 	}
 	/* overlapped/recursive copy: repeat 'dist' segment filling 'n' bytes */
@@ -836,9 +1999,10 @@ S_INLINE void s_reccpy(uint8_t *o, size_t dist, size_t n)
 		memcpy(o + i, s, n - i);
 }
 
-S_INLINE void sdec_lz_load_ref(uint8_t **o, size_t dist, size_t len)
+S_INLINE void sdec_lz_load_ref(uint8_t **o, size_t dist, size_t len,
+			       const uint8_t *o_top)
 {
-	s_reccpy(*o, dist, len);
+	s_reccpy(*o, dist, len, (size_t)(o_top - *o));
 	(*o) += len;
 }
 
@@ -849,36 +2013,164 @@ S_INLINE void sdec_lz_load_lit(const uint8_t **s, uint8_t **o, size_t cnt)
 	(*o) += cnt;
 }
 
-/* BEHAVIOR: safety for avoiding decompression buffer overflow */
-#define SDEC_LZ_ILOOP_OVERFLOW_CHECK(s, s_top, o, o_top, sz)                   \
-	if (S_UNLIKELY(o + sz > o_top)) {                                      \
-		s = s_top;                                                     \
-		continue;                                                      \
+/*
+ * Reference to an external history ending at 'h_top' (dictionary): copy
+ * the bytes coming from there, returning the bytes left (from the output)
+ */
+S_INLINE size_t sdec_lz_load_xref(uint8_t **o, size_t dist, size_t len,
+				  const uint8_t *o0, const uint8_t *h_top)
+{
+	size_t back = dist - (size_t)(*o - o0), n = S_MIN(back, len);
+	memcpy(*o, h_top - back, n);
+	(*o) += n;
+	return len - n;
+}
+
+#define SDEC_LZ_XREF                                                           \
+	if (h_top != o0 && dist > (size_t)(o - o0)) {                          \
+		len = sdec_lz_load_xref(&o, dist, len, o0, h_top);             \
+		if (!len)                                                      \
+			continue;                                              \
 	}
 
-size_t sdec_lz(const uint8_t *s0, size_t ss, uint8_t *o0)
+/*
+ * BEHAVIOR: safety for avoiding decompression buffer overflow, and for
+ * not reading outside of the input and the history (invalid input)
+ */
+#define SDEC_LZ_ILOOP_CHECK(cond)                                              \
+	if (S_UNLIKELY(cond)) {                                                \
+		err = S_TRUE;                                                  \
+		break;                                                         \
+	}
+
+/*
+ * Fast decoding (output buffer with S_LZ_DEC_SLACK bytes after the end):
+ * opcodes are loaded 8 bytes at once, short literal runs are copied 32 bytes
+ * at once, and references 16 bytes at once, repeating a 16-byte pattern for
+ * distances below 16. Bytes written after the current opcode output are
+ * overwritten by the next one (or land in the slack area). Near the input
+ * end, the careful loop decodes the remaining opcodes.
+ */
+#define SDEC_LZ_WILD 32
+#define SDEC_LZ_FAST_IN (9 + SDEC_LZ_WILD) /* min input: opcode + literals */
+
+/* Packed integer size from its first byte (lowest bit set, 0: invalid) */
+static const uint8_t sdec_lz_pk_sz[8] = {1, 2, 7, 3, 9, 6, 5, 4};
+/* Pattern step for distances below 16 (largest multiple <= 16) */
+static const uint8_t sdec_lz_pat_step[16] = {0,  16, 16, 15, 16, 15, 12, 14,
+					     16, 9,  10, 11, 12, 13, 14, 15};
+
+S_INLINE uint64_t sdec_lz_ld_pk(const uint8_t **s)
+{
+	uint64_t w = S_LD_LE_U64(*s);
+	unsigned h = (unsigned)w & 0xff;
+	size_t sz = h ? sdec_lz_pk_sz[(((h & (0u - h)) * 0x1d) & 0xff) >> 5] : 0;
+	(*s) += sz;
+	return sz < 8 ? (w >> sz) & S_NBITMASK64(7 * sz) : S_LD_LE_U64(*s - 8);
+}
+
+S_INLINE void sdec_lz_wild_lit(uint8_t *o, const uint8_t *s, size_t n)
+{
+	if (n > SDEC_LZ_WILD) {
+		memcpy(o, s, n);
+		return;
+	}
+	memcpy(o, s, 16);
+	memcpy(o + 16, s + 16, 16);
+}
+
+S_INLINE void sdec_lz_wild_ref(uint8_t *o, size_t dist, size_t n)
+{
+	size_t k, c;
+	uint8_t pat[16];
+	const uint8_t *r = o - dist, *top = o + n;
+	if (dist >= 16) {
+		do {
+			memcpy(o, r, 16);
+			o += 16;
+			r += 16;
+		} while (o < top);
+		return;
+	}
+	memcpy(pat, r, dist);
+	for (k = dist; k < 16; k += c) {
+		c = S_MIN(k, 16 - k);
+		memcpy(pat + k, pat, c);
+	}
+	k = sdec_lz_pat_step[dist];
+	do {
+		memcpy(o, pat, 16);
+		o += k;
+	} while (o < top);
+}
+
+/*
+ * Decode with 'hist' bytes of history before 'h_top' (references can point
+ * there; 'h_top' is 'o0', unless using an external dictionary). 'max_out':
+ * S_NPOS for the legacy behavior (on error, return the bytes decoded until
+ * that point), otherwise the maximum output size (on error, or output size
+ * different than the expected, return S_NPOS).
+ * 'fast': the output buffer has S_LZ_DEC_SLACK bytes after the end
+ */
+static size_t sdec_lz_aux(const uint8_t *s0, size_t ss, uint8_t *o0,
+			  const uint8_t *h_top, size_t hist, size_t max_out,
+			  srt_bool fast)
 {
-#if SDEBUG_LZ
-	const uint8_t *s_bk;
-#endif
 	uint64_t op64;
 	uint8_t *o, op8;
-	const uint8_t *s, *s_top, *o_top;
+	srt_bool err = S_FALSE, strict = max_out != S_NPOS;
+	const uint8_t *s, *s_bk, *s_top, *o_top;
 	size_t dist, len, expected_ss;
-	RETURN_IF(!s0 || ss < 3, 0); /* too small input (min hdr + opcode) */
+	RETURN_IF(!s0 || ss < 3, strict ? S_NPOS : 0); /* min hdr + opcode */
 	s = s0;
 	expected_ss = (size_t)s_ld_pk_u64(&s, ss);
-	RETURN_IF(ss <= (size_t)(s - s0), 0); /* invalid: incomplete header */
-	RETURN_IF(!o0, expected_ss + 16);     /* max out size */
+	/* invalid: incomplete header */
+	RETURN_IF(ss <= (size_t)(s - s0), strict ? S_NPOS : 0);
+	RETURN_IF(!o0, expected_ss + S_LZ_DEC_SLACK); /* max out size */
+	RETURN_IF(strict && expected_ss > max_out, S_NPOS);
 	s_top = s0 + ss;
 	RETURN_IF(s_top < s0, 0); /* BEHAVIOR: error on overflow */
 	o = o0;
 	o_top = o + expected_ss;
-	while (s < s_top) {
-#if SDEBUG_LZ
+	while (fast && (size_t)(s_top - s) >= SDEC_LZ_FAST_IN) {
+		s_bk = s;
+		op64 = sdec_lz_ld_pk(&s);
+		SDEC_LZ_ILOOP_CHECK(s == s_bk);
+		if ((op64 & LZOP_REFVX_MASK) == LZOP_REFVX) {
+			len = (size_t)(
+				((op64 >> LZOP_REFVX_LSHIFT) & LZOP_REFVX_LMASK)
+				+ 4);
+			dist = (size_t)(
+				((op64 >> LZOP_REFVX_DSHIFT) & LZOP_REFVX_DMASK)
+				+ 1);
+			SDEC_LZ_ILOOP_CHECK(len > (size_t)(o_top - o)
+					    || dist > (size_t)(o - o0) + hist);
+			SDEC_LZ_XREF
+			sdec_lz_wild_ref(o, dist, len);
+			o += len;
+			continue;
+		}
+		if ((op64 & LZOP_LITV_MASK) == LZOP_LITV) {
+			len = (size_t)((op64 >> LZOP_LITV_NBITS) + 1);
+			SDEC_LZ_ILOOP_CHECK(len > (size_t)(o_top - o)
+					    || len > (size_t)(s_top - s));
+			sdec_lz_wild_lit(o, s, len);
+			s += len;
+			o += len;
+			continue;
+		}
+		len = (size_t)((op64 >> LZOP_REFVV_NBITS) + 4);
+		dist = (size_t)(sdec_lz_ld_pk(&s) + 1);
+		SDEC_LZ_ILOOP_CHECK(len > (size_t)(o_top - o)
+				    || dist > (size_t)(o - o0) + hist);
+		SDEC_LZ_XREF
+		sdec_lz_wild_ref(o, dist, len);
+		o += len;
+	}
+	while (!err && s < s_top) {
 		s_bk = s;
-#endif
 		op64 = s_ld_pk_u64(&s, (size_t)(s_top - s));
+		SDEC_LZ_ILOOP_CHECK(s == s_bk || s > s_top);
 		op8 = op64 & 0xff;
 		if ((op8 & LZOP_REFVX_MASK) == LZOP_REFVX) {
 			len = (size_t)(
@@ -887,24 +2179,587 @@ size_t sdec_lz(const uint8_t *s0, size_t ss, uint8_t *o0)
 			dist = (size_t)(
 				((op64 >> LZOP_REFVX_DSHIFT) & LZOP_REFVX_DMASK)
 				+ 1);
-			SDEC_LZ_ILOOP_OVERFLOW_CHECK(s, s_top, o, o_top, len);
-			sdec_lz_load_ref(&o, dist, len);
+			SDEC_LZ_ILOOP_CHECK(len > (size_t)(o_top - o)
+					    || dist > (size_t)(o - o0) + hist);
+			SDEC_LZ_XREF
+			sdec_lz_load_ref(&o, dist, len, o_top);
 			DBG_LZREF(s - s_bk, dist, len, "[REFVX]");
 			continue;
 		}
 		if ((op8 & LZOP_LITV_MASK) == LZOP_LITV) {
 			len = (size_t)((op64 >> LZOP_LITV_NBITS) + 1);
 			DBG_LZLIT(s - s_bk, len);
-			SDEC_LZ_ILOOP_OVERFLOW_CHECK(s, s_top, o, o_top, len);
+			SDEC_LZ_ILOOP_CHECK(len > (size_t)(o_top - o)
+					    || len > (size_t)(s_top - s));
 			sdec_lz_load_lit(&s, &o, len);
 			continue;
 		}
 		/* LZOP_REFVV */
 		len = (size_t)((op64 >> LZOP_REFVV_NBITS) + 4);
 		dist = (size_t)(s_ld_pk_u64(&s, (size_t)(s_top - s)) + 1);
-		SDEC_LZ_ILOOP_OVERFLOW_CHECK(s, s_top, o, o_top, len);
-		sdec_lz_load_ref(&o, dist, len);
+		SDEC_LZ_ILOOP_CHECK(s > s_top || len > (size_t)(o_top - o)
+				    || dist > (size_t)(o - o0) + hist);
+		SDEC_LZ_XREF
+		sdec_lz_load_ref(&o, dist, len, o_top);
 		DBG_LZREF(s - s_bk, dist, len, "[REFVV]");
 	}
+	RETURN_IF(strict && (err || o != o_top), S_NPOS);
 	return (size_t)(o - o0);
 }
+
+size_t sdec_lz(const uint8_t *s0, size_t ss, uint8_t *o0)
+{
+	return sdec_lz_aux(s0, ss, o0, o0, 0, S_NPOS, S_TRUE);
+}
+
+size_t sdec_lz_blk(const uint8_t *s, size_t ss, uint8_t *o, size_t hist,
+		   size_t max_out)
+{
+	return sdec_lz_aux(s, ss, o, o, hist, max_out, S_FALSE);
+}
+
+/*
+ * Dictionary training: the dictionary is built from the sample segments
+ * (S_LZ_DICT_SEG bytes) with the most frequent content, measured as the
+ * number of samples containing each of the segment S_LZ_DICT_D-byte
+ * substrings (hashed). Samples are split in as many epochs as segments fit
+ * in the dictionary, taking the best segment of each one (the counters of
+ * the selected substrings are cleared, so content is not repeated).
+ * Segments are sorted by score, placing the best ones at the dictionary
+ * end (shorter distances from the data). Without heap usage allowed, only
+ * samples fitting in the dictionary are supported, and the dictionary is
+ * not used for encoding (the output can be decoded with it, anyway).
+ */
+#define S_LZ_DICT_D 6
+#define S_LZ_DICT_SEG 256
+#define S_LZ_DICT_HBITS 16
+
+#ifdef S_LZ_ALLOW_HEAP_USAGE
+
+struct SLzDictSeg {
+	size_t off, len, score;
+};
+
+S_INLINE size_t senc_lz_dict_h(const uint8_t *s)
+{
+	uint64_t w = S_LD_LE_U32(s) | ((uint64_t)S_LD_LE_U16(s + 4) << 32);
+	return (size_t)((w * 0x9e3779b97f4a7c15ULL) >> (64 - S_LZ_DICT_HBITS));
+}
+
+/* Substring score: samples containing it (0 if only in one) */
+S_INLINE size_t senc_lz_dict_f(const uint32_t *freq, size_t h)
+{
+	return freq[h] > 1 ? freq[h] : 0;
+}
+
+/*
+ * Best segment starting in s[e0, e1), from the samples in [*si, n), with
+ * the substrings repeated in the segment being counted once ('win': count
+ * of every substring in the segment, all zero before and after the call)
+ */
+static void senc_lz_dict_best(const uint8_t *s, const size_t *sizes,
+			      size_t n, size_t *si, size_t *so, size_t e0,
+			      size_t e1, const uint32_t *freq, uint32_t *win,
+			      struct SLzDictSeg *best)
+{
+	size_t h, p, q, qe, se, sum;
+	best->score = 0;
+	for (; *si < n; (*so) += sizes[(*si)++]) {
+		se = *so + sizes[*si];
+		p = q = S_MAX(e0, *so);
+		for (sum = 0; p < e1 && p + S_LZ_DICT_D <= se; p++) {
+			qe = S_MIN(p + S_LZ_DICT_SEG, se) - S_LZ_DICT_D + 1;
+			for (; q < qe; q++) {
+				h = senc_lz_dict_h(s + q);
+				if (!win[h]++)
+					sum += senc_lz_dict_f(freq, h);
+			}
+			if (sum > best->score) {
+				best->score = sum;
+				best->off = p;
+				best->len = qe + S_LZ_DICT_D - 1 - p;
+			}
+			h = senc_lz_dict_h(s + p);
+			if (!--win[h])
+				sum -= senc_lz_dict_f(freq, h);
+		}
+		for (; p < q; p++)
+			win[senc_lz_dict_h(s + p)]--;
+		if (se >= e1)
+			break;
+	}
+}
+
+static size_t senc_lz_dict_sel(const uint8_t *s, const size_t *sizes,
+			       size_t n, size_t ss, uint8_t *o, size_t max_os)
+{
+	uint32_t *freq, *stamp;
+	struct SLzDictSeg *seg, t;
+	size_t i, j, k, ep, e0, nseg, si, so, os, hs;
+	nseg = max_os / S_LZ_DICT_SEG;
+	RETURN_IF(!nseg, 0);
+	ep = S_MAX(ss / nseg, S_LZ_DICT_SEG);
+	hs = (size_t)1 << S_LZ_DICT_HBITS;
+	freq = (uint32_t *)s_malloc(2 * hs * sizeof(uint32_t)
+				    + nseg * sizeof(struct SLzDictSeg));
+	RETURN_IF(!freq, 0); /* BEHAVIOR: out of memory */
+	stamp = freq + hs;
+	seg = (struct SLzDictSeg *)(stamp + hs);
+	memset(freq, 0, 2 * hs * sizeof(uint32_t));
+	/* Substring frequency (once per sample) */
+	for (i = so = 0; i < n; so += sizes[i++])
+		for (j = so; j + S_LZ_DICT_D <= so + sizes[i]; j++) {
+			k = senc_lz_dict_h(s + j);
+			if (stamp[k] != (uint32_t)(i + 1)) {
+				stamp[k] = (uint32_t)(i + 1);
+				freq[k]++;
+			}
+		}
+	/* Best segment per epoch ('stamp' reused for segment counts) */
+	memset(stamp, 0, hs * sizeof(uint32_t));
+	for (e0 = si = so = k = 0; e0 < ss && k < nseg; e0 += ep) {
+		senc_lz_dict_best(s, sizes, n, &si, &so, e0,
+				  S_MIN(e0 + ep, ss), freq, stamp, &seg[k]);
+		if (!seg[k].score)
+			continue;
+		for (j = 0; j + S_LZ_DICT_D <= seg[k].len; j++)
+			freq[senc_lz_dict_h(s + seg[k].off + j)] = 0;
+		k++;
+	}
+	/* Sort by score (insertion sort), and copy */
+	for (i = 1; i < k; i++) {
+		t = seg[i];
+		for (j = i; j > 0 && seg[j - 1].score > t.score; j--)
+			seg[j] = seg[j - 1];
+		seg[j] = t;
+	}
+	for (i = os = 0; i < k; os += seg[i++].len)
+		memcpy(o + os, s + seg[i].off, seg[i].len);
+	s_free(freq);
+	return os;
+}
+#endif
+
+size_t senc_lz_dict_train(const uint8_t *s, size_t ss, const size_t *sizes,
+			  size_t n, uint8_t *o, size_t max_os)
+{
+	size_t i, t;
+	RETURN_IF(!s || !sizes || !n, 0);
+	for (i = t = 0; i < n; i++) {
+		t += sizes[i];
+		RETURN_IF(t < sizes[i] || t > ss, 0); /* BEHAVIOR: overflow */
+	}
+	ss = t;
+	RETURN_IF(!o, S_MIN(ss, max_os)); /* max out size */
+	if (ss <= max_os) { /* all the samples fit in the dictionary */
+		memcpy(o, s, ss);
+		return ss;
+	}
+#ifdef S_LZ_ALLOW_HEAP_USAGE
+	return senc_lz_dict_sel(s, sizes, n, ss, o, max_os);
+#else
+	return 0;
+#endif
+}
+
+size_t senc_lz_xdict(const uint8_t *d, size_t ds, const uint8_t *s,
+		     size_t ss, uint8_t *o, int level)
+{
+#ifdef S_LZ_ALLOW_HEAP_USAGE
+	uint8_t *b;
+	size_t os, bs;
+#endif
+	RETURN_IF(!o, senc_lz_lvl_aux(s, 0, ss, NULL, level));
+	RETURN_IF(!s || (!d && ds), 0);
+#ifdef S_LZ_ALLOW_HEAP_USAGE
+	if (ds > 0) {
+		/* Contiguous dictionary and input, for the match finders */
+		bs = s_size_t_add(ds, ss, S_NPOS);
+		RETURN_IF(bs == S_NPOS, 0);
+		b = (uint8_t *)s_malloc(bs);
+		RETURN_IF(!b, 0); /* BEHAVIOR: out of memory */
+		memcpy(b, d, ds);
+		memcpy(b + ds, s, ss);
+		os = senc_lz_lvl_aux(b, ds, bs, o, level);
+		s_free(b);
+		return os;
+	}
+#endif
+	return senc_lz_lvl_aux(s, 0, ss, o, level);
+}
+
+size_t sdec_lz_xdict(const uint8_t *d, size_t ds, const uint8_t *s,
+		     size_t ss, uint8_t *o)
+{
+	RETURN_IF(!d && ds, 0);
+	return sdec_lz_aux(s, ss, o, d ? d + ds : o, ds, S_NPOS, S_TRUE);
+}
+
+/*
+ * LZ + entropy coding ("LZE"): the LZ opcode stream is split into literals
+ * and sequences (literal run length, match length, distance), Huffman coded
+ * separately (four literal bit streams, decoded interleaved). Values are
+ * coded as a bucket (Huffman code) and the offset in the bucket (extra
+ * bits): buckets 0 to 15 are the values 0 to 15, and from there, 2 buckets
+ * per power of two.
+ *
+ * Format: mode (1 byte; 0: senc_lz() format follows, if not smaller with
+ * entropy coding; 1: LZE), uncompressed size, sequence count, literal count
+ * (packed integers), literal mode (1 byte, 0: raw, 1: Huffman), literals
+ * (raw, or Huffman code lengths, the size of the four bit streams -packed
+ * integers-, and the streams), and, if there are sequences, the code
+ * lengths for literal runs, match lengths, and distances, followed by the
+ * sequence bit stream. Code lengths: symbols (packed integer, trailing
+ * unused symbols are not stored), 4 bits per symbol.
+ */
+#define SLZE_VSYMS 136 /* value buckets: 16 + 2 * (64 - 4) */
+#define SLZE_LSTREAMS 4
+
+struct SLzeEnc {
+	size_t fl[256], fv[3][SLZE_VSYMS]; /* frequencies */
+	uint8_t ll[256], lv[3][SLZE_VSYMS]; /* code lengths */
+	uint16_t cl[256], cv[3][SLZE_VSYMS]; /* codes */
+	size_t nseq, nlit, xbits;
+};
+
+static unsigned slze_vcode(uint64_t v, size_t *nx)
+{
+	unsigned b;
+	if (v < 16) {
+		*nx = 0;
+		return (unsigned)v;
+	}
+	b = slog2(v);
+	*nx = b - 1;
+	return 16 + ((b - 4) << 1) + (unsigned)((v >> (b - 1)) & 1);
+}
+
+S_INLINE uint64_t slze_vdec(struct SBitRd *r, size_t c)
+{
+	size_t nx;
+	RETURN_IF(c < 16, c);
+	nx = ((c - 16) >> 1) + 3;
+	return ((uint64_t)(2 | ((c - 16) & 1)) << nx) | sbr_get64(r, nx);
+}
+
+/*
+ * LZ opcode stream walk: without bit stream writer, literals are copied and
+ * value codes are counted; otherwise, sequences are written
+ */
+static void slze_walk(const uint8_t *z, size_t zs, struct SLzeEnc *e,
+		      uint8_t *lits, struct SBitWr *w)
+{
+	uint64_t op64, v[3];
+	const uint8_t *p = z, *top = z + zs;
+	size_t c, k, nx, run = 0, len;
+	s_ld_pk_u64(&p, zs); /* header */
+	while (p < top) {
+		op64 = s_ld_pk_u64(&p, (size_t)(top - p));
+		if ((op64 & LZOP_REFVX_MASK) == LZOP_REFVX) {
+			v[1] = (op64 >> LZOP_REFVX_LSHIFT) & LZOP_REFVX_LMASK;
+			v[2] = (op64 >> LZOP_REFVX_DSHIFT) & LZOP_REFVX_DMASK;
+		} else if ((op64 & LZOP_LITV_MASK) == LZOP_LITV) {
+			len = (size_t)(op64 >> LZOP_LITV_NBITS) + 1;
+			if (!w) {
+				memcpy(lits + e->nlit, p, len);
+				e->nlit += len;
+			}
+			p += len;
+			run += len;
+			continue;
+		} else {
+			v[1] = op64 >> LZOP_REFVV_NBITS;
+			v[2] = s_ld_pk_u64(&p, (size_t)(top - p));
+		}
+		v[0] = run;
+		for (k = 0; k < 3; k++) {
+			c = slze_vcode(v[k], &nx);
+			if (w) {
+				sbw_put(w, e->cv[k][c], e->lv[k][c]);
+				sbw_put64(w, v[k] & S_NBITMASK64(nx), nx);
+			} else {
+				e->fv[k][c]++;
+				e->xbits += nx;
+			}
+		}
+		if (!w)
+			e->nseq++;
+		run = 0;
+	}
+}
+
+static size_t slze_tbl_size(const uint8_t *len, size_t nsym, size_t *used)
+{
+	for (*used = nsym; *used > 0 && !len[*used - 1]; (*used)--)
+		;
+	return senc_lz_pk_size(*used) + (*used + 1) / 2;
+}
+
+static void slze_tbl_write(uint8_t **o, const uint8_t *len, size_t used)
+{
+	size_t i;
+	s_st_pk_u64(o, used);
+	for (i = 0; i < used; i += 2)
+		*(*o)++ = (uint8_t)(len[i]
+				    | (i + 1 < used ? len[i + 1] << 4 : 0));
+}
+
+static srt_bool slze_tbl_read(const uint8_t **s, const uint8_t *top,
+			      uint16_t *tbl, size_t nsym)
+{
+	size_t i, used;
+	uint8_t len[SHUFF_MAX_SYMS];
+	used = (size_t)s_ld_pk_u64(s, (size_t)(top - *s));
+	RETURN_IF(*s > top || used > nsym, S_FALSE);
+	RETURN_IF((used + 1) / 2 > (size_t)(top - *s), S_FALSE);
+	memset(len, 0, nsym);
+	for (i = 0; i < used; i++)
+		len[i] = (uint8_t)((*s)[i / 2] >> ((i & 1) * 4)) & 15;
+	*s += (used + 1) / 2;
+	return shuff_dec_table(len, nsym, tbl);
+}
+
+static size_t senc_lze_aux(const uint8_t *s, size_t ss, uint8_t *o0,
+			   int level)
+{
+	uint8_t *o, *z, *lits;
+	struct SBitWr w;
+	struct SLzeEnc *e;
+	size_t i, k, q, lhs, vhs, out, zs, zmax, lbits, lend, vused[3], lused,
+		lb[SLZE_LSTREAMS];
+	srt_bool lhuff;
+	zmax = senc_lz_lvl_aux(s, 0, ss, NULL, level);
+	RETURN_IF(!zmax, 0);
+	RETURN_IF(!o0, s_size_t_add(zmax, 1, 0));
+	RETURN_IF(!s, 0);
+	e = (struct SLzeEnc *)s_malloc(sizeof(struct SLzeEnc) + zmax + ss);
+	RETURN_IF(!e, 0); /* BEHAVIOR: out of memory */
+	z = (uint8_t *)(e + 1);
+	lits = z + zmax;
+	zs = senc_lz_lvl_aux(s, 0, ss, z, level);
+	if (!zs) { /* BEHAVIOR: out of memory */
+		s_free(e);
+		return 0;
+	}
+	memset(e, 0, sizeof(*e));
+	slze_walk(z, zs, e, lits, NULL);
+	/*
+	 * Literals: Huffman coded only if smaller than raw
+	 */
+	for (i = 0; i < e->nlit; i++)
+		e->fl[lits[i]]++;
+	shuff_lengths(e->fl, 256, e->ll);
+	q = (e->nlit + SLZE_LSTREAMS - 1) / SLZE_LSTREAMS;
+	lhs = slze_tbl_size(e->ll, 256, &lused);
+	for (k = 0; k < SLZE_LSTREAMS; k++) {
+		lend = S_MIN((k + 1) * q, e->nlit);
+		for (i = k * q, lbits = 0; i < lend; i++)
+			lbits += e->ll[lits[i]];
+		lb[k] = (lbits + 7) / 8;
+		lhs += senc_lz_pk_size(lb[k]) + lb[k];
+	}
+	lhuff = lhs < e->nlit ? S_TRUE : S_FALSE;
+	out = 2 + senc_lz_pk_size(ss) + senc_lz_pk_size(e->nseq)
+	      + senc_lz_pk_size(e->nlit) + (lhuff ? lhs : e->nlit);
+	/*
+	 * Sequences
+	 */
+	if (e->nseq) {
+		for (k = 0, vhs = e->xbits; k < 3; k++) {
+			shuff_lengths(e->fv[k], SLZE_VSYMS, e->lv[k]);
+			vhs += shuff_bits(e->fv[k], e->lv[k], SLZE_VSYMS);
+			out += slze_tbl_size(e->lv[k], SLZE_VSYMS, &vused[k]);
+		}
+		out += (vhs + 7) / 8;
+	}
+	if (out > zs) { /* LZ without entropy coding */
+		o0[0] = 0;
+		memcpy(o0 + 1, z, zs);
+		s_free(e);
+		return zs + 1;
+	}
+	o = o0;
+	*o++ = 1;
+	s_st_pk_u64(&o, ss);
+	s_st_pk_u64(&o, e->nseq);
+	s_st_pk_u64(&o, e->nlit);
+	*o++ = lhuff ? 1 : 0;
+	if (lhuff) {
+		shuff_codes(e->ll, 256, e->cl);
+		slze_tbl_write(&o, e->ll, lused);
+		for (k = 0; k < SLZE_LSTREAMS; k++)
+			s_st_pk_u64(&o, lb[k]);
+		for (k = 0; k < SLZE_LSTREAMS; k++) {
+			lend = S_MIN((k + 1) * q, e->nlit);
+			sbw_init(&w, o);
+			for (i = k * q; i < lend; i++)
+				sbw_put(&w, e->cl[lits[i]], e->ll[lits[i]]);
+			o = sbw_flush(&w);
+		}
+	} else {
+		memcpy(o, lits, e->nlit);
+		o += e->nlit;
+	}
+	if (e->nseq) {
+		for (k = 0; k < 3; k++) {
+			shuff_codes(e->lv[k], SLZE_VSYMS, e->cv[k]);
+			slze_tbl_write(&o, e->lv[k], vused[k]);
+		}
+		sbw_init(&w, o);
+		slze_walk(z, zs, e, NULL, &w);
+		o = sbw_flush(&w);
+	}
+	s_free(e);
+	return (size_t)(o - o0);
+}
+
+size_t senc_lze_lvl(const uint8_t *s, size_t ss, uint8_t *o0, int level)
+{
+	return senc_lze_aux(s, ss, o0, level);
+}
+
+/* Literals: four bit streams, decoded interleaved */
+static srt_bool sdec_lze_lits(const uint8_t **s, const uint8_t *top,
+			      uint8_t *o, size_t nlit)
+{
+	uint16_t tbl[SHUFF_TBL_SIZE];
+	struct SBitRd r[SLZE_LSTREAMS];
+	uint8_t *ok[SLZE_LSTREAMS];
+	size_t i, j, k, q, x, bad = 0, off = 0, lb[SLZE_LSTREAMS],
+				cnt[SLZE_LSTREAMS];
+	RETURN_IF(!slze_tbl_read(s, top, tbl, 256), S_FALSE);
+	for (k = 0; k < SLZE_LSTREAMS; k++) {
+		lb[k] = (size_t)s_ld_pk_u64(s, (size_t)(top - *s));
+		RETURN_IF(*s > top || lb[k] > (size_t)(top - *s), S_FALSE);
+	}
+	q = (nlit + SLZE_LSTREAMS - 1) / SLZE_LSTREAMS;
+	for (k = 0; k < SLZE_LSTREAMS; k++) {
+		RETURN_IF(lb[k] > (size_t)(top - *s) - off, S_FALSE);
+		sbr_init(&r[k], *s + off, lb[k]);
+		off += lb[k];
+		ok[k] = o + S_MIN(k * q, nlit);
+		cnt[k] = S_MIN(q, nlit - (size_t)(ok[k] - o));
+	}
+	*s += off;
+	/* the last stream is the shortest */
+	for (i = 0; i + 4 <= cnt[SLZE_LSTREAMS - 1]; i += 4)
+		for (k = 0; k < SLZE_LSTREAMS; k++) {
+			sbr_refill(&r[k]);
+			for (j = 0; j < 4; j++) {
+				x = sbr_sym(&r[k], tbl);
+				bad |= x;
+				ok[k][i + j] = (uint8_t)x;
+			}
+		}
+	for (k = 0; k < SLZE_LSTREAMS; k++) {
+		for (j = i; j < cnt[k]; j++) {
+			sbr_refill(&r[k]);
+			x = sbr_sym(&r[k], tbl);
+			bad |= x;
+			ok[k][j] = (uint8_t)x;
+		}
+		RETURN_IF(sbr_overrun(&r[k]), S_FALSE);
+	}
+	return bad < 256 ? S_TRUE : S_FALSE;
+}
+
+size_t sdec_lze(const uint8_t *s, size_t ss, uint8_t *o)
+{
+	uint64_t v[3];
+	struct SBitRd r;
+	uint16_t tv[3][SHUFF_TBL_SIZE];
+	const uint8_t *p, *top;
+	uint8_t *op, *lp, *ltop;
+	size_t c, i, k, n, nseq, nlit, len, dist;
+	RETURN_IF(!s || ss < 2 || s[0] > 1, 0);
+	if (!s[0]) /* LZ */
+		return sdec_lz(s + 1, ss - 1, o);
+	p = s + 1;
+	top = s + ss;
+	n = (size_t)s_ld_pk_u64(&p, (size_t)(top - p));
+	RETURN_IF(p >= top, 0);
+	RETURN_IF(!o, n + S_LZ_DEC_SLACK); /* max out size */
+	nseq = (size_t)s_ld_pk_u64(&p, (size_t)(top - p));
+	nlit = (size_t)s_ld_pk_u64(&p, (size_t)(top - p));
+	/* BEHAVIOR: invalid input (no output) */
+	RETURN_IF(p >= top || nlit > n || nseq > (n - nlit) / 4 || *p > 1, 0);
+	lp = o + n - nlit;
+	if (*p++) {
+		RETURN_IF(!sdec_lze_lits(&p, top, lp, nlit), 0);
+	} else {
+		RETURN_IF(nlit > (size_t)(top - p), 0);
+		memcpy(lp, p, nlit);
+		p += nlit;
+	}
+	/*
+	 * Sequences: literals are moved from the end of the output (already
+	 * decoded there), never overwritten before being moved
+	 */
+	op = o;
+	ltop = o + n;
+	if (nseq) {
+		for (k = 0; k < 3; k++)
+			RETURN_IF(!slze_tbl_read(&p, top, tv[k], SLZE_VSYMS),
+				  0);
+		sbr_init(&r, p, (size_t)(top - p));
+	}
+	for (i = 0; i < nseq; i++) {
+		for (k = 0; k < 3; k++) {
+			sbr_refill(&r);
+			c = sbr_sym(&r, tv[k]);
+			RETURN_IF(c == S_NPOS, 0);
+			v[k] = slze_vdec(&r, c);
+		}
+		RETURN_IF(v[0] > (uint64_t)(ltop - lp), 0);
+		memmove(op, lp, (size_t)v[0]);
+		op += v[0];
+		lp += v[0];
+		RETURN_IF(lp - op < 4 || v[1] > (uint64_t)(lp - op - 4)
+				  || v[2] >= (uint64_t)(op - o),
+			  0);
+		len = (size_t)v[1] + 4;
+		dist = (size_t)v[2] + 1;
+		s_reccpy(op, dist, len, (size_t)(lp - op));
+		op += len;
+	}
+	RETURN_IF(nseq && sbr_overrun(&r), 0);
+	memmove(op, lp, (size_t)(ltop - lp));
+	op += ltop - lp;
+	RETURN_IF(op != ltop, 0);
+	return n;
+}
+
+#define MK_SENC_LZE_LVL(n)                                                     \
+	static size_t senc_lze##n(const uint8_t *s, size_t ss, uint8_t *o0)    \
+	{                                                                      \
+		return senc_lze_aux(s, ss, o0, n);                             \
+	}
+
+MK_SENC_LZE_LVL(0)
+MK_SENC_LZE_LVL(1)
+MK_SENC_LZE_LVL(2)
+MK_SENC_LZE_LVL(3)
+MK_SENC_LZE_LVL(4)
+MK_SENC_LZE_LVL(5)
+MK_SENC_LZE_LVL(6)
+MK_SENC_LZE_LVL(7)
+MK_SENC_LZE_LVL(8)
+MK_SENC_LZE_LVL(9)
+
+static const srt_enc_f senc_lze_lvl_fs[S_LZ_LEVEL_MAX + 1] = {
+	senc_lze0, senc_lze1, senc_lze2, senc_lze3, senc_lze4,
+	senc_lze5, senc_lze6, senc_lze7, senc_lze8, senc_lze9};
+
+srt_enc_f senc_lze_lvl_f(int level)
+{
+	return senc_lze_lvl_fs[S_RANGE(level, 0, S_LZ_LEVEL_MAX)];
+}
+
+int senc_lz_level(srt_enc_f f)
+{
+	int i = 0;
+	for (; i <= S_LZ_LEVEL_MAX; i++)
+		if (senc_lz_lvl_fs[i] == f || senc_lze_lvl_fs[i] == f)
+			return i;
+	return -1;
+}
@@ -17,6 +17,12 @@ extern "C" {
  * - Aliasing safe (input and output buffer can be the same).
  * - RFC 3548/4648 base 16 (hexadecimal) and 64 encoding/decoding.
  * - Fast (~1 GB/s on i5-3330 @3GHz -using one core- and gcc 4.8.2 -O2)
+ * - SSSE3/AVX2 base64 and hex encoding/decoding, selected at run time (x86).
+ * - Base64 URL and filename safe alphabet (RFC 4648 section 5), and
+ *   unpadded output. Decoding accepts both alphabets, with or without
+ *   padding.
+ * - Validating base64 decoding (sdec_b64_chk), reporting the offset of the
+ *   first invalid character.
  *
  * Features (JSON and XML escape/unescape):
  *
@@ -25,14 +31,27 @@ extern "C" {
  * - XML escape subset of XML 1.0 W3C 26 Nov 2008 (4.6 Predefined Entities)
  * - Fast decoding (~1 GB/s on i5-3330 @3GHz -using one core-)
  * - "Fast" decoding (200-400 MB/s on "; there is room for optimization)
+ * - SSE2/AVX2 encoding (x86): spans not requiring escaping are found 16/32
+ *   bytes at a time and copied in bulk (also used for URL and quote escaping,
+ *   and for computing the output size).
  *
  * Features (custom LZ77 implementation):
  *
  * - Encoding time complexity: O(n)
  * - Decoding time complexity: O(n)
+ * - Optional encoding context, so compressing many small buffers does not
+ *   require setting up the match hash table every time (same output).
+ * - Compression levels for higher compression ratio (slower encoding, same
+ *   decoding speed): hash chains, lazy matching, and optimal parsing.
+ * - Optional entropy coding stage (Huffman), for higher compression ratio
+ *   at the cost of slower decoding.
+ * - Dictionary compression (a dictionary trained from samples is used as
+ *   history for encoding/decoding), for small inputs.
+ * - Fast decoding: 16/32-byte chunk copies (overlapping copies for short
+ *   distances using a repeated pattern), with bounds checks per opcode.
  *
  * Observations:
- * - Tables take 288 bytes (could be reduced to 248 bytes -tweaking access
+ * - Tables take 352 bytes (could be reduced to 312 bytes -tweaking access
  * to b64d[]-, but it would require to increase the number of operations in
  * order to shift -and secure- access to that area, being code increase more
  * than those 40 bytes).
@@ -45,8 +64,19 @@ extern "C" {
 typedef size_t (*srt_enc_f)(const uint8_t *s, size_t ss, uint8_t *o);
 typedef size_t (*srt_enc_f2)(const uint8_t *s, size_t ss, uint8_t *o, size_t known_sso);
 
+/* LZ encoding context (match hash table reused across calls) */
+struct SLzCtx {
+	size_t *refs; /* match hash table */
+	size_t hbits; /* hash table size (log2) */
+	size_t base;  /* entries below 'base' are from previous calls */
+};
+
 size_t senc_b64(const uint8_t *s, size_t ss, uint8_t *o);
+size_t senc_b64_nopad(const uint8_t *s, size_t ss, uint8_t *o);
+size_t senc_b64url(const uint8_t *s, size_t ss, uint8_t *o);
 size_t sdec_b64(const uint8_t *s, size_t ss, uint8_t *o);
+size_t sdec_b64_chk(const uint8_t *s, size_t ss, uint8_t *o, srt_bool url,
+		    size_t *inv_off);
 size_t senc_hex(const uint8_t *s, size_t ss, uint8_t *o);
 size_t senc_HEX(const uint8_t *s, size_t ss, uint8_t *o);
 size_t sdec_hex(const uint8_t *s, size_t ss, uint8_t *o);
@@ -62,7 +92,63 @@ size_t senc_esc_squote(const uint8_t *s, size_t ss, uint8_t *o, size_t known_sso
 size_t sdec_esc_squote(const uint8_t *s, size_t ss, uint8_t *o);
 size_t senc_lz(const uint8_t *s, size_t ss, uint8_t *o);
 size_t senc_lzh(const uint8_t *s, size_t ss, uint8_t *o);
+/*
+ * sdec_lz() output buffer: decoded size plus S_LZ_DEC_SLACK bytes (as
+ * returned when 'o' is NULL), so it can copy in 16/32-byte chunks
+ */
+#define S_LZ_DEC_SLACK 32
 size_t sdec_lz(const uint8_t *s, size_t ss, uint8_t *o);
+struct SLzCtx *senc_lz_ctx_alloc(void);
+void senc_lz_ctx_free(struct SLzCtx *c);
+size_t senc_lz_ctx(struct SLzCtx *c, const uint8_t *s, size_t ss, uint8_t *o);
+size_t senc_lzh_ctx(struct SLzCtx *c, const uint8_t *s, size_t ss,
+		    uint8_t *o);
+/*
+ * Block encoding/decoding for streams: s[0, start) is the dictionary for
+ * encoding s[start, ss) (the context keeps the hash table entries between
+ * calls, its 'base' being moved forward when dropping bytes from the
+ * beginning of the buffer), and 'hist' bytes before 'o' are available for
+ * decoding (S_NPOS on error)
+ */
+size_t senc_lz_blk(struct SLzCtx *c, const uint8_t *s, size_t start,
+		   size_t ss, uint8_t *o, size_t max_ss);
+size_t sdec_lz_blk(const uint8_t *s, size_t ss, uint8_t *o, size_t hist,
+		   size_t max_out);
+/* Encode s[start, ss), with s[0, start) as dictionary (no context) */
+size_t senc_lz_dict(const uint8_t *s, size_t start, size_t ss, uint8_t *o,
+		    srt_bool lzh);
+/*
+ * Compression levels (0: senc_lz(), 1: senc_lzh(), 2 to 8: hash chains and
+ * lazy matching, 9: optimal parsing), decoded with sdec_lz(). Out of range
+ * levels are clamped. senc_lz_lvl_f() returns the encoding function for a
+ * level, and senc_lz_level() the level of an encoding function (-1 if not
+ * an LZ encoding function)
+ */
+#define S_LZ_LEVEL_MAX 9
+size_t senc_lz_lvl(const uint8_t *s, size_t ss, uint8_t *o, int level);
+srt_enc_f senc_lz_lvl_f(int level);
+int senc_lz_level(srt_enc_f f);
+/*
+ * LZ with entropy coding (Huffman coded literals, lengths and distances),
+ * using the same compression levels for the LZ stage
+ */
+size_t senc_lze_lvl(const uint8_t *s, size_t ss, uint8_t *o, int level);
+size_t sdec_lze(const uint8_t *s, size_t ss, uint8_t *o);
+srt_enc_f senc_lze_lvl_f(int level);
+/*
+ * Dictionary compression, for small inputs: senc_lz_dict_train() builds a
+ * dictionary of up to 'max_os' bytes from the samples (concatenated in 's',
+ * 'sizes' being the size of each of the 'n' samples), and
+ * senc_lz_xdict()/sdec_lz_xdict() encode/decode using a dictionary 'd' of
+ * 'ds' bytes as history (it is not stored in the output). The output buffer
+ * for sdec_lz_xdict() is the same as for sdec_lz()
+ */
+size_t senc_lz_dict_train(const uint8_t *s, size_t ss, const size_t *sizes,
+			  size_t n, uint8_t *o, size_t max_os);
+size_t senc_lz_xdict(const uint8_t *d, size_t ds, const uint8_t *s,
+		     size_t ss, uint8_t *o, int level);
+size_t sdec_lz_xdict(const uint8_t *d, size_t ds, const uint8_t *s,
+		     size_t ss, uint8_t *o);
 
 #define senc_b16 senc_HEX
 #define sdec_b16 sdec_hex
@@ -0,0 +1,126 @@
+/*
+ * shuff.c
+ *
+ * Canonical Huffman coding and bit streams
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "shuff.h"
+
+void shuff_lengths(const size_t *freq, size_t nsym, uint8_t *len)
+{
+	size_t i, j, m, t, l, k, nl, ni, kraft, kmax;
+	size_t sym[SHUFF_MAX_SYMS], w[2 * SHUFF_MAX_SYMS],
+		parent[2 * SHUFF_MAX_SYMS];
+	uint8_t depth[2 * SHUFF_MAX_SYMS];
+	if (!freq || !len || !nsym || nsym > SHUFF_MAX_SYMS)
+		return;
+	memset(len, 0, nsym);
+	/* Used symbols, sorted by frequency (insertion sort: few elements) */
+	for (i = m = 0; i < nsym; i++) {
+		if (!freq[i])
+			continue;
+		for (j = m; j > 0 && freq[sym[j - 1]] > freq[i]; j--)
+			sym[j] = sym[j - 1];
+		sym[j] = i;
+		m++;
+	}
+	if (m < 2) {
+		if (m)
+			len[sym[0]] = 1;
+		return;
+	}
+	/*
+	 * Huffman tree: leaves are nodes [0, m), internal nodes [m, 2m - 1)
+	 * are created in increasing weight order (two queues, no heap)
+	 */
+	for (i = 0; i < m; i++)
+		w[i] = freq[sym[i]];
+	for (nl = 0, ni = m, k = m; k < 2 * m - 1; k++) {
+		for (t = 0, w[k] = 0; t < 2; t++) {
+			if (nl < m && (ni >= k || w[nl] <= w[ni]))
+				j = nl++;
+			else
+				j = ni++;
+			w[k] += w[j];
+			parent[j] = k;
+		}
+	}
+	depth[2 * m - 2] = 0;
+	for (k = 2 * m - 2; k-- > 0;)
+		depth[k] = (uint8_t)(depth[parent[k]] + 1);
+	/*
+	 * Length limit: longer codes are truncated, and then the lengths of
+	 * the least frequent symbols are increased until the code is valid
+	 * (Kraft inequality)
+	 */
+	kmax = (size_t)1 << SHUFF_MAX_BITS;
+	for (i = kraft = 0; i < m; i++) {
+		l = S_MIN(depth[i], SHUFF_MAX_BITS);
+		len[sym[i]] = (uint8_t)l;
+		kraft += (size_t)1 << (SHUFF_MAX_BITS - l);
+	}
+	while (kraft > kmax) {
+		for (l = SHUFF_MAX_BITS - 1; l > 0; l--) {
+			for (i = 0; i < m && len[sym[i]] != l; i++)
+				;
+			if (i < m)
+				break;
+		}
+		len[sym[i]]++;
+		kraft -= (size_t)1 << (SHUFF_MAX_BITS - l - 1);
+	}
+}
+
+void shuff_codes(const uint8_t *len, size_t nsym, uint16_t *code)
+{
+	size_t i, b;
+	unsigned c, r, cnt[SHUFF_MAX_BITS + 1], next[SHUFF_MAX_BITS + 1];
+	memset(cnt, 0, sizeof(cnt));
+	for (i = 0; i < nsym; i++)
+		cnt[len[i]]++;
+	cnt[0] = 0;
+	for (c = 0, b = 1; b <= SHUFF_MAX_BITS; b++) {
+		c = (c + cnt[b - 1]) << 1;
+		next[b] = c;
+	}
+	for (i = 0; i < nsym; i++) {
+		if (!len[i])
+			continue;
+		c = next[len[i]]++;
+		for (r = 0, b = 0; b < len[i]; b++, c >>= 1)
+			r = (r << 1) | (c & 1);
+		code[i] = (uint16_t)r;
+	}
+}
+
+size_t shuff_bits(const size_t *freq, const uint8_t *len, size_t nsym)
+{
+	size_t i, acc = 0;
+	for (i = 0; i < nsym; i++)
+		acc += freq[i] * len[i];
+	return acc;
+}
+
+srt_bool shuff_dec_table(const uint8_t *len, size_t nsym, uint16_t *tbl)
+{
+	size_t i, j, kraft = 0;
+	uint16_t code[SHUFF_MAX_SYMS];
+	RETURN_IF(nsym > SHUFF_MAX_SYMS, S_FALSE);
+	for (i = 0; i < nsym; i++) {
+		RETURN_IF(len[i] > SHUFF_MAX_BITS, S_FALSE);
+		if (len[i])
+			kraft += (size_t)1 << (SHUFF_MAX_BITS - len[i]);
+	}
+	RETURN_IF(kraft > SHUFF_TBL_SIZE, S_FALSE); /* over-subscribed */
+	shuff_codes(len, nsym, code);
+	memset(tbl, 0, sizeof(uint16_t) * SHUFF_TBL_SIZE);
+	for (i = 0; i < nsym; i++)
+		if (len[i])
+			for (j = code[i]; j < SHUFF_TBL_SIZE;
+			     j += (size_t)1 << len[i])
+				tbl[j] = (uint16_t)((i << 4) | len[i]);
+	return S_TRUE;
+}
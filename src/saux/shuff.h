@@ -0,0 +1,171 @@
+#ifndef SHUFF_H
+#define SHUFF_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * shuff.h
+ *
+ * Canonical Huffman coding and bit streams
+ *
+ * Features:
+ * - Length-limited Huffman code lengths (up to SHUFF_MAX_BITS bits), so
+ *   decoding uses a single table lookup per symbol.
+ * - Canonical codes (only the code lengths need to be stored).
+ * - Bit streams written/read LSB first, reading 64 bits at once.
+ * - Reading after the end of the stream is safe (zero bits are returned,
+ *   and the condition is detected with sbr_overrun()).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "scommon.h"
+
+#define SHUFF_MAX_BITS 11
+#define SHUFF_TBL_SIZE (1 << SHUFF_MAX_BITS)
+#define SHUFF_MAX_SYMS 256
+
+/* Bit stream writer */
+struct SBitWr {
+	uint8_t *p;
+	uint64_t acc;
+	size_t n; /* bits in 'acc' */
+};
+
+/* Bit stream reader */
+struct SBitRd {
+	const uint8_t *p, *top;
+	uint64_t acc;
+	size_t n;    /* bits in 'acc' */
+	size_t over; /* bytes read after the end (zeros) */
+};
+
+/*
+ * Code lengths from symbol frequencies (0 for symbols not used; a single
+ * symbol used gets a 1-bit code)
+ */
+void shuff_lengths(const size_t *freq, size_t nsym, uint8_t *len);
+
+/* Canonical codes (bit reversed, for LSB first bit streams) */
+void shuff_codes(const uint8_t *len, size_t nsym, uint16_t *code);
+
+/* Encoded size, in bits */
+size_t shuff_bits(const size_t *freq, const uint8_t *len, size_t nsym);
+
+/*
+ * Decoding table (SHUFF_TBL_SIZE elements, entries: symbol << 4 | length,
+ * 0 for invalid codes). S_FALSE: invalid code lengths
+ */
+srt_bool shuff_dec_table(const uint8_t *len, size_t nsym, uint16_t *tbl);
+
+S_INLINE void sbw_init(struct SBitWr *w, uint8_t *p)
+{
+	w->p = p;
+	w->acc = 0;
+	w->n = 0;
+}
+
+/* Write 'n' bits (up to 32) */
+S_INLINE void sbw_put(struct SBitWr *w, uint64_t v, size_t n)
+{
+	w->acc |= v << w->n;
+	w->n += n;
+	for (; w->n >= 8; w->n -= 8) {
+		*w->p++ = (uint8_t)w->acc;
+		w->acc >>= 8;
+	}
+}
+
+/* Write 'n' bits (up to 64) */
+S_INLINE void sbw_put64(struct SBitWr *w, uint64_t v, size_t n)
+{
+	if (n > 32) {
+		sbw_put(w, v & 0xffffffff, 32);
+		v >>= 32;
+		n -= 32;
+	}
+	sbw_put(w, v, n);
+}
+
+/* Write pending bits, returning the end of the stream */
+S_INLINE uint8_t *sbw_flush(struct SBitWr *w)
+{
+	if (w->n > 0) {
+		*w->p++ = (uint8_t)w->acc;
+		w->acc = 0;
+		w->n = 0;
+	}
+	return w->p;
+}
+
+S_INLINE void sbr_init(struct SBitRd *r, const uint8_t *p, size_t size)
+{
+	r->p = p;
+	r->top = p + size;
+	r->acc = 0;
+	r->n = 0;
+	r->over = 0;
+}
+
+/* Fill the bit buffer (at least 56 bits after the call) */
+S_INLINE void sbr_refill(struct SBitRd *r)
+{
+	if (r->top - r->p >= 8) {
+		r->acc |= S_LD_LE_U64(r->p) << r->n;
+		r->p += (63 - r->n) >> 3;
+		r->n |= 56;
+		return;
+	}
+	for (; r->n <= 56; r->n += 8) {
+		if (r->p < r->top)
+			r->acc |= (uint64_t)*r->p++ << r->n;
+		else
+			r->over++;
+	}
+}
+
+/* Read 'n' bits (up to 56, after refill) */
+S_INLINE uint64_t sbr_get(struct SBitRd *r, size_t n)
+{
+	uint64_t v = r->acc & S_NBITMASK64(n);
+	r->acc >>= n;
+	r->n -= n;
+	return v;
+}
+
+/* Read 'n' bits (up to 64) */
+S_INLINE uint64_t sbr_get64(struct SBitRd *r, size_t n)
+{
+	uint64_t lo;
+	if (n <= 32) {
+		sbr_refill(r);
+		return sbr_get(r, n);
+	}
+	sbr_refill(r);
+	lo = sbr_get(r, 32);
+	sbr_refill(r);
+	return lo | (sbr_get(r, n - 32) << 32);
+}
+
+/* Decode symbol (up to 5 symbols after refill). S_NPOS: invalid code */
+S_INLINE size_t sbr_sym(struct SBitRd *r, const uint16_t *tbl)
+{
+	unsigned e = tbl[r->acc & (SHUFF_TBL_SIZE - 1)], l = e & 15;
+	RETURN_IF(!e, S_NPOS);
+	r->acc >>= l;
+	r->n -= l;
+	return e >> 4;
+}
+
+/* S_TRUE if bits after the end of the stream were used */
+S_INLINE srt_bool sbr_overrun(const struct SBitRd *r)
+{
+	return r->over * 8 > r->n ? S_TRUE : S_FALSE;
+}
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+#endif /* #ifndef SHUFF_H */
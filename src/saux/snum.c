@@ -0,0 +1,899 @@
+/*
+ * snum.c
+ *
+ * Number formatting and parsing
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ *
+ * Floating point formatting: Grisu3 (F. Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers", 2010), and the "free
+ * format" algorithm (G. Steele, J. White, 1990) as exact fallback.
+ */
+
+#include "snum.h"
+
+static const char snum_pairs[201] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/*
+ * Integer formatting
+ */
+
+static size_t snum_u64_digits(uint64_t v)
+{
+	size_t n = 1;
+	for (;; v /= 10000, n += 4) {
+		if (v < 10)
+			return n;
+		if (v < 100)
+			return n + 1;
+		if (v < 1000)
+			return n + 2;
+		if (v < 10000)
+			return n + 3;
+	}
+}
+
+size_t snum_u64toa(uint64_t v, char *o)
+{
+	size_t i, n = snum_u64_digits(v);
+	char *p = o + n;
+	for (; v >= 100; p -= 2) {
+		i = (size_t)(v % 100) * 2;
+		v /= 100;
+		p[-2] = snum_pairs[i];
+		p[-1] = snum_pairs[i + 1];
+	}
+	if (v >= 10) {
+		p[-2] = snum_pairs[v * 2];
+		p[-1] = snum_pairs[v * 2 + 1];
+	} else {
+		p[-1] = (char)('0' + v);
+	}
+	return n;
+}
+
+size_t snum_i64toa(int64_t v, char *o)
+{
+	if (v >= 0)
+		return snum_u64toa((uint64_t)v, o);
+	*o = '-';
+	return 1 + snum_u64toa(0 - (uint64_t)v, o + 1);
+}
+
+/*
+ * Big integers (exact fallback, for formatting and parsing)
+ */
+
+#define SNUM_BN_WORDS 128
+
+struct SNumBn {
+	uint32_t w[SNUM_BN_WORDS];
+	size_t n; /* words in use (no leading zero words) */
+};
+
+static void sbn_set(struct SNumBn *a, uint64_t v)
+{
+	a->w[0] = (uint32_t)v;
+	a->w[1] = (uint32_t)(v >> 32);
+	a->n = (v >> 32) ? 2 : v ? 1 : 0;
+}
+
+/* a = a * m + c */
+static void sbn_muladd(struct SNumBn *a, uint32_t m, uint32_t c)
+{
+	size_t i;
+	uint64_t acc = c;
+	for (i = 0; i < a->n; i++) {
+		acc += (uint64_t)a->w[i] * m;
+		a->w[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+	if (acc && a->n < SNUM_BN_WORDS)
+		a->w[a->n++] = (uint32_t)acc;
+}
+
+static void sbn_shl(struct SNumBn *a, size_t bits)
+{
+	size_t i, ws = bits / 32, b = bits % 32, top;
+	if (!a->n || !bits)
+		return;
+	top = a->n + ws;
+	if (top >= SNUM_BN_WORDS) /* not reached (sizes bounded by callers) */
+		return;
+	a->w[top] = b ? a->w[a->n - 1] >> (32 - b) : 0;
+	for (i = a->n - 1; i > 0; i--)
+		a->w[i + ws] = b ? (a->w[i] << b) | (a->w[i - 1] >> (32 - b))
+				 : a->w[i];
+	a->w[ws] = a->w[0] << b;
+	for (i = 0; i < ws; i++)
+		a->w[i] = 0;
+	a->n = top + (a->w[top] ? 1 : 0);
+}
+
+static void sbn_mulpow5(struct SNumBn *a, size_t e)
+{
+	static const uint32_t p5[14] = {1,	   5,	    25,	     125,
+					625,	   3125,    15625,   78125,
+					390625,	   1953125, 9765625, 48828125,
+					244140625, 1220703125};
+	for (; e >= 13; e -= 13)
+		sbn_muladd(a, p5[13], 0);
+	if (e)
+		sbn_muladd(a, p5[e], 0);
+}
+
+static void sbn_mulpow10(struct SNumBn *a, size_t e)
+{
+	sbn_mulpow5(a, e);
+	sbn_shl(a, e);
+}
+
+static int sbn_cmp(const struct SNumBn *a, const struct SNumBn *b)
+{
+	size_t i;
+	if (a->n != b->n)
+		return a->n < b->n ? -1 : 1;
+	for (i = a->n; i-- > 0;)
+		if (a->w[i] != b->w[i])
+			return a->w[i] < b->w[i] ? -1 : 1;
+	return 0;
+}
+
+/* r = a + b ('r' can be 'a') */
+static void sbn_add(struct SNumBn *r, const struct SNumBn *a,
+		    const struct SNumBn *b)
+{
+	size_t i, n = S_MAX(a->n, b->n);
+	uint64_t acc = 0;
+	for (i = 0; i < n; i++) {
+		acc += (uint64_t)(i < a->n ? a->w[i] : 0)
+		       + (i < b->n ? b->w[i] : 0);
+		r->w[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+	r->n = n;
+	if (acc && n < SNUM_BN_WORDS)
+		r->w[r->n++] = (uint32_t)acc;
+}
+
+/* a = a - b (a >= b) */
+static void sbn_sub(struct SNumBn *a, const struct SNumBn *b)
+{
+	size_t i;
+	uint64_t t, borrow = 0;
+	for (i = 0; i < a->n; i++) {
+		t = (uint64_t)a->w[i] - (i < b->n ? b->w[i] : 0) - borrow;
+		a->w[i] = (uint32_t)t;
+		borrow = t >> 63;
+	}
+	while (a->n > 0 && !a->w[a->n - 1])
+		a->n--;
+}
+
+/* Compare a + b with c */
+static int sbn_cmp_sum(const struct SNumBn *a, const struct SNumBn *b,
+		       const struct SNumBn *c)
+{
+	struct SNumBn t;
+	sbn_add(&t, a, b);
+	return sbn_cmp(&t, c);
+}
+
+/* a = a mod b, returning a / b (small quotient) */
+static unsigned sbn_divmod(struct SNumBn *a, const struct SNumBn *b)
+{
+	unsigned q = 0;
+	for (; sbn_cmp(a, b) >= 0; q++)
+		sbn_sub(a, b);
+	return q;
+}
+
+/*
+ * 64-bit floating point ("DIY" floating point, value: f * 2^e)
+ */
+
+struct SNumFp {
+	uint64_t f;
+	int e;
+};
+
+static struct SNumFp snum_fp(uint64_t f, int e)
+{
+	struct SNumFp r;
+	r.f = f;
+	r.e = e;
+	return r;
+}
+
+static struct SNumFp snum_fp_norm(struct SNumFp a)
+{
+	for (; !(a.f & 0xffc0000000000000ULL); a.f <<= 10, a.e -= 10)
+		;
+	for (; !(a.f & 0x8000000000000000ULL); a.f <<= 1, a.e--)
+		;
+	return a;
+}
+
+/* Product (64 most significant bits, rounded) */
+static struct SNumFp snum_fp_mul(struct SNumFp a, struct SNumFp b)
+{
+	uint64_t m = 0xffffffff, ah = a.f >> 32, al = a.f & m, bh = b.f >> 32,
+		 bl = b.f & m, hh = ah * bh, hl = ah * bl, lh = al * bh,
+		 ll = al * bl,
+		 t = (ll >> 32) + (hl & m) + (lh & m) + ((uint64_t)1 << 31);
+	return snum_fp(hh + (hl >> 32) + (lh >> 32) + (t >> 32),
+		       a.e + b.e + 64);
+}
+
+/*
+ * Cached powers of ten (10^-348 to 10^340, every 8): normalized 64-bit
+ * significand (rounded), binary and decimal exponent
+ */
+#define SNUM_CP_OFFSET 348
+#define SNUM_CP_STEP 8
+
+struct SNumCp {
+	uint64_t f;
+	int16_t e, k;
+};
+
+static const struct SNumCp snum_cp[] = {
+	{0xfa8fd5a0081c0288ULL, -1220, -348},
+	{0xbaaee17fa23ebf76ULL, -1193, -340},
+	{0x8b16fb203055ac76ULL, -1166, -332},
+	{0xcf42894a5dce35eaULL, -1140, -324},
+	{0x9a6bb0aa55653b2dULL, -1113, -316},
+	{0xe61acf033d1a45dfULL, -1087, -308},
+	{0xab70fe17c79ac6caULL, -1060, -300},
+	{0xff77b1fcbebcdc4fULL, -1034, -292},
+	{0xbe5691ef416bd60cULL, -1007, -284},
+	{0x8dd01fad907ffc3cULL, -980, -276},
+	{0xd3515c2831559a83ULL, -954, -268},
+	{0x9d71ac8fada6c9b5ULL, -927, -260},
+	{0xea9c227723ee8bcbULL, -901, -252},
+	{0xaecc49914078536dULL, -874, -244},
+	{0x823c12795db6ce57ULL, -847, -236},
+	{0xc21094364dfb5637ULL, -821, -228},
+	{0x9096ea6f3848984fULL, -794, -220},
+	{0xd77485cb25823ac7ULL, -768, -212},
+	{0xa086cfcd97bf97f4ULL, -741, -204},
+	{0xef340a98172aace5ULL, -715, -196},
+	{0xb23867fb2a35b28eULL, -688, -188},
+	{0x84c8d4dfd2c63f3bULL, -661, -180},
+	{0xc5dd44271ad3cdbaULL, -635, -172},
+	{0x936b9fcebb25c996ULL, -608, -164},
+	{0xdbac6c247d62a584ULL, -582, -156},
+	{0xa3ab66580d5fdaf6ULL, -555, -148},
+	{0xf3e2f893dec3f126ULL, -529, -140},
+	{0xb5b5ada8aaff80b8ULL, -502, -132},
+	{0x87625f056c7c4a8bULL, -475, -124},
+	{0xc9bcff6034c13053ULL, -449, -116},
+	{0x964e858c91ba2655ULL, -422, -108},
+	{0xdff9772470297ebdULL, -396, -100},
+	{0xa6dfbd9fb8e5b88fULL, -369, -92},
+	{0xf8a95fcf88747d94ULL, -343, -84},
+	{0xb94470938fa89bcfULL, -316, -76},
+	{0x8a08f0f8bf0f156bULL, -289, -68},
+	{0xcdb02555653131b6ULL, -263, -60},
+	{0x993fe2c6d07b7facULL, -236, -52},
+	{0xe45c10c42a2b3b06ULL, -210, -44},
+	{0xaa242499697392d3ULL, -183, -36},
+	{0xfd87b5f28300ca0eULL, -157, -28},
+	{0xbce5086492111aebULL, -130, -20},
+	{0x8cbccc096f5088ccULL, -103, -12},
+	{0xd1b71758e219652cULL, -77, -4},
+	{0x9c40000000000000ULL, -50, 4},
+	{0xe8d4a51000000000ULL, -24, 12},
+	{0xad78ebc5ac620000ULL, 3, 20},
+	{0x813f3978f8940984ULL, 30, 28},
+	{0xc097ce7bc90715b3ULL, 56, 36},
+	{0x8f7e32ce7bea5c70ULL, 83, 44},
+	{0xd5d238a4abe98068ULL, 109, 52},
+	{0x9f4f2726179a2245ULL, 136, 60},
+	{0xed63a231d4c4fb27ULL, 162, 68},
+	{0xb0de65388cc8ada8ULL, 189, 76},
+	{0x83c7088e1aab65dbULL, 216, 84},
+	{0xc45d1df942711d9aULL, 242, 92},
+	{0x924d692ca61be758ULL, 269, 100},
+	{0xda01ee641a708deaULL, 295, 108},
+	{0xa26da3999aef774aULL, 322, 116},
+	{0xf209787bb47d6b85ULL, 348, 124},
+	{0xb454e4a179dd1877ULL, 375, 132},
+	{0x865b86925b9bc5c2ULL, 402, 140},
+	{0xc83553c5c8965d3dULL, 428, 148},
+	{0x952ab45cfa97a0b3ULL, 455, 156},
+	{0xde469fbd99a05fe3ULL, 481, 164},
+	{0xa59bc234db398c25ULL, 508, 172},
+	{0xf6c69a72a3989f5cULL, 534, 180},
+	{0xb7dcbf5354e9beceULL, 561, 188},
+	{0x88fcf317f22241e2ULL, 588, 196},
+	{0xcc20ce9bd35c78a5ULL, 614, 204},
+	{0x98165af37b2153dfULL, 641, 212},
+	{0xe2a0b5dc971f303aULL, 667, 220},
+	{0xa8d9d1535ce3b396ULL, 694, 228},
+	{0xfb9b7cd9a4a7443cULL, 720, 236},
+	{0xbb764c4ca7a44410ULL, 747, 244},
+	{0x8bab8eefb6409c1aULL, 774, 252},
+	{0xd01fef10a657842cULL, 800, 260},
+	{0x9b10a4e5e9913129ULL, 827, 268},
+	{0xe7109bfba19c0c9dULL, 853, 276},
+	{0xac2820d9623bf429ULL, 880, 284},
+	{0x80444b5e7aa7cf85ULL, 907, 292},
+	{0xbf21e44003acdd2dULL, 933, 300},
+	{0x8e679c2f5e44ff8fULL, 960, 308},
+	{0xd433179d9c8cb841ULL, 986, 316},
+	{0x9e19db92b4e31ba9ULL, 1013, 324},
+	{0xeb96bf6ebadf77d9ULL, 1039, 332},
+	{0xaf87023b9bf0ee6bULL, 1066, 340},
+};
+
+/* 10^1 to 10^7 */
+static const struct SNumCp snum_cp_adj[7] = {
+	{0xa000000000000000ULL, -60, 1}, {0xc800000000000000ULL, -57, 2},
+	{0xfa00000000000000ULL, -54, 3}, {0x9c40000000000000ULL, -50, 4},
+	{0xc350000000000000ULL, -47, 5}, {0xf424000000000000ULL, -44, 6},
+	{0x9896800000000000ULL, -40, 7}};
+
+/*
+ * Shortest digits: Grisu3
+ */
+
+#define SNUM_MIN_TEXP -60 /* scaled exponent range: [-60, -32] */
+
+/* Decimal digits shortening, S_FALSE if not sure of being correct */
+static srt_bool snum_round_weed(char *b, size_t n, uint64_t dist_high_w,
+				uint64_t unsafe, uint64_t rest,
+				uint64_t ten_kappa, uint64_t unit)
+{
+	uint64_t small_d = dist_high_w - unit, big_d = dist_high_w + unit;
+	while (rest < small_d && unsafe - rest >= ten_kappa
+	       && (rest + ten_kappa < small_d
+		   || small_d - rest >= rest + ten_kappa - small_d)) {
+		b[n - 1]--;
+		rest += ten_kappa;
+	}
+	if (rest < big_d && unsafe - rest >= ten_kappa
+	    && (rest + ten_kappa < big_d
+		|| big_d - rest > rest + ten_kappa - big_d))
+		return S_FALSE;
+	return 2 * unit <= rest && rest <= unsafe - 4 * unit ? S_TRUE : S_FALSE;
+}
+
+static srt_bool snum_digit_gen(struct SNumFp lo, struct SNumFp w,
+			       struct SNumFp hi, char *b, size_t *n,
+			       int *kappa)
+{
+	static const uint32_t p10[11] = {0,	 1,	  10,	    100,
+					 1000,	 10000,	  100000,   1000000,
+					 10000000, 100000000, 1000000000};
+	unsigned d;
+	uint32_t integrals, div;
+	int k, sh = -w.e;
+	uint64_t unit = 1, too_low = lo.f - unit, too_high = hi.f + unit,
+		 unsafe = too_high - too_low, one = (uint64_t)1 << sh,
+		 fractionals = too_high & (one - 1), rest;
+	integrals = (uint32_t)(too_high >> sh);
+	k = (((64 - sh + 1) * 1233) >> 12) + 1;
+	if (integrals < p10[k])
+		k--;
+	div = p10[k];
+	*n = 0;
+	for (; k > 0; div /= 10) {
+		d = integrals / div;
+		b[(*n)++] = (char)('0' + d);
+		integrals %= div;
+		k--;
+		rest = ((uint64_t)integrals << sh) + fractionals;
+		if (rest < unsafe) {
+			*kappa = k;
+			return snum_round_weed(b, *n, too_high - w.f, unsafe,
+					       rest, (uint64_t)div << sh, unit);
+		}
+	}
+	for (;;) {
+		fractionals *= 10;
+		unit *= 10;
+		unsafe *= 10;
+		b[(*n)++] = (char)('0' + (fractionals >> sh));
+		fractionals &= one - 1;
+		k--;
+		if (fractionals < unsafe) {
+			*kappa = k;
+			return snum_round_weed(b, *n, (too_high - w.f) * unit,
+					       unsafe, fractionals, one, unit);
+		}
+	}
+}
+
+/* Value: f * 2^e; digits * 10^(*dexp) */
+static srt_bool snum_grisu3(uint64_t f, int e, srt_bool lower_closer,
+			    char *b, size_t *n, int *dexp)
+{
+	int kappa, k, i;
+	double t;
+	struct SNumFp w, lo, hi, c;
+	w = snum_fp_norm(snum_fp(f, e));
+	hi = snum_fp_norm(snum_fp((f << 1) + 1, e - 1));
+	lo = lower_closer ? snum_fp((f << 2) - 1, e - 2)
+			  : snum_fp((f << 1) - 1, e - 1);
+	lo.f <<= lo.e - hi.e;
+	lo.e = hi.e;
+	/* Cached power so the scaled exponent is in the target range */
+	t = (SNUM_MIN_TEXP - (w.e + 64) + 63) * 0.30102999566398114;
+	k = (int)t;
+	if (t > 0 && (double)k < t)
+		k++;
+	i = (SNUM_CP_OFFSET + k - 1) / SNUM_CP_STEP + 1;
+	c = snum_fp(snum_cp[i].f, snum_cp[i].e);
+	if (!snum_digit_gen(snum_fp_mul(lo, c), snum_fp_mul(w, c),
+			    snum_fp_mul(hi, c), b, n, &kappa))
+		return S_FALSE;
+	*dexp = kappa - snum_cp[i].k;
+	return S_TRUE;
+}
+
+/*
+ * Shortest digits: exact ("free format" algorithm, big integers)
+ */
+static size_t snum_shortest_bn(uint64_t f, int e, srt_bool lower_closer,
+			       char *b, int *dpos)
+{
+	size_t n = 0, bits;
+	int k, c, in_lo, in_hi, even = !(f & 1);
+	unsigned d;
+	double t;
+	struct SNumBn num, den, dlo, dhi;
+	for (bits = 0; (f >> bits) > 1; bits++)
+		;
+	t = ((double)e + (double)bits) * 0.30102999566398114 - 1e-10;
+	k = (int)t;
+	if (t > 0 && (double)k < t)
+		k++;
+	/* v = num / den, boundaries: (num - dlo) / den, (num + dhi) / den */
+	if (e >= 0) {
+		sbn_set(&num, f);
+		sbn_shl(&num, (size_t)e + 1);
+		sbn_set(&den, 2);
+		sbn_set(&dlo, 1);
+		sbn_shl(&dlo, (size_t)e);
+		dhi = dlo;
+		sbn_mulpow10(&den, (size_t)k);
+	} else if (k >= 0) {
+		sbn_set(&num, f);
+		sbn_shl(&num, 1);
+		sbn_set(&den, 1);
+		sbn_mulpow10(&den, (size_t)k);
+		sbn_shl(&den, (size_t)(1 - e));
+		sbn_set(&dlo, 1);
+		dhi = dlo;
+	} else {
+		sbn_set(&dlo, 1);
+		sbn_mulpow10(&dlo, (size_t)-k);
+		dhi = dlo;
+		sbn_set(&num, f);
+		sbn_mulpow10(&num, (size_t)-k);
+		sbn_shl(&num, 1);
+		sbn_set(&den, 1);
+		sbn_shl(&den, (size_t)(1 - e));
+	}
+	if (lower_closer) {
+		sbn_shl(&num, 1);
+		sbn_shl(&den, 1);
+		sbn_shl(&dhi, 1);
+	}
+	/* The estimated power could be one less than the right one */
+	c = sbn_cmp_sum(&num, &dhi, &den);
+	if (even ? c >= 0 : c > 0) {
+		*dpos = k + 1;
+	} else {
+		*dpos = k;
+		sbn_muladd(&num, 10, 0);
+		sbn_muladd(&dlo, 10, 0);
+		sbn_muladd(&dhi, 10, 0);
+	}
+	for (;;) {
+		d = sbn_divmod(&num, &den);
+		b[n++] = (char)('0' + d);
+		c = sbn_cmp(&num, &dlo);
+		in_lo = even ? c <= 0 : c < 0;
+		c = sbn_cmp_sum(&num, &dhi, &den);
+		in_hi = even ? c >= 0 : c > 0;
+		if (!in_lo && !in_hi) {
+			sbn_muladd(&num, 10, 0);
+			sbn_muladd(&dlo, 10, 0);
+			sbn_muladd(&dhi, 10, 0);
+			continue;
+		}
+		if (in_lo && in_hi) { /* closest, ties: even digit */
+			c = sbn_cmp_sum(&num, &num, &den);
+			if (c > 0 || (c == 0 && (d & 1)))
+				b[n - 1]++;
+		} else if (in_hi) {
+			b[n - 1]++;
+		}
+		return n;
+	}
+}
+
+/* Shortest digits for f * 2^e, decimal point at 'dpos' */
+static size_t snum_shortest(uint64_t f, int e, srt_bool lower_closer,
+			    char *b, int *dpos)
+{
+	size_t n;
+	int dexp;
+	if (snum_grisu3(f, e, lower_closer, b, &n, &dexp)) {
+		*dpos = (int)n + dexp;
+		return n;
+	}
+	return snum_shortest_bn(f, e, lower_closer, b, dpos);
+}
+
+/* Digits with the decimal point at 'dpos' (0.digits * 10^dpos) */
+static size_t snum_fmt(const char *b, size_t n, int dpos, char *o)
+{
+	int i, x;
+	char *p = o;
+	if (dpos > 0 && dpos <= 21) {
+		if ((int)n <= dpos) {
+			memcpy(p, b, n);
+			p += n;
+			for (i = (int)n; i < dpos; i++)
+				*p++ = '0';
+		} else {
+			memcpy(p, b, (size_t)dpos);
+			p += dpos;
+			*p++ = '.';
+			memcpy(p, b + dpos, n - (size_t)dpos);
+			p += n - (size_t)dpos;
+		}
+		return (size_t)(p - o);
+	}
+	if (dpos > -6 && dpos <= 0) {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = dpos; i < 0; i++)
+			*p++ = '0';
+		memcpy(p, b, n);
+		return (size_t)(p - o) + n;
+	}
+	*p++ = b[0];
+	if (n > 1) {
+		*p++ = '.';
+		memcpy(p, b + 1, n - 1);
+		p += n - 1;
+	}
+	x = dpos - 1;
+	*p++ = 'e';
+	*p++ = x < 0 ? '-' : '+';
+	return (size_t)(p - o) + snum_u64toa((uint64_t)(x < 0 ? -x : x), p);
+}
+
+static size_t snum_fptoa(srt_bool neg, uint64_t f, int e,
+			 srt_bool lower_closer, char *o)
+{
+	size_t n;
+	int dpos;
+	char b[24], *p = o;
+	if (neg)
+		*p++ = '-';
+	if (!f) {
+		*p = '0';
+		return (size_t)(p - o) + 1;
+	}
+	n = snum_shortest(f, e, lower_closer, b, &dpos);
+	return (size_t)(p - o) + snum_fmt(b, n, dpos, p);
+}
+
+static size_t snum_special(srt_bool neg, srt_bool nan, char *o)
+{
+	const char *t = nan ? "nan" : neg ? "-inf" : "inf";
+	size_t n = nan || !neg ? 3 : 4;
+	memcpy(o, t, n);
+	return n;
+}
+
+size_t snum_dtoa(double v, char *o)
+{
+	uint64_t x, fr;
+	int be;
+	memcpy(&x, &v, sizeof(x));
+	fr = x & S_NBITMASK64(52);
+	be = (int)((x >> 52) & 0x7ff);
+	if (be == 0x7ff)
+		return snum_special(x >> 63 ? S_TRUE : S_FALSE,
+				    fr ? S_TRUE : S_FALSE, o);
+	if (!be)
+		return snum_fptoa(x >> 63 ? S_TRUE : S_FALSE, fr, -1074,
+				  S_FALSE, o);
+	return snum_fptoa(x >> 63 ? S_TRUE : S_FALSE, fr | S_NBIT64(52),
+			  be - 1075, !fr && be > 1 ? S_TRUE : S_FALSE, o);
+}
+
+size_t snum_ftoa(float v, char *o)
+{
+	uint32_t x, fr;
+	int be;
+	memcpy(&x, &v, sizeof(x));
+	fr = x & 0x7fffff;
+	be = (int)((x >> 23) & 0xff);
+	if (be == 0xff)
+		return snum_special(x >> 31 ? S_TRUE : S_FALSE,
+				    fr ? S_TRUE : S_FALSE, o);
+	if (!be)
+		return snum_fptoa(x >> 31 ? S_TRUE : S_FALSE, fr, -149,
+				  S_FALSE, o);
+	return snum_fptoa(x >> 31 ? S_TRUE : S_FALSE, fr | 0x800000,
+			  be - 150, !fr && be > 1 ? S_TRUE : S_FALSE, o);
+}
+
+/*
+ * Parsing
+ */
+
+size_t snum_atoi64(const char *s, size_t ss, int64_t *v)
+{
+	size_t i = 0, i0;
+	uint64_t acc = 0, lim;
+	srt_bool neg = S_FALSE, sat = S_FALSE;
+	unsigned d;
+	*v = 0;
+	RETURN_IF(!s || !ss, 0);
+	if (s[0] == '-' || s[0] == '+')
+		neg = s[i++] == '-' ? S_TRUE : S_FALSE;
+	lim = neg ? (uint64_t)1 << 63 : ((uint64_t)1 << 63) - 1;
+	for (i0 = i; i < ss && (d = (unsigned)(s[i] - '0')) < 10; i++) {
+		if (sat || acc > (lim - d) / 10)
+			sat = S_TRUE;
+		else
+			acc = acc * 10 + d;
+	}
+	RETURN_IF(i == i0, 0);
+	if (sat)
+		acc = lim;
+	*v = !neg ? (int64_t)acc
+		  : acc == (uint64_t)1 << 63 ? (int64_t)(acc - 1) * -1 - 1
+					     : -(int64_t)acc;
+	return i;
+}
+
+/* Significant digits kept (more than needed for deciding any halfway) */
+#define SNUM_ATOD_DIGITS 780
+
+#define SNUM_DBL_HIDDEN S_NBIT64(52)
+#define SNUM_DBL_DENORM_E -1074
+#define SNUM_DBL_MAX_E 972
+
+static double snum_u64tod(uint64_t x)
+{
+	double r;
+	memcpy(&r, &x, sizeof(r));
+	return r;
+}
+
+static uint64_t snum_dtou64(double d)
+{
+	uint64_t x;
+	memcpy(&x, &d, sizeof(x));
+	return x;
+}
+
+/* f * 2^e to double (truncated, 'f' up to 64 bits) */
+static double snum_fp2d(uint64_t f, int e)
+{
+	for (; f > SNUM_DBL_HIDDEN + S_NBITMASK64(52); f >>= 1, e++)
+		;
+	RETURN_IF(e >= SNUM_DBL_MAX_E, snum_u64tod(0x7ff0000000000000ULL));
+	RETURN_IF(e < SNUM_DBL_DENORM_E, 0);
+	for (; e > SNUM_DBL_DENORM_E && !(f & SNUM_DBL_HIDDEN); f <<= 1, e--)
+		;
+	if (e == SNUM_DBL_DENORM_E && !(f & SNUM_DBL_HIDDEN))
+		return snum_u64tod(f);
+	return snum_u64tod((f & S_NBITMASK64(52))
+			   | ((uint64_t)(e + 1075) << 52));
+}
+
+/*
+ * Decimal digits * 10^e to double, using 64-bit arithmetic. Returns S_FALSE
+ * if the result could be one unit in the last place below the right one
+ */
+static srt_bool snum_dig2d_fp(const char *dig, size_t nd, long e, double *r)
+{
+	size_t i, prec, rd = S_MIN(nd, 19);
+	int j, old_e, o, sig;
+	uint64_t f = 0, err, bits, half; /* 'err': 1/8 units of the last bit */
+	struct SNumFp in;
+	const struct SNumCp *a;
+	for (i = 0; i < rd; i++)
+		f = f * 10 + (uint64_t)(dig[i] - '0');
+	if (nd > rd && dig[rd] >= '5')
+		f++;
+	e += (long)(nd - rd);
+	err = nd > rd ? 4 : 0;
+	in = snum_fp_norm(snum_fp(f, 0));
+	err <<= -in.e;
+	j = (int)((e + SNUM_CP_OFFSET) / SNUM_CP_STEP);
+	if (snum_cp[j].k != e) {
+		a = &snum_cp_adj[e - snum_cp[j].k - 1];
+		in = snum_fp_mul(in, snum_fp(a->f, a->e));
+		if (nd + (size_t)a->k > 19)
+			err += 4;
+	}
+	in = snum_fp_mul(in, snum_fp(snum_cp[j].f, snum_cp[j].e));
+	err += 4 + (err ? 1 : 0) + 4;
+	old_e = in.e;
+	in = snum_fp_norm(in);
+	err <<= old_e - in.e;
+	/* Significand bits available (fewer for denormals) */
+	o = 64 + in.e;
+	sig = o >= SNUM_DBL_DENORM_E + 53 ? 53
+	      : o <= SNUM_DBL_DENORM_E	  ? 0
+					  : o - SNUM_DBL_DENORM_E;
+	prec = (size_t)(64 - sig);
+	if (prec + 3 >= 64) {
+		j = (int)(prec + 3 - 64 + 1);
+		in.f >>= j;
+		in.e += j;
+		err = (err >> j) + 1 + 8;
+		prec -= (size_t)j;
+	}
+	bits = (in.f & S_NBITMASK64(prec)) * 8;
+	half = S_NBIT64(prec - 1) * 8;
+	f = in.f >> prec;
+	if (bits >= half + err)
+		f++;
+	*r = snum_fp2d(f, in.e + (int)prec);
+	return half - err >= bits || bits >= half + err ? S_TRUE : S_FALSE;
+}
+
+/* Decimal digits * 10^e compared to (2f + 1) * 2^(be - 1) */
+static int snum_cmp_upper(const char *dig, size_t nd, long e, uint64_t f,
+			  int be)
+{
+	size_t i;
+	long p2 = (long)be - 1 - e;
+	struct SNumBn a, b;
+	sbn_set(&a, 0);
+	for (i = 0; i < nd; i++)
+		sbn_muladd(&a, 10, (uint32_t)(dig[i] - '0'));
+	sbn_set(&b, f * 2 + 1);
+	if (e >= 0)
+		sbn_mulpow5(&a, (size_t)e);
+	else
+		sbn_mulpow5(&b, (size_t)-e);
+	if (p2 >= 0)
+		sbn_shl(&b, (size_t)p2);
+	else
+		sbn_shl(&a, (size_t)-p2);
+	return sbn_cmp(&a, &b);
+}
+
+static double snum_dig2d(const char *dig, size_t nd, long e)
+{
+	static const double p10[23] = {
+		1e0,  1e1,  1e2,  1e3,	1e4,  1e5,  1e6,  1e7,
+		1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	size_t i;
+	uint64_t x, f;
+	int be, c;
+	double r;
+	RETURN_IF(!nd, 0);
+	RETURN_IF(e + (long)nd > 309, snum_u64tod(0x7ff0000000000000ULL));
+	RETURN_IF(e + (long)nd <= -324, 0);
+	if (nd <= 15) { /* exact */
+		for (i = 0, x = 0; i < nd; i++)
+			x = x * 10 + (uint64_t)(dig[i] - '0');
+		r = (double)x;
+		if (e < 0 && e >= -22)
+			return r / p10[-e];
+		if (e >= 0 && e <= 22)
+			return r * p10[e];
+		if (e > 22 && e - (15 - (long)nd) <= 22)
+			return r * p10[15 - nd] * p10[e - (15 - (long)nd)];
+	}
+	if (snum_dig2d_fp(dig, nd, e, &r))
+		return r;
+	/* Exact comparison with the halfway to the next value */
+	x = snum_dtou64(r);
+	RETURN_IF(x == 0x7ff0000000000000ULL, r);
+	f = x & S_NBITMASK64(52);
+	be = (int)(x >> 52);
+	if (be)
+		f |= SNUM_DBL_HIDDEN;
+	be = be ? be - 1075 : SNUM_DBL_DENORM_E;
+	c = snum_cmp_upper(dig, nd, e, f, be);
+	return c < 0 || (c == 0 && !(f & 1)) ? r : snum_u64tod(x + 1);
+}
+
+static size_t snum_match_ci(const char *s, size_t ss, const char *w)
+{
+	size_t i;
+	for (i = 0; w[i]; i++)
+		if (i >= ss || (s[i] | 0x20) != w[i])
+			return 0;
+	return i;
+}
+
+size_t snum_atod(const char *s, size_t ss, double *v)
+{
+	char dig[SNUM_ATOD_DIGITS];
+	size_t i = 0, i0, nd = 0, l;
+	long e = 0, x = 0;
+	srt_bool neg = S_FALSE, sticky = S_FALSE, eneg;
+	unsigned d;
+	*v = 0;
+	RETURN_IF(!s || !ss, 0);
+	if (s[0] == '-' || s[0] == '+')
+		neg = s[i++] == '-' ? S_TRUE : S_FALSE;
+	if (snum_match_ci(s + i, ss - i, "inf")) {
+		l = snum_match_ci(s + i, ss - i, "infinity");
+		*v = snum_u64tod(neg ? 0xfff0000000000000ULL
+				     : 0x7ff0000000000000ULL);
+		return i + (l ? l : 3);
+	}
+	if (snum_match_ci(s + i, ss - i, "nan")) {
+		*v = snum_u64tod(neg ? 0xfff8000000000000ULL
+				     : 0x7ff8000000000000ULL);
+		return i + 3;
+	}
+	for (i0 = i; i < ss && (d = (unsigned)(s[i] - '0')) < 10; i++) {
+		if (!nd && !d)
+			continue;
+		if (nd < SNUM_ATOD_DIGITS - 1) {
+			dig[nd++] = s[i];
+			continue;
+		}
+		e++; /* digit not kept */
+		if (d)
+			sticky = S_TRUE;
+	}
+	l = i - i0;
+	if (i < ss && s[i] == '.') {
+		for (i0 = ++i; i < ss && (d = (unsigned)(s[i] - '0')) < 10;
+		     i++) {
+			if (nd >= SNUM_ATOD_DIGITS - 1) {
+				if (d)
+					sticky = S_TRUE;
+				continue;
+			}
+			if (nd || d)
+				dig[nd++] = s[i];
+			e--;
+		}
+		l += i - i0;
+	}
+	RETURN_IF(!l, 0); /* no digits */
+	if (i + 1 < ss && (s[i] | 0x20) == 'e') {
+		i0 = i + 1;
+		eneg = s[i0] == '-' ? S_TRUE : S_FALSE;
+		if (s[i0] == '-' || s[i0] == '+')
+			i0++;
+		if (i0 < ss && (unsigned)(s[i0] - '0') < 10) {
+			for (i = i0; i < ss; i++) {
+				d = (unsigned)(s[i] - '0');
+				if (d > 9)
+					break;
+				if (x < 100000) /* saturated */
+					x = x * 10 + (long)d;
+			}
+			e += eneg ? -x : x;
+		}
+	}
+	if (sticky) {
+		dig[nd++] = '1';
+		e--;
+	} else {
+		for (; nd > 0 && dig[nd - 1] == '0'; nd--, e++)
+			;
+	}
+	*v = snum_dig2d(dig, nd, e);
+	if (neg)
+		*v = -*v;
+	return i;
+}
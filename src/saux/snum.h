@@ -0,0 +1,57 @@
+#ifndef SNUM_H
+#define SNUM_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * snum.h
+ *
+ * Number formatting and parsing
+ *
+ * Features:
+ * - Integer formatting writing two digits at once (digit pair table).
+ * - Shortest round-trip floating point formatting: the fewest digits that
+ *   parse back to the same value (double or float). Grisu3, with exact
+ *   (big integer) fallback for the cases Grisu3 can not decide.
+ * - Correctly rounded floating point parsing (exact for up to 15 digits
+ *   and powers of ten up to 1e22, 64-bit approximation otherwise, checked
+ *   with big integers when close to a rounding boundary).
+ * - Locale independent ('.' as decimal separator, no thousands separator).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "scommon.h"
+
+/* Maximum output size, in bytes */
+#define SNUM_U64_MAX 20
+#define SNUM_I64_MAX 21
+#define SNUM_DTOA_MAX 32
+
+/*
+ * Formatting: the output is not 0-terminated, returning its size. Floating
+ * point output: fixed notation for decimal exponents from -6 to 20
+ * (e.g. "12.5", "0.001", "100"), scientific otherwise (e.g. "1e+21",
+ * "2.5e-7"), "inf", "-inf", and "nan"
+ */
+size_t snum_u64toa(uint64_t v, char *o);
+size_t snum_i64toa(int64_t v, char *o);
+size_t snum_dtoa(double v, char *o);
+size_t snum_ftoa(float v, char *o);
+
+/*
+ * Parsing: optional sign and digits ("[+-]digits"; floating point:
+ * "[+-]digits[.digits][(e|E)[+-]digits]", "inf", "infinity", and "nan",
+ * case insensitive), without skipping white space. Returns the bytes used
+ * (0 if not a number, with 0 as value). Integers out of range are
+ * saturated (INT64_MIN or INT64_MAX).
+ */
+size_t snum_atoi64(const char *s, size_t ss, int64_t *v);
+size_t snum_atod(const char *s, size_t ss, double *v);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+#endif /* #ifndef SNUM_H */
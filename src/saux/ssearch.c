@@ -38,8 +38,9 @@
 			csum_collision_count = 1;                              \
 		} else {                                                       \
 			if (++csum_collision_count > (2 + ts / 2)) {           \
-				return ss_find_csum_slow(s0, (size_t)(s - s0), \
-							 ss, t, ts);           \
+				return ss_find_csum_slow(                      \
+					s0, (size_t)(s - s0) - ts + 1, ss, t,  \
+					ts);                                   \
 			}                                                      \
 		}                                                              \
 	}
@@ -143,3 +144,304 @@ size_t ss_find_csum_fast(const char *s0, size_t off, size_t ss, const char *t,
 	S_FIND_CSUM_SEARCH2(FCSUM_FAST, S_FIND_CSUM_ALG_SWITCH);
 	return S_NPOS;
 }
+
+static size_t ss_find_anyof_generic(const char *s0, size_t off, size_t ss,
+				    const uint8_t *set, size_t nset)
+{
+	size_t i, j;
+	const char *p;
+	if (nset == 1) {
+		p = (const char *)memchr(s0 + off, set[0], ss - off);
+		return p ? (size_t)(p - s0) : S_NPOS;
+	}
+	for (i = off; i < ss; i++)
+		for (j = 0; j < nset; j++)
+			if ((uint8_t)s0[i] == set[j])
+				return i;
+	return S_NPOS;
+}
+
+/*
+ * Vectorized search: candidate positions are filtered comparing the first
+ * and the last target bytes over whole blocks (16 bytes with SSE2, 32 bytes
+ * with AVX2, memchr() for the portable fallback), and then verified with
+ * memcmp(). Verification work is accounted: when it gets over a budget
+ * proportional to the scanned data (e.g. "aaa...ab" on "aaa...a"), the
+ * search continues with ss_find_csum_slow(), keeping the O(n) guarantee.
+ */
+
+#ifdef S_ENABLE_FIND_VECTOR_FILTER
+
+#define SS_FVEC_BUDGET 1024
+
+#define SS_FVEC_VARS size_t vcost = 0
+
+#define SS_FVEC_CHECK(pos)                                                     \
+	if (!memcmp(s0 + (pos) + 1, t + 1, ts - 2))                            \
+		return (pos);                                                  \
+	if ((vcost += ts) > ((pos) - off) * 2 + SS_FVEC_BUDGET)                \
+		return ss_find_csum_slow(s0, (pos) + 1, ss, t, ts);
+
+static size_t ss_find_vec_generic(const char *s0, size_t off, size_t ss,
+				  const char *t, size_t ts)
+{
+	size_t pos;
+	const char *p = s0 + off, *pl = s0 + ss - ts;
+	SS_FVEC_VARS;
+	for (; p <= pl; p++) {
+		p = (const char *)memchr(p, *t, (size_t)(pl - p) + 1);
+		if (!p)
+			break;
+		if (p[ts - 1] == t[ts - 1]) {
+			pos = (size_t)(p - s0);
+			SS_FVEC_CHECK(pos);
+		}
+	}
+	return S_NPOS;
+}
+
+#if defined(S_SIMD_X86_GNUC)
+#include <immintrin.h>
+#define SS_FVEC_CTZ(m) ((size_t)__builtin_ctz(m))
+#elif defined(S_SIMD_X64_MSVC)
+#include <emmintrin.h>
+#include <intrin.h>
+S_INLINE size_t SS_FVEC_CTZ(unsigned m)
+{
+	unsigned long r;
+	_BitScanForward(&r, m);
+	return (size_t)r;
+}
+#endif
+
+#if defined(S_SIMD_X86_GNUC) || defined(S_SIMD_X64_MSVC)
+
+S_SSE2_ATTR static size_t ss_find_vec_sse2(const char *s0, size_t off,
+					   size_t ss, const char *t, size_t ts)
+{
+	size_t i, pos;
+	unsigned m;
+	__m128i a, b;
+	const __m128i f = _mm_set1_epi8(t[0]), l = _mm_set1_epi8(t[ts - 1]);
+	SS_FVEC_VARS;
+	for (i = off; i + 16 <= ss - ts + 1; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(s0 + i));
+		b = _mm_loadu_si128((const __m128i *)(s0 + i + ts - 1));
+		m = (unsigned)_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(a, f), _mm_cmpeq_epi8(b, l)));
+		for (; m; m &= m - 1) {
+			pos = i + SS_FVEC_CTZ(m);
+			SS_FVEC_CHECK(pos);
+		}
+	}
+	return ss_find_vec_generic(s0, i, ss, t, ts);
+}
+
+S_SSE2_ATTR static size_t ss_find_anyof_sse2(const char *s0, size_t off,
+					     size_t ss, const uint8_t *set,
+					     size_t nset)
+{
+	size_t i, j;
+	unsigned m;
+	__m128i a, c, v[SS_FIND_ANYOF_MAX];
+	for (j = 0; j < nset; j++)
+		v[j] = _mm_set1_epi8((char)set[j]);
+	for (i = off; i + 16 <= ss; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(s0 + i));
+		c = _mm_cmpeq_epi8(a, v[0]);
+		for (j = 1; j < nset; j++)
+			c = _mm_or_si128(c, _mm_cmpeq_epi8(a, v[j]));
+		m = (unsigned)_mm_movemask_epi8(c);
+		if (m)
+			return i + SS_FVEC_CTZ(m);
+	}
+	return ss_find_anyof_generic(s0, i, ss, set, nset);
+}
+
+#endif
+
+#ifdef S_SIMD_X86_GNUC
+
+S_AVX2_ATTR static size_t ss_find_vec_avx2(const char *s0, size_t off,
+					   size_t ss, const char *t, size_t ts)
+{
+	size_t i, pos;
+	unsigned m;
+	__m256i a, b;
+	const __m256i f = _mm256_set1_epi8(t[0]),
+		      l = _mm256_set1_epi8(t[ts - 1]);
+	SS_FVEC_VARS;
+	for (i = off; i + 32 <= ss - ts + 1; i += 32) {
+		a = _mm256_loadu_si256((const __m256i *)(s0 + i));
+		b = _mm256_loadu_si256((const __m256i *)(s0 + i + ts - 1));
+		m = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(a, f), _mm256_cmpeq_epi8(b, l)));
+		for (; m; m &= m - 1) {
+			pos = i + SS_FVEC_CTZ(m);
+			SS_FVEC_CHECK(pos);
+		}
+	}
+	return ss_find_vec_sse2(s0, i, ss, t, ts);
+}
+
+#endif
+
+size_t ss_find_vec(const char *s0, size_t off, size_t ss, const char *t,
+		   size_t ts)
+{
+	const char *p;
+	RETURN_IF(!ts || off + ts > ss, S_NPOS);
+	if (ts == 1) {
+		p = (const char *)memchr(s0 + off, *t, ss - off);
+		return p ? (size_t)(p - s0) : S_NPOS;
+	}
+	/* Kernel selection by CPU features (runtime) */
+#if defined(S_SIMD_X86_GNUC)
+	if (__builtin_cpu_supports("avx2"))
+		return ss_find_vec_avx2(s0, off, ss, t, ts);
+	if (__builtin_cpu_supports("sse2"))
+		return ss_find_vec_sse2(s0, off, ss, t, ts);
+#elif defined(S_SIMD_X64_MSVC)
+	return ss_find_vec_sse2(s0, off, ss, t, ts); /* x64: SSE2 always */
+#endif
+	return ss_find_vec_generic(s0, off, ss, t, ts);
+}
+
+size_t ss_find_anyof(const char *s0, size_t off, size_t ss, const uint8_t *set,
+		     size_t nset)
+{
+	RETURN_IF(!nset || off >= ss, S_NPOS);
+#if defined(S_SIMD_X86_GNUC)
+	if (nset > 1 && nset <= SS_FIND_ANYOF_MAX
+	    && __builtin_cpu_supports("sse2"))
+		return ss_find_anyof_sse2(s0, off, ss, set, nset);
+#elif defined(S_SIMD_X64_MSVC)
+	if (nset > 1 && nset <= SS_FIND_ANYOF_MAX)
+		return ss_find_anyof_sse2(s0, off, ss, set, nset);
+#endif
+	return ss_find_anyof_generic(s0, off, ss, set, nset);
+}
+
+#else
+
+size_t ss_find_vec(const char *s0, size_t off, size_t ss, const char *t,
+		   size_t ts)
+{
+	RETURN_IF(!ts || off + ts > ss, S_NPOS);
+	return ss_find_csum_fast(s0, off, ss, t, ts);
+}
+
+size_t ss_find_anyof(const char *s0, size_t off, size_t ss, const uint8_t *set,
+		     size_t nset)
+{
+	RETURN_IF(!nset || off >= ss, S_NPOS);
+	return ss_find_anyof_generic(s0, off, ss, set, nset);
+}
+
+#endif /* #ifdef S_ENABLE_FIND_VECTOR_FILTER */
+
+/*
+ * Precomputed search: target analysis and kernel selection is done once
+ * (ss_search_init()), so repeated searches of the same target have no
+ * setup cost. When no vectorized kernel is available, long targets use
+ * Boyer-Moore-Horspool, with the same verification cost accounting and
+ * ss_find_csum_slow() switch used by the vectorized search.
+ */
+
+#define SS_BMH_BUDGET 1024
+
+static size_t ss_search_k1(const struct SSearch *sp, const char *s0,
+			   size_t off, size_t ss)
+{
+	const char *p = (const char *)memchr(s0 + off, *sp->t, ss - off);
+	return p ? (size_t)(p - s0) : S_NPOS;
+}
+
+static size_t ss_search_bmh(const struct SSearch *sp, const char *s0,
+			    size_t off, size_t ss)
+{
+	size_t i, vcost = 0, ts = sp->ts;
+	const char *t = sp->t;
+	char tl = t[ts - 1];
+	for (i = off; i <= ss - ts; i += sp->bmh[(uint8_t)s0[i + ts - 1]]) {
+		if (s0[i + ts - 1] != tl)
+			continue;
+		if (!memcmp(s0 + i, t, ts - 1))
+			return i;
+		if ((vcost += ts) > (i - off) * 2 + SS_BMH_BUDGET)
+			return ss_find_csum_slow(s0, i + 1, ss, t, ts);
+	}
+	return S_NPOS;
+}
+
+#ifdef S_ENABLE_FIND_VECTOR_FILTER
+
+static size_t ss_search_kgen(const struct SSearch *sp, const char *s0,
+			     size_t off, size_t ss)
+{
+	return ss_find_vec_generic(s0, off, ss, sp->t, sp->ts);
+}
+
+#if defined(S_SIMD_X86_GNUC) || defined(S_SIMD_X64_MSVC)
+static size_t ss_search_ksse2(const struct SSearch *sp, const char *s0,
+			      size_t off, size_t ss)
+{
+	return ss_find_vec_sse2(s0, off, ss, sp->t, sp->ts);
+}
+#endif
+
+#ifdef S_SIMD_X86_GNUC
+static size_t ss_search_kavx2(const struct SSearch *sp, const char *s0,
+			      size_t off, size_t ss)
+{
+	return ss_find_vec_avx2(s0, off, ss, sp->t, sp->ts);
+}
+#endif
+
+#else
+
+static size_t ss_search_kgen(const struct SSearch *sp, const char *s0,
+			     size_t off, size_t ss)
+{
+	return ss_find_csum_fast(s0, off, ss, sp->t, sp->ts);
+}
+
+#endif /* #ifdef S_ENABLE_FIND_VECTOR_FILTER */
+
+void ss_search_init(struct SSearch *sp, const char *t, size_t ts)
+{
+	size_t i;
+	uint32_t skip;
+	if (!sp)
+		return;
+	sp->t = t;
+	sp->ts = t ? ts : 0;
+	sp->kernel = ss_search_kgen;
+	if (sp->ts == 1) {
+		sp->kernel = ss_search_k1;
+		return;
+	}
+	/* Vectorized kernels (filtering faster than BMH skipping) */
+#if defined(S_ENABLE_FIND_VECTOR_FILTER) && defined(S_SIMD_X86_GNUC)
+	if (__builtin_cpu_supports("avx2")) {
+		sp->kernel = ss_search_kavx2;
+		return;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		sp->kernel = ss_search_ksse2;
+		return;
+	}
+#elif defined(S_ENABLE_FIND_VECTOR_FILTER) && defined(S_SIMD_X64_MSVC)
+	sp->kernel = ss_search_ksse2;
+	return;
+#endif
+	if (sp->ts >= SS_SEARCH_BMH_MIN) {
+		skip = ts > 0xffffffff ? 0xffffffff : (uint32_t)ts;
+		for (i = 0; i < 256; i++)
+			sp->bmh[i] = skip;
+		for (i = 0; i < ts - 1; i++)
+			if (ts - 1 - i < skip)
+				sp->bmh[(uint8_t)t[i]] = (uint32_t)(ts - 1 - i);
+		sp->kernel = ss_search_bmh;
+	}
+}
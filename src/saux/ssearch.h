@@ -52,6 +52,19 @@ extern "C" {
  * ss_find_csum_slow: O(n) (half the speed of ss_find_csum_fast in good cases,
  * and just a bit faster in worst cases -as the "fast" algorithm switch
  * requires recomputing again the hash of the target pattern-).
+ * ss_find_vec: vectorized candidate filter (first and last target bytes
+ * compared over 16/32-byte blocks, SSE2/AVX2 kernel selected at run time,
+ * memchr() based portable fallback), switching to ss_find_csum_slow() when
+ * candidate verification cost gets over a budget proportional to the
+ * scanned data, so it is still O(n). Used by ss_find()/ss_find_cn().
+ * ss_find_anyof: locate the first byte belonging to a small set (vectorized
+ * when the set has up to SS_FIND_ANYOF_MAX bytes). Used as prefilter by the
+ * multi-pattern search (ss_mpattern_*()).
+ * ss_search_init/ss_search: precomputed search, for searching the same
+ * target many times: kernel selection (and the Boyer-Moore-Horspool skip
+ * table, for targets of SS_SEARCH_BMH_MIN or more bytes when there is no
+ * vectorized kernel) is done just once.
+ * Same O(n) guarantee as ss_find_vec(). Used by ss_searcher_*().
  *
  * References:
  *   - Rabin-Karp search algorithm (search using a rolling hash)
@@ -87,6 +100,9 @@ extern "C" {
  * Warning: it is a bad idea to disable this without a good reason,
  * as this ensures real-time requirements.
  *
+ * S_ENABLE_FIND_VECTOR_FILTER: use ss_find_vec() vectorized kernels. When
+ * disabled, ss_find_vec() is just an alias of ss_find_csum_fast().
+ *
  * S_ENABLE_FIND_OTHER_EXAMPLES: additional implementations (brute force,
  * Boyer-Moore-Horspool, strstr wrapper). Disabling this could save some
  * space on devices with little memory (e.g. microcontrollers).
@@ -97,14 +113,38 @@ extern "C" {
 #define S_ENABLE_FIND_CSUM_FIRST_CHAR_LOCATION_OPTIMIZATION
 #define S_ENABLE_FIND_CSUM_INNER_LOOP_UNROLLING
 #define S_ENABLE_FIND_CSUM_FAST_TO_SLOW_ALGORITHM_SWITCH
+#define S_ENABLE_FIND_VECTOR_FILTER
+
+#define SS_FIND_ANYOF_MAX 8
+#define SS_SEARCH_BMH_MIN 64
 
 #ifdef S_MINIMAL
 #undef S_ENABLE_FIND_CSUM_FIRST_CHAR_LOCATION_OPTIMIZATION
 #undef S_ENABLE_FIND_CSUM_INNER_LOOP_UNROLLING
+#undef S_ENABLE_FIND_VECTOR_FILTER
 #endif
 
 size_t ss_find_csum_slow(const char *s0, size_t off, size_t ss, const char *t, size_t ts);
 size_t ss_find_csum_fast(const char *s0, size_t off, size_t ss, const char *t, size_t ts);
+size_t ss_find_vec(const char *s0, size_t off, size_t ss, const char *t, size_t ts);
+size_t ss_find_anyof(const char *s0, size_t off, size_t ss, const uint8_t *set, size_t nset);
+
+struct SSearch {
+	const char *t;
+	size_t ts;
+	size_t (*kernel)(const struct SSearch *sp, const char *s0, size_t off,
+			 size_t ss);
+	uint32_t bmh[256]; /* skip table (targets >= SS_SEARCH_BMH_MIN) */
+};
+
+void ss_search_init(struct SSearch *sp, const char *t, size_t ts);
+
+S_INLINE size_t ss_search(const struct SSearch *sp, const char *s0, size_t off,
+			  size_t ss)
+{
+	RETURN_IF(!sp->ts || off >= ss || sp->ts > ss - off, S_NPOS);
+	return sp->kernel(sp, s0, off, ss);
+}
 
 #ifdef __cplusplus
 } /* extern "C" { */
@@ -8,6 +8,115 @@
  */
 
 #include "sstringo.h"
+#include "scommon.h"
+
+/*
+ * String heap
+ */
+
+#define SSH_ALIGN 8
+#define SSH_CHUNK_MIN 4096
+#define SSH_CHUNK_MAX (1024 * 1024)
+
+struct SSHeapChunk {
+	struct SSHeapChunk *prev;
+	size_t size, used;
+};
+
+#define SSH_ALIGN_UP(n) (((n) + SSH_ALIGN - 1) & ~(size_t)(SSH_ALIGN - 1))
+#define SSH_CHUNK_HDR SSH_ALIGN_UP(sizeof(struct SSHeapChunk))
+
+static void *sso_heap_raw(struct SSHeap *h, size_t n)
+{
+	size_t cs;
+	uint8_t *p;
+	struct SSHeapChunk *c = h->c;
+	n = SSH_ALIGN_UP(n);
+	if (!c || c->size - c->used < n) {
+		/*
+		 * Geometric growth (capped), so the chunk count stays small
+		 * and releasing the heap does not depend on the string count
+		 */
+		cs = c ? S_MIN(c->size * 2, SSH_CHUNK_MAX) : SSH_CHUNK_MIN;
+		cs = S_MAX(cs, n);
+		c = (struct SSHeapChunk *)s_malloc(SSH_CHUNK_HDR + cs);
+		RETURN_IF(!c, NULL);
+		c->prev = h->c;
+		c->size = cs;
+		c->used = 0;
+		h->c = c;
+	}
+	p = (uint8_t *)c + SSH_CHUNK_HDR + c->used;
+	c->used += n;
+	h->used += n;
+	return p;
+}
+
+struct SSHeap *sso_heap_alloc(void)
+{
+	struct SSHeap *h = (struct SSHeap *)s_malloc(sizeof(struct SSHeap));
+	RETURN_IF(!h, NULL);
+	h->c = NULL;
+	h->used = 0;
+	return h;
+}
+
+void sso_heap_free(struct SSHeap **h)
+{
+	struct SSHeapChunk *c, *prev;
+	if (h && *h) {
+		for (c = (*h)->c; c; c = prev) {
+			prev = c->prev;
+			s_free(c);
+		}
+		s_free(*h);
+		*h = NULL;
+	}
+}
+
+void sso_heap_reset(struct SSHeap *h)
+{
+	struct SSHeapChunk *c, *prev;
+	if (!h || !h->c)
+		return;
+	/* Keep the newest chunk, which is the biggest one */
+	for (c = h->c->prev; c; c = prev) {
+		prev = c->prev;
+		s_free(c);
+	}
+	h->c->prev = NULL;
+	h->c->used = 0;
+	h->used = 0;
+}
+
+srt_string *sso_heap_dup(struct SSHeap *h, const srt_string *s)
+{
+	void *buf;
+	srt_string *r;
+	size_t ss, max_size;
+	if (!s)
+		s = ss_void;
+	ss = ss_size(s);
+	max_size = ss ? ss : 1;
+	buf = sso_heap_raw(h, sd_alloc_size_raw(sizeof(srt_string), 1,
+						max_size, S_TRUE)
+				      + 1);
+	RETURN_IF(!buf, ss_dup(s)); /* BEHAVIOR: fallback to the C heap */
+	r = ss_alloc_into_ext_buf(buf, max_size);
+	return ss_cpy(&r, s);
+}
+
+srt_string *sso_heap_cpy(struct SSHeap *h, srt_string *s0,
+			 const srt_string *s)
+{
+	if (!s)
+		s = ss_void;
+	if (s0 && s0->d.f.ext_buffer && ss_capacity(s0) >= ss_size(s))
+		return ss_cpy(&s0, s); /* in-place update */
+	if (s0 && !s0->d.f.ext_buffer)
+		ss_free(&s0); /* C heap string (e.g. heap allocation fallback) */
+	return sso_heap_dup(h, s);
+}
 
 #ifdef S_ENABLE_SM_STRING_OPTIMIZATION
 
@@ -17,7 +126,24 @@ S_INLINE const uint8_t *sso_dd_get_s2_raw(const srt_stringo *s)
 	return &s->kv.d.s_raw[0] + ss_size(s1) + sizeof(struct SDataSmall) + 1;
 }
 
-S_INLINE void sso1_set0(srt_stringo1 *so, const srt_string *s, srt_string *s0)
+/*
+ * Out-of-line string placement: reuse the previous string when possible
+ * (always for the C heap; string heap only if it fits), else allocate.
+ */
+S_INLINE srt_string *sso_put(srt_string **s0, const srt_string *s,
+			     struct SSHeap *h)
+{
+	srt_string *r = *s0;
+	*s0 = NULL;
+	if (h)
+		return sso_heap_cpy(h, r, s);
+	if (r)
+		return ss_cpy(&r, s);
+	return ss_dup(s);
+}
+
+S_INLINE void sso1_set0(srt_stringo1 *so, const srt_string *s, srt_string *s0,
+			struct SSHeap *h)
 {
 	size_t ss;
 	if (!so)
@@ -32,18 +158,15 @@ S_INLINE void sso1_set0(srt_stringo1 *so, const srt_string *s, srt_string *s0)
 		ss_cpy(&s_out, s);
 	} else {
 		so->t = OptStr_I;
-		if (s0) {
-			so->i.s = s0;
-			s0 = NULL;
-			ss_cpy(&so->i.s, s);
-		} else
-			so->i.s = ss_dup(s);
+		so->i.s = sso_put(&s0, s, h);
 	}
-	ss_free(&s0);
+	if (!h) /* string heap: never released one by one */
+		ss_free(&s0);
 }
 
 S_INLINE void sso_set0(srt_stringo *so, const srt_string *s1,
-		       const srt_string *s2, srt_string *sa, srt_string *sb)
+		       const srt_string *s2, srt_string *sa, srt_string *sb,
+		       struct SSHeap *h)
 {
 	size_t s1s, s2s;
 	srt_string *so1, *so2;
@@ -55,63 +178,36 @@ S_INLINE void sso_set0(srt_stringo *so, const srt_string *s1,
 		s2 = ss_void;
 	s1s = ss_size(s1);
 	s2s = ss_size(s2);
-	if (s1s + s2s <= OptStr_MaxSize_DD) {
+	if (s1s + s2s <= OptStr_MaxSize_DD && s1s < OptStr_MaxSize_DD
+	    && s2s < OptStr_MaxSize_DD) { /* no zero-capacity buffer */
 		so1 = (srt_string *)so->kv.di.s_raw;
-		ss_alloc_into_ext_buf(so1, OptStr_MaxSize_DI);
+		ss_alloc_into_ext_buf(so1, OptStr_MaxSize_DD - s2s);
 		ss_cpy(&so1, s1);
 		so->t = OptStr_DD;
 		so2 = (srt_string *)sso_get_s2(so);
-		ss_alloc_into_ext_buf(so2, OptStr_MaxSize_DI - s1s);
+		ss_alloc_into_ext_buf(so2, OptStr_MaxSize_DD - s1s);
 		ss_cpy(&so2, s2);
 	} else if (s1s <= OptStr_MaxSize_DI) {
 		so1 = (srt_string *)so->kv.di.s_raw;
 		ss_alloc_into_ext_buf(so1, OptStr_MaxSize_DI);
 		ss_cpy(&so1, s1);
-		if (sa || sb) {
-			if (sa) {
-				so->kv.di.si = sa;
-				sa = NULL;
-			} else {
-				so->kv.di.si = sb;
-				sb = NULL;
-			}
-			ss_cpy(&so->kv.di.si, s2);
-		} else
-			so->kv.di.si = ss_dup(s2);
+		so->kv.di.si = sso_put(sa ? &sa : &sb, s2, h);
 		so->t = OptStr_DI;
 	} else if (s2s <= OptStr_MaxSize_DI) {
-		if (sa || sb) {
-			if (sa) {
-				so->kv.di.si = sa;
-				sa = NULL;
-			} else {
-				so->kv.di.si = sb;
-				sb = NULL;
-			}
-			ss_cpy(&so->kv.di.si, s1);
-		} else
-			so->kv.di.si = ss_dup(s1);
+		so->kv.di.si = sso_put(sa ? &sa : &sb, s1, h);
 		so2 = (srt_string *)so->kv.di.s_raw;
 		ss_alloc_into_ext_buf(so2, OptStr_MaxSize_DI);
 		ss_cpy(&so2, s2);
 		so->t = OptStr_ID;
 	} else {
-		if (sa) {
-			so->kv.ii.s1 = sa;
-			sa = NULL;
-			ss_cpy(&so->kv.ii.s1, s1);
-		} else
-			so->kv.ii.s1 = ss_dup(s1);
-		if (sb) {
-			so->kv.ii.s2 = sb;
-			sb = NULL;
-			ss_cpy(&so->kv.ii.s2, s2);
-		} else
-			so->kv.ii.s2 = ss_dup(s2);
+		so->kv.ii.s1 = sso_put(&sa, s1, h);
+		so->kv.ii.s2 = sso_put(&sb, s2, h);
 		so->t = OptStr_II;
 	}
-	ss_free(&sa);
-	ss_free(&sb);
+	if (!h) { /* string heap: never released one by one */
+		ss_free(&sa);
+		ss_free(&sb);
+	}
 }
 
 const srt_string *sso1_get(const srt_stringo1 *s)
@@ -150,15 +246,27 @@ const srt_string *sso_get_s2(const srt_stringo *s)
 
 void sso1_set(srt_stringo1 *so, const srt_string *s)
 {
-	sso1_set0(so, s, NULL);
+	sso1_set0(so, s, NULL, NULL);
 }
 
 void sso_set(srt_stringo *so, const srt_string *s1, const srt_string *s2)
 {
-	sso_set0(so, s1, s2, NULL, NULL);
+	sso_set0(so, s1, s2, NULL, NULL, NULL);
 }
 
-void sso_update(srt_stringo *so, const srt_string *s, const srt_string *s2)
+void sso1_set_h(srt_stringo1 *so, const srt_string *s, struct SSHeap *h)
+{
+	sso1_set0(so, s, NULL, h);
+}
+
+void sso_set_h(srt_stringo *so, const srt_string *s1, const srt_string *s2,
+	       struct SSHeap *h)
+{
+	sso_set0(so, s1, s2, NULL, NULL, h);
+}
+
+void sso_update_h(srt_stringo *so, const srt_string *s, const srt_string *s2,
+		  struct SSHeap *h)
 {
 	srt_string *s0, *s20;
 	if (so) {
@@ -170,19 +278,29 @@ void sso_update(srt_stringo *so, const srt_string *s, const srt_string *s2)
 			s20 = so->kv.ii.s2;
 		} else
 			s0 = s20 = NULL;
-		sso_set0(so, s, s2, s0, s20);
+		sso_set0(so, s, s2, s0, s20, h);
 	}
 }
 
-void sso1_update(srt_stringo1 *so, const srt_string *s)
+void sso_update(srt_stringo *so, const srt_string *s, const srt_string *s2)
+{
+	sso_update_h(so, s, s2, NULL);
+}
+
+void sso1_update_h(srt_stringo1 *so, const srt_string *s, struct SSHeap *h)
 {
 	srt_string *s0;
 	if (so) {
 		s0 = so->t == OptStr_I ? so->i.s : NULL;
-		sso1_set0(so, s, s0);
+		sso1_set0(so, s, s0, h);
 	}
 }
 
+void sso1_update(srt_stringo1 *so, const srt_string *s)
+{
+	sso1_update_h(so, s, NULL);
+}
+
 void sso1_setref(srt_stringo1 *so, const srt_string *s)
 {
 	if (so) {
@@ -217,7 +335,7 @@ void sso_free(srt_stringo *so)
 	else if (so->kv.t == OptStr_II) {
 		ss_free(&so->kv.ii.s1);
 		ss_free(&so->kv.ii.s2);
-	} else if (so->kv.t == OptStr_DI)
+	} else if ((so->kv.t & OptStr_Ix) != 0)
 		ss_free(&so->kv.di.si);
 	so->k.t |= OptStr_Null;
 }
@@ -228,18 +346,38 @@ void sso_free(srt_stringo *so)
  */
 
 void sso_dupa(srt_stringo *s)
+{
+	sso_dupa_h(s, NULL);
+}
+
+void sso_dupa1(srt_stringo1 *s)
+{
+	sso_dupa1_h(s, NULL);
+}
+
+/*
+ * Same, placing the strings into a string heap (if not NULL), e.g. for
+ * compacting a string heap into a new one
+ */
+
+S_INLINE srt_string *sso_dup_h(const srt_string *s, struct SSHeap *h)
+{
+	return h ? sso_heap_dup(h, s) : ss_dup(s);
+}
+
+void sso_dupa_h(srt_stringo *s, struct SSHeap *h)
 {
 	switch (s->t) {
 	case OptStr_I:
-		s->k.i.s = ss_dup(s->k.i.s);
+		s->k.i.s = sso_dup_h(s->k.i.s, h);
 		break;
 	case OptStr_DI:
 	case OptStr_ID:
-		s->kv.di.si = ss_dup(s->kv.di.si);
+		s->kv.di.si = sso_dup_h(s->kv.di.si, h);
 		break;
 	case OptStr_II:
-		s->kv.ii.s1 = ss_dup(s->kv.ii.s1);
-		s->kv.ii.s2 = ss_dup(s->kv.ii.s2);
+		s->kv.ii.s1 = sso_dup_h(s->kv.ii.s1, h);
+		s->kv.ii.s2 = sso_dup_h(s->kv.ii.s2, h);
 		break;
 	default:
 		/* cases not using dynamic memory */
@@ -247,10 +385,10 @@ void sso_dupa(srt_stringo *s)
 	}
 }
 
-void sso_dupa1(srt_stringo1 *s)
+void sso_dupa1_h(srt_stringo1 *s, struct SSHeap *h)
 {
 	if (s->t == OptStr_I)
-		s->i.s = ss_dup(s->i.s);
+		s->i.s = sso_dup_h(s->i.s, h);
 }
 
 #endif /* #ifdef S_ENABLE_SM_STRING_OPTIMIZATION */
@@ -123,6 +123,33 @@ typedef struct OptStr1 srt_stringo1; /* one-string */
 
 typedef union OptStr srt_stringo; /* one or two strings sharing space */
 
+/*
+ * String heap: per-container append-only arena for the strings that do not
+ * fit in-place. Strings placed there use external buffers, so they are
+ * never released one by one: the whole heap is reset or freed at once, and
+ * garbage (deleted or overwritten strings) is reclaimed by copying the live
+ * strings into a new heap.
+ */
+
+struct SSHeapChunk;
+
+struct SSHeap {
+	struct SSHeapChunk *c; /* newest chunk (chained to the older ones) */
+	size_t used;	       /* bytes handed out, including garbage */
+};
+
+struct SSHeap *sso_heap_alloc(void);
+void sso_heap_free(struct SSHeap **h);
+void sso_heap_reset(struct SSHeap *h);
+srt_string *sso_heap_dup(struct SSHeap *h, const srt_string *s);
+srt_string *sso_heap_cpy(struct SSHeap *h, srt_string *s0,
+			 const srt_string *s);
+
+S_INLINE size_t sso_heap_used(const struct SSHeap *h)
+{
+	return h ? h->used : 0;
+}
+
 #ifdef S_ENABLE_SM_STRING_OPTIMIZATION
 
 const srt_string *sso1_get(const srt_stringo1 *s);
@@ -139,6 +166,14 @@ void sso1_free(srt_stringo1 *so);
 void sso_free(srt_stringo *so);
 void sso_dupa(srt_stringo *s);
 void sso_dupa1(srt_stringo1 *s);
+void sso1_set_h(srt_stringo1 *so, const srt_string *s, struct SSHeap *h);
+void sso_set_h(srt_stringo *so, const srt_string *s1, const srt_string *s2,
+	       struct SSHeap *h);
+void sso1_update_h(srt_stringo1 *so, const srt_string *s, struct SSHeap *h);
+void sso_update_h(srt_stringo *so, const srt_string *s1,
+		  const srt_string *s2, struct SSHeap *h);
+void sso_dupa_h(srt_stringo *s, struct SSHeap *h);
+void sso_dupa1_h(srt_stringo1 *s, struct SSHeap *h);
 
 #else
 
@@ -227,6 +262,63 @@ S_INLINE void sso_dupa(srt_stringo *s)
 	s->kv.s2 = ss_dup(s->kv.s2);
 }
 
+S_INLINE srt_string *sso_dup_h(const srt_string *s, struct SSHeap *h)
+{
+	return h ? sso_heap_dup(h, s) : ss_dup(s);
+}
+
+S_INLINE void sso1_set_h(srt_stringo1 *so, const srt_string *s,
+			 struct SSHeap *h)
+{
+	if (so)
+		so->s = sso_dup_h(s, h);
+}
+
+S_INLINE void sso_set_h(srt_stringo *so, const srt_string *s1,
+			const srt_string *s2, struct SSHeap *h)
+{
+	if (so) {
+		so->kv.s1 = sso_dup_h(s1, h);
+		so->kv.s2 = sso_dup_h(s2, h);
+	}
+}
+
+S_INLINE void sso1_update_h(srt_stringo1 *so, const srt_string *s,
+			    struct SSHeap *h)
+{
+	if (so) {
+		if (h)
+			so->s = sso_heap_cpy(h, so->s, s);
+		else
+			ss_cpy(&so->s, s);
+	}
+}
+
+S_INLINE void sso_update_h(srt_stringo *so, const srt_string *s1,
+			   const srt_string *s2, struct SSHeap *h)
+{
+	if (so) {
+		if (h) {
+			so->kv.s1 = sso_heap_cpy(h, so->kv.s1, s1);
+			so->kv.s2 = sso_heap_cpy(h, so->kv.s2, s2);
+		} else {
+			ss_cpy(&so->kv.s1, s1);
+			ss_cpy(&so->kv.s2, s2);
+		}
+	}
+}
+
+S_INLINE void sso_dupa1_h(srt_stringo1 *s, struct SSHeap *h)
+{
+	s->s = sso_dup_h(s->s, h);
+}
+
+S_INLINE void sso_dupa_h(srt_stringo *s, struct SSHeap *h)
+{
+	s->kv.s1 = sso_dup_h(s->kv.s1, h);
+	s->kv.s2 = sso_dup_h(s->kv.s2, h);
+}
+
 #endif /* #ifdef S_ENABLE_SM_STRING_OPTIMIZATION */
 
 S_INLINE srt_bool sso1_eq(const srt_string *s, const srt_stringo1 *sso1)
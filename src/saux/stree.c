@@ -36,6 +36,7 @@
  */
 
 #define CW_SIZE 4 /* Node context window size (must be 4) */
+#define RBT_MAX_DEPTH_LOG2 65
 
 enum STNDir { ST_Left = 0, ST_Right = 1 };
 
@@ -140,7 +141,11 @@ S_INLINE enum STNDir cd(enum STNDir d)
 	set_lr(xn, xd, get_lr(yn, d));                                         \
 	set_lr(yn, d, x);                                                      \
 	set_red(t, x, S_TRUE);                                                 \
-	set_red(t, y, S_FALSE);
+	set_red(t, y, S_FALSE);                                                \
+	if (t->aug_f) {                                                        \
+		t->aug_f(t, xn);                                               \
+		t->aug_f(t, yn);                                               \
+	}
 
 S_INLINE srt_tndx rot1x(srt_tree *t, srt_tnode *xn, srt_tndx x, enum STNDir d,
 			enum STNDir xd)
@@ -173,6 +178,40 @@ S_INLINE srt_tndx rot2x(srt_tree *t, srt_tnode *xn, srt_tndx x, enum STNDir d,
 	return rot1x(t, xn, x, d, xd);
 }
 
+/*
+ * Augmented trees: update the nodes from the root to the given key (or to
+ * the position where it would be), bottom-up. For deletion, the path
+ * continues from the matching node to the rightmost node of its left
+ * subtree (where the node used as replacement was removed).
+ */
+static void st_aug_path(srt_tree *t, const srt_tnode *n, srt_bool del)
+{
+	int cmp;
+	srt_tnode *cn;
+	srt_bool rightmost = S_FALSE;
+	srt_tndx c = t->root, p[2 * RBT_MAX_DEPTH_LOG2];
+	size_t np = 0;
+	while (c != ST_NIL && np < 2 * RBT_MAX_DEPTH_LOG2) {
+		cn = get_node(t, c);
+		p[np++] = c;
+		if (rightmost) {
+			c = cn->r;
+			continue;
+		}
+		cmp = t->cmp_f(cn, n);
+		if (!cmp) {
+			if (!del)
+				break;
+			rightmost = S_TRUE;
+			c = cn->x.l;
+			continue;
+		}
+		c = cmp < 0 ? cn->r : cn->x.l;
+	}
+	while (np > 0)
+		t->aug_f(t, get_node(t, p[--np]));
+}
+
 /*
  * If current node is the tree root node, change the root index so it targets
  * the new node.
@@ -237,6 +276,8 @@ srt_tree *st_alloc_raw(srt_cmp cmp_f, srt_bool ext_buf, void *buffer,
 	sd_reset((srt_data *)t, sizeof(srt_tree), elem_size, max_size, ext_buf,
 		 S_FALSE);
 	t->cmp_f = cmp_f;
+	t->aug_f = NULL;
+	t->sh = NULL;
 	t->root = ST_NIL;
 	return t;
 }
@@ -297,6 +338,8 @@ srt_bool st_insert_rw(srt_tree **tt, const srt_tnode *n, srt_tree_rewrite rw_f)
 		new_node(t, node, n, S_FALSE, rw_f, S_FALSE);
 		t->root = 0;
 		st_set_size(t, 1);
+		if (t->aug_f)
+			t->aug_f(t, node);
 		return S_TRUE;
 	}
 	/*
@@ -381,6 +424,8 @@ srt_bool st_insert_rw(srt_tree **tt, const srt_tnode *n, srt_tree_rewrite rw_f)
 		w[cppp].n = get_node(t, w[cppp].x);
 		c = cppp;
 	}
+	if (t->aug_f)
+		st_aug_path(t, n, S_FALSE);
 	return S_TRUE;
 }
 
@@ -400,7 +445,7 @@ srt_bool st_delete(srt_tree *t, const srt_tnode *n, srt_tree_callback callback)
 	srt_tndx y;
 	enum STNDir xd, xd0, d2;
 	srt_tndx s, sz;
-	srt_tnode *yn, *sn, *cpp_d2n;
+	srt_tnode *yn, *sn, *cpp_d2n, *rn = NULL;
 	/* BEHAVIOR: valid request */
 	RETURN_IF(!t || !n, S_FALSE);
 	/* Check empty tree: */
@@ -516,6 +561,10 @@ srt_bool st_delete(srt_tree *t, const srt_tnode *n, srt_tree_callback callback)
 		 * the last current node found. So shifting the last node to
 		 * the location of node to be deleted balancin
 		 */
+		if (t->aug_f) { /* replacement node key, for the path update */
+			rn = (srt_tnode *)s_alloca(t->d.elem_size);
+			copy_node(t, rn, w[c].n);
+		}
 		if (found.n != w[c].n) {
 			/*copy_node_data(t, found.n, cn); ?????*/
 			update_node_data(t, found.n, w[c].n);
@@ -560,6 +609,8 @@ srt_bool st_delete(srt_tree *t, const srt_tnode *n, srt_tree_callback callback)
 		st_set_size(t, ts - 1);
 		if (st_size(t) == 0)
 			t->root = ST_NIL;
+		if (rn)
+			st_aug_path(t, rn, S_TRUE);
 	}
 	/* Set root node as black */
 	set_red(t, t->root, S_FALSE);
@@ -591,8 +642,6 @@ enum eTMode { TR_Preorder, TR_Inorder, TR_Postorder };
  * Aux space: using the stack -i.e. "free"-, O(2 * log(n))
  */
 
-#define RBT_MAX_DEPTH_LOG2 65
-
 static ssize_t srt_treer_aux(const srt_tree *t, st_traverse f, void *context,
 			     enum eTMode m)
 {
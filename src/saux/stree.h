@@ -41,10 +41,26 @@ struct S_Node {
 	srt_tndx r;
 };
 
+struct S_Tree;
+struct SSHeap;
+typedef void (*srt_tree_aug)(const struct S_Tree *t, struct S_Node *n);
+
 struct S_Tree {
 	struct SDataFull d;
 	srt_tndx root;
 	srt_cmp cmp_f;
+	/*
+	 * Optional node augmentation callback (e.g. for subtree summaries):
+	 * recompute node data derived from its children. When set, it is
+	 * called for every node whose subtree changes (rotations, insert and
+	 * delete paths), children always before their parents.
+	 */
+	srt_tree_aug aug_f;
+	/*
+	 * Optional string heap for the node strings (string maps only, see
+	 * sm_alloc_sheap()). NULL: each string is allocated on its own.
+	 */
+	struct SSHeap *sh;
 };
 
 typedef struct S_Node srt_tnode;
@@ -0,0 +1,919 @@
+/*
+ * sfmap.c
+ *
+ * Frozen map handling.
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sfmap.h"
+#include "saux/scommon.h"
+
+/*
+ * Internal constants
+ */
+
+enum SFMKind { SFMK_None, SFMK_I32, SFMK_U32, SFMK_I64, SFMK_F, SFMK_D,
+	       SFMK_S, SFMK_P };
+
+/* key and value kinds, by map type (set types are not supported) */
+static const uint8_t sfm_kinds[SM0_NumTypes][2] = {
+	{SFMK_I32, SFMK_I32}, /*SM0_II32*/
+	{SFMK_U32, SFMK_U32}, /*SM0_UU32*/
+	{SFMK_I64, SFMK_I64}, /*SM0_II*/
+	{SFMK_I64, SFMK_S},   /*SM0_IS*/
+	{SFMK_I64, SFMK_P},   /*SM0_IP*/
+	{SFMK_S, SFMK_I64},   /*SM0_SI*/
+	{SFMK_S, SFMK_S},     /*SM0_SS*/
+	{SFMK_S, SFMK_P},     /*SM0_SP*/
+	{SFMK_None, SFMK_None}, /*SM0_I*/
+	{SFMK_None, SFMK_None}, /*SM0_I32*/
+	{SFMK_None, SFMK_None}, /*SM0_U32*/
+	{SFMK_None, SFMK_None}, /*SM0_S*/
+	{SFMK_None, SFMK_None}, /*SM0_F*/
+	{SFMK_None, SFMK_None}, /*SM0_D*/
+	{SFMK_F, SFMK_F},     /*SM0_FF*/
+	{SFMK_D, SFMK_D},     /*SM0_DD*/
+	{SFMK_D, SFMK_P},     /*SM0_DP*/
+	{SFMK_D, SFMK_S},     /*SM0_DS*/
+	{SFMK_S, SFMK_D}};    /*SM0_SD*/
+
+#define SFM_ALIGN_UP(x) (((x) + 7) & ~(size_t)7)
+#define SFM_HDR_SIZE SFM_ALIGN_UP(sizeof(srt_fmap))
+#define SFM_FILE_MAGIC "SFM1"
+#define SFM_FILE_ENDIANNESS 0x01020304
+#define SFM_FILE_HDR_SIZE (12 + 3 * sizeof(size_t))
+#define SFM_FILE_PC 0x80 /* type flag: prefix-compressed keys */
+
+#define SFM_PC_BLOCK 16
+#define SFM_PC_NBLOCKS(n) (((n) + SFM_PC_BLOCK - 1) / SFM_PC_BLOCK)
+#define SFM_PC_PAD S_PK_U64_MAX_BYTES /* packed integer loads read ahead */
+
+#define SFM_K(m, T, i) (((T *)(m)->k)[i])
+#define SFM_V(m, T, i) (((T *)(m)->v)[i])
+#define SFM_S(m, off) ((const srt_string *)((m)->k + (m)->str_off + (off)))
+
+struct SFMBuild {
+	srt_fmap *m;
+	size_t i, str_off;
+	size_t pc_off;		   /* key block data (prefix-compressed keys) */
+	const srt_string *pc_prev; /* previous key (prefix-compressed keys) */
+};
+
+/* Key cursor, for the ordered enumeration of string keys */
+struct SFMCursor {
+	const srt_fmap *m;
+	size_t i;		/* key slot (0: no more keys) */
+	const srt_string *k;	/* current key */
+	const uint8_t *p;	/* next front-coded key (prefix-compressed) */
+	srt_string *kbuf;	/* decoded key (prefix-compressed) */
+};
+
+/*
+ * Internal functions
+ */
+
+static size_t sfm_kind_size(int kind)
+{
+	switch (kind) {
+	case SFMK_I32:
+		return sizeof(int32_t);
+	case SFMK_U32:
+		return sizeof(uint32_t);
+	case SFMK_I64:
+		return sizeof(int64_t);
+	case SFMK_F:
+		return sizeof(float);
+	case SFMK_D:
+		return sizeof(double);
+	case SFMK_S:
+		return sizeof(size_t); /* offset into the string buffer */
+	case SFMK_P:
+		return sizeof(const void *);
+	default:
+		break;
+	}
+	return 0;
+}
+
+S_INLINE srt_bool sfm_type_ok(int t)
+{
+	return t >= 0 && t < SM0_NumTypes && sfm_kinds[t][0] != SFMK_None
+		       ? S_TRUE
+		       : S_FALSE;
+}
+
+S_INLINE srt_bool sfm_chk_k(const srt_fmap *m, int kind)
+{
+	return m && sfm_kinds[m->type][0] == kind ? S_TRUE : S_FALSE;
+}
+
+/*
+ * Keys and values use (n + 1) slots each, as the Eytzinger layout is
+ * 1-based (slot 0 is unused). Prefix-compressed maps keep the values in
+ * sorted order (also 1-based), and the keys hold the string buffer offset of
+ * every key block, plus the end of the last one.
+ */
+static srt_bool sfm_layout(int t, size_t n, srt_bool pc, size_t *voff,
+			   size_t *str_off)
+{
+	size_t ks, vs;
+	RETURN_IF(!sfm_type_ok(t), S_FALSE);
+	RETURN_IF(pc && sfm_kinds[t][0] != SFMK_S, S_FALSE);
+	ks = sfm_kind_size(sfm_kinds[t][0]);
+	vs = sfm_kind_size(sfm_kinds[t][1]);
+	RETURN_IF(n >= (S_SIZET_MAX / 2) / 16, S_FALSE); /* overflow */
+	*voff = SFM_ALIGN_UP((pc ? SFM_PC_NBLOCKS(n) + 1 : n + 1) * ks);
+	*str_off = *voff + SFM_ALIGN_UP((n + 1) * vs);
+	return S_TRUE;
+}
+
+static srt_fmap *sfm_alloc_raw(int t, size_t n, srt_bool pc, size_t str_size)
+{
+	srt_fmap *m;
+	size_t voff, str_off;
+	RETURN_IF(!sfm_layout(t, n, pc, &voff, &str_off), NULL);
+	RETURN_IF(s_size_t_overflow(str_off, str_size)
+			  || s_size_t_overflow(SFM_HDR_SIZE, str_off + str_size),
+		  NULL);
+	m = (srt_fmap *)s_malloc(SFM_HDR_SIZE + str_off + str_size);
+	RETURN_IF(!m, NULL); /* BEHAVIOR: not enough memory */
+	m->type = (uint8_t)t;
+	m->ksize = (uint8_t)sfm_kind_size(sfm_kinds[t][0]);
+	m->vsize = (uint8_t)sfm_kind_size(sfm_kinds[t][1]);
+	m->pc = (uint8_t)pc;
+	m->size = n;
+	m->raw_size = str_off + str_size;
+	m->str_off = str_off;
+	m->k = (uint8_t *)m + SFM_HDR_SIZE;
+	m->v = m->k + voff;
+	return m;
+}
+
+/* first element in sorted order (0 if empty) */
+S_INLINE size_t sfm_first(size_t n)
+{
+	size_t i = 1;
+	RETURN_IF(!n, 0);
+	while (2 * i <= n)
+		i *= 2;
+	return i;
+}
+
+/* next element in sorted order (0 if there are no more elements) */
+S_INLINE size_t sfm_next(size_t i, size_t n)
+{
+	if (2 * i + 1 <= n) {
+		i = 2 * i + 1;
+		while (2 * i <= n)
+			i *= 2;
+		return i;
+	}
+	while (i & 1)
+		i >>= 1;
+	return i >> 1;
+}
+
+/*
+ * Branchless lower bound: index of the first key >= k (0 if not found). The
+ * descent path is encoded in 'i' bits, so after the loop the trailing 1's
+ * (right turns) and the last 0 (left turn) are removed for getting the
+ * lower bound. The prefetch targets the descendants 4 levels below.
+ */
+#define BUILD_SFM_LB(FN, T)                                                    \
+	static size_t FN(const srt_fmap *m, T k)                               \
+	{                                                                      \
+		const T *keys = (const T *)m->k;                               \
+		size_t i = 1, n = m->size;                                     \
+		while (i <= n) {                                               \
+			S_PREFETCH(keys + 16 * i);                             \
+			i = 2 * i + (keys[i] < k);                             \
+		}                                                              \
+		while (i & 1)                                                  \
+			i >>= 1;                                               \
+		return i >> 1;                                                 \
+	}
+
+BUILD_SFM_LB(sfm_lb_i32, int32_t)
+BUILD_SFM_LB(sfm_lb_u32, uint32_t)
+BUILD_SFM_LB(sfm_lb_i, int64_t)
+BUILD_SFM_LB(sfm_lb_f, float)
+BUILD_SFM_LB(sfm_lb_d, double)
+
+static size_t sfm_lb_s(const srt_fmap *m, const srt_string *k)
+{
+	const size_t *keys = (const size_t *)m->k;
+	size_t i = 1, n = m->size;
+	while (i <= n) {
+		S_PREFETCH(keys + 16 * i);
+		i = 2 * i + (ss_cmp(SFM_S(m, keys[i]), k) < 0);
+	}
+	while (i & 1)
+		i >>= 1;
+	return i >> 1;
+}
+
+static const srt_string *sfm_node_ks(int t, const srt_tnode *cn)
+{
+	if (t == SM0_SS)
+		return sso_get(&((const struct SMapSS *)cn)->s);
+	if (sfm_kinds[t][0] == SFMK_S)
+		return sso1_get(&((const struct SMapS *)cn)->k);
+	return NULL;
+}
+
+static const srt_string *sfm_node_vs(int t, const srt_tnode *cn)
+{
+	switch (t) {
+	case SM0_SS:
+		return sso_get_s2(&((const struct SMapSS *)cn)->s);
+	case SM0_IS:
+		return sso1_get(&((const struct SMapIS *)cn)->v);
+	case SM0_DS:
+		return sso1_get(&((const struct SMapDS *)cn)->v);
+	default:
+		break;
+	}
+	return NULL;
+}
+
+/*
+ * Strings are stored as srt_string objects built into the string buffer
+ * (non-reference strings are position-independent, so the buffer can be
+ * copied or loaded from a file as is)
+ */
+static size_t sfm_str_size(const srt_string *s)
+{
+	return SFM_ALIGN_UP(sd_alloc_size_raw(sizeof(srt_string), 1,
+					      S_MAX(ss_size(s), 1), S_TRUE)
+			    + 1);
+}
+
+static void sfm_st_s(srt_fmap *m, size_t off, const srt_string *s)
+{
+	srt_string *t = ss_alloc_into_ext_buf(m->k + m->str_off + off,
+					      S_MAX(ss_size(s), 1));
+	ss_cpy(&t, s);
+}
+
+static size_t sfm_put_s(struct SFMBuild *b, const srt_string *s)
+{
+	size_t off = b->str_off;
+	sfm_st_s(b->m, off, s);
+	b->str_off += sfm_str_size(s);
+	return off;
+}
+
+static srt_bool sfm_chk_s(const srt_fmap *m, size_t off)
+{
+	const srt_data *d;
+	size_t hs, ms, left, str_size = m->raw_size - m->str_off;
+	RETURN_IF(off % 8 || off >= str_size, S_FALSE);
+	left = str_size - off;
+	RETURN_IF(left < sizeof(struct SDataSmall), S_FALSE);
+	d = (const srt_data *)(m->k + m->str_off + off);
+	RETURN_IF(!d->f.ext_buffer || d->f.flag3, S_FALSE);
+	if (d->f.st_mode == SData_DynSmall) {
+		hs = sizeof(struct SDataSmall);
+	} else {
+		RETURN_IF(d->f.st_mode != SData_DynFull
+				  || left < sizeof(srt_string)
+				  || d->header_size != sizeof(srt_string)
+				  || d->elem_size != 1,
+			  S_FALSE);
+		hs = sizeof(srt_string);
+	}
+	ms = sdx_max_size(d);
+	return sdx_size(d) <= ms && ms < left - hs ? S_TRUE : S_FALSE;
+}
+
+/*
+ * Prefix-compressed keys
+ *
+ * Every block of SFM_PC_BLOCK keys starts with the first key, as a string
+ * built into the buffer, followed by the other keys front-coded: packed
+ * prefix length (bytes shared with the previous key), packed suffix length,
+ * and suffix bytes. Blocks are followed by SFM_PC_PAD bytes (the packed
+ * integer load/store may access a few bytes ahead) and aligned to 8 bytes.
+ */
+
+static size_t sfm_lcp(const char *a, size_t as, const char *b, size_t bs)
+{
+	size_t i = 0, n = S_MIN(as, bs);
+	for (; i < n && a[i] == b[i]; i++)
+		;
+	return i;
+}
+
+/* Add the key for the current slot (just computing its size if no map) */
+static void sfm_pc_put_k(struct SFMBuild *b, const srt_string *k)
+{
+	srt_fmap *m = b->m;
+	uint8_t tmp[4 * S_PK_U64_MAX_BYTES], *p0, *p;
+	size_t lcp, sl;
+	if ((b->i - 1) % SFM_PC_BLOCK == 0) {
+		if (b->i > 1)
+			b->pc_off = SFM_ALIGN_UP(b->pc_off + SFM_PC_PAD);
+		if (m) {
+			SFM_K(m, size_t, (b->i - 1) / SFM_PC_BLOCK) = b->pc_off;
+			sfm_st_s(m, b->pc_off, k);
+		}
+		b->pc_off += sfm_str_size(k);
+	} else {
+		lcp = sfm_lcp(ss_get_buffer_r(b->pc_prev), ss_size(b->pc_prev),
+			      ss_get_buffer_r(k), ss_size(k));
+		sl = ss_size(k) - lcp;
+		p0 = p = m ? m->k + m->str_off + b->pc_off : tmp;
+		s_st_pk_u64(&p, lcp);
+		s_st_pk_u64(&p, sl);
+		if (m)
+			memcpy(p, ss_get_buffer_r(k) + lcp, sl);
+		b->pc_off += (size_t)(p - p0) + sl;
+	}
+	b->pc_prev = k;
+}
+
+/*
+ * Slot of the first key >= k (size + 1 if none). The block is located with a
+ * binary search over the first key of every block, where comparisons skip
+ * the prefix shared by the query and both search bounds. Then, the block
+ * scan tracks the prefix shared by the query and the current key ('l'), so
+ * keys sharing more than that with the previous one are smaller than the
+ * query, keys sharing less are greater, and only the rest are compared (just
+ * the bytes after 'l').
+ */
+static size_t sfm_pc_lb(const srt_fmap *m, const srt_string *k,
+			srt_bool *found)
+{
+	const srt_string *h;
+	const uint8_t *p;
+	const char *ks = ss_get_buffer_r(k), *hs;
+	size_t lo = 0, hi = SFM_PC_NBLOCKS(m->size), mid, l, llo = 0, lhi = 0,
+	       hsz, ksz = ss_size(k), i, cnt, lcp, sl, c;
+	*found = S_FALSE;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		h = SFM_S(m, SFM_K(m, size_t, mid));
+		hs = ss_get_buffer_r(h);
+		hsz = ss_size(h);
+		l = S_MIN(llo, lhi);
+		l += sfm_lcp(hs + l, hsz - l, ks + l, ksz - l);
+		if (l == hsz && l == ksz) {
+			*found = S_TRUE;
+			return mid * SFM_PC_BLOCK + 1;
+		}
+		if (l == hsz
+		    || (l < ksz && (unsigned char)hs[l] < (unsigned char)ks[l])) {
+			lo = mid + 1; /* block first key < k */
+			llo = l;
+		} else {
+			hi = mid;
+			lhi = l;
+		}
+	}
+	RETURN_IF(!lo, 1); /* k is below the first key */
+	i = (lo - 1) * SFM_PC_BLOCK + 1;
+	cnt = S_MIN(SFM_PC_BLOCK, m->size - (i - 1));
+	h = SFM_S(m, SFM_K(m, size_t, lo - 1));
+	p = (const uint8_t *)h + sfm_str_size(h);
+	for (l = llo; --cnt > 0;) {
+		lcp = (size_t)s_ld_pk_u64(&p, SFM_PC_PAD);
+		sl = (size_t)s_ld_pk_u64(&p, SFM_PC_PAD);
+		i++;
+		if (lcp != l) {
+			if (lcp < l)
+				return i; /* greater than k */
+			p += sl;
+			continue; /* same as the previous key: smaller than k */
+		}
+		c = sfm_lcp((const char *)p, sl, ks + l, ksz - l);
+		if (c == sl && l + c == ksz) {
+			*found = S_TRUE;
+			return i;
+		}
+		if (c < sl && (l + c == ksz || p[c] > (unsigned char)ks[l + c]))
+			return i;
+		l += c;
+		p += sl;
+	}
+	return i + 1;
+}
+
+static void sfm_pc_cur_key(struct SFMCursor *c)
+{
+	const srt_fmap *m = c->m;
+	const srt_string *h;
+	size_t lcp, sl;
+	if ((c->i - 1) % SFM_PC_BLOCK == 0) {
+		h = SFM_S(m, SFM_K(m, size_t, (c->i - 1) / SFM_PC_BLOCK));
+		ss_cpy(&c->kbuf, h);
+		c->p = (const uint8_t *)h + sfm_str_size(h);
+	} else {
+		lcp = (size_t)s_ld_pk_u64(&c->p, SFM_PC_PAD);
+		sl = (size_t)s_ld_pk_u64(&c->p, SFM_PC_PAD);
+		ss_resize(&c->kbuf, lcp, 0);
+		ss_cat_cn(&c->kbuf, (const char *)c->p, sl);
+		c->p += sl;
+	}
+	c->k = c->kbuf;
+}
+
+/* Place the cursor at the first key >= k */
+static void sfm_seek_s(struct SFMCursor *c, const srt_fmap *m,
+		       const srt_string *k)
+{
+	size_t i;
+	srt_bool found;
+	c->m = m;
+	c->p = NULL;
+	c->kbuf = NULL;
+	c->k = ss_void;
+	if (!m->pc) {
+		c->i = sfm_lb_s(m, k);
+		if (c->i)
+			c->k = SFM_S(m, SFM_K(m, size_t, c->i));
+		return;
+	}
+	i = sfm_pc_lb(m, k, &found);
+	c->kbuf = i <= m->size ? ss_alloc(64) : NULL;
+	if (!c->kbuf) {
+		c->i = 0; /* BEHAVIOR: no keys, or not enough memory */
+		return;
+	}
+	for (c->i = i - (i - 1) % SFM_PC_BLOCK;; c->i++) {
+		sfm_pc_cur_key(c); /* decoding from the block start */
+		if (c->i == i)
+			break;
+	}
+}
+
+static void sfm_next_s(struct SFMCursor *c)
+{
+	const srt_fmap *m = c->m;
+	if (!m->pc) {
+		c->i = sfm_next(c->i, m->size);
+		c->k = c->i ? SFM_S(m, SFM_K(m, size_t, c->i)) : ss_void;
+	} else if (c->i < m->size) {
+		c->i++;
+		sfm_pc_cur_key(c);
+	} else {
+		c->i = 0;
+		c->k = ss_void;
+	}
+}
+
+/*
+ * Frozen map building
+ */
+
+/* Key blocks check (the packed integers and suffixes stay in the block) */
+static srt_bool sfm_chk_pc(const srt_fmap *m)
+{
+	const uint8_t *p, *end, *base = m->k + m->str_off;
+	size_t b, j, cnt, off, next, hs, ks, lcp, sl,
+		nb = SFM_PC_NBLOCKS(m->size);
+	RETURN_IF(SFM_K(m, size_t, nb) > m->raw_size - m->str_off, S_FALSE);
+	for (b = 0; b < nb; b++) {
+		off = SFM_K(m, size_t, b);
+		next = SFM_K(m, size_t, b + 1);
+		RETURN_IF(!sfm_chk_s(m, off) || next < off, S_FALSE);
+		hs = sfm_str_size(SFM_S(m, off));
+		RETURN_IF(hs > next - off, S_FALSE);
+		p = base + off + hs;
+		end = base + next;
+		ks = ss_size(SFM_S(m, off));
+		cnt = S_MIN(SFM_PC_BLOCK, m->size - b * SFM_PC_BLOCK);
+		for (j = 1; j < cnt; j++) {
+			RETURN_IF((size_t)(end - p) < SFM_PC_PAD, S_FALSE);
+			lcp = (size_t)s_ld_pk_u64(&p, SFM_PC_PAD);
+			RETURN_IF((size_t)(end - p) < SFM_PC_PAD, S_FALSE);
+			sl = (size_t)s_ld_pk_u64(&p, SFM_PC_PAD);
+			RETURN_IF(lcp > ks || sl > (size_t)(end - p), S_FALSE);
+			p += sl;
+			ks = lcp + sl;
+		}
+	}
+	return S_TRUE;
+}
+
+static int sfm_pc_size_node(struct STraverseParams *tp)
+{
+	struct SFMBuild *b = (struct SFMBuild *)tp->context;
+	const srt_tnode *cn = get_node_r(tp->t, tp->c);
+	const srt_string *vs;
+	int t = tp->t->d.sub_type;
+	if (!cn)
+		return 0;
+	sfm_pc_put_k(b, sfm_node_ks(t, cn));
+	if ((vs = sfm_node_vs(t, cn)))
+		b->str_off += sfm_str_size(vs);
+	b->i++;
+	return 0;
+}
+
+static int sfm_build_node(struct STraverseParams *tp)
+{
+	struct SFMBuild *b = (struct SFMBuild *)tp->context;
+	const srt_tnode *cn = get_node_r(tp->t, tp->c);
+	srt_fmap *m = b->m;
+	size_t i = b->i;
+	int t = m->type;
+	if (!cn)
+		return 0;
+	switch (sfm_kinds[t][0]) {
+	case SFMK_I32:
+		((int32_t *)m->k)[i] = ((const struct SMapi *)cn)->k;
+		break;
+	case SFMK_U32:
+		((uint32_t *)m->k)[i] = ((const struct SMapu *)cn)->k;
+		break;
+	case SFMK_I64:
+		((int64_t *)m->k)[i] = ((const struct SMapI *)cn)->k;
+		break;
+	case SFMK_F:
+		((float *)m->k)[i] = ((const struct SMapF *)cn)->k;
+		break;
+	case SFMK_D:
+		((double *)m->k)[i] = ((const struct SMapD *)cn)->k;
+		break;
+	case SFMK_S:
+		if (m->pc)
+			sfm_pc_put_k(b, sfm_node_ks(t, cn));
+		else
+			((size_t *)m->k)[i] = sfm_put_s(b, sfm_node_ks(t, cn));
+		break;
+	default:
+		break;
+	}
+	switch (t) {
+	case SM0_II32:
+		((int32_t *)m->v)[i] = ((const struct SMapii *)cn)->v;
+		break;
+	case SM0_UU32:
+		((uint32_t *)m->v)[i] = ((const struct SMapuu *)cn)->v;
+		break;
+	case SM0_II:
+		((int64_t *)m->v)[i] = ((const struct SMapII *)cn)->v;
+		break;
+	case SM0_SI:
+		((int64_t *)m->v)[i] = ((const struct SMapSI *)cn)->v;
+		break;
+	case SM0_FF:
+		((float *)m->v)[i] = ((const struct SMapFF *)cn)->v;
+		break;
+	case SM0_DD:
+		((double *)m->v)[i] = ((const struct SMapDD *)cn)->v;
+		break;
+	case SM0_SD:
+		((double *)m->v)[i] = ((const struct SMapSD *)cn)->v;
+		break;
+	case SM0_IP:
+		((const void **)m->v)[i] = ((const struct SMapIP *)cn)->v;
+		break;
+	case SM0_SP:
+		((const void **)m->v)[i] = ((const struct SMapSP *)cn)->v;
+		break;
+	case SM0_DP:
+		((const void **)m->v)[i] = ((const struct SMapDP *)cn)->v;
+		break;
+	case SM0_IS:
+	case SM0_SS:
+	case SM0_DS:
+		((size_t *)m->v)[i] = sfm_put_s(b, sfm_node_vs(t, cn));
+		break;
+	default:
+		break;
+	}
+	if (m->pc)
+		b->i = i < m->size ? i + 1 : 0;
+	else
+		b->i = sfm_next(i, m->size);
+	return 0;
+}
+
+/*
+ * Allocation
+ */
+
+srt_fmap *sm_freeze(const srt_map *m)
+{
+	int t;
+	const srt_tnode *cn;
+	const srt_string *s;
+	size_t i, n, str_size = 0;
+	struct SFMBuild b;
+	RETURN_IF(!m, NULL);
+	t = m->d.sub_type;
+	RETURN_IF(!sfm_type_ok(t), NULL);
+	n = sm_size(m);
+	for (i = 0; i < n; i++) {
+		cn = st_enum_r(m, (srt_tndx)i);
+		if ((s = sfm_node_ks(t, cn)))
+			str_size += sfm_str_size(s);
+		if ((s = sfm_node_vs(t, cn)))
+			str_size += sfm_str_size(s);
+	}
+	b.m = sfm_alloc_raw(t, n, S_FALSE, str_size);
+	RETURN_IF(!b.m, NULL);
+	b.i = sfm_first(n);
+	b.str_off = 0;
+	if (n)
+		st_traverse_inorder(m, sfm_build_node, &b);
+	S_ASSERT(!b.i && b.str_off == str_size);
+	return b.m;
+}
+
+srt_fmap *sm_freeze_pc(const srt_map *m)
+{
+	int t;
+	size_t n, kdata_size, vdata_size;
+	struct SFMBuild b;
+	RETURN_IF(!m, NULL);
+	t = m->d.sub_type;
+	RETURN_IF(!sfm_type_ok(t) || sfm_kinds[t][0] != SFMK_S, NULL);
+	n = sm_size(m);
+	b.m = NULL; /* first pass: sizes */
+	b.i = 1;
+	b.str_off = b.pc_off = 0;
+	b.pc_prev = NULL;
+	if (n)
+		st_traverse_inorder(m, sfm_pc_size_node, &b);
+	kdata_size = n ? SFM_ALIGN_UP(b.pc_off + SFM_PC_PAD) : 0;
+	vdata_size = b.str_off;
+	b.m = sfm_alloc_raw(t, n, S_TRUE, kdata_size + vdata_size);
+	RETURN_IF(!b.m, NULL);
+	b.i = n ? 1 : 0;
+	b.str_off = kdata_size; /* value strings go after the key blocks */
+	b.pc_off = 0;
+	b.pc_prev = NULL;
+	if (n)
+		st_traverse_inorder(m, sfm_build_node, &b);
+	SFM_K(b.m, size_t, SFM_PC_NBLOCKS(n)) = kdata_size;
+	S_ASSERT(!b.i && b.str_off == kdata_size + vdata_size);
+	return b.m;
+}
+
+srt_fmap *sfm_dup(const srt_fmap *src)
+{
+	srt_fmap *m;
+	RETURN_IF(!src, NULL);
+	m = (srt_fmap *)s_malloc(SFM_HDR_SIZE + src->raw_size);
+	RETURN_IF(!m, NULL); /* BEHAVIOR: not enough memory */
+	memcpy(m, src, SFM_HDR_SIZE + src->raw_size);
+	m->k = (uint8_t *)m + SFM_HDR_SIZE;
+	m->v = m->k + (src->v - src->k);
+	return m;
+}
+
+void sfm_free_aux(srt_fmap **m, ...)
+{
+	va_list ap;
+	srt_fmap **next;
+	va_start(ap, m);
+	next = m;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next) {
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_fmap **)va_arg(ap, srt_fmap **);
+	}
+	va_end(ap);
+}
+
+/*
+ * Random access
+ */
+
+#define BUILD_SFM_AT(FN, ID, TK, TV, LB, DEF_VAL)                              \
+	TV FN(const srt_fmap *m, TK k)                                         \
+	{                                                                      \
+		size_t i;                                                      \
+		RETURN_IF(!m || m->type != ID, DEF_VAL);                       \
+		i = LB(m, k);                                                  \
+		return i && SFM_K(m, TK, i) == k ? SFM_V(m, TV, i)             \
+						 : DEF_VAL; /* BEHAVIOR */     \
+	}
+
+BUILD_SFM_AT(sfm_at_ii32, SM0_II32, int32_t, int32_t, sfm_lb_i32, 0)
+BUILD_SFM_AT(sfm_at_uu32, SM0_UU32, uint32_t, uint32_t, sfm_lb_u32, 0)
+BUILD_SFM_AT(sfm_at_ii, SM0_II, int64_t, int64_t, sfm_lb_i, 0)
+BUILD_SFM_AT(sfm_at_ff, SM0_FF, float, float, sfm_lb_f, 0)
+BUILD_SFM_AT(sfm_at_dd, SM0_DD, double, double, sfm_lb_d, 0)
+BUILD_SFM_AT(sfm_at_ip, SM0_IP, int64_t, const void *, sfm_lb_i, NULL)
+BUILD_SFM_AT(sfm_at_dp, SM0_DP, double, const void *, sfm_lb_d, NULL)
+
+#define BUILD_SFM_AT_XS(FN, ID, TK, LB)                                        \
+	const srt_string *FN(const srt_fmap *m, TK k)                          \
+	{                                                                      \
+		size_t i;                                                      \
+		RETURN_IF(!m || m->type != ID, ss_void);                       \
+		i = LB(m, k);                                                  \
+		return i && SFM_K(m, TK, i) == k                               \
+			       ? SFM_S(m, SFM_V(m, size_t, i))                 \
+			       : ss_void;                                      \
+	}
+
+BUILD_SFM_AT_XS(sfm_at_is, SM0_IS, int64_t, sfm_lb_i)
+BUILD_SFM_AT_XS(sfm_at_ds, SM0_DS, double, sfm_lb_d)
+
+S_INLINE size_t sfm_locate_s(const srt_fmap *m, const srt_string *k)
+{
+	size_t i;
+	srt_bool found;
+	if (m->pc) {
+		i = sfm_pc_lb(m, k, &found);
+		return found ? i : 0;
+	}
+	i = sfm_lb_s(m, k);
+	return i && !ss_cmp(SFM_S(m, SFM_K(m, size_t, i)), k) ? i : 0;
+}
+
+#define BUILD_SFM_AT_SX(FN, ID, TV, DEF_VAL)                                   \
+	TV FN(const srt_fmap *m, const srt_string *k)                          \
+	{                                                                      \
+		size_t i;                                                      \
+		RETURN_IF(!m || m->type != ID, DEF_VAL);                       \
+		i = sfm_locate_s(m, k);                                        \
+		return i ? SFM_V(m, TV, i) : DEF_VAL; /* BEHAVIOR */           \
+	}
+
+BUILD_SFM_AT_SX(sfm_at_si, SM0_SI, int64_t, 0)
+BUILD_SFM_AT_SX(sfm_at_sd, SM0_SD, double, 0)
+BUILD_SFM_AT_SX(sfm_at_sp, SM0_SP, const void *, NULL)
+
+const srt_string *sfm_at_ss(const srt_fmap *m, const srt_string *k)
+{
+	size_t i;
+	RETURN_IF(!m || m->type != SM0_SS, ss_void);
+	i = sfm_locate_s(m, k);
+	return i ? SFM_S(m, SFM_V(m, size_t, i)) : ss_void;
+}
+
+/*
+ * Existence check
+ */
+
+#define BUILD_SFM_COUNT(FN, KIND, TK, LB)                                      \
+	size_t FN(const srt_fmap *m, TK k)                                     \
+	{                                                                      \
+		size_t i;                                                      \
+		RETURN_IF(!sfm_chk_k(m, KIND), S_FALSE);                       \
+		i = LB(m, k);                                                  \
+		return i && SFM_K(m, TK, i) == k ? 1 : 0;                      \
+	}
+
+BUILD_SFM_COUNT(sfm_count_i32, SFMK_I32, int32_t, sfm_lb_i32)
+BUILD_SFM_COUNT(sfm_count_u32, SFMK_U32, uint32_t, sfm_lb_u32)
+BUILD_SFM_COUNT(sfm_count_i, SFMK_I64, int64_t, sfm_lb_i)
+BUILD_SFM_COUNT(sfm_count_f, SFMK_F, float, sfm_lb_f)
+BUILD_SFM_COUNT(sfm_count_d, SFMK_D, double, sfm_lb_d)
+
+size_t sfm_count_s(const srt_fmap *m, const srt_string *k)
+{
+	RETURN_IF(!sfm_chk_k(m, SFMK_S), S_FALSE);
+	return sfm_locate_s(m, k) ? 1 : 0;
+}
+
+/*
+ * Enumeration
+ */
+
+#define BUILD_SFM_ITR(FN, ID, CALLBACK_T, TK, LB, IN_RANGE, TR_CALLBACK)       \
+	size_t FN(const srt_fmap *m, TK kmin, TK kmax, CALLBACK_T f,           \
+		  void *context)                                               \
+	{                                                                      \
+		size_t i, nelems = 0;                                          \
+		RETURN_IF(!m || m->type != ID, 0);                             \
+		for (i = LB(m, kmin); i && (IN_RANGE);                         \
+		     i = sfm_next(i, m->size)) {                               \
+			if (f && !TR_CALLBACK)                                 \
+				return nelems;                                 \
+			nelems++;                                              \
+		}                                                              \
+		return nelems;                                                 \
+	}
+
+#define BUILD_SFM_ITR_S(FN, ID, CALLBACK_T, TR_CALLBACK)                       \
+	size_t FN(const srt_fmap *m, const srt_string *kmin,                   \
+		  const srt_string *kmax, CALLBACK_T f, void *context)         \
+	{                                                                      \
+		size_t i, nelems = 0;                                          \
+		struct SFMCursor c;                                            \
+		RETURN_IF(!m || m->type != ID, 0);                             \
+		for (sfm_seek_s(&c, m, kmin);                                  \
+		     (i = c.i) && ss_cmp(c.k, kmax) <= 0; sfm_next_s(&c)) {    \
+			if (f && !TR_CALLBACK)                                 \
+				break;                                         \
+			nelems++;                                              \
+		}                                                              \
+		ss_free(&c.kbuf);                                              \
+		return nelems;                                                 \
+	}
+
+#define SFM_KLE(T) (SFM_K(m, T, i) <= kmax)
+#define SFM_VS SFM_S(m, SFM_V(m, size_t, i))
+
+BUILD_SFM_ITR(sfm_itr_ii32, SM0_II32, srt_map_it_ii32, int32_t, sfm_lb_i32,
+	      SFM_KLE(int32_t),
+	      f(SFM_K(m, int32_t, i), SFM_V(m, int32_t, i), context))
+BUILD_SFM_ITR(sfm_itr_uu32, SM0_UU32, srt_map_it_uu32, uint32_t, sfm_lb_u32,
+	      SFM_KLE(uint32_t),
+	      f(SFM_K(m, uint32_t, i), SFM_V(m, uint32_t, i), context))
+BUILD_SFM_ITR(sfm_itr_ii, SM0_II, srt_map_it_ii, int64_t, sfm_lb_i,
+	      SFM_KLE(int64_t),
+	      f(SFM_K(m, int64_t, i), SFM_V(m, int64_t, i), context))
+BUILD_SFM_ITR(sfm_itr_ff, SM0_FF, srt_map_it_ff, float, sfm_lb_f,
+	      SFM_KLE(float), f(SFM_K(m, float, i), SFM_V(m, float, i), context))
+BUILD_SFM_ITR(sfm_itr_dd, SM0_DD, srt_map_it_dd, double, sfm_lb_d,
+	      SFM_KLE(double),
+	      f(SFM_K(m, double, i), SFM_V(m, double, i), context))
+BUILD_SFM_ITR(sfm_itr_is, SM0_IS, srt_map_it_is, int64_t, sfm_lb_i,
+	      SFM_KLE(int64_t), f(SFM_K(m, int64_t, i), SFM_VS, context))
+BUILD_SFM_ITR(sfm_itr_ip, SM0_IP, srt_map_it_ip, int64_t, sfm_lb_i,
+	      SFM_KLE(int64_t),
+	      f(SFM_K(m, int64_t, i), SFM_V(m, const void *, i), context))
+BUILD_SFM_ITR(sfm_itr_ds, SM0_DS, srt_map_it_ds, double, sfm_lb_d,
+	      SFM_KLE(double), f(SFM_K(m, double, i), SFM_VS, context))
+BUILD_SFM_ITR(sfm_itr_dp, SM0_DP, srt_map_it_dp, double, sfm_lb_d,
+	      SFM_KLE(double),
+	      f(SFM_K(m, double, i), SFM_V(m, const void *, i), context))
+BUILD_SFM_ITR_S(sfm_itr_si, SM0_SI, srt_map_it_si,
+		f(c.k, SFM_V(m, int64_t, i), context))
+BUILD_SFM_ITR_S(sfm_itr_sd, SM0_SD, srt_map_it_sd,
+		f(c.k, SFM_V(m, double, i), context))
+BUILD_SFM_ITR_S(sfm_itr_ss, SM0_SS, srt_map_it_ss, f(c.k, SFM_VS, context))
+BUILD_SFM_ITR_S(sfm_itr_sp, SM0_SP, srt_map_it_sp,
+		f(c.k, SFM_V(m, const void *, i), context))
+
+/*
+ * I/O
+ */
+
+ssize_t sfm_write(FILE *handle, const srt_fmap *m)
+{
+	uint8_t hdr[SFM_FILE_HDR_SIZE];
+	uint32_t endianness = SFM_FILE_ENDIANNESS;
+	RETURN_IF(!handle || !m, -1);
+	memcpy(hdr, SFM_FILE_MAGIC, 4);
+	hdr[4] = (uint8_t)(m->type | (m->pc ? SFM_FILE_PC : 0));
+	hdr[5] = (uint8_t)sizeof(size_t);
+	hdr[6] = m->ksize;
+	hdr[7] = m->vsize;
+	memcpy(hdr + 8, &endianness, 4);
+	memcpy(hdr + 12, &m->size, sizeof(size_t));
+	memcpy(hdr + 12 + sizeof(size_t), &m->raw_size, sizeof(size_t));
+	memcpy(hdr + 12 + 2 * sizeof(size_t), &m->str_off, sizeof(size_t));
+	RETURN_IF(fwrite(hdr, 1, sizeof(hdr), handle) != sizeof(hdr), -1);
+	RETURN_IF(fwrite(m->k, 1, m->raw_size, handle) != m->raw_size, -1);
+	return (ssize_t)(sizeof(hdr) + m->raw_size);
+}
+
+srt_fmap *sfm_read(FILE *handle)
+{
+	srt_fmap *m;
+	uint8_t hdr[SFM_FILE_HDR_SIZE];
+	uint32_t endianness;
+	size_t i, n, raw_size, str_off, voff, str_off_exp;
+	int t;
+	srt_bool pc;
+	RETURN_IF(!handle, NULL);
+	RETURN_IF(fread(hdr, 1, sizeof(hdr), handle) != sizeof(hdr), NULL);
+	memcpy(&endianness, hdr + 8, 4);
+	memcpy(&n, hdr + 12, sizeof(size_t));
+	memcpy(&raw_size, hdr + 12 + sizeof(size_t), sizeof(size_t));
+	memcpy(&str_off, hdr + 12 + 2 * sizeof(size_t), sizeof(size_t));
+	t = hdr[4] & ~SFM_FILE_PC;
+	pc = (hdr[4] & SFM_FILE_PC) != 0 ? S_TRUE : S_FALSE;
+	RETURN_IF(memcmp(hdr, SFM_FILE_MAGIC, 4)
+			  || hdr[5] != sizeof(size_t)
+			  || endianness != SFM_FILE_ENDIANNESS
+			  || !sfm_layout(t, n, pc, &voff, &str_off_exp)
+			  || str_off != str_off_exp || raw_size < str_off
+			  || hdr[6] != sfm_kind_size(sfm_kinds[t][0])
+			  || hdr[7] != sfm_kind_size(sfm_kinds[t][1]),
+		  NULL); /* BEHAVIOR: not compatible */
+	m = sfm_alloc_raw(t, n, pc, raw_size - str_off);
+	RETURN_IF(!m, NULL);
+	if (fread(m->k, 1, raw_size, handle) != raw_size) {
+		sfm_free(&m);
+		return NULL;
+	}
+	/*
+	 * Validate the string offsets, so a corrupted file can not trigger
+	 * out of bounds accesses
+	 */
+	for (i = 1; i <= n; i++) {
+		if ((sfm_kinds[t][0] == SFMK_S && !pc
+		     && !sfm_chk_s(m, SFM_K(m, size_t, i)))
+		    || (sfm_kinds[t][1] == SFMK_S
+			&& !sfm_chk_s(m, SFM_V(m, size_t, i)))) {
+			sfm_free(&m);
+			return NULL;
+		}
+	}
+	if (pc && !sfm_chk_pc(m))
+		sfm_free(&m);
+	return m;
+}
@@ -0,0 +1,232 @@
+#ifndef SFMAP_H
+#define SFMAP_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * sfmap.h
+ *
+ * #SHORTDOC frozen map handling (read-only key-value storage)
+ *
+ * #DOC Frozen map functions handle read-only key-value storage, built from
+ * #DOC a map (srt_map) once it has been populated. Keys are stored in
+ * #DOC Eytzinger (breadth-first) order, with the values in a parallel array,
+ * #DOC so the search is branchless and prefetch-friendly (O(log n) time
+ * #DOC complexity, with much better cache usage than the Red-Black tree).
+ * #DOC String keys and values are packed into a single buffer, so the whole
+ * #DOC frozen map uses just one heap allocation, and it can be saved to and
+ * #DOC loaded from a file as is.
+ * #DOC
+ * #DOC For string keys (SM_SI, SM_SS, SM_SP, SM_SD) sm_freeze_pc() builds a
+ * #DOC prefix-compressed frozen map instead: keys are kept in sorted order,
+ * #DOC in blocks of 16, each block having the first key stored as is and the
+ * #DOC rest front-coded (length of the prefix shared with the previous key,
+ * #DOC plus the remaining suffix). Blocks are located with a binary search
+ * #DOC over their first key, and the block scan resumes every comparison
+ * #DOC from the already known common prefix, so keys sharing long prefixes
+ * #DOC (e.g. paths or URLs) take several times less memory and are not
+ * #DOC compared again and again from the start.
+ * #DOC
+ * #DOC
+ * #DOC Supported key/value modes: same as srt_map (see enum eSM_Type)
+ * #DOC
+ * #DOC
+ * #DOC Callback types for the sfm_itr_*() functions: same as the ones used
+ * #DOC by the sm_itr_*() functions (srt_map_it_*)
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "smap.h"
+
+/*
+ * Structures
+ */
+
+struct SFMap {
+	uint8_t type;	 /* enum eSM_Type0 */
+	uint8_t ksize;	 /* key element size */
+	uint8_t vsize;	 /* value element size */
+	uint8_t pc;	 /* prefix-compressed string keys (sm_freeze_pc) */
+	size_t size;	 /* number of elements */
+	size_t raw_size; /* keys + values + string buffer, in bytes */
+	size_t str_off;	 /* string buffer offset */
+	uint8_t *k;	 /* keys (Eytzinger order, 1-based) */
+	uint8_t *v;	 /* values (parallel to the keys) */
+};
+
+typedef struct SFMap srt_fmap; /* Opaque structure (accessors are provided) */
+
+/*
+ * Allocation
+ */
+
+/* #API: |Build a frozen map from a map|input map|frozen map (NULL if not enough memory)|O(n)|1;2| */
+srt_fmap *sm_freeze(const srt_map *m);
+
+/* #API: |Build a frozen map with prefix-compressed keys from a map with string keys (SM_SI, SM_SS, SM_SP, SM_SD)|input map|frozen map (NULL if not a string-key map or not enough memory)|O(n)|1;2| */
+srt_fmap *sm_freeze_pc(const srt_map *m);
+
+/* #API: |Duplicate frozen map|input frozen map|output frozen map|O(n)|1;2| */
+srt_fmap *sfm_dup(const srt_fmap *src);
+
+/*
+#API: |Free one or more frozen maps|frozen map; more frozen maps (optional)|-|O(1)|1;2|
+void sfm_free(srt_fmap **m, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define sfm_free(...) sfm_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define sfm_free(m) sfm_free_aux(m, S_INVALID_PTR_VARG_TAIL)
+#endif
+void sfm_free_aux(srt_fmap **m, ...);
+
+/* #API: |Get frozen map size|frozen map|Number of elements|O(1)|1;2| */
+S_INLINE size_t sfm_size(const srt_fmap *m)
+{
+	return m ? m->size : 0;
+}
+
+/* #API: |Get frozen map type|frozen map|map type (enum eSM_Type)|O(1)|1;2| */
+S_INLINE enum eSM_Type sfm_type(const srt_fmap *m)
+{
+	return m ? (enum eSM_Type)m->type : SM_II32;
+}
+
+/* #API: |Check if the frozen map keys are prefix-compressed|frozen map|S_TRUE: built with sm_freeze_pc(); S_FALSE: otherwise|O(1)|1;2| */
+S_INLINE srt_bool sfm_is_pc(const srt_fmap *m)
+{
+	return m && m->pc ? S_TRUE : S_FALSE;
+}
+
+/* #API: |Get frozen map memory usage|frozen map|bytes allocated (including string data)|O(1)|1;2| */
+S_INLINE size_t sfm_alloc_size(const srt_fmap *m)
+{
+	return m ? sizeof(srt_fmap) + m->raw_size : 0;
+}
+
+/*
+ * Random access
+ */
+
+/* #API: |Access to frozen map element (SM_II32)|frozen map; key|value|O(log n)|1;2| */
+int32_t sfm_at_ii32(const srt_fmap *m, int32_t k);
+
+/* #API: |Access to frozen map element (SM_UU32)|frozen map; key|value|O(log n)|1;2| */
+uint32_t sfm_at_uu32(const srt_fmap *m, uint32_t k);
+
+/* #API: |Access to frozen map element (SM_II)|frozen map; key|value|O(log n)|1;2| */
+int64_t sfm_at_ii(const srt_fmap *m, int64_t k);
+
+/* #API: |Access to frozen map element (SM_FF)|frozen map; key|value|O(log n)|1;2| */
+float sfm_at_ff(const srt_fmap *m, float k);
+
+/* #API: |Access to frozen map element (SM_DD)|frozen map; key|value|O(log n)|1;2| */
+double sfm_at_dd(const srt_fmap *m, double k);
+
+/* #API: |Access to frozen map element (SM_IS)|frozen map; key|value|O(log n)|1;2| */
+const srt_string *sfm_at_is(const srt_fmap *m, int64_t k);
+
+/* #API: |Access to frozen map element (SM_IP)|frozen map; key|value|O(log n)|1;2| */
+const void *sfm_at_ip(const srt_fmap *m, int64_t k);
+
+/* #API: |Access to frozen map element (SM_SI)|frozen map; key|value|O(log n)|1;2| */
+int64_t sfm_at_si(const srt_fmap *m, const srt_string *k);
+
+/* #API: |Access to frozen map element (SM_SS)|frozen map; key|value|O(log n)|1;2| */
+const srt_string *sfm_at_ss(const srt_fmap *m, const srt_string *k);
+
+/* #API: |Access to frozen map element (SM_SP)|frozen map; key|value|O(log n)|1;2| */
+const void *sfm_at_sp(const srt_fmap *m, const srt_string *k);
+
+/* #API: |Access to frozen map element (SM_DS)|frozen map; key|value|O(log n)|1;2| */
+const srt_string *sfm_at_ds(const srt_fmap *m, double k);
+
+/* #API: |Access to frozen map element (SM_DP)|frozen map; key|value|O(log n)|1;2| */
+const void *sfm_at_dp(const srt_fmap *m, double k);
+
+/* #API: |Access to frozen map element (SM_SD)|frozen map; key|value|O(log n)|1;2| */
+double sfm_at_sd(const srt_fmap *m, const srt_string *k);
+
+/*
+ * Existence check
+ */
+
+/* #API: |Frozen map element count/check (SM_II32)|frozen map; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t sfm_count_i32(const srt_fmap *m, int32_t k);
+
+/* #API: |Frozen map element count/check (SM_UU32)|frozen map; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t sfm_count_u32(const srt_fmap *m, uint32_t k);
+
+/* #API: |Frozen map element count/check (SM_I*)|frozen map; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t sfm_count_i(const srt_fmap *m, int64_t k);
+
+/* #API: |Frozen map element count/check (SM_FF)|frozen map; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t sfm_count_f(const srt_fmap *m, float k);
+
+/* #API: |Frozen map element count/check (SM_D*)|frozen map; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t sfm_count_d(const srt_fmap *m, double k);
+
+/* #API: |Frozen map element count/check (SM_S*)|frozen map; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t sfm_count_s(const srt_fmap *m, const srt_string *k);
+
+/*
+ * Enumeration
+ */
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_II32)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_ii32(const srt_fmap *m, int32_t key_min, int32_t key_max, srt_map_it_ii32 f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_UU32)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_uu32(const srt_fmap *m, uint32_t key_min, uint32_t key_max, srt_map_it_uu32 f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_II)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_ii(const srt_fmap *m, int64_t key_min, int64_t key_max, srt_map_it_ii f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_FF)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_ff(const srt_fmap *m, float key_min, float key_max, srt_map_it_ff f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_DD)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_dd(const srt_fmap *m, double key_min, double key_max, srt_map_it_dd f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_IS)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_is(const srt_fmap *m, int64_t key_min, int64_t key_max, srt_map_it_is f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_IP)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_ip(const srt_fmap *m, int64_t key_min, int64_t key_max, srt_map_it_ip f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_SI)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_si(const srt_fmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_si f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_DS)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_ds(const srt_fmap *m, double key_min, double key_max, srt_map_it_ds f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_DP)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_dp(const srt_fmap *m, double key_min, double key_max, srt_map_it_dp f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_SD)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_sd(const srt_fmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_sd f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_SS)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_ss(const srt_fmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_ss f, void *context);
+
+/* #API: |Enumerate frozen map elements in a given key range (SM_SP)|frozen map; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t sfm_itr_sp(const srt_fmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_sp f, void *context);
+
+/*
+ * I/O
+ */
+
+/* #API: |Write frozen map to file. BEHAVIOR: the format is platform-dependent (endianness and size_t width are checked when reading it back); pointer values (SM_IP, SM_SP, SM_DP) are written as is, so they are only meaningful for the same process|file handle; frozen map|Number of bytes written; < 0: error|O(n)|1;2| */
+ssize_t sfm_write(FILE *handle, const srt_fmap *m);
+
+/* #API: |Read frozen map from file|file handle|frozen map (NULL if not valid or not enough memory)|O(n)|1;2| */
+srt_fmap *sfm_read(FILE *handle);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+
+#endif /* #ifndef SFMAP_H */
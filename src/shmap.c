@@ -69,129 +69,155 @@ static srt_bool eq_sso1(const void *key, const void *node)
 	return sso1_eq((const srt_string *)key, (const srt_stringo1 *)node);
 }
 
-static void shmcb_set_ii32(void *loc, const void *key, const void *value)
+static void shmcb_set_ii32(void *loc, const void *key, const void *value,
+			   struct SSHeap *sh)
 {
 	struct SHMapii *e = (struct SHMapii *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
-static void shmcb_set_uu32(void *loc, const void *key, const void *value)
+static void shmcb_set_uu32(void *loc, const void *key, const void *value,
+			   struct SSHeap *sh)
 {
 	struct SHMapuu *e = (struct SHMapuu *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
-static void shmcb_set_ii64(void *loc, const void *key, const void *value)
+static void shmcb_set_ii64(void *loc, const void *key, const void *value,
+			   struct SSHeap *sh)
 {
 	struct SHMapII *e = (struct SHMapII *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
-static void shmcb_set_is(void *loc, const void *key, const void *value)
+static void shmcb_set_is(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapIS *e = (struct SHMapIS *)loc;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
-	sso1_set(&e->v, (const srt_string *)value);
+	sso1_set_h(&e->v, (const srt_string *)value, sh);
 }
 
-static void shmcb_set_ip(void *loc, const void *key, const void *value)
+static void shmcb_set_ip(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapIP *e = (struct SHMapIP *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	e->v = value;
 }
 
-static void shmcb_set_si(void *loc, const void *key, const void *value)
+static void shmcb_set_si(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapSI *e = (struct SHMapSI *)loc;
-	sso1_set(&e->x.k, (const srt_string *)key);
+	sso1_set_h(&e->x.k, (const srt_string *)key, sh);
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
-static void shmcb_set_ss(void *loc, const void *key, const void *value)
+static void shmcb_set_ss(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapSS *e = (struct SHMapSS *)loc;
-	sso_set(&e->kv, (const srt_string *)key, (const srt_string *)value);
+	sso_set_h(&e->kv, (const srt_string *)key, (const srt_string *)value,
+		  sh);
 }
 
-static void shmcb_set_sp(void *loc, const void *key, const void *value)
+static void shmcb_set_sp(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapSP *e = (struct SHMapSP *)loc;
-	sso1_set(&e->x.k, (const srt_string *)key);
+	sso1_set_h(&e->x.k, (const srt_string *)key, sh);
 	e->v = value;
 }
 
-static void shmcb_set_i32(void *loc, const void *key)
+static void shmcb_set_i32(void *loc, const void *key, struct SSHeap *sh)
 {
 	struct SHMapi *e = (struct SHMapi *)loc;
+	(void)sh;
 	memcpy(&e->k, key, sizeof(e->k));
 }
 
-static void shmcb_set_u32(void *loc, const void *key)
+static void shmcb_set_u32(void *loc, const void *key, struct SSHeap *sh)
 {
 	struct SHMapu *e = (struct SHMapu *)loc;
+	(void)sh;
 	memcpy(&e->k, key, sizeof(e->k));
 }
 
-static void shmcb_set_i64(void *loc, const void *key)
+static void shmcb_set_i64(void *loc, const void *key, struct SSHeap *sh)
 {
 	struct SHMapI *e = (struct SHMapI *)loc;
+	(void)sh;
 	memcpy(&e->k, key, sizeof(e->k));
 }
 
-static void shmcb_set_s(void *loc, const void *key)
+static void shmcb_set_s(void *loc, const void *key, struct SSHeap *sh)
 {
 	struct SHMapS *e = (struct SHMapS *)loc;
-	sso1_set(&e->k, (const srt_string *)key);
+	sso1_set_h(&e->k, (const srt_string *)key, sh);
 }
 
-static void shmcb_set_f(void *loc, const void *key)
+static void shmcb_set_f(void *loc, const void *key, struct SSHeap *sh)
 {
 	struct SHMapF *e = (struct SHMapF *)loc;
+	(void)sh;
 	memcpy(&e->k, key, sizeof(e->k));
 }
 
-static void shmcb_set_d(void *loc, const void *key)
+static void shmcb_set_d(void *loc, const void *key, struct SSHeap *sh)
 {
 	struct SHMapD *e = (struct SHMapD *)loc;
+	(void)sh;
 	memcpy(&e->k, key, sizeof(e->k));
 }
 
-static void shmcb_set_ff(void *loc, const void *key, const void *value)
+static void shmcb_set_ff(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapFF *e = (struct SHMapFF *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
-static void shmcb_set_dd(void *loc, const void *key, const void *value)
+static void shmcb_set_dd(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapDD *e = (struct SHMapDD *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
-static void shmcb_set_ds(void *loc, const void *key, const void *value)
+static void shmcb_set_ds(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapDS *e = (struct SHMapDS *)loc;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
-	sso1_set(&e->v, (const srt_string *)value);
+	sso1_set_h(&e->v, (const srt_string *)value, sh);
 }
 
-static void shmcb_set_dp(void *loc, const void *key, const void *value)
+static void shmcb_set_dp(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapDP *e = (struct SHMapDP *)loc;
+	(void)sh;
 	memcpy(&e->x.k, key, sizeof(e->x.k));
 	e->v = value;
 }
 
-static void shmcb_set_sd(void *loc, const void *key, const void *value)
+static void shmcb_set_sd(void *loc, const void *key, const void *value,
+			 struct SSHeap *sh)
 {
 	struct SHMapSD *e = (struct SHMapSD *)loc;
-	sso1_set(&e->x.k, (const srt_string *)key);
+	sso1_set_h(&e->x.k, (const srt_string *)key, sh);
 	memcpy(&e->v, value, sizeof(e->v));
 }
 
@@ -520,7 +546,8 @@ static srt_bool del(srt_hmap *hm, uint32_t h, const void *key)
 				l0 = b[l].loc;
 				b[bid].cnt--;
 				b[l].loc = 0;
-				delf(dloc);
+				if (!hm->sh) /* heap: reclaimed on shrink */
+					delf(dloc);
 				/* Fill the hole with the latest elem */
 				ss = shm_size(hm);
 				if (ss > 1 && ss != l0) {
@@ -564,6 +591,7 @@ srt_hmap *shm_alloc_raw(int t, srt_bool ext_buf, void *buffer, size_t hdr_size,
 	h->d.sub_type = (uint8_t)t;
 	h->rh_threshold_pct = SHM_REHASH_DEFAULT_THRESHOLD_PCT;
 	h->hbits = (uint32_t)hbits;
+	h->sh = NULL;
 	aux_rehash(h);
 	return h;
 }
@@ -581,6 +609,18 @@ srt_hmap *shm_alloc_aux(int t, size_t init_size)
 	return h;
 }
 
+srt_hmap *shm_alloc_sheap_aux(int t, size_t init_size)
+{
+	srt_hmap *h = shm_alloc_aux(t, init_size);
+	if (h && h != shm_void && t < SHM0_NumTypes
+	    && shm_ctx[t].delf != del_nop) {
+		h->sh = sso_heap_alloc();
+		if (!h->sh) /* BEHAVIOR: allocation error */
+			shm_free(&h);
+	}
+	return h;
+}
+
 void shm_clear(srt_hmap *hm)
 {
 	size_t es;
@@ -592,11 +632,14 @@ void shm_clear(srt_hmap *hm)
 	es = hm->d.elem_size;
 	pt = p + shm_size(hm) * es;
 	t = hm->d.sub_type;
-	delf = t < SHM0_NumTypes ? shm_ctx[t].delf : NULL;
+	if (hm->sh) /* string heap: bulk release */
+		sso_heap_reset(hm->sh);
+	delf = t < SHM0_NumTypes && !hm->sh ? shm_ctx[t].delf : NULL;
 	if (delf && delf != del_nop)
 		for (; p < pt; p += es)
 			delf(p);
 	shm_set_size(hm, 0);
+	aux_rehash(hm); /* empty buckets */
 }
 
 void shm_free_aux(srt_hmap **hm, ...)
@@ -605,7 +648,10 @@ void shm_free_aux(srt_hmap **hm, ...)
 	srt_hmap **next = hm;
 	va_start(ap, hm);
 	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
-		shm_clear(*next); /* release associated dyn. memory */
+		if (*next && (*next)->sh) /* no per-element release */
+			sso_heap_free(&(*next)->sh);
+		else
+			shm_clear(*next); /* release associated dyn. memory */
 		sd_free((srt_data **)next);
 		next = (srt_hmap **)va_arg(ap, srt_hmap **);
 	}
@@ -667,12 +713,14 @@ static srt_bool shm_cpy_reconfig(srt_hmap **hm, const srt_hmap *src)
 	return S_TRUE;
 }
 
-srt_hmap *shm_cpy(srt_hmap **hm, const srt_hmap *src)
+/*
+ * Duplicate the strings of bulk-copied elements (into the string heap, if
+ * any)
+ */
+static void shm_dupa(srt_hmap *hm, struct SSHeap *h)
 {
-	uint8_t t;
-	uint8_t *data_tgt;
-	const uint8_t *data_src;
-	size_t i, hs, hdr0_size, es, ss;
+	size_t i, ss = shm_size(hm);
+	uint8_t *data = shm_get_buffer(hm);
 	struct SHMapS *h_s;
 	struct SHMapIS *h_is;
 	struct SHMapSI *h_si;
@@ -680,67 +728,92 @@ srt_hmap *shm_cpy(srt_hmap **hm, const srt_hmap *src)
 	struct SHMapSS *h_ss;
 	struct SHMapDS *h_ds;
 	struct SHMapSD *h_sd;
-	RETURN_IF(!hm || !src, NULL); /* BEHAVIOR */
-	RETURN_IF(*hm == src, *hm);
-	t = src->d.sub_type;
-	hs = shm_size(src);
-	es = src->d.elem_size;
-	ss = shm_size(src);
-	RETURN_IF(hs > SHM_MAX_ELEMS, NULL); /* BEHAVIOR */
-	if (*hm) {
-		/* De-allocate target nodes, if necessary */
-		RETURN_IF(!shm_cpy_reconfig(hm, src), NULL);
-	} else {
-		*hm = shm_alloc_aux(t, ss);
-		RETURN_IF(!*hm, NULL); /* BEHAVIOR: allocation error */
-	}
-	RETURN_IF(shm_max_size(*hm) < ss, *hm); /* BEHAVIOR: not enough space */
-	/* Copy data */
-	data_tgt = shm_get_buffer(*hm);
-	data_src = shm_get_buffer_r(src);
-	/* bulk copy */
-	memcpy(data_tgt, data_src, es * ss);
-	shm_set_size(*hm, ss);
-	/* cases potentially requiring adaptation */
-	switch (t) {
+	switch (hm->d.sub_type) {
 	case SHM0_S:
-		h_s = (struct SHMapS *)data_tgt;
+		h_s = (struct SHMapS *)data;
 		for (i = 0; i < ss; i++)
-			sso_dupa1(&h_s[i].k);
+			sso_dupa1_h(&h_s[i].k, h);
 		break;
 	case SHM0_IS:
-		h_is = (struct SHMapIS *)data_tgt;
-		for (i = 0; i < ss; sso_dupa1(&h_is[i++].v))
+		h_is = (struct SHMapIS *)data;
+		for (i = 0; i < ss; sso_dupa1_h(&h_is[i++].v, h))
 			;
 		break;
 	case SHM0_SP:
-		h_sp = (struct SHMapSP *)data_tgt;
-		for (i = 0; i < ss; sso_dupa1(&h_sp[i++].x.k))
+		h_sp = (struct SHMapSP *)data;
+		for (i = 0; i < ss; sso_dupa1_h(&h_sp[i++].x.k, h))
 			;
 		break;
 	case SHM0_SI:
-		h_si = (struct SHMapSI *)data_tgt;
-		for (i = 0; i < ss; sso_dupa1(&h_si[i++].x.k))
+		h_si = (struct SHMapSI *)data;
+		for (i = 0; i < ss; sso_dupa1_h(&h_si[i++].x.k, h))
 			;
 		break;
 	case SHM0_SS:
-		h_ss = (struct SHMapSS *)data_tgt;
-		for (i = 0; i < ss; sso_dupa(&h_ss[i++].kv))
+		h_ss = (struct SHMapSS *)data;
+		for (i = 0; i < ss; sso_dupa_h(&h_ss[i++].kv, h))
 			;
 		break;
 	case SHM0_DS:
-		h_ds = (struct SHMapDS *)data_tgt;
-		for (i = 0; i < ss; sso_dupa1(&h_ds[i++].v))
+		h_ds = (struct SHMapDS *)data;
+		for (i = 0; i < ss; sso_dupa1_h(&h_ds[i++].v, h))
 			;
 		break;
 	case SHM0_SD:
-		h_sd = (struct SHMapSD *)data_tgt;
-		for (i = 0; i < ss; sso_dupa1(&h_sd[i++].x.k))
+		h_sd = (struct SHMapSD *)data;
+		for (i = 0; i < ss; sso_dupa1_h(&h_sd[i++].x.k, h))
 			;
 		break;
 	default:
 		break;
 	}
+}
+
+srt_hmap *shm_shrink(srt_hmap **hm)
+{
+	struct SSHeap *h;
+	if (hm && *hm && (*hm)->sh) {
+		/* String heap compaction: copy the live strings only */
+		h = sso_heap_alloc();
+		if (h) {
+			shm_dupa(*hm, h);
+			sso_heap_free(&(*hm)->sh);
+			(*hm)->sh = h;
+		}
+	}
+	return (srt_hmap *)sd_shrink((srt_data **)hm, 0);
+}
+
+srt_hmap *shm_cpy(srt_hmap **hm, const srt_hmap *src)
+{
+	uint8_t t;
+	uint8_t *data_tgt;
+	const uint8_t *data_src;
+	size_t hs, hdr0_size, es, ss;
+	RETURN_IF(!hm || !src, NULL); /* BEHAVIOR */
+	RETURN_IF(*hm == src, *hm);
+	t = src->d.sub_type;
+	hs = shm_size(src);
+	es = src->d.elem_size;
+	ss = shm_size(src);
+	RETURN_IF(hs > SHM_MAX_ELEMS, NULL); /* BEHAVIOR */
+	if (*hm) {
+		/* De-allocate target nodes, if necessary */
+		RETURN_IF(!shm_cpy_reconfig(hm, src), NULL);
+	} else {
+		*hm = src->sh ? shm_alloc_sheap_aux(t, ss)
+			      : shm_alloc_aux(t, ss);
+		RETURN_IF(!*hm, NULL); /* BEHAVIOR: allocation error */
+	}
+	RETURN_IF(shm_max_size(*hm) < ss, *hm); /* BEHAVIOR: not enough space */
+	/* Copy data */
+	data_tgt = shm_get_buffer(*hm);
+	data_src = shm_get_buffer_r(src);
+	/* bulk copy */
+	memcpy(data_tgt, data_src, es * ss);
+	shm_set_size(*hm, ss);
+	/* cases potentially requiring adaptation */
+	shm_dupa(*hm, (*hm)->sh);
 	/* rehash */
 	if ((*hm)->d.header_size == src->d.header_size) {
 		/* Same header size: hash table buckets bulk copy */
@@ -759,13 +832,37 @@ srt_hmap *shm_cpy(srt_hmap **hm, const srt_hmap *src)
  * Insert
  */
 
-typedef void (*shm_set1_f)(void *loc, const void *key);
+typedef void (*shm_set1_f)(void *loc, const void *key, struct SSHeap *sh);
+
+/*
+ * Overwriting an element having strings: the previous ones are released
+ * after the update, as the new data could reference them
+ */
+union SHMapStrElem {
+	struct SHMapS s;
+	struct SHMapIS is;
+	struct SHMapSI si;
+	struct SHMapSS ss;
+	struct SHMapSP sp;
+	struct SHMapDS ds;
+	struct SHMapSD sd;
+};
+
+S_INLINE shm_del_f shm_save_old(const srt_hmap *hm, int t, const void *l,
+				union SHMapStrElem *old)
+{
+	RETURN_IF(hm->sh || shm_ctx[t].delf == del_nop, NULL);
+	memcpy(old, l, hm->d.elem_size);
+	return shm_ctx[t].delf;
+}
 
 static srt_bool shm_insert1(srt_hmap **hm, int t, const void *k, uint32_t h32,
 			    shm_set1_f setf)
 {
 	void *l;
 	size_t i;
+	shm_del_f delf = NULL;
+	union SHMapStrElem old;
 	RETURN_IF(!hm || !*hm || !shm_chk_t(*hm, t), S_FALSE);
 	RETURN_IF(!aux_insert_check(hm), S_FALSE);
 	l = (void *)shm_at(*hm, h32, k, NULL);
@@ -774,18 +871,24 @@ static srt_bool shm_insert1(srt_hmap **hm, int t, const void *k, uint32_t h32,
 		aux_reg_hash(*hm, k, h32, (shm_eloc_t_)i);
 		shm_set_size(*hm, i + 1);
 		l = shm_get_buffer(*hm) + i * (*hm)->d.elem_size;
-	}
-	setf(l, k);
+	} else
+		delf = shm_save_old(*hm, t, l, &old);
+	setf(l, k, (*hm)->sh);
+	if (delf)
+		delf(&old);
 	return S_TRUE;
 }
 
-typedef void (*shm_set_f)(void *loc, const void *key, const void *value);
+typedef void (*shm_set_f)(void *loc, const void *key, const void *value,
+			  struct SSHeap *sh);
 
 static srt_bool shm_insert(srt_hmap **hm, int t, const void *k, uint32_t h32,
 			   const void *v, shm_set_f setf)
 {
 	void *l;
 	size_t i;
+	shm_del_f delf = NULL;
+	union SHMapStrElem old;
 	RETURN_IF(!hm || !*hm || !shm_chk_t(*hm, t), S_FALSE);
 	RETURN_IF(!aux_insert_check(hm), S_FALSE);
 	l = (void *)shm_at(*hm, h32, k, NULL);
@@ -794,8 +897,11 @@ static srt_bool shm_insert(srt_hmap **hm, int t, const void *k, uint32_t h32,
 		aux_reg_hash(*hm, k, h32, (shm_eloc_t_)i);
 		shm_set_size(*hm, i + 1);
 		l = shm_get_buffer(*hm) + i * (*hm)->d.elem_size;
-	}
-	setf(l, k, v);
+	} else
+		delf = shm_save_old(*hm, t, l, &old);
+	setf(l, k, v, (*hm)->sh);
+	if (delf)
+		delf(&old);
 	return S_TRUE;
 }
 
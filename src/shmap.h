@@ -232,6 +232,7 @@ struct S_HMap {
 	uint32_t hmask; /* hash table bitmask */
 	size_t rh_threshold; /* (1 << hbits) * rh_threshold_pct) / 100 */
 	size_t rh_threshold_pct;
+	struct SSHeap *sh; /* string heap (optional, see shm_alloc_sheap()) */
 };
 
 /*
@@ -347,6 +348,7 @@ srt_hmap *shm_alloc_raw(int t, srt_bool ext_buf, void *buffer, size_t hdr_size,
 			size_t elem_size, size_t max_size, size_t np2_size);
 
 srt_hmap *shm_alloc_aux(int t, size_t init_size);
+srt_hmap *shm_alloc_sheap_aux(int t, size_t init_size);
 
 /* #api: |allocate hash map (heap)|hash map type; initial reserve|hmap|O(n)|1;2| */
 S_INLINE srt_hmap *shm_alloc(enum eSHM_Type t, size_t init_size)
@@ -354,7 +356,16 @@ S_INLINE srt_hmap *shm_alloc(enum eSHM_Type t, size_t init_size)
 	return shm_alloc_aux((int)t, init_size);
 }
 
-SD_BUILDFUNCS_FULL_ST(shm, srt_hmap, 0)
+/* #API: |Allocate hash map (heap) with embedded string heap: strings not fitting in the element are appended to a per-map arena instead of being allocated one by one, so inserts avoid malloc and shm_clear()/shm_free() release all of them at once; deleted or overwritten strings are reclaimed by shm_shrink() and shm_dup()/shm_cpy() (compaction). For map types without strings it is the same as shm_alloc()|hash map type; initial reserve|hmap|O(n)|1;2| */
+S_INLINE srt_hmap *shm_alloc_sheap(enum eSHM_Type t, size_t init_size)
+{
+	return shm_alloc_sheap_aux((int)t, init_size);
+}
+
+SD_BUILDFUNCS_FULL_ST0(shm, srt_hmap, 0)
+
+/* #API: |Make the hmap use the minimum possible memory (hmaps with string heap are compacted, too)|hmap|hmap reference (optional usage)|O(1) for allocators using memory remap; O(n) for naive allocators and hmaps with string heap|1;2| */
+srt_hmap *shm_shrink(srt_hmap **hm);
 
 /*
 #API: |Ensure space for extra elements|hash map;number of extra elements|extra size allocated|O(1)|1;2|
@@ -363,9 +374,6 @@ size_t shm_grow(srt_hmap **hm, size_t extra_elems)
 #API: |Ensure space for elements|hash map;absolute element reserve|reserved elements|O(1)|1;2|
 size_t shm_reserve(srt_hmap **hm, size_t max_elems)
 
-#API: |Make the hmap use the minimum possible memory|hmap|hmap reference (optional usage)|O(1) for allocators using memory remap; O(n) for naive allocators|1;2|
-srt_hmap *shm_shrink(srt_hmap **hm);
-
 #API: |Get hmap size|hmap|Hash map number of elements|O(1)|1;2|
 size_t shm_size(const srt_hmap *hm);
 
@@ -385,11 +393,11 @@ srt_bool shm_empty(const srt_hmap *hm)
 /* #API: |Duplicate hash map|input map|output map|O(n)|1;2| */
 srt_hmap *shm_dup(const srt_hmap *src);
 
-/* #API: |Clear/reset map (keeping map type)|hmap||O(1) for simple maps, O(n) for maps having nodes with strings|0;1| */
+/* #API: |Clear/reset map (keeping map type)|hmap||O(1) for simple maps and maps with string heap, O(n) for maps having nodes with strings|0;1| */
 void shm_clear(srt_hmap *hm);
 
 /*
-#API: |Free one or more hash maps|hash map; more hash maps (optional)|-|O(1) for simple dmaps, O(n) for dmaps having nodes with strings|1;2|
+#API: |Free one or more hash maps|hash map; more hash maps (optional)|-|O(1) for simple dmaps and dmaps with string heap, O(n) for dmaps having nodes with strings|1;2|
 void shm_free(srt_hmap **hm, ...)
 */
 #ifdef S_USE_VA_ARGS
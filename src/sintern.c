@@ -0,0 +1,298 @@
+/*
+ * sintern.c
+ *
+ * String interning (string to dense integer ID, and back).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sintern.h"
+#include "saux/scommon.h"
+#include "saux/shash.h"
+
+#define SIN_MIN_RESERVE 16
+#define SIN_MAX_N ((size_t)SIN_NONE - 1)
+#define SIN_FILE_MAGIC "SIN1"
+#define SIN_FILE_HDR_SIZE 8
+#define SIN_READ_CHUNK 65536
+
+/*
+ * Internal functions
+ */
+
+S_INLINE uint32_t sin_hash(const char *s, size_t s_size)
+{
+	return sh_fnv1a(S_FNV1_INIT, s, s_size);
+}
+
+/* Hash index slot for the string: either its slot, or an empty one */
+static size_t sin_slot(const srt_intern *in, const char *s, size_t s_size,
+		       uint32_t h)
+{
+	uint32_t id;
+	size_t i = h & in->hmask;
+	for (; in->ht[i]; i = (i + 1) & in->hmask) {
+		id = in->ht[i] - 1;
+		if (in->hash[id] == h && in->off[id + 1] - in->off[id] == s_size
+		    && !memcmp(ss_get_buffer_r(in->a) + in->off[id], s, s_size))
+			break;
+	}
+	return i;
+}
+
+static srt_bool sin_ht_alloc(srt_intern *in, size_t n)
+{
+	uint32_t *ht;
+	size_t i, j, hs = 1;
+	while (hs < 2 * n)
+		hs <<= 1;
+	ht = (uint32_t *)s_calloc(hs, sizeof(uint32_t));
+	RETURN_IF(!ht, S_FALSE);
+	if (in->ht)
+		s_free(in->ht);
+	in->ht = ht;
+	in->hmask = hs - 1;
+	for (i = 0; i < in->n; i++) { /* distinct strings: no comparisons */
+		for (j = in->hash[i] & in->hmask; ht[j]; j = (j + 1) & in->hmask)
+			;
+		ht[j] = (uint32_t)(i + 1);
+	}
+	return S_TRUE;
+}
+
+static srt_bool sin_reserve(srt_intern *in, size_t n)
+{
+	size_t *off;
+	uint32_t *hash;
+	RETURN_IF(n <= in->max_n, S_TRUE);
+	RETURN_IF(n > SIN_MAX_N, S_FALSE);
+	off = (size_t *)s_realloc(in->off, (n + 1) * sizeof(size_t));
+	RETURN_IF(!off, S_FALSE);
+	in->off = off;
+	hash = (uint32_t *)s_realloc(in->hash, n * sizeof(uint32_t));
+	RETURN_IF(!hash, S_FALSE);
+	in->hash = hash;
+	RETURN_IF(!sin_ht_alloc(in, n), S_FALSE);
+	in->max_n = n;
+	return S_TRUE;
+}
+
+/* Append string to the arena and the hash index ('slot' from sin_slot()) */
+static uint32_t sin_add(srt_intern *in, const char *s, size_t s_size,
+			uint32_t h, size_t slot)
+{
+	size_t as;
+	if (in->n == in->max_n) {
+		RETURN_IF(in->n >= SIN_MAX_N
+				  || !sin_reserve(in, S_MIN(in->n * 2, SIN_MAX_N)),
+			  SIN_NONE);
+		slot = sin_slot(in, s, s_size, h);
+	}
+	as = ss_size(in->a);
+	ss_cat_cn(&in->a, s, s_size);
+	RETURN_IF(ss_size(in->a) != as + s_size, SIN_NONE);
+	in->hash[in->n] = h;
+	in->off[in->n + 1] = as + s_size;
+	in->ht[slot] = (uint32_t)(++in->n);
+	return (uint32_t)(in->n - 1);
+}
+
+static srt_intern *sin_read_aux(srt_intern *in, FILE *handle, size_t n)
+{
+	uint8_t b[8];
+	char *p;
+	size_t i, slot, done, c;
+	uint64_t o;
+	for (i = 1; i <= n; i++) {
+		RETURN_IF(fread(b, 1, 8, handle) != 8, NULL);
+		o = S_LD_LE_U64(b);
+		RETURN_IF(o < in->off[i - 1] || o > (uint64_t)SS_RANGE, NULL);
+		RETURN_IF(i > in->max_n && !sin_reserve(in, in->max_n * 2),
+			  NULL);
+		in->off[i] = (size_t)o;
+	}
+	/*
+	 * The arena is read in growing chunks, so a corrupted offset table
+	 * fails on the short read instead of allocating up to SS_RANGE bytes
+	 */
+	for (done = 0; done < in->off[n]; done += c) {
+		c = S_MIN(in->off[n] - done, S_MAX(done, SIN_READ_CHUNK));
+		ss_resize(&in->a, done + c, 0);
+		RETURN_IF(ss_size(in->a) != done + c, NULL);
+		RETURN_IF(fread(ss_get_buffer(in->a) + done, 1, c, handle) != c,
+			  NULL);
+	}
+	p = ss_get_buffer(in->a);
+	for (i = 0; i < n; i++) {
+		in->hash[i] = sin_hash(p + in->off[i], in->off[i + 1] - in->off[i]);
+		slot = sin_slot(in, p + in->off[i], in->off[i + 1] - in->off[i],
+				in->hash[i]);
+		RETURN_IF(in->ht[slot], NULL); /* BEHAVIOR: duplicated string */
+		in->ht[slot] = (uint32_t)(++in->n);
+	}
+	return in;
+}
+
+/*
+ * Allocation
+ */
+
+srt_intern *sin_alloc(size_t initial_reserve)
+{
+	srt_intern *in = (srt_intern *)s_malloc(sizeof(srt_intern));
+	RETURN_IF(!in, NULL);
+	memset(in, 0, sizeof(*in));
+	in->a = ss_alloc(SIN_MIN_RESERVE);
+	if (ss_max_size(in->a) < SIN_MIN_RESERVE) { /* ss_void or sd_void */
+		s_free(in);
+		return NULL;
+	}
+	if (!sin_reserve(in, S_MAX(initial_reserve, SIN_MIN_RESERVE))) {
+		sin_free(&in);
+		return NULL;
+	}
+	in->off[0] = 0;
+	return in;
+}
+
+void sin_free_aux(srt_intern **in, ...)
+{
+	va_list ap;
+	srt_intern **next;
+	va_start(ap, in);
+	next = in;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			ss_free(&(*next)->a);
+			s_free((*next)->off);
+			s_free((*next)->hash);
+			s_free((*next)->ht);
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_intern **)va_arg(ap, srt_intern **);
+	}
+	va_end(ap);
+}
+
+void sin_clear(srt_intern *in)
+{
+	if (in) {
+		ss_clear(in->a);
+		memset(in->ht, 0, (in->hmask + 1) * sizeof(uint32_t));
+		in->n = 0;
+	}
+}
+
+/*
+ * Interning
+ */
+
+uint32_t sin_id_cn(srt_intern *in, const char *s, size_t s_size)
+{
+	uint32_t h;
+	size_t slot;
+	RETURN_IF(!in || (!s && s_size), SIN_NONE);
+	if (!s)
+		s = "";
+	h = sin_hash(s, s_size);
+	slot = sin_slot(in, s, s_size, h);
+	RETURN_IF(in->ht[slot], in->ht[slot] - 1);
+	return sin_add(in, s, s_size, h, slot);
+}
+
+uint32_t sin_id(srt_intern *in, const srt_string *s)
+{
+	return sin_id_cn(in, ss_get_buffer_r(s), ss_size(s));
+}
+
+uint32_t sin_find(const srt_intern *in, const srt_string *s)
+{
+	size_t slot, ss;
+	const char *sb;
+	RETURN_IF(!in, SIN_NONE);
+	sb = ss_get_buffer_r(s);
+	ss = ss_size(s);
+	slot = sin_slot(in, sb, ss, sin_hash(sb, ss));
+	return in->ht[slot] ? in->ht[slot] - 1 : SIN_NONE;
+}
+
+const char *sin_get(const srt_intern *in, uint32_t id, size_t *s_size)
+{
+	RETURN_IF(!in || id >= in->n, NULL);
+	if (s_size)
+		*s_size = in->off[id + 1] - in->off[id];
+	return ss_get_buffer_r(in->a) + in->off[id];
+}
+
+srt_string *sin_cpy(srt_string **s, const srt_intern *in, uint32_t id)
+{
+	size_t ss = 0;
+	const char *p = sin_get(in, id, &ss);
+	return p ? ss_cpy_cn(s, p, ss) : ss_cpy_c(s, "");
+}
+
+uint32_t sin_id_sync(srt_intern *in, const srt_string *s)
+{
+	uint32_t id;
+	RETURN_IF(!in, SIN_NONE);
+	s_spin_lock(&in->lock);
+	id = sin_id(in, s);
+	s_spin_unlock(&in->lock);
+	return id;
+}
+
+srt_string *sin_cpy_sync(srt_string **s, srt_intern *in, uint32_t id)
+{
+	RETURN_IF(!in, sin_cpy(s, in, id));
+	s_spin_lock(&in->lock);
+	sin_cpy(s, in, id);
+	s_spin_unlock(&in->lock);
+	return s ? *s : ss_void;
+}
+
+/*
+ * I/O
+ *
+ * File format (little endian): "SIN1", number of strings (32 bit), end
+ * offset of every string (64 bit), and the string arena.
+ */
+
+ssize_t sin_write(FILE *handle, const srt_intern *in)
+{
+	uint8_t b[SIN_FILE_HDR_SIZE];
+	size_t i;
+	RETURN_IF(!handle || !in, -1);
+	memcpy(b, SIN_FILE_MAGIC, 4);
+	S_ST_LE_U32(b + 4, (uint32_t)in->n);
+	RETURN_IF(fwrite(b, 1, SIN_FILE_HDR_SIZE, handle) != SIN_FILE_HDR_SIZE,
+		  -1);
+	for (i = 1; i <= in->n; i++) {
+		S_ST_LE_U64(b, (uint64_t)in->off[i]);
+		RETURN_IF(fwrite(b, 1, 8, handle) != 8, -1);
+	}
+	RETURN_IF(fwrite(ss_get_buffer_r(in->a), 1, in->off[in->n], handle)
+			  != in->off[in->n],
+		  -1);
+	return (ssize_t)(SIN_FILE_HDR_SIZE + in->n * 8 + in->off[in->n]);
+}
+
+srt_intern *sin_read(FILE *handle)
+{
+	srt_intern *in;
+	uint8_t hdr[SIN_FILE_HDR_SIZE];
+	size_t n;
+	RETURN_IF(!handle, NULL);
+	RETURN_IF(fread(hdr, 1, sizeof(hdr), handle) != sizeof(hdr), NULL);
+	n = S_LD_LE_U32(hdr + 4);
+	RETURN_IF(memcmp(hdr, SIN_FILE_MAGIC, 4) || n > SIN_MAX_N, NULL);
+	/*
+	 * The offset table grows while reading, so a corrupted string count
+	 * can not trigger a huge allocation
+	 */
+	in = sin_alloc(0);
+	if (in && !sin_read_aux(in, handle, n))
+		sin_free(&in);
+	return in;
+}
@@ -0,0 +1,120 @@
+#ifndef SINTERN_H
+#define SINTERN_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * sintern.h
+ *
+ * #SHORTDOC string interning (string to dense integer ID, and back)
+ *
+ * #DOC String interning functions map strings to dense 32-bit IDs (0, 1,
+ * #DOC 2, ..., in insertion order), storing every distinct string just
+ * #DOC once. Both directions are O(1): ID to string is an offset table
+ * #DOC lookup, and string to ID uses a hash index (open addressing, with
+ * #DOC the string hashes kept, so growing the index does not rehash the
+ * #DOC strings). All the strings are packed into a single arena, with no
+ * #DOC per-string allocation.
+ * #DOC
+ * #DOC The typical use is replacing repeated strings (e.g. tag names) with
+ * #DOC their ID in other containers (e.g. srt_hmap SHM_UU32), saving
+ * #DOC memory and turning string comparisons into integer comparisons.
+ * #DOC
+ * #DOC Thread safety: the sin_*_sync() functions can be called from
+ * #DOC different threads (a spin lock protects the container). Mixing them
+ * #DOC with the other functions requires external synchronization.
+ * #DOC
+ * #DOC The interned strings can be saved to a file, and loaded back with
+ * #DOC the same IDs (sin_write(), sin_read()).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sstring.h"
+
+/*
+ * Structures
+ */
+
+#define SIN_NONE ((uint32_t)-1) /* not found or not enough memory */
+
+struct SIntern {
+	srt_string *a;	    /* string arena */
+	size_t *off;	    /* string offsets (n + 1 entries) */
+	uint32_t *hash;	    /* string hashes */
+	uint32_t *ht;	    /* hash index: string ID + 1 (0: empty) */
+	size_t n, max_n;    /* number of strings, offset/hash reserve */
+	size_t hmask;	    /* hash index size - 1 (power of two) */
+	volatile long lock; /* sin_*_sync() */
+};
+
+typedef struct SIntern srt_intern; /* Opaque structure */
+
+/*
+ * Allocation
+ */
+
+/* #API: |Allocate string interning container|initial reserve (number of strings)|container (NULL if not enough memory)|O(n)|1;2| */
+srt_intern *sin_alloc(size_t initial_reserve);
+
+/*
+#API: |Free one or more string interning containers|container; more containers (optional)|-|O(1)|1;2|
+void sin_free(srt_intern **in, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define sin_free(...) sin_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define sin_free(in) sin_free_aux(in, S_INVALID_PTR_VARG_TAIL)
+#endif
+void sin_free_aux(srt_intern **in, ...);
+
+/* #API: |Number of interned strings|container|number of strings (valid IDs: 0 to size - 1)|O(1)|1;2| */
+S_INLINE size_t sin_size(const srt_intern *in)
+{
+	return in ? in->n : 0;
+}
+
+/* #API: |Remove all interned strings (IDs are reused from 0)|container|-|O(n)|1;2| */
+void sin_clear(srt_intern *in);
+
+/*
+ * Interning
+ */
+
+/* #API: |Get string ID, inserting the string if not interned yet|container; string|string ID (SIN_NONE: not enough memory)|O(m), m = string size|1;2| */
+uint32_t sin_id(srt_intern *in, const srt_string *s);
+
+/* #API: |Get string ID, inserting the string if not interned yet (raw buffer)|container; buffer; buffer size|string ID (SIN_NONE: not enough memory)|O(m), m = string size|1;2| */
+uint32_t sin_id_cn(srt_intern *in, const char *s, size_t s_size);
+
+/* #API: |Get string ID, with no insertion|container; string|string ID (SIN_NONE: not found)|O(m), m = string size|1;2| */
+uint32_t sin_find(const srt_intern *in, const srt_string *s);
+
+/* #API: |Get interned string (zero-copy: valid until the next insertion)|container; string ID; output string size (optional)|string buffer (NULL: invalid ID)|O(1)|1;2| */
+const char *sin_get(const srt_intern *in, uint32_t id, size_t *s_size);
+
+/* #API: |Overwrite string with the interned string|output string; container; string ID|output string (empty for invalid IDs)|O(m), m = string size|1;2| */
+srt_string *sin_cpy(srt_string **s, const srt_intern *in, uint32_t id);
+
+/* #API: |Get string ID, inserting the string if not interned yet (thread-safe)|container; string|string ID (SIN_NONE: not enough memory)|O(m), m = string size|1;2| */
+uint32_t sin_id_sync(srt_intern *in, const srt_string *s);
+
+/* #API: |Overwrite string with the interned string (thread-safe)|output string; container; string ID|output string (empty for invalid IDs)|O(m), m = string size|1;2| */
+srt_string *sin_cpy_sync(srt_string **s, srt_intern *in, uint32_t id);
+
+/*
+ * I/O
+ */
+
+/* #API: |Save interned strings to file|file handle; container|Number of bytes written; < 0: error|O(n)|1;2| */
+ssize_t sin_write(FILE *handle, const srt_intern *in);
+
+/* #API: |Load interned strings from file (same IDs as when saved)|file handle|container (NULL: read error, invalid data or not enough memory)|O(n)|1;2| */
+srt_intern *sin_read(FILE *handle);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+#endif /* #ifndef SINTERN_H */
@@ -0,0 +1,266 @@
+/*
+ * sivmap.c
+ *
+ * Interval map handling.
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sivmap.h"
+#include "saux/scommon.h"
+
+/*
+ * Internal constants
+ */
+
+#define SIV_STACK_MAX 130 /* 2 * (log2(ST_NIL) + 1), plus margin */
+
+/*
+ * Internal functions
+ */
+
+#define BUILD_SIV_CMP(FN, T)                                                   \
+	static int FN(const T *a, const T *b)                                  \
+	{                                                                      \
+		if (a->s != b->s)                                              \
+			return a->s > b->s ? 1 : -1;                           \
+		return a->e > b->e ? 1 : a->e < b->e ? -1 : 0;                 \
+	}
+
+BUILD_SIV_CMP(cmp_siv_i, struct SIvMapI)
+BUILD_SIV_CMP(cmp_siv_d, struct SIvMapD)
+
+/* Subtree maximum end: own end, or the children's maximum end */
+#define BUILD_SIV_AUG(FN, T)                                                   \
+	static void FN(const srt_tree *t, srt_tnode *node)                     \
+	{                                                                      \
+		T *n = (T *)node;                                              \
+		const T *l = (const T *)get_node_r(t, node->x.l),              \
+			*r = (const T *)get_node_r(t, node->r);                \
+		n->max_e = n->e;                                               \
+		if (l && l->max_e > n->max_e)                                  \
+			n->max_e = l->max_e;                                   \
+		if (r && r->max_e > n->max_e)                                  \
+			n->max_e = r->max_e;                                   \
+	}
+
+BUILD_SIV_AUG(aug_siv_i, struct SIvMapI)
+BUILD_SIV_AUG(aug_siv_d, struct SIvMapD)
+
+S_INLINE srt_bool siv_chk_t(const srt_ivmap *m, int t)
+{
+	return m && m->d.sub_type == t ? S_TRUE : S_FALSE;
+}
+
+static srt_ivmap *siv_alloc_aux(enum eSIV_Type t, size_t init_size)
+{
+	srt_ivmap *m;
+	if (t == SIV_I)
+		m = st_alloc((srt_cmp)cmp_siv_i, sizeof(struct SIvMapI),
+			     init_size);
+	else
+		m = st_alloc((srt_cmp)cmp_siv_d, sizeof(struct SIvMapD),
+			     init_size);
+	if (m && (srt_data *)m != sd_void) {
+		m->d.sub_type = (uint8_t)t;
+		m->aug_f = t == SIV_I ? aug_siv_i : aug_siv_d;
+	}
+	return m;
+}
+
+/*
+ * Balanced tree from sorted nodes, stored in the same order (node i is the
+ * i-th interval). Nodes at the deepest level are red (unless the root), so
+ * every path to a leaf has the same number of black nodes.
+ */
+static srt_tndx siv_build_aux(srt_ivmap *m, size_t lo, size_t hi,
+			      size_t depth, size_t red_depth)
+{
+	size_t mid;
+	srt_tnode *n;
+	if (lo >= hi)
+		return ST_NIL;
+	mid = lo + (hi - lo) / 2;
+	n = get_node(m, (srt_tndx)mid);
+	n->x.l = siv_build_aux(m, lo, mid, depth + 1, red_depth);
+	n->r = siv_build_aux(m, mid + 1, hi, depth + 1, red_depth);
+	n->x.is_red = depth > 0 && depth == red_depth;
+	m->aug_f(m, n);
+	return (srt_tndx)mid;
+}
+
+#define BUILD_SIV_BUILD(FN, ID, TN, T, INSERT)                                 \
+	srt_ivmap *FN(const T *s, const T *e, const int64_t *v, size_t n)      \
+	{                                                                      \
+		size_t i;                                                      \
+		TN *node;                                                      \
+		srt_bool sorted = S_TRUE;                                      \
+		srt_ivmap *m;                                                  \
+		RETURN_IF(n > ST_NDX_MAX || (n && (!s || !e)), NULL);          \
+		m = siv_alloc_aux(ID, n);                                      \
+		RETURN_IF(!m || (srt_data *)m == sd_void, m);                  \
+		for (i = 0; i < n && sorted; i++) {                            \
+			if (!(s[i] <= e[i])                                    \
+			    || (i > 0 && !(s[i - 1] < s[i])                    \
+				&& !(s[i - 1] <= s[i] && e[i - 1] < e[i])))    \
+				sorted = S_FALSE;                              \
+		}                                                              \
+		if (!sorted) {                                                 \
+			for (i = 0; i < n; i++)                                \
+				INSERT(&m, s[i], e[i], v ? v[i] : 0);          \
+			return m;                                              \
+		}                                                              \
+		for (i = 0; i < n; i++) {                                      \
+			node = (TN *)get_node(m, (srt_tndx)i);                 \
+			node->s = s[i];                                        \
+			node->e = e[i];                                        \
+			node->v = v ? v[i] : 0;                                \
+		}                                                              \
+		m->root = siv_build_aux(m, 0, n, 0, n ? slog2(n) : 0);         \
+		siv_set_size(m, n);                                            \
+		return m;                                                      \
+	}
+
+/*
+ * Allocation
+ */
+
+srt_ivmap *siv_alloc(enum eSIV_Type t, size_t init_size)
+{
+	return siv_alloc_aux(t, init_size);
+}
+
+BUILD_SIV_BUILD(siv_build_i, SIV_I, struct SIvMapI, int64_t, siv_insert_i)
+BUILD_SIV_BUILD(siv_build_d, SIV_D, struct SIvMapD, double, siv_insert_d)
+
+srt_ivmap *siv_dup(const srt_ivmap *src)
+{
+	srt_ivmap *m;
+	size_t ss;
+	RETURN_IF(!src, NULL);
+	ss = siv_size(src);
+	m = siv_alloc_aux(siv_type(src), ss);
+	RETURN_IF(!m || (srt_data *)m == sd_void, m);
+	if (ss) /* nodes are linked by index: raw copy */
+		memcpy(st_enum(m, 0), st_enum_r(src, 0), ss * src->d.elem_size);
+	m->root = src->root;
+	siv_set_size(m, ss);
+	return m;
+}
+
+void siv_clear(srt_ivmap *m)
+{
+	if (m) {
+		siv_set_size(m, 0);
+		m->root = ST_NIL;
+	}
+}
+
+/*
+ * Insert
+ */
+
+#define BUILD_SIV_INSERT(FN, ID, TN, T)                                        \
+	srt_bool FN(srt_ivmap **m, T s, T e, int64_t v)                        \
+	{                                                                      \
+		TN n;                                                          \
+		RETURN_IF(!m || !siv_chk_t(*m, ID), S_FALSE);                  \
+		RETURN_IF(!(s <= e), S_FALSE); /* BEHAVIOR: invalid interval */\
+		n.s = s;                                                       \
+		n.e = n.max_e = e;                                             \
+		n.v = v;                                                       \
+		return st_insert((srt_tree **)m, (const srt_tnode *)&n);       \
+	}
+
+BUILD_SIV_INSERT(siv_insert_i, SIV_I, struct SIvMapI, int64_t)
+BUILD_SIV_INSERT(siv_insert_d, SIV_D, struct SIvMapD, double)
+
+/*
+ * Delete
+ */
+
+#define BUILD_SIV_DELETE(FN, ID, TN, T)                                        \
+	srt_bool FN(srt_ivmap *m, T s, T e)                                    \
+	{                                                                      \
+		TN n;                                                          \
+		RETURN_IF(!siv_chk_t(m, ID), S_FALSE);                         \
+		n.s = s;                                                       \
+		n.e = e;                                                       \
+		return st_delete(m, (const srt_tnode *)&n, NULL);              \
+	}
+
+BUILD_SIV_DELETE(siv_delete_i, SIV_I, struct SIvMapI, int64_t)
+BUILD_SIV_DELETE(siv_delete_d, SIV_D, struct SIvMapD, double)
+
+/*
+ * Random access
+ */
+
+#define BUILD_SIV_AT(FN, FN_COUNT, ID, TN, T)                                  \
+	int64_t FN(const srt_ivmap *m, T s, T e)                               \
+	{                                                                      \
+		TN n;                                                          \
+		const TN *nr;                                                  \
+		RETURN_IF(!siv_chk_t(m, ID) || !siv_size(m), 0);               \
+		n.s = s;                                                       \
+		n.e = e;                                                       \
+		nr = (const TN *)st_locate(m, (const srt_tnode *)&n);          \
+		return nr ? nr->v : 0; /* BEHAVIOR */                          \
+	}                                                                      \
+	size_t FN_COUNT(const srt_ivmap *m, T s, T e)                          \
+	{                                                                      \
+		TN n;                                                          \
+		RETURN_IF(!siv_chk_t(m, ID) || !siv_size(m), S_FALSE);         \
+		n.s = s;                                                       \
+		n.e = e;                                                       \
+		return st_locate(m, (const srt_tnode *)&n) ? 1 : 0;            \
+	}
+
+BUILD_SIV_AT(siv_at_i, siv_count_i, SIV_I, struct SIvMapI, int64_t)
+BUILD_SIV_AT(siv_at_d, siv_count_d, SIV_D, struct SIvMapD, double)
+
+/*
+ * Queries
+ *
+ * In-order traversal, skipping the subtrees with maximum end below the query
+ * start, and stopping at the first interval starting after the query end
+ * (all the remaining ones start later).
+ */
+
+#define BUILD_SIV_OVERLAP(FN, ID, TN, T, CALLBACK_T)                           \
+	size_t FN(const srt_ivmap *m, T s, T e, CALLBACK_T f, void *context)   \
+	{                                                                      \
+		size_t np = 0, nelems = 0;                                     \
+		srt_tndx c, p[SIV_STACK_MAX];                                  \
+		const TN *cn;                                                  \
+		RETURN_IF(!siv_chk_t(m, ID) || !siv_size(m), 0);               \
+		RETURN_IF(!(s <= e), 0);                                       \
+		c = m->root;                                                   \
+		for (;;) {                                                     \
+			for (; c != ST_NIL && np < SIV_STACK_MAX;              \
+			     c = cn->n.x.l) {                                  \
+				cn = (const TN *)get_node_r(m, c);             \
+				if (cn->max_e < s)                             \
+					break;                                 \
+				p[np++] = c;                                   \
+			}                                                      \
+			if (!np)                                               \
+				break;                                         \
+			cn = (const TN *)get_node_r(m, p[--np]);               \
+			if (cn->s > e)                                         \
+				break;                                         \
+			if (cn->e >= s) {                                      \
+				if (f && !f(cn->s, cn->e, cn->v, context))     \
+					return nelems;                         \
+				nelems++;                                      \
+			}                                                      \
+			c = cn->n.r;                                           \
+		}                                                              \
+		return nelems;                                                 \
+	}
+
+BUILD_SIV_OVERLAP(siv_overlap_i, SIV_I, struct SIvMapI, int64_t,
+		  srt_ivmap_it_i)
+BUILD_SIV_OVERLAP(siv_overlap_d, SIV_D, struct SIvMapD, double,
+		  srt_ivmap_it_d)
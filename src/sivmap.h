@@ -0,0 +1,194 @@
+#ifndef SIVMAP_H
+#define SIVMAP_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * sivmap.h
+ *
+ * #SHORTDOC interval map handling (interval-value storage, overlap queries)
+ *
+ * #DOC Interval map functions handle closed intervals ([start, end], both
+ * #DOC ends included) with an associated value. It is implemented as a
+ * #DOC Red-Black tree sorted by (start, end), with every node augmented with
+ * #DOC the maximum end of its subtree, so stabbing (intervals containing a
+ * #DOC point) and overlap (intervals intersecting a given interval) queries
+ * #DOC skip the subtrees that can not match. Intervals are unique: inserting
+ * #DOC an existing (start, end) pair replaces its value.
+ * #DOC
+ * #DOC
+ * #DOC Supported interval map modes (enum eSIV_Type):
+ * #DOC
+ * #DOC
+ * #DOC 	SIV_I: int64_t start and end, int64_t value
+ * #DOC
+ * #DOC 	SIV_D: double start and end, int64_t value
+ * #DOC
+ * #DOC
+ * #DOC Callback types for the siv_stab_*() and siv_overlap_*() functions:
+ * #DOC
+ * #DOC
+ * #DOC	typedef srt_bool (*srt_ivmap_it_i)(int64_t s, int64_t e, int64_t v, void *context);
+ * #DOC
+ * #DOC	typedef srt_bool (*srt_ivmap_it_d)(double s, double e, int64_t v, void *context);
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "saux/stree.h"
+
+/*
+ * Structures
+ */
+
+enum eSIV_Type { SIV_I, SIV_D };
+
+struct SIvMapI {
+	srt_tnode n;
+	int64_t s, e;
+	int64_t max_e; /* subtree maximum end */
+	int64_t v;
+};
+
+struct SIvMapD {
+	srt_tnode n;
+	double s, e;
+	double max_e; /* subtree maximum end */
+	int64_t v;
+};
+
+typedef srt_tree srt_ivmap; /* Opaque structure (accessors are provided) */
+			    /* (interval map is implemented as a tree)   */
+
+typedef srt_bool (*srt_ivmap_it_i)(int64_t s, int64_t e, int64_t v,
+				   void *context);
+typedef srt_bool (*srt_ivmap_it_d)(double s, double e, int64_t v,
+				   void *context);
+
+/*
+ * Allocation
+ */
+
+/* #API: |Allocate interval map (heap)|interval map type; initial reserve|interval map|O(1)|1;2| */
+srt_ivmap *siv_alloc(enum eSIV_Type t, size_t initial_num_elems_reserve);
+
+/* #API: |Build interval map from intervals sorted by (start, end). BEHAVIOR: if the input is not sorted, or has repeated or invalid intervals, the map is built by inserting the intervals one by one (invalid intervals are ignored)|start array; end array; value array (NULL for 0 values); number of intervals|interval map|O(n) (O(n log n) if not sorted)|1;2| */
+srt_ivmap *siv_build_i(const int64_t *s, const int64_t *e, const int64_t *v,
+		       size_t n);
+
+/* #API: |Build interval map from intervals sorted by (start, end). BEHAVIOR: if the input is not sorted, or has repeated or invalid intervals, the map is built by inserting the intervals one by one (invalid intervals are ignored)|start array; end array; value array (NULL for 0 values); number of intervals|interval map|O(n) (O(n log n) if not sorted)|1;2| */
+srt_ivmap *siv_build_d(const double *s, const double *e, const int64_t *v,
+		       size_t n);
+
+SD_BUILDFUNCS_FULL(siv, srt_ivmap, 0)
+
+/*
+#API: |Free one or more interval maps (heap)|interval map; more interval maps (optional)|-|O(1)|1;2|
+void siv_free(srt_ivmap **m, ...)
+
+#API: |Ensure space for extra elements|interval map;number of extra elements|extra size allocated|O(1)|1;2|
+size_t siv_grow(srt_ivmap **m, size_t extra_elems)
+
+#API: |Ensure space for elements|interval map;absolute element reserve|reserved elements|O(1)|1;2|
+size_t siv_reserve(srt_ivmap **m, size_t max_elems)
+
+#API: |Make the interval map use the minimum possible memory|interval map|interval map reference (optional usage)|O(1) for allocators using memory remap; O(n) for naive allocators|1;2|
+srt_ivmap *siv_shrink(srt_ivmap **m)
+
+#API: |Get interval map size|interval map|Interval map number of elements|O(1)|1;2|
+size_t siv_size(const srt_ivmap *m)
+
+#API: |Allocated space|interval map|current allocated space (vector elements)|O(1)|1;2|
+size_t siv_capacity(const srt_ivmap *m)
+
+#API: |Preallocated space left|interval map|allocated space left|O(1)|1;2|
+size_t siv_capacity_left(const srt_ivmap *m)
+*/
+
+#ifdef S_USE_VA_ARGS
+#define siv_free(...) siv_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define siv_free(m) siv_free_aux(m, S_INVALID_PTR_VARG_TAIL)
+#endif
+
+/* #API: |Duplicate interval map|input interval map|output interval map|O(n)|1;2| */
+srt_ivmap *siv_dup(const srt_ivmap *src);
+
+/* #API: |Reset/clean interval map (keeping interval map type)|interval map|-|O(1)|1;2| */
+void siv_clear(srt_ivmap *m);
+
+/* #API: |Get interval map type|interval map|interval map type (enum eSIV_Type)|O(1)|1;2| */
+S_INLINE enum eSIV_Type siv_type(const srt_ivmap *m)
+{
+	return m ? (enum eSIV_Type)m->d.sub_type : SIV_I;
+}
+
+/*
+ * Insert
+ */
+
+/* #API: |Insert into interval map (SIV_I). If the interval is already in the map, the value is replaced|interval map; start; end; value|S_TRUE: OK, S_FALSE: insertion error (e.g. start > end)|O(log n)|1;2| */
+srt_bool siv_insert_i(srt_ivmap **m, int64_t s, int64_t e, int64_t v);
+
+/* #API: |Insert into interval map (SIV_D). If the interval is already in the map, the value is replaced|interval map; start; end; value|S_TRUE: OK, S_FALSE: insertion error (e.g. start > end)|O(log n)|1;2| */
+srt_bool siv_insert_d(srt_ivmap **m, double s, double e, int64_t v);
+
+/*
+ * Delete
+ */
+
+/* #API: |Delete interval map element (SIV_I)|interval map; start; end|S_TRUE: found and deleted; S_FALSE: not found|O(log n)|1;2| */
+srt_bool siv_delete_i(srt_ivmap *m, int64_t s, int64_t e);
+
+/* #API: |Delete interval map element (SIV_D)|interval map; start; end|S_TRUE: found and deleted; S_FALSE: not found|O(log n)|1;2| */
+srt_bool siv_delete_d(srt_ivmap *m, double s, double e);
+
+/*
+ * Random access
+ */
+
+/* #API: |Access to interval value (SIV_I)|interval map; start; end|value (0 if not found)|O(log n)|1;2| */
+int64_t siv_at_i(const srt_ivmap *m, int64_t s, int64_t e);
+
+/* #API: |Access to interval value (SIV_D)|interval map; start; end|value (0 if not found)|O(log n)|1;2| */
+int64_t siv_at_d(const srt_ivmap *m, double s, double e);
+
+/* #API: |Interval count/check (SIV_I)|interval map; start; end|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t siv_count_i(const srt_ivmap *m, int64_t s, int64_t e);
+
+/* #API: |Interval count/check (SIV_D)|interval map; start; end|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t siv_count_d(const srt_ivmap *m, double s, double e);
+
+/*
+ * Queries
+ */
+
+/* #API: |Enumerate intervals overlapping [s, e], in (start, end) order (SIV_I)|interval map; start; end; callback function (NULL for just counting); callback function context|Elements processed|O(log n) + O(m log n)|1;2| */
+size_t siv_overlap_i(const srt_ivmap *m, int64_t s, int64_t e,
+		     srt_ivmap_it_i f, void *context);
+
+/* #API: |Enumerate intervals overlapping [s, e], in (start, end) order (SIV_D)|interval map; start; end; callback function (NULL for just counting); callback function context|Elements processed|O(log n) + O(m log n)|1;2| */
+size_t siv_overlap_d(const srt_ivmap *m, double s, double e, srt_ivmap_it_d f,
+		     void *context);
+
+/* #API: |Enumerate intervals containing a point, in (start, end) order (SIV_I)|interval map; point; callback function (NULL for just counting); callback function context|Elements processed|O(log n) + O(m log n)|1;2| */
+S_INLINE size_t siv_stab_i(const srt_ivmap *m, int64_t p, srt_ivmap_it_i f,
+			   void *context)
+{
+	return siv_overlap_i(m, p, p, f, context);
+}
+
+/* #API: |Enumerate intervals containing a point, in (start, end) order (SIV_D)|interval map; point; callback function (NULL for just counting); callback function context|Elements processed|O(log n) + O(m log n)|1;2| */
+S_INLINE size_t siv_stab_d(const srt_ivmap *m, double p, srt_ivmap_it_d f,
+			   void *context)
+{
+	return siv_overlap_d(m, p, p, f, context);
+}
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+
+#endif /* #ifndef SIVMAP_H */
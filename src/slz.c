@@ -0,0 +1,450 @@
+/*
+ * slz.c
+ *
+ * Streaming LZ compression (framed, with sliding window).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "slz.h"
+#include "saux/scommon.h"
+#include "saux/senc.h"
+#include "saux/shash.h"
+
+#define SLZ_MAGIC "SLZ1"
+#define SLZ_HDR_SIZE 6
+#define SLZ_CRC_SIZE 4
+
+/*
+ * Internal functions
+ */
+
+/* Maximum compressed block size (see senc_lz_aux()) */
+static size_t slz_cmax(size_t win)
+{
+	return win + (win / 8) * 10 + 32;
+}
+
+/* Drop 'n' bytes from the beginning of the window */
+static void slz_enc_drop(srt_lz_enc *e, size_t n)
+{
+	if (n > e->used)
+		n = e->used;
+	memmove(e->buf, e->buf + n, e->used - n);
+	e->used -= n;
+	e->hist = n > e->hist ? 0 : e->hist - n;
+	/* Hash table entries are kept, referring to the same data */
+	e->c->base = e->c->base > S_SIZET_MAX - n ? S_SIZET_MAX
+						  : e->c->base + n;
+}
+
+static srt_bool slz_enc_hdr(srt_string **out, srt_lz_enc *e)
+{
+	uint8_t h[SLZ_HDR_SIZE];
+	size_t os;
+	RETURN_IF(e->hdr_ok, S_TRUE);
+	memcpy(h, SLZ_MAGIC, 4);
+	h[4] = e->wbits;
+	h[5] = e->flags;
+	os = ss_size(*out);
+	ss_cat_cn(out, (const char *)h, SLZ_HDR_SIZE);
+	RETURN_IF(ss_size(*out) != os + SLZ_HDR_SIZE, S_FALSE);
+	e->hdr_ok = S_TRUE;
+	return S_TRUE;
+}
+
+/* Compress the pending input as a block */
+static srt_bool slz_enc_blk(srt_string **out, srt_lz_enc *e)
+{
+	uint8_t *o;
+	size_t n = e->used - e->hist, cs, os;
+	RETURN_IF(!slz_enc_hdr(out, e), S_FALSE);
+	RETURN_IF(!n, S_TRUE);
+	o = e->cbuf + S_PK_U64_MAX_BYTES;
+	cs = senc_lz_blk(e->c, e->buf, e->hist, e->used, o, 2 * e->win);
+	RETURN_IF(!cs, S_FALSE);
+	/* Block size before the block data, and the checksum after it */
+	o = e->cbuf;
+	s_st_pk_u64(&o, cs);
+	if (e->flags & SLZ_F_CRC32) {
+		S_ST_LE_U32(e->cbuf + S_PK_U64_MAX_BYTES + cs,
+			    sh_crc32(S_CRC32_INIT, e->buf + e->hist, n));
+		cs += SLZ_CRC_SIZE;
+	}
+	os = ss_size(*out);
+	ss_cat_cn(out, (const char *)e->cbuf, (size_t)(o - e->cbuf));
+	ss_cat_cn(out, (const char *)e->cbuf + S_PK_U64_MAX_BYTES, cs);
+	RETURN_IF(ss_size(*out) != os + (size_t)(o - e->cbuf) + cs, S_FALSE);
+	e->hist = e->used;
+	if (e->hist > e->win)
+		slz_enc_drop(e, e->hist - e->win);
+	return S_TRUE;
+}
+
+/*
+ * Return: SLZ_MORE (need more input), SLZ_END, or SLZ_ERROR. '*off' is
+ * moved forward after every decoded block.
+ */
+static int slz_dec_blk(srt_string **out, srt_lz_dec *d, const uint8_t *p,
+		       size_t ps, size_t *off)
+{
+	const uint8_t *q;
+	size_t hs, cs, ds, crcs, os;
+	RETURN_IF(*off >= ps, SLZ_MORE);
+	hs = s_pk_u64_size(p + *off);
+	RETURN_IF(!hs, SLZ_ERROR);
+	RETURN_IF(hs > ps - *off, SLZ_MORE);
+	q = p + *off;
+	cs = (size_t)s_ld_pk_u64(&q, hs);
+	if (!cs) {
+		*off += hs;
+		return SLZ_END;
+	}
+	RETURN_IF(cs > slz_cmax(d->win), SLZ_ERROR);
+	crcs = d->flags & SLZ_F_CRC32 ? SLZ_CRC_SIZE : 0;
+	RETURN_IF(hs + cs + crcs > ps - *off, SLZ_MORE);
+	ds = sdec_lz_blk(q, cs, d->buf + d->hist, d->hist, d->win);
+	RETURN_IF(ds == S_NPOS, SLZ_ERROR);
+	RETURN_IF(crcs
+			  && S_LD_LE_U32(q + cs)
+				     != sh_crc32(S_CRC32_INIT, d->buf + d->hist,
+						 ds),
+		  SLZ_ERROR);
+	os = ss_size(*out);
+	ss_cat_cn(out, (const char *)d->buf + d->hist, ds);
+	RETURN_IF(ss_size(*out) != os + ds, SLZ_ERROR);
+	d->hist += ds;
+	if (d->hist > d->win) {
+		memmove(d->buf, d->buf + d->hist - d->win, d->win);
+		d->hist = d->win;
+	}
+	*off += hs + cs + crcs;
+	return SLZ_MORE;
+}
+
+static int slz_dec_hdr(srt_lz_dec *d, const uint8_t *p, size_t ps,
+		       size_t *off)
+{
+	RETURN_IF(ps < SLZ_HDR_SIZE, SLZ_MORE);
+	RETURN_IF(memcmp(p, SLZ_MAGIC, 4) || p[4] < SLZ_WBITS_MIN
+			  || p[4] > d->wbits_max || (p[5] & ~SLZ_F_CRC32),
+		  SLZ_ERROR);
+	d->win = (size_t)1 << p[4];
+	d->flags = p[5];
+	d->buf = (uint8_t *)s_malloc(2 * d->win + 16);
+	RETURN_IF(!d->buf, SLZ_ERROR);
+	*off = SLZ_HDR_SIZE;
+	return SLZ_MORE;
+}
+
+/*
+ * Encoding
+ */
+
+srt_lz_enc *slz_enc_alloc(unsigned wbits, srt_bool crc32)
+{
+	srt_lz_enc *e;
+	if (!wbits)
+		wbits = SLZ_WBITS_DEFAULT;
+	RETURN_IF(wbits < SLZ_WBITS_MIN || wbits > SLZ_WBITS_MAX, NULL);
+	e = (srt_lz_enc *)s_malloc(sizeof(srt_lz_enc));
+	RETURN_IF(!e, NULL);
+	memset(e, 0, sizeof(*e));
+	e->win = (size_t)1 << wbits;
+	e->wbits = (uint8_t)wbits;
+	e->flags = crc32 ? SLZ_F_CRC32 : 0;
+	e->c = ss_lz_ctx_alloc();
+	e->buf = (uint8_t *)s_malloc(2 * e->win);
+	e->cbuf = (uint8_t *)s_malloc(S_PK_U64_MAX_BYTES + slz_cmax(e->win)
+				      + SLZ_CRC_SIZE);
+	if (!e->c || !e->buf || !e->cbuf)
+		slz_enc_free(&e);
+	return e;
+}
+
+void slz_enc_free_aux(srt_lz_enc **e, ...)
+{
+	va_list ap;
+	srt_lz_enc **next;
+	va_start(ap, e);
+	next = e;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			ss_lz_ctx_free(&(*next)->c);
+			s_free((*next)->buf);
+			s_free((*next)->cbuf);
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_lz_enc **)va_arg(ap, srt_lz_enc **);
+	}
+	va_end(ap);
+}
+
+srt_bool slz_enc_write(srt_string **out, srt_lz_enc *e, const srt_string *in)
+{
+	const char *p;
+	size_t n, k, off = 0;
+	RETURN_IF(!out || !e, S_FALSE);
+	p = ss_get_buffer_r(in);
+	n = ss_size(in);
+	while (off < n) {
+		k = S_MIN(n - off, e->win - (e->used - e->hist));
+		memcpy(e->buf + e->used, p + off, k);
+		e->used += k;
+		off += k;
+		if (e->used - e->hist == e->win && !slz_enc_blk(out, e))
+			return S_FALSE;
+	}
+	return S_TRUE;
+}
+
+srt_bool slz_enc_flush(srt_string **out, srt_lz_enc *e)
+{
+	RETURN_IF(!out || !e, S_FALSE);
+	return slz_enc_blk(out, e);
+}
+
+srt_bool slz_enc_end(srt_string **out, srt_lz_enc *e)
+{
+	uint8_t b[S_PK_U64_MAX_BYTES], *o = b;
+	size_t os;
+	RETURN_IF(!slz_enc_flush(out, e), S_FALSE);
+	s_st_pk_u64(&o, 0); /* zero-size block: end of stream */
+	os = ss_size(*out);
+	ss_cat_cn(out, (const char *)b, (size_t)(o - b));
+	RETURN_IF(ss_size(*out) != os + (size_t)(o - b), S_FALSE);
+	slz_enc_drop(e, e->used);
+	e->hdr_ok = S_FALSE;
+	return S_TRUE;
+}
+
+/*
+ * Decoding
+ */
+
+srt_lz_dec *slz_dec_alloc(unsigned wbits_max)
+{
+	srt_lz_dec *d;
+	if (!wbits_max || wbits_max > SLZ_WBITS_MAX)
+		wbits_max = SLZ_WBITS_MAX;
+	d = (srt_lz_dec *)s_malloc(sizeof(srt_lz_dec));
+	RETURN_IF(!d, NULL);
+	memset(d, 0, sizeof(*d));
+	d->in = ss_alloc(0);
+	d->wbits_max = (uint8_t)wbits_max;
+	d->st = SLZ_MORE;
+	return d;
+}
+
+void slz_dec_free_aux(srt_lz_dec **d, ...)
+{
+	va_list ap;
+	srt_lz_dec **next;
+	va_start(ap, d);
+	next = d;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			ss_free(&(*next)->in);
+			s_free((*next)->buf);
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_lz_dec **)va_arg(ap, srt_lz_dec **);
+	}
+	va_end(ap);
+}
+
+int slz_dec_write(srt_string **out, srt_lz_dec *d, const srt_string *in)
+{
+	const uint8_t *p;
+	size_t ps, is, off = 0;
+	RETURN_IF(!out || !d, SLZ_ERROR);
+	RETURN_IF(d->st != SLZ_MORE, d->st);
+	is = ss_size(d->in);
+	ss_cat(&d->in, in);
+	if (ss_size(d->in) != is + ss_size(in)) {
+		d->st = SLZ_ERROR;
+		return d->st;
+	}
+	p = (const uint8_t *)ss_get_buffer_r(d->in);
+	ps = ss_size(d->in);
+	if (!d->win)
+		d->st = slz_dec_hdr(d, p, ps, &off);
+	if (d->win) {
+		while (d->st == SLZ_MORE) {
+			is = off;
+			d->st = slz_dec_blk(out, d, p, ps, &off);
+			if (off == is)
+				break;
+		}
+	}
+	ss_erase(&d->in, 0, off);
+	return d->st;
+}
+
+/*
+ * Block-parallel container
+ */
+
+#define SLZ_PAR_MAGIC "SLZP"
+#define SLZ_PAR_HDR_SIZE 16
+
+srt_bool slz_par_init(srt_lz_par *p, size_t ss, unsigned bbits, unsigned dbits,
+		      srt_bool lzh)
+{
+	RETURN_IF(!p, S_FALSE);
+	if (!bbits)
+		bbits = SLZ_PAR_BBITS_DEFAULT;
+	RETURN_IF(bbits < SLZ_PAR_BBITS_MIN || bbits > SLZ_PAR_BBITS_MAX
+			  || dbits > bbits,
+		  S_FALSE);
+	memset(p, 0, sizeof(*p));
+	p->ss = ss;
+	p->bbits = (uint8_t)bbits;
+	p->dbits = (uint8_t)dbits;
+	p->bsize = (size_t)1 << bbits;
+	p->dsize = dbits ? (size_t)1 << dbits : 0;
+	p->nblk = (ss >> bbits) + ((ss & (p->bsize - 1)) ? 1 : 0);
+	p->lzh = lzh;
+	return S_TRUE;
+}
+
+size_t slz_par_enc_blk(srt_string **out, const srt_lz_par *p,
+		       const srt_string *in, size_t i)
+{
+	uint8_t *o;
+	const uint8_t *s;
+	size_t off, n, d, os, cs, cmax;
+	RETURN_IF(!out || !p || i >= p->nblk || ss_size(in) != p->ss, 0);
+	off = i * p->bsize;
+	n = S_MIN(p->bsize, p->ss - off);
+	d = S_MIN(p->dsize, off);
+	s = (const uint8_t *)ss_get_buffer_r(in) + off - d;
+	os = ss_size(*out);
+	cmax = s_size_t_add(os, senc_lz_dict(s, d, d + n, NULL, p->lzh), 0);
+	RETURN_IF(!cmax || ss_reserve(out, cmax) < cmax, 0);
+	o = (uint8_t *)ss_get_buffer(*out) + os;
+	cs = senc_lz_dict(s, d, d + n, o, p->lzh);
+	ss_set_size(*out, os + cs);
+	return cs;
+}
+
+srt_string *slz_par_cat_hdr(srt_string **out, const srt_lz_par *p,
+			    const size_t *blk_sizes)
+{
+	uint8_t b[SLZ_PAR_HDR_SIZE];
+	size_t i;
+	uint64_t acc = 0;
+	ASSERT_RETURN_IF(!out, ss_void);
+	RETURN_IF(!p || (p->nblk && !blk_sizes), ss_check(out));
+	memcpy(b, SLZ_PAR_MAGIC, 4);
+	b[4] = p->bbits;
+	b[5] = p->dbits;
+	b[6] = b[7] = 0;
+	S_ST_LE_U64(b + 8, (uint64_t)p->ss);
+	ss_cat_cn(out, (const char *)b, SLZ_PAR_HDR_SIZE);
+	for (i = 0; i < p->nblk; i++) {
+		acc += blk_sizes[i];
+		S_ST_LE_U64(b, acc);
+		ss_cat_cn(out, (const char *)b, 8);
+	}
+	return *out;
+}
+
+srt_bool slz_par_enc(srt_string **out, const srt_string *in, unsigned bbits,
+		     unsigned dbits, srt_bool lzh)
+{
+	srt_lz_par p;
+	srt_bool ok;
+	srt_string *blks;
+	size_t i, *bs;
+	RETURN_IF(!out || !slz_par_init(&p, ss_size(in), bbits, dbits, lzh),
+		  S_FALSE);
+	bs = (size_t *)s_malloc(sizeof(size_t) * (p.nblk + 1));
+	RETURN_IF(!bs, S_FALSE);
+	blks = ss_alloc(0);
+	for (i = 0; i < p.nblk; i++)
+		if (!(bs[i] = slz_par_enc_blk(&blks, &p, in, i)))
+			break;
+	ok = i == p.nblk ? S_TRUE : S_FALSE;
+	if (ok) {
+		ss_cpy_c(out, ""); /* unshares, unlike ss_clear() */
+		slz_par_cat_hdr(out, &p, bs);
+		ss_cat(out, blks);
+		ok = ss_size(*out)
+			     == SLZ_PAR_HDR_SIZE + p.nblk * 8 + ss_size(blks);
+	}
+	s_free(bs);
+	ss_free(&blks);
+	return ok;
+}
+
+srt_bool slz_par_open(srt_lz_par *p, const srt_string *c)
+{
+	size_t i, cs, is;
+	uint64_t ss, o, prev = 0;
+	const uint8_t *b = (const uint8_t *)ss_get_buffer_r(c);
+	cs = ss_size(c);
+	RETURN_IF(!p || cs < SLZ_PAR_HDR_SIZE || memcmp(b, SLZ_PAR_MAGIC, 4)
+			  || b[6] || b[7],
+		  S_FALSE);
+	ss = S_LD_LE_U64(b + 8);
+	RETURN_IF(ss > (uint64_t)S_SIZET_MAX || !b[4]
+			  || !slz_par_init(p, (size_t)ss, b[4], b[5], S_FALSE),
+		  S_FALSE);
+	/* Block index, checking bounds for avoiding overflows */
+	RETURN_IF(p->nblk > (cs - SLZ_PAR_HDR_SIZE) / 8, S_FALSE);
+	is = SLZ_PAR_HDR_SIZE + p->nblk * 8;
+	for (i = 0; i < p->nblk; i++) {
+		o = S_LD_LE_U64(b + SLZ_PAR_HDR_SIZE + i * 8);
+		RETURN_IF(o < prev, S_FALSE);
+		prev = o;
+	}
+	RETURN_IF(prev != (uint64_t)(cs - is), S_FALSE);
+	p->idx = b + SLZ_PAR_HDR_SIZE;
+	p->data = b + is;
+	return S_TRUE;
+}
+
+size_t slz_par_dec_blk(const srt_lz_par *p, size_t i, uint8_t *o, size_t hist)
+{
+	size_t off, end, n;
+	RETURN_IF(!p || !p->data || i >= p->nblk || !o, S_NPOS);
+	off = i ? (size_t)S_LD_LE_U64(p->idx + (i - 1) * 8) : 0;
+	end = (size_t)S_LD_LE_U64(p->idx + i * 8);
+	n = S_MIN(p->bsize, p->ss - i * p->bsize);
+	/* BEHAVIOR: no references to previous blocks without dictionary */
+	hist = S_MIN(hist, S_MIN(p->dsize, i * p->bsize));
+	RETURN_IF(sdec_lz_blk(p->data + off, end - off, o, hist, n) != n,
+		  S_NPOS);
+	return n;
+}
+
+srt_bool slz_par_dec(srt_string **out, const srt_string *c)
+{
+	srt_lz_par p;
+	srt_bool r;
+	uint8_t *o;
+	size_t i;
+	srt_string *c2;
+	RETURN_IF(!out, S_FALSE);
+	if (*out == c && c) { /* aliasing: container read while decoding */
+		c2 = ss_dup(c);
+		r = slz_par_dec(out, c2);
+		ss_free(&c2);
+		return r;
+	}
+	RETURN_IF(!slz_par_open(&p, c), S_FALSE);
+	RETURN_IF(ss_reserve(out, p.ss) < p.ss, S_FALSE);
+	o = (uint8_t *)ss_get_buffer(*out);
+	for (i = 0; i < p.nblk; i++)
+		if (slz_par_dec_blk(&p, i, o + i * p.bsize, i * p.bsize)
+		    == S_NPOS) {
+			ss_clear(*out);
+			return S_FALSE;
+		}
+	ss_set_size(*out, p.ss);
+	return S_TRUE;
+}
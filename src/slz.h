@@ -0,0 +1,186 @@
+#ifndef SLZ_H
+#define SLZ_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * slz.h
+ *
+ * #SHORTDOC LZ compression streams and block-parallel containers
+ *
+ * #DOC Streaming LZ functions compress and decompress data given in pieces
+ * #DOC of any size, using the ss_enc_lz() format for the blocks. Unlike
+ * #DOC compressing independent chunks, block references can reach the
+ * #DOC previous blocks (sliding window), so the compression ratio is close
+ * #DOC to compressing all the data at once. Memory usage is bounded by the
+ * #DOC window size, both for the encoder and the decoder (two times the
+ * #DOC window size, plus the match hash table for the encoder).
+ * #DOC
+ * #DOC Blocks are self-delimiting: the decoder can be given the input in
+ * #DOC pieces of any size (e.g. as received from the network), returning
+ * #DOC the decoded data as blocks are completed.
+ * #DOC
+ * #DOC Stream format: "SLZ1", window size (log2, 1 byte), flags (1 byte,
+ * #DOC bit 0: block checksums), and the blocks: compressed size (packed
+ * #DOC integer, as in the ss_enc_lz() header; 0 for the end of the stream),
+ * #DOC compressed data (ss_enc_lz() format, up to window size bytes when
+ * #DOC decoded, with references up to window size bytes before the block),
+ * #DOC and, if enabled, the CRC-32 of the decoded block (32-bit, little
+ * #DOC endian).
+ * #DOC
+ * #DOC Block-parallel containers split the input into blocks of fixed size,
+ * #DOC compressed independently, so both compression and decompression can
+ * #DOC run on several threads (one call per block, using different output
+ * #DOC strings), and any block can be decoded alone (random access).
+ * #DOC Optionally, the tail of the previous block can be used as dictionary
+ * #DOC for improving the compression ratio, at the cost of requiring
+ * #DOC the previous block to be decoded first. The library does not create
+ * #DOC threads: see the '-j' option of the 'enc' example (test/enc.c).
+ * #DOC
+ * #DOC Container format: "SLZP", block size (log2, 1 byte), dictionary size
+ * #DOC (log2, 1 byte; 0: no dictionary), 2 zero bytes, uncompressed size
+ * #DOC (64-bit), the end offset of every compressed block relative to the
+ * #DOC first block (64-bit), and the blocks (ss_enc_lz() format). Integers
+ * #DOC are little endian.
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sstring.h"
+
+/*
+ * Structures
+ */
+
+#define SLZ_WBITS_MIN 12
+#define SLZ_WBITS_MAX 26
+#define SLZ_WBITS_DEFAULT 20 /* 1 MiB window */
+#define SLZ_F_CRC32 1	     /* per-block CRC-32 */
+
+enum eSLZ_Status { SLZ_ERROR = -1, SLZ_MORE = 0, SLZ_END = 1 };
+
+struct SLzEnc {
+	srt_lz_ctx *c;	 /* match hash table */
+	uint8_t *buf;	 /* history + pending input (2 * win bytes) */
+	uint8_t *cbuf;	 /* compressed block */
+	size_t hist;	 /* history bytes in 'buf' */
+	size_t used;	 /* history + pending input bytes in 'buf' */
+	size_t win;	 /* window size (also the maximum block size) */
+	uint8_t wbits;	 /* window size (log2) */
+	uint8_t flags;	 /* SLZ_F_* */
+	srt_bool hdr_ok; /* stream header written */
+};
+
+struct SLzDec {
+	srt_string *in; /* pending input (incomplete block) */
+	uint8_t *buf;	/* history + current block (2 * win + 16 bytes) */
+	size_t hist;	/* history bytes in 'buf' */
+	size_t win;	/* window size (0: stream header not read yet) */
+	uint8_t wbits_max;
+	uint8_t flags;
+	int st; /* enum eSLZ_Status */
+};
+
+#define SLZ_PAR_BBITS_MIN 12
+#define SLZ_PAR_BBITS_MAX 30
+#define SLZ_PAR_BBITS_DEFAULT 20 /* 1 MiB blocks */
+
+struct SLzPar {
+	size_t ss;	     /* uncompressed size */
+	size_t nblk;	     /* number of blocks */
+	size_t bsize;	     /* block size */
+	size_t dsize;	     /* dictionary size (0: independent blocks) */
+	const uint8_t *idx;  /* block end offsets (decoding) */
+	const uint8_t *data; /* first block (decoding) */
+	uint8_t bbits;	     /* block size (log2) */
+	uint8_t dbits;	     /* dictionary size (log2) */
+	srt_bool lzh;	     /* high compression (encoding) */
+};
+
+typedef struct SLzEnc srt_lz_enc; /* Opaque structure */
+typedef struct SLzDec srt_lz_dec; /* Opaque structure */
+typedef struct SLzPar srt_lz_par;
+
+/*
+ * Encoding
+ */
+
+/* #API: |Allocate streaming LZ encoder|window size (log2, from SLZ_WBITS_MIN to SLZ_WBITS_MAX; 0 for SLZ_WBITS_DEFAULT); S_TRUE: per-block CRC-32|encoder (NULL if not enough memory or invalid window size)|O(1)|1;2| */
+srt_lz_enc *slz_enc_alloc(unsigned wbits, srt_bool crc32);
+
+/*
+#API: |Free one or more streaming LZ encoders|encoder; more encoders (optional)|-|O(1)|1;2|
+void slz_enc_free(srt_lz_enc **e, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define slz_enc_free(...) slz_enc_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define slz_enc_free(e) slz_enc_free_aux(e, S_INVALID_PTR_VARG_TAIL)
+#endif
+void slz_enc_free_aux(srt_lz_enc **e, ...);
+
+/* #API: |Compress data, appending the completed blocks to the output (input is buffered up to the window size)|output string; encoder; input data|S_TRUE: OK, S_FALSE: not enough memory|O(n)|1;2| */
+srt_bool slz_enc_write(srt_string **out, srt_lz_enc *e, const srt_string *in);
+
+/* #API: |Compress the buffered input as a block (e.g. for sending a complete message), appending it to the output|output string; encoder|S_TRUE: OK, S_FALSE: not enough memory|O(n)|1;2| */
+srt_bool slz_enc_flush(srt_string **out, srt_lz_enc *e);
+
+/* #API: |Compress the buffered input and end the stream, appending it to the output (the encoder can be used for a new stream after that)|output string; encoder|S_TRUE: OK, S_FALSE: not enough memory|O(n)|1;2| */
+srt_bool slz_enc_end(srt_string **out, srt_lz_enc *e);
+
+/*
+ * Decoding
+ */
+
+/* #API: |Allocate streaming LZ decoder|maximum window size accepted (log2, up to SLZ_WBITS_MAX; 0 for SLZ_WBITS_MAX), limiting the memory usage|decoder (NULL if not enough memory)|O(1)|1;2| */
+srt_lz_dec *slz_dec_alloc(unsigned wbits_max);
+
+/*
+#API: |Free one or more streaming LZ decoders|decoder; more decoders (optional)|-|O(1)|1;2|
+void slz_dec_free(srt_lz_dec **d, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define slz_dec_free(...) slz_dec_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define slz_dec_free(d) slz_dec_free_aux(d, S_INVALID_PTR_VARG_TAIL)
+#endif
+void slz_dec_free_aux(srt_lz_dec **d, ...);
+
+/* #API: |Decompress data, appending the decoded blocks to the output (incomplete blocks are buffered)|output string; decoder; input data (any size)|SLZ_MORE: more input required; SLZ_END: end of stream (input after it is ignored); SLZ_ERROR: invalid data, checksum error, or not enough memory (the decoder stays in error state)|O(n)|1;2| */
+int slz_dec_write(srt_string **out, srt_lz_dec *d, const srt_string *in);
+
+/*
+ * Block-parallel container
+ */
+
+/* #API: |Set container parameters for compression|container parameters; uncompressed size; block size (log2, from SLZ_PAR_BBITS_MIN to SLZ_PAR_BBITS_MAX; 0 for SLZ_PAR_BBITS_DEFAULT); dictionary size (log2, up to the block size; 0: independent blocks); S_TRUE: high compression (slower)|S_TRUE: OK, S_FALSE: invalid parameters|O(1)|1;2| */
+srt_bool slz_par_init(srt_lz_par *p, size_t ss, unsigned bbits, unsigned dbits,
+		      srt_bool lzh);
+
+/* #API: |Compress one block, appending it to the output (thread-safe for different output strings)|output string; container parameters; input data (all blocks); block number|compressed block size (0: error)|O(n)|1;2| */
+size_t slz_par_enc_blk(srt_string **out, const srt_lz_par *p,
+		       const srt_string *in, size_t i);
+
+/* #API: |Append container header, including the block index|output string; container parameters; compressed size of every block (p->nblk elements)|output string|O(n)|1;2| */
+srt_string *slz_par_cat_hdr(srt_string **out, const srt_lz_par *p,
+			    const size_t *blk_sizes);
+
+/* #API: |Compress data as container (single thread)|output string; input data; block size (log2; 0 for SLZ_PAR_BBITS_DEFAULT); dictionary size (log2; 0: independent blocks); S_TRUE: high compression|S_TRUE: OK, S_FALSE: invalid parameters or not enough memory|O(n)|1;2| */
+srt_bool slz_par_enc(srt_string **out, const srt_string *in, unsigned bbits,
+		     unsigned dbits, srt_bool lzh);
+
+/* #API: |Read container header, validating the block index|container parameters; container (must be kept while decoding blocks)|S_TRUE: OK, S_FALSE: invalid or incomplete container|O(n)|1;2| */
+srt_bool slz_par_open(srt_lz_par *p, const srt_string *c);
+
+/* #API: |Decode one block (thread-safe, not writing outside of the block)|container parameters (from slz_par_open()); block number; output (block size bytes, or less for the last block); bytes of the previous blocks already decoded before the output (containers with dictionary: at least the dictionary size)|decoded bytes (S_NPOS: error)|O(n)|1;2| */
+size_t slz_par_dec_blk(const srt_lz_par *p, size_t i, uint8_t *o, size_t hist);
+
+/* #API: |Decode container (single thread)|output string; container|S_TRUE: OK, S_FALSE: invalid data or not enough memory|O(n)|1;2| */
+srt_bool slz_par_dec(srt_string **out, const srt_string *c);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+#endif /* #ifndef SLZ_H */
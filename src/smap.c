@@ -43,6 +43,26 @@ static int cmp_s(const struct SMapS *a, const struct SMapS *b)
 		      sso_get((const srt_stringo *)&b->k));
 }
 
+/*
+ * Insert node for types having strings: it carries the map string heap (if
+ * any) with the new node data, so the rewrite callbacks can place the
+ * strings there
+ */
+struct SMapRW {
+	union {
+		struct SMapS s;
+		struct SMapSI si;
+		struct SMapSD sd;
+		struct SMapSP sp;
+		struct SMapSS ss;
+		struct SMapIS is;
+		struct SMapDS ds;
+	} n;
+	struct SSHeap *sh;
+};
+
+#define SM_RW_SH(new_data) (((const struct SMapRW *)(new_data))->sh)
+
 #define BUILD_SMAP_RW_INC(FN, T)                                               \
 	static void FN(srt_tnode *node, const srt_tnode *new_data,             \
 		       srt_bool existing)                                      \
@@ -66,9 +86,11 @@ static void rw_add_SM_S(srt_tnode *node, const srt_tnode *new_data,
 	struct SMapS *n = (struct SMapS *)node;
 	const struct SMapS *m = (const struct SMapS *)new_data;
 	if (!existing)
-		sso1_set(&n->k, sso_get((const srt_stringo *)&m->k));
+		sso1_set_h(&n->k, sso_get((const srt_stringo *)&m->k),
+			   SM_RW_SH(new_data));
 	else
-		sso1_update(&n->k, sso_get((const srt_stringo *)&m->k));
+		sso1_update_h(&n->k, sso_get((const srt_stringo *)&m->k),
+			      SM_RW_SH(new_data));
 }
 
 #define BUILD_SMAP_RW_ADD_SX(FN, T)                                            \
@@ -91,9 +113,11 @@ static void rw_add_SM_SS(srt_tnode *node, const srt_tnode *new_data,
 	struct SMapSS *n = (struct SMapSS *)node;
 	const struct SMapSS *m = (const struct SMapSS *)new_data;
 	if (!existing)
-		sso_set(&n->s, sso_get(&m->s), sso_get_s2(&m->s));
+		sso_set_h(&n->s, sso_get(&m->s), sso_get_s2(&m->s),
+			  SM_RW_SH(new_data));
 	else
-		sso_update(&n->s, sso_get(&m->s), sso_get_s2(&m->s));
+		sso_update_h(&n->s, sso_get(&m->s), sso_get_s2(&m->s),
+			     SM_RW_SH(new_data));
 }
 
 #define BUILD_SMAP_RW_ADD_XS(FN, T)                                            \
@@ -104,9 +128,11 @@ static void rw_add_SM_SS(srt_tnode *node, const srt_tnode *new_data,
 		const T *nd = (const T *)new_data;                             \
 		n->x.k = nd->x.k;                                              \
 		if (!existing)                                                 \
-			sso1_set(&n->v, sso1_get(&nd->v));                     \
+			sso1_set_h(&n->v, sso1_get(&nd->v),                    \
+				   SM_RW_SH(new_data));                        \
 		else                                                           \
-			sso1_update(&n->v, sso1_get(&nd->v));                  \
+			sso1_update_h(&n->v, sso1_get(&nd->v),                 \
+				      SM_RW_SH(new_data));                     \
 	}
 
 BUILD_SMAP_RW_ADD_XS(rw_add_SM_IS, struct SMapIS)
@@ -432,6 +458,18 @@ srt_map *sm_alloc0(enum eSM_Type0 t, size_t init_size)
 	return m;
 }
 
+srt_map *sm_alloc_sheap0(enum eSM_Type0 t, size_t init_size)
+{
+	srt_map *m = sm_alloc0(t, init_size);
+	if (m
+	    && (sm_chk_sx(m) || sm_chk_t(m, SM0_IS) || sm_chk_t(m, SM0_DS))) {
+		m->sh = sso_heap_alloc();
+		if (!m->sh) /* BEHAVIOR: allocation error */
+			sm_free(&m);
+	}
+	return m;
+}
+
 void sm_free_aux(srt_map **m, ...)
 {
 	va_list ap;
@@ -440,7 +478,10 @@ void sm_free_aux(srt_map **m, ...)
 	next = m;
 	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
 		if (next) {
-			sm_clear(*next); /* release associated dyn. memory */
+			if (*next && (*next)->sh) /* no per-node release */
+				sso_heap_free(&(*next)->sh);
+			else
+				sm_clear(*next); /* release assoc. dyn. mem. */
 			sd_free((srt_data **)next);
 		}
 		next = (srt_map **)va_arg(ap, srt_map **);
@@ -457,11 +498,17 @@ srt_map *sm_dup(const srt_map *src)
 void sm_clear(srt_map *m)
 {
 	int t;
-	if (!m || !m->d.size)
+	srt_tree_callback delete_callback;
+	if (!m)
+		return;
+	if (m->sh)
+		sso_heap_reset(m->sh);
+	if (!m->d.size)
 		return;
 	t = m->d.sub_type;
-	srt_tree_callback delete_callback =
-		t < SM0_NumTypes ? sm_ctx[t].delete_callback : NULL;
+	delete_callback = t < SM0_NumTypes && !m->sh
+				  ? sm_ctx[t].delete_callback
+				  : NULL;
 	if (delete_callback) { /* deletion of dynamic memory elems */
 		srt_tndx i = 0;
 		for (; i < (srt_tndx)m->d.size; i++) {
@@ -477,9 +524,55 @@ void sm_clear(srt_map *m)
  * Copy
  */
 
+/*
+ * Duplicate the strings of bulk-copied nodes (into the string heap, if any)
+ */
+static void sm_dupa(srt_map *m, struct SSHeap *h)
+{
+	srt_tndx i, ss = (srt_tndx)sm_size(m);
+	switch (m->d.sub_type) {
+	case SM0_IS:
+		for (i = 0; i < ss; i++)
+			sso_dupa1_h(&((struct SMapIS *)st_enum(m, i))->v, h);
+		break;
+	case SM0_DS:
+		for (i = 0; i < ss; i++)
+			sso_dupa1_h(&((struct SMapDS *)st_enum(m, i))->v, h);
+		break;
+	case SM0_S:
+	case SM0_SI:
+	case SM0_SD:
+	case SM0_SP:
+		for (i = 0; i < ss; i++)
+			sso_dupa1_h(&((struct SMapS *)st_enum(m, i))->k, h);
+		break;
+	case SM0_SS:
+		for (i = 0; i < ss; i++)
+			sso_dupa_h(&((struct SMapSS *)st_enum(m, i))->s, h);
+		break;
+	default:
+		/* no additional action required */
+		break;
+	}
+}
+
+srt_map *sm_shrink(srt_map **m)
+{
+	struct SSHeap *h;
+	if (m && *m && (*m)->sh) {
+		/* String heap compaction: copy the live strings only */
+		h = sso_heap_alloc();
+		if (h) {
+			sm_dupa(*m, h);
+			sso_heap_free(&(*m)->sh);
+			(*m)->sh = h;
+		}
+	}
+	return (srt_map *)sd_shrink((srt_data **)m, 0);
+}
+
 srt_map *sm_cpy(srt_map **m, const srt_map *src)
 {
-	srt_tndx i;
 	enum eSM_Type0 t;
 	size_t ss, src_buf_size;
 	RETURN_IF(!m || !src, NULL); /* BEHAVIOR */
@@ -503,7 +596,7 @@ srt_map *sm_cpy(srt_map **m, const srt_map *src)
 		}
 		sm_reserve(m, ss);
 	} else {
-		*m = sm_alloc0(t, ss);
+		*m = src->sh ? sm_alloc_sheap0(t, ss) : sm_alloc0(t, ss);
 		RETURN_IF(!*m, NULL); /* BEHAVIOR: allocation error */
 	}
 	RETURN_IF(sm_max_size(*m) < ss, *m); /* BEHAVIOR: not enough space */
@@ -517,46 +610,7 @@ srt_map *sm_cpy(srt_map **m, const srt_map *src)
 	/*
 	 * Copy elements using external dynamic memory (string data)
 	 */
-	switch (t) {
-	case SM0_IS:
-		for (i = 0; i < ss; i++) {
-			const struct SMapIS *ms =
-				(const struct SMapIS *)st_enum_r(src, i);
-			struct SMapIS *mt = (struct SMapIS *)st_enum(*m, i);
-			sso1_set(&mt->v, sso1_get(&ms->v));
-		}
-		break;
-	case SM0_DS:
-		for (i = 0; i < ss; i++) {
-			const struct SMapDS *ms =
-				(const struct SMapDS *)st_enum_r(src, i);
-			struct SMapDS *mt = (struct SMapDS *)st_enum(*m, i);
-			sso1_set(&mt->v, sso1_get(&ms->v));
-		}
-		break;
-	case SM0_S:
-	case SM0_SI:
-	case SM0_SD:
-	case SM0_SP:
-		for (i = 0; i < ss; i++) {
-			const struct SMapS *ms =
-				(const struct SMapS *)st_enum_r(src, i);
-			struct SMapS *mt = (struct SMapS *)st_enum(*m, i);
-			sso1_set(&mt->k, sso1_get(&ms->k));
-		}
-		break;
-	case SM0_SS:
-		for (i = 0; i < ss; i++) {
-			const struct SMapSS *ms =
-				(const struct SMapSS *)st_enum_r(src, i);
-			struct SMapSS *mt = (struct SMapSS *)st_enum(*m, i);
-			sso_set(&mt->s, sso_get(&ms->s), sso_get_s2(&ms->s));
-		}
-		break;
-	default:
-		/* no additional action required */
-		break;
-	}
+	sm_dupa(*m, (*m)->sh);
 	return *m;
 }
 
@@ -755,20 +809,22 @@ srt_bool sm_inc_dd(srt_map **m, double k, double v)
 
 srt_bool sm_insert_is(srt_map **m, int64_t k, const srt_string *v)
 {
-	struct SMapIS n;
+	struct SMapRW n;
 	RETURN_IF(!m || !sm_chk_t(*m, SM0_IS), S_FALSE);
-	n.x.k = k;
-	sso1_setref(&n.v, v);
+	n.n.is.x.k = k;
+	sso1_setref(&n.n.is.v, v);
+	n.sh = (*m)->sh;
 	return st_insert_rw((srt_tree **)m, (const srt_tnode *)&n,
 			    rw_add_SM_IS);
 }
 
 srt_bool sm_insert_ds(srt_map **m, double k, const srt_string *v)
 {
-	struct SMapDS n;
+	struct SMapRW n;
 	RETURN_IF(!m || !sm_chk_t(*m, SM0_DS), S_FALSE);
-	n.x.k = k;
-	sso1_setref(&n.v, v);
+	n.n.ds.x.k = k;
+	sso1_setref(&n.n.ds.v, v);
+	n.sh = (*m)->sh;
 	return st_insert_rw((srt_tree **)m, (const srt_tnode *)&n,
 			    rw_add_SM_DS);
 }
@@ -795,10 +851,11 @@ S_INLINE srt_bool sm_insert_si_aux(srt_map **m, const srt_string *k, int64_t v,
 				   srt_tree_rewrite rw_f)
 {
 	srt_bool r;
-	struct SMapSI n;
+	struct SMapRW n;
 	RETURN_IF(!m || !sm_chk_t(*m, SM0_SI), S_FALSE);
-	sso1_setref(&n.x.k, k);
-	n.v = v;
+	sso1_setref(&n.n.si.x.k, k);
+	n.n.si.v = v;
+	n.sh = (*m)->sh;
 	r = st_insert_rw((srt_tree **)m, (const srt_tnode *)&n, rw_f);
 	return r;
 }
@@ -817,10 +874,11 @@ S_INLINE srt_bool sm_insert_sd_aux(srt_map **m, const srt_string *k, double v,
 				   srt_tree_rewrite rw_f)
 {
 	srt_bool r;
-	struct SMapSD n;
+	struct SMapRW n;
 	RETURN_IF(!m || !sm_chk_t(*m, SM0_SD), S_FALSE);
-	sso1_setref(&n.x.k, k);
-	n.v = v;
+	sso1_setref(&n.n.sd.x.k, k);
+	n.n.sd.v = v;
+	n.sh = (*m)->sh;
 	r = st_insert_rw((srt_tree **)m, (const srt_tnode *)&n, rw_f);
 	return r;
 }
@@ -837,19 +895,21 @@ srt_bool sm_inc_sd(srt_map **m, const srt_string *k, double v)
 
 srt_bool sm_insert_ss(srt_map **m, const srt_string *k, const srt_string *v)
 {
-	struct SMapSS n;
+	struct SMapRW n;
 	RETURN_IF(!m || !sm_chk_t(*m, SM0_SS), S_FALSE);
-	sso_setref(&n.s, k, v);
+	sso_setref(&n.n.ss.s, k, v);
+	n.sh = (*m)->sh;
 	return st_insert_rw((srt_tree **)m, (const srt_tnode *)&n,
 			    rw_add_SM_SS);
 }
 
 srt_bool sm_insert_sp(srt_map **m, const srt_string *k, const void *v)
 {
-	struct SMapSP n;
+	struct SMapRW n;
 	RETURN_IF(!m || !sm_chk_t(*m, SM0_SP), S_FALSE);
-	sso1_setref(&n.x.k, k);
-	n.v = v;
+	sso1_setref(&n.n.sp.x.k, k);
+	n.n.sp.v = v;
+	n.sh = (*m)->sh;
 	return st_insert_rw((srt_tree **)m, (const srt_tnode *)&n,
 			    rw_add_SM_SP);
 }
@@ -880,7 +940,7 @@ srt_bool sm_delete_i(srt_map *m, int64_t k)
 	RETURN_IF(!sm_chk_ix(m), S_FALSE);
 	n.k = k;
 	return st_delete(m, (const srt_tnode *)&n,
-			 sm_chk_t(m, SM0_IS) ? aux_is_delete : NULL);
+			 sm_chk_t(m, SM0_IS) && !m->sh ? aux_is_delete : NULL);
 }
 
 srt_bool sm_delete_f(srt_map *m, float k)
@@ -897,7 +957,7 @@ srt_bool sm_delete_d(srt_map *m, double k)
 	RETURN_IF(!sm_chk_dx(m), S_FALSE);
 	n.k = k;
 	return st_delete(m, (const srt_tnode *)&n,
-			 sm_chk_t(m, SM0_DS) ? aux_ds_delete : NULL);
+			 sm_chk_t(m, SM0_DS) && !m->sh ? aux_ds_delete : NULL);
 }
 
 srt_bool sm_delete_s(srt_map *m, const srt_string *k)
@@ -912,6 +972,8 @@ srt_bool sm_delete_s(srt_map *m, const srt_string *k)
 		callback = aux_sx_delete;
 	else
 		return S_FALSE;
+	if (m->sh) /* string heap: reclaimed on shrink/dup */
+		callback = NULL;
 	return st_delete(m, (const srt_tnode *)&sx, callback);
 }
 
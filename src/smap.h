@@ -271,6 +271,15 @@ S_INLINE srt_map *sm_alloc(enum eSM_Type t, size_t initial_num_elems_reserve)
 	return sm_alloc0((enum eSM_Type0)t, initial_num_elems_reserve);
 }
 
+srt_map *sm_alloc_sheap0(enum eSM_Type0 t, size_t initial_num_elems_reserve);
+
+/* #API: |Allocate map (heap) with embedded string heap: strings not fitting in the node are appended to a per-map arena instead of being allocated one by one, so inserts avoid malloc and sm_clear()/sm_free() release all of them at once; deleted or overwritten strings are reclaimed by sm_shrink() and sm_dup()/sm_cpy() (compaction). For map types without strings it is the same as sm_alloc()|map type; initial reserve|map|O(1)|1;2| */
+S_INLINE srt_map *sm_alloc_sheap(enum eSM_Type t,
+				 size_t initial_num_elems_reserve)
+{
+	return sm_alloc_sheap0((enum eSM_Type0)t, initial_num_elems_reserve);
+}
+
 /* #NOTAPI: |Get map node size from map type|map type|bytes required for storing a single node|O(1)|1;2| */
 S_INLINE uint8_t sm_elem_size(int t)
 {
@@ -322,11 +331,11 @@ S_INLINE uint8_t sm_elem_size(int t)
 /* #API: |Duplicate map|input map|output map|O(n)|1;2| */
 srt_map *sm_dup(const srt_map *src);
 
-/* #API: |Reset/clean map (keeping map type)|map|-|O(1) for simple maps, O(n) for maps having nodes with strings|1;2| */
+/* #API: |Reset/clean map (keeping map type)|map|-|O(1) for simple maps and maps with string heap, O(n) for maps having nodes with strings|1;2| */
 void sm_clear(srt_map *m);
 
 /*
-#API: |Free one or more maps (heap)|map; more maps (optional)|-|O(1) for simple maps, O(n) for maps having nodes with strings|1;2|
+#API: |Free one or more maps (heap)|map; more maps (optional)|-|O(1) for simple maps and maps with string heap, O(n) for maps having nodes with strings|1;2|
 void sm_free(srt_map **m, ...)
 */
 #ifdef S_USE_VA_ARGS
@@ -336,7 +345,10 @@ void sm_free(srt_map **m, ...)
 #endif
 void sm_free_aux(srt_map **m, ...);
 
-SD_BUILDFUNCS_FULL_ST(sm, srt_map, 0)
+SD_BUILDFUNCS_FULL_ST0(sm, srt_map, 0)
+
+/* #API: |Make the map use the minimum possible memory (maps with string heap are compacted, too)|map|map reference (optional usage)|O(1) for allocators using memory remap; O(n) for naive allocators and maps with string heap|1;2| */
+srt_map *sm_shrink(srt_map **m);
 
 /*
 #API: |Ensure space for extra elements|map;number of extra elements|extra size allocated|O(1)|1;2|
@@ -345,9 +357,6 @@ size_t sm_grow(srt_map **m, size_t extra_elems)
 #API: |Ensure space for elements|map;absolute element reserve|reserved elements|O(1)|1;2|
 size_t sm_reserve(srt_map **m, size_t max_elems)
 
-#API: |Make the map use the minimum possible memory|map|map reference (optional usage)|O(1) for allocators using memory remap; O(n) for naive allocators|1;2|
-srt_map *sm_shrink(srt_map **m);
-
 #API: |Get map size|map|Map number of elements|O(1)|1;2|
 size_t sm_size(const srt_map *m);
 
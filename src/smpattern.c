@@ -0,0 +1,374 @@
+/*
+ * smpattern.c
+ *
+ * Multi-pattern string search (Aho-Corasick automaton).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "smpattern.h"
+#include "saux/scommon.h"
+#include "saux/ssearch.h"
+
+/*
+ * Internal constants
+ */
+
+#define SMP_NONE 0xffffffff
+#define SMP_MAX_STATES 0x7ffffff0
+#define SMP_OUTF 0x80000000 /* dense: target state has output */
+#define SMP_DENSE_MAX_CELLS (1 << 20) /* 4 MB transition table */
+#define SMP_ALIGN_UP(x) (((x) + 7) & ~(size_t)7)
+#define SMP_HDR_SIZE SMP_ALIGN_UP(sizeof(srt_mpattern))
+#define SMP_FOLD(c) ((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 'a' : (c))
+
+/*
+ * Trie, before being converted into the automaton
+ */
+
+struct SMPBuild {
+	size_t nn;
+	uint32_t *child, *sib, *cls, *queue, *out, *dict, *fail, *pnext;
+};
+
+static uint32_t smp_build_child(const struct SMPBuild *b, uint32_t u,
+				uint32_t c)
+{
+	uint32_t v = b->child[u];
+	for (; v != SMP_NONE; v = b->sib[v])
+		if (b->cls[v] == c)
+			return v;
+	return SMP_NONE;
+}
+
+static void smp_build_insert(struct SMPBuild *b, const srt_mpattern *mp,
+			     uint32_t id, const uint8_t *p, size_t ps)
+{
+	size_t i;
+	uint32_t u = 0, v, c;
+	for (i = 0; i < ps; i++, u = v) {
+		c = mp->cls[p[i]];
+		v = smp_build_child(b, u, c);
+		if (v != SMP_NONE)
+			continue;
+		v = (uint32_t)b->nn++;
+		b->cls[v] = c;
+		b->child[v] = b->out[v] = SMP_NONE;
+		b->sib[v] = b->child[u];
+		b->child[u] = v;
+	}
+	b->pnext[id] = b->out[u];
+	b->out[u] = id;
+}
+
+/* Failure and output (dictionary suffix) links, in breadth-first order */
+static void smp_build_links(struct SMPBuild *b)
+{
+	size_t head = 0, tail = 1;
+	uint32_t u, v, f, w;
+	b->queue[0] = 0;
+	b->fail[0] = 0;
+	b->dict[0] = SMP_NONE;
+	while (head < tail) {
+		u = b->queue[head++];
+		for (v = b->child[u]; v != SMP_NONE; v = b->sib[v]) {
+			f = 0;
+			if (u)
+				for (f = b->fail[u];; f = b->fail[f]) {
+					w = smp_build_child(b, f, b->cls[v]);
+					if (w != SMP_NONE) {
+						f = w;
+						break;
+					}
+					if (!f)
+						break;
+				}
+			b->fail[v] = f;
+			b->dict[v] = b->out[f] != SMP_NONE ? f : b->dict[f];
+			b->queue[tail++] = v;
+		}
+	}
+}
+
+/*
+ * Dense transitions point to the target row offset (state * nc), tagged
+ * with SMP_OUTF when the target state has output, so the search loop
+ * needs just one table lookup per input byte.
+ */
+static void smp_build_dense(srt_mpattern *mp, const struct SMPBuild *b)
+{
+	size_t i, c, nc = mp->nc;
+	uint32_t u, v, *row;
+	for (i = 0; i < mp->nn; i++) {
+		u = b->queue[i];
+		row = mp->next + u * nc;
+		if (u)
+			memcpy(row, mp->next + b->fail[u] * nc,
+			       nc * sizeof(uint32_t));
+		else
+			for (c = 0; c < nc; c++)
+				row[c] = 0;
+		for (v = b->child[u]; v != SMP_NONE; v = b->sib[v])
+			row[b->cls[v]] =
+				(uint32_t)(v * nc)
+				| (b->out[v] != SMP_NONE
+						   || b->dict[v] != SMP_NONE
+					   ? SMP_OUTF
+					   : 0);
+	}
+}
+
+static void smp_build_compressed(srt_mpattern *mp, const struct SMPBuild *b)
+{
+	size_t c, u, k = 0;
+	uint32_t v;
+	for (c = 0; c < mp->nc; c++)
+		mp->next[c] = 0;
+	for (u = 0; u < mp->nn; u++) {
+		mp->eoff[u] = (uint32_t)k;
+		mp->fail[u] = b->fail[u];
+		for (v = b->child[u]; v != SMP_NONE; v = b->sib[v], k++) {
+			mp->enode[k] = v;
+			mp->ecls[k] = (uint16_t)b->cls[v];
+			if (!u)
+				mp->next[b->cls[v]] = v;
+		}
+	}
+	mp->eoff[mp->nn] = (uint32_t)k;
+}
+
+/* Bytes able to start a match, if few, for the search prefilter */
+static void smp_build_first(srt_mpattern *mp)
+{
+	size_t i;
+	mp->nfirst = 0;
+	for (i = 0; i < 256; i++)
+		if (mp->cls[i] && mp->next[mp->cls[i]]) {
+			if (mp->nfirst < sizeof(mp->first))
+				mp->first[mp->nfirst] = (uint8_t)i;
+			mp->nfirst++;
+		}
+}
+
+static void smp_build_classes(srt_mpattern *mp,
+			      const srt_string *const *patterns, size_t np)
+{
+	size_t i, j, ps;
+	const uint8_t *p;
+	uint16_t used[256];
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < np; i++) {
+		p = (const uint8_t *)ss_get_buffer_r(patterns[i]);
+		ps = ss_size(patterns[i]);
+		for (j = 0; j < ps; j++)
+			used[mp->icase ? SMP_FOLD(p[j]) : p[j]] = 1;
+	}
+	mp->nc = 1; /* class 0: bytes not used by any pattern */
+	for (i = 0; i < 256; i++)
+		if (used[i])
+			used[i] = (uint16_t)mp->nc++;
+	for (i = 0; i < 256; i++)
+		mp->cls[i] = used[mp->icase ? SMP_FOLD(i) : i];
+}
+
+srt_mpattern *ss_mpattern_build(const srt_string *const *patterns, size_t np,
+				int flags)
+{
+	size_t i, total = 0, maxn, as;
+	srt_mpattern tmp, *mp;
+	struct SMPBuild b;
+	uint32_t *bbuf;
+	uint8_t *p;
+	RETURN_IF(np && !patterns, NULL);
+	RETURN_IF(np > SMP_MAX_STATES || np > S_SIZET_MAX / 64, NULL);
+	for (i = 0; i < np; i++) {
+		total += ss_size(patterns[i]);
+		RETURN_IF(total > SMP_MAX_STATES - 1 || total > S_SIZET_MAX / 64,
+			  NULL);
+	}
+	memset(&tmp, 0, sizeof(tmp));
+	tmp.np = np;
+	tmp.icase = (flags & SMP_ICASE) ? S_TRUE : S_FALSE;
+	smp_build_classes(&tmp, patterns, np);
+	/* Trie */
+	maxn = total + 1;
+	bbuf = (uint32_t *)s_malloc(sizeof(uint32_t) * (maxn * 7 + np + 1));
+	RETURN_IF(!bbuf, NULL);
+	b.nn = 1;
+	b.child = bbuf;
+	b.sib = b.child + maxn;
+	b.cls = b.sib + maxn;
+	b.queue = b.cls + maxn;
+	b.out = b.queue + maxn;
+	b.dict = b.out + maxn;
+	b.fail = b.dict + maxn;
+	b.pnext = b.fail + maxn;
+	b.child[0] = b.out[0] = SMP_NONE;
+	for (i = 0; i < np; i++)
+		if (ss_size(patterns[i]) > 0)
+			smp_build_insert(
+				&b, &tmp, (uint32_t)i,
+				(const uint8_t *)ss_get_buffer_r(patterns[i]),
+				ss_size(patterns[i]));
+		else
+			b.pnext[i] = SMP_NONE;
+	smp_build_links(&b);
+	tmp.nn = b.nn;
+	tmp.dense = tmp.nn <= SMP_DENSE_MAX_CELLS / tmp.nc ? S_TRUE : S_FALSE;
+	/* Automaton, using one allocation */
+	as = SMP_HDR_SIZE + np * sizeof(size_t)
+	     + (tmp.nn * 2 + np) * sizeof(uint32_t);
+	if (tmp.dense)
+		as += tmp.nn * tmp.nc * sizeof(uint32_t);
+	else
+		as += (tmp.nc + tmp.nn * 3 + 1) * sizeof(uint32_t)
+		      + tmp.nn * sizeof(uint16_t);
+	mp = (srt_mpattern *)s_malloc(as);
+	if (!mp) {
+		s_free(bbuf);
+		return NULL;
+	}
+	*mp = tmp;
+	mp->alloc_size = as;
+	p = (uint8_t *)mp + SMP_HDR_SIZE;
+	mp->plen = (size_t *)p;
+	mp->out = (uint32_t *)(mp->plen + np);
+	mp->dict = mp->out + mp->nn;
+	mp->pnext = mp->dict + mp->nn;
+	mp->next = mp->pnext + np;
+	for (i = 0; i < np; i++)
+		mp->plen[i] = ss_size(patterns[i]);
+	memcpy(mp->out, b.out, mp->nn * sizeof(uint32_t));
+	memcpy(mp->dict, b.dict, mp->nn * sizeof(uint32_t));
+	memcpy(mp->pnext, b.pnext, np * sizeof(uint32_t));
+	if (mp->dense) {
+		smp_build_dense(mp, &b);
+	} else {
+		mp->fail = mp->next + mp->nc;
+		mp->eoff = mp->fail + mp->nn;
+		mp->enode = mp->eoff + mp->nn + 1;
+		mp->ecls = (uint16_t *)(mp->enode + mp->nn);
+		smp_build_compressed(mp, &b);
+	}
+	smp_build_first(mp);
+	s_free(bbuf);
+	return mp;
+}
+
+void ss_mpattern_free_aux(srt_mpattern **mp, ...)
+{
+	va_list ap;
+	srt_mpattern **next;
+	va_start(ap, mp);
+	next = mp;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next) {
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_mpattern **)va_arg(ap, srt_mpattern **);
+	}
+	va_end(ap);
+}
+
+/*
+ * Search
+ */
+
+static uint32_t smp_next_compressed(const srt_mpattern *mp, uint32_t u,
+				    uint16_t c)
+{
+	uint32_t k, ke;
+	for (; u; u = mp->fail[u])
+		for (k = mp->eoff[u], ke = mp->eoff[u + 1]; k < ke; k++)
+			if (mp->ecls[k] == c)
+				return mp->enode[k];
+	return mp->next[c]; /* root state */
+}
+
+static srt_bool smp_report(const srt_mpattern *mp, uint32_t u, size_t end,
+			   srt_mpattern_f f, void *context, size_t *cnt)
+{
+	uint32_t id, v = mp->out[u] != SMP_NONE ? u : mp->dict[u];
+	for (; v != SMP_NONE; v = mp->dict[v])
+		for (id = mp->out[v]; id != SMP_NONE; id = mp->pnext[id]) {
+			(*cnt)++;
+			if (f && !f(id, end - mp->plen[id], context))
+				return S_FALSE;
+		}
+	return S_TRUE;
+}
+
+/*
+ * Run the automaton over a buffer. Match offsets are relative to 'base'.
+ * Returns the number of matches, and the bytes processed in 'done' (less
+ * than 'n' if stopped by the callback).
+ */
+static size_t smp_run(const srt_mpattern *mp, size_t *node, const uint8_t *b,
+		      size_t n, size_t base, srt_mpattern_f f, void *context,
+		      size_t *done)
+{
+	size_t i, cnt = 0;
+	uint32_t u = (uint32_t)*node;
+	const uint16_t *cls = mp->cls;
+	const uint32_t *next = mp->next;
+	srt_bool prefilter =
+		mp->nfirst <= sizeof(mp->first) ? S_TRUE : S_FALSE;
+	for (i = 0; i < n; i++) {
+		if (!u && prefilter) {
+			i = ss_find_anyof((const char *)b, i, n, mp->first,
+					  mp->nfirst);
+			if (i == S_NPOS) {
+				i = n;
+				break;
+			}
+		}
+		if (mp->dense) {
+			u = next[(u & ~SMP_OUTF) + cls[b[i]]];
+			if (!(u & SMP_OUTF))
+				continue;
+			if (!smp_report(mp, (uint32_t)((u & ~SMP_OUTF) / mp->nc),
+					base + i + 1, f, context, &cnt)) {
+				i++;
+				break;
+			}
+		} else {
+			u = smp_next_compressed(mp, u, cls[b[i]]);
+			if (mp->out[u] == SMP_NONE && mp->dict[u] == SMP_NONE)
+				continue;
+			if (!smp_report(mp, u, base + i + 1, f, context,
+					&cnt)) {
+				i++;
+				break;
+			}
+		}
+	}
+	*node = u;
+	*done = i;
+	return cnt;
+}
+
+size_t ss_mpattern_find(const srt_mpattern *mp, const srt_string *s,
+			size_t off, srt_mpattern_f f, void *context)
+{
+	size_t ss, node = 0, done;
+	RETURN_IF(!mp || !s, 0);
+	ss = ss_size(s);
+	RETURN_IF(off >= ss, 0);
+	return smp_run(mp, &node,
+		       (const uint8_t *)ss_get_buffer_r(s) + off, ss - off,
+		       off, f, context, &done);
+}
+
+size_t ss_mpattern_feed(const srt_mpattern *mp, srt_mpattern_state *st,
+			const srt_string *chunk, srt_mpattern_f f,
+			void *context)
+{
+	size_t cnt, done;
+	RETURN_IF(!mp || !st || !chunk, 0);
+	cnt = smp_run(mp, &st->node, (const uint8_t *)ss_get_buffer_r(chunk),
+		      ss_size(chunk), st->off, f, context, &done);
+	st->off += done;
+	return cnt;
+}
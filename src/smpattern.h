@@ -0,0 +1,145 @@
+#ifndef SMPATTERN_H
+#define SMPATTERN_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * smpattern.h
+ *
+ * #SHORTDOC multi-pattern string search (Aho-Corasick automaton)
+ *
+ * #DOC Multi-pattern search functions locate every occurrence of a set of
+ * #DOC patterns in one pass over the input string, instead of calling
+ * #DOC ss_find() once per pattern (O(n) instead of O(n * patterns)).
+ * #DOC
+ * #DOC The pattern set is compiled once into a reusable Aho-Corasick
+ * #DOC automaton, with the input bytes mapped into equivalence classes
+ * #DOC (bytes not used by any pattern share the same class). When the
+ * #DOC number of states times the number of classes is small enough, the
+ * #DOC automaton is expanded into a dense transition table (one table
+ * #DOC lookup per input byte); otherwise, a compressed table (goto edges
+ * #DOC plus failure links) is used, taking memory proportional to the
+ * #DOC total pattern size.
+ * #DOC
+ * #DOC When the set of bytes starting a pattern is small (up to 8 bytes),
+ * #DOC the input not able to start a match is skipped with a vectorized
+ * #DOC prefilter (SSE2 when available), so e.g. searching a few keywords
+ * #DOC runs at memchr()-like speed over non-matching data.
+ * #DOC
+ * #DOC Case-insensitive mode (SMP_ICASE) folds ASCII letters. It has no
+ * #DOC search time cost, as both cases are mapped to the same byte class.
+ * #DOC
+ * #DOC Streaming: the automaton state can be carried across chunks (e.g.
+ * #DOC read with ss_read()), so matches spanning chunk boundaries are found
+ * #DOC too, and reported with their offset from the start of the stream.
+ * #DOC
+ * #DOC Match callback:
+ * #DOC
+ * #DOC	typedef srt_bool (*srt_mpattern_f)(size_t pattern_id, size_t off, void *context);
+ * #DOC
+ * #DOC Where pattern_id is the index in the pattern array passed to
+ * #DOC ss_mpattern_build(), and off the match start offset. Returning
+ * #DOC S_FALSE stops the search.
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sstring.h"
+
+/*
+ * Structures
+ */
+
+enum eSMP_Flags { SMP_ICASE = 1 };
+
+struct SMPattern {
+	size_t np;	 /* number of patterns */
+	size_t nn;	 /* number of automaton states */
+	size_t nc;	 /* number of byte classes */
+	size_t nfirst;	 /* number of bytes starting a pattern */
+	srt_bool dense;	 /* dense (DFA) transition table */
+	srt_bool icase;	 /* case-insensitive (ASCII) */
+	uint16_t cls[256]; /* byte to class */
+	uint8_t first[8];  /* bytes starting a pattern (prefilter) */
+	uint32_t *next;	 /* dense: nn * nc transitions; compressed: root */
+	uint32_t *eoff;	 /* compressed: nn + 1 edge offsets */
+	uint32_t *enode; /* compressed: edge target */
+	uint16_t *ecls;	 /* compressed: edge class */
+	uint32_t *fail;	 /* compressed: failure link */
+	uint32_t *out;	 /* first pattern ending at the state */
+	uint32_t *dict;	 /* next state with output in the suffix chain */
+	uint32_t *pnext; /* next pattern ending at the same state */
+	size_t *plen;	 /* pattern length */
+	size_t alloc_size;
+};
+
+typedef struct SMPattern srt_mpattern; /* Opaque structure */
+
+struct SMPatternState {
+	size_t node; /* automaton state (internal) */
+	size_t off;  /* stream offset */
+};
+
+typedef struct SMPatternState srt_mpattern_state;
+
+typedef srt_bool (*srt_mpattern_f)(size_t pattern_id, size_t off,
+				   void *context);
+
+/*
+ * Allocation
+ */
+
+/* #API: |Build multi-pattern search automaton|pattern array (NULL and empty patterns are allowed, never matching); number of patterns; flags (0 or SMP_ICASE)|automaton (NULL if not enough memory)|O(m), m = total pattern size|1;2| */
+srt_mpattern *ss_mpattern_build(const srt_string *const *patterns, size_t np,
+				int flags);
+
+/*
+#API: |Free one or more multi-pattern search automatons|automaton; more automatons (optional)|-|O(1)|1;2|
+void ss_mpattern_free(srt_mpattern **mp, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define ss_mpattern_free(...)                                                  \
+	ss_mpattern_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define ss_mpattern_free(mp) ss_mpattern_free_aux(mp, S_INVALID_PTR_VARG_TAIL)
+#endif
+void ss_mpattern_free_aux(srt_mpattern **mp, ...);
+
+/* #API: |Get number of patterns|automaton|number of patterns|O(1)|1;2| */
+S_INLINE size_t ss_mpattern_size(const srt_mpattern *mp)
+{
+	return mp ? mp->np : 0;
+}
+
+/* #API: |Get automaton memory usage|automaton|bytes allocated|O(1)|1;2| */
+S_INLINE size_t ss_mpattern_alloc_size(const srt_mpattern *mp)
+{
+	return mp ? mp->alloc_size : 0;
+}
+
+/*
+ * Search
+ */
+
+/* #API: |Find all pattern occurrences|automaton; string; start offset; match callback (NULL for just counting); callback context|Number of matches reported|O(n + matches)|1;2| */
+size_t ss_mpattern_find(const srt_mpattern *mp, const srt_string *s,
+			size_t off, srt_mpattern_f f, void *context);
+
+/* #API: |Initialize streaming search state|state|-|O(1)|1;2| */
+S_INLINE void ss_mpattern_state_init(srt_mpattern_state *st)
+{
+	if (st)
+		st->node = st->off = 0;
+}
+
+/* #API: |Streaming search: process next chunk, with matches reported with their stream offset (matches can span chunks)|automaton; state (initialized with ss_mpattern_state_init()); chunk; match callback (NULL for just counting); callback context|Number of matches reported|O(n + matches)|1;2| */
+size_t ss_mpattern_feed(const srt_mpattern *mp, srt_mpattern_state *st,
+			const srt_string *chunk, srt_mpattern_f f,
+			void *context);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+#endif /* #ifndef SMPATTERN_H */
@@ -0,0 +1,988 @@
+/*
+ * spmap.c
+ *
+ * Persistent map handling.
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "spmap.h"
+#include "saux/scommon.h"
+
+/*
+ * Internal constants
+ */
+
+#define SPM_BLOCK_BITS 7
+#define SPM_BLOCK_ELEMS ((srt_tndx)1 << SPM_BLOCK_BITS)
+#define SPM_BLOCK_MASK (SPM_BLOCK_ELEMS - 1)
+#define SPM_DIR_MIN 8
+#define SPM_STACK_MAX 130 /* 2 * (log2(ST_NIL) + 1), plus margin */
+
+/*
+ * Upper bound of the nodes allocated by one insert or delete: every level
+ * of the path can copy the path node, plus the ones touched by rotations
+ * and color flips (left-leaning RB tree height <= 2 * log2(n + 1))
+ */
+#define SPM_OP_NODES(n) (10 * (2 * (slog2((n) + 1) + 1) + 2))
+
+/*
+ * Node blocks: SPM_BLOCK_ELEMS nodes, followed by their reference counters.
+ * Blocks are never moved, so readers can keep using them while the writer
+ * adds more. When the directory is grown, the previous one is kept (with
+ * the same block pointers) for the snapshots using it.
+ */
+struct SPMapDir {
+	struct SPMapDir *prev; /* replaced directory */
+	size_t max_blocks;
+	uint8_t *b[1];
+};
+
+struct SPMapPool {
+	struct SPMapDir *d; /* current directory */
+	size_t nblocks;
+	srt_tndx next;	    /* first never used node */
+	srt_tndx free_list; /* recycled nodes, linked through 'r' */
+	size_t nfree;
+	srt_pmap *snaps; /* snapshots, both live and released */
+	long refs;	 /* map + live snapshots (atomic) */
+	uint8_t type, elem_size;
+};
+
+struct SPMapCtx {
+	srt_cmp cmpf;
+	srt_tree_rewrite setf;		    /* NULL: raw copy */
+	srt_tree_callback dupf, freef; /* node dynamic memory (strings) */
+};
+
+/*
+ * Internal functions
+ */
+
+#define BUILD_SPMAP_CMP(FN, T)                                                 \
+	static int FN(const T *a, const T *b)                                  \
+	{                                                                      \
+		return a->k > b->k ? 1 : a->k < b->k ? -1 : 0;                 \
+	}
+
+BUILD_SPMAP_CMP(cmp_i, struct SMapi)
+BUILD_SPMAP_CMP(cmp_u, struct SMapu)
+BUILD_SPMAP_CMP(cmp_I, struct SMapI)
+BUILD_SPMAP_CMP(cmp_F, struct SMapF)
+BUILD_SPMAP_CMP(cmp_D, struct SMapD)
+
+static int cmp_s(const struct SMapS *a, const struct SMapS *b)
+{
+	return ss_cmp(sso_get((const srt_stringo *)&a->k),
+		      sso_get((const srt_stringo *)&b->k));
+}
+
+#define BUILD_SPMAP_SET_SX(FN, T)                                              \
+	static void FN(srt_tnode *node, const srt_tnode *new_data,             \
+		       srt_bool existing)                                      \
+	{                                                                      \
+		T *n = (T *)node;                                              \
+		const T *nd = (const T *)new_data;                             \
+		if (!existing)                                                 \
+			sso1_set(&n->x.k, sso1_get(&nd->x.k));                 \
+		n->v = nd->v;                                                  \
+	}
+
+BUILD_SPMAP_SET_SX(set_SM_SI, struct SMapSI)
+BUILD_SPMAP_SET_SX(set_SM_SD, struct SMapSD)
+BUILD_SPMAP_SET_SX(set_SM_SP, struct SMapSP)
+
+#define BUILD_SPMAP_SET_XS(FN, T)                                              \
+	static void FN(srt_tnode *node, const srt_tnode *new_data,             \
+		       srt_bool existing)                                      \
+	{                                                                      \
+		T *n = (T *)node;                                              \
+		const T *nd = (const T *)new_data;                             \
+		n->x.k = nd->x.k;                                              \
+		if (!existing)                                                 \
+			sso1_set(&n->v, sso1_get(&nd->v));                     \
+		else                                                           \
+			sso1_update(&n->v, sso1_get(&nd->v));                  \
+	}
+
+BUILD_SPMAP_SET_XS(set_SM_IS, struct SMapIS)
+BUILD_SPMAP_SET_XS(set_SM_DS, struct SMapDS)
+
+static void set_SM_SS(srt_tnode *node, const srt_tnode *new_data,
+		      srt_bool existing)
+{
+	struct SMapSS *n = (struct SMapSS *)node;
+	const struct SMapSS *nd = (const struct SMapSS *)new_data;
+	if (!existing)
+		sso_set(&n->s, sso_get(&nd->s), sso_get_s2(&nd->s));
+	else
+		sso_update(&n->s, sso_get(&nd->s), sso_get_s2(&nd->s));
+}
+
+static void dup_xs(void *node)
+{
+	sso_dupa1(&((struct SMapIS *)node)->v);
+}
+
+static void dup_dx(void *node)
+{
+	sso_dupa1(&((struct SMapDS *)node)->v);
+}
+
+static void dup_sx(void *node)
+{
+	sso_dupa1(&((struct SMapS *)node)->k);
+}
+
+static void dup_ss(void *node)
+{
+	sso_dupa(&((struct SMapSS *)node)->s);
+}
+
+static void free_xs(void *node)
+{
+	sso1_free(&((struct SMapIS *)node)->v);
+}
+
+static void free_dx(void *node)
+{
+	sso1_free(&((struct SMapDS *)node)->v);
+}
+
+static void free_sx(void *node)
+{
+	sso1_free(&((struct SMapS *)node)->k);
+}
+
+static void free_ss(void *node)
+{
+	sso_free(&((struct SMapSS *)node)->s);
+}
+
+/* set types are not supported (NULL compare function) */
+static const struct SPMapCtx spm_ctx[SM0_NumTypes] = {
+	{(srt_cmp)cmp_i, NULL, NULL, NULL},		     /*SM0_II32*/
+	{(srt_cmp)cmp_u, NULL, NULL, NULL},		     /*SM0_UU32*/
+	{(srt_cmp)cmp_I, NULL, NULL, NULL},		     /*SM0_II*/
+	{(srt_cmp)cmp_I, set_SM_IS, dup_xs, free_xs},	     /*SM0_IS*/
+	{(srt_cmp)cmp_I, NULL, NULL, NULL},		     /*SM0_IP*/
+	{(srt_cmp)cmp_s, set_SM_SI, dup_sx, free_sx},	     /*SM0_SI*/
+	{(srt_cmp)cmp_s, set_SM_SS, dup_ss, free_ss},	     /*SM0_SS*/
+	{(srt_cmp)cmp_s, set_SM_SP, dup_sx, free_sx},	     /*SM0_SP*/
+	{NULL, NULL, NULL, NULL},			     /*SM0_I*/
+	{NULL, NULL, NULL, NULL},			     /*SM0_I32*/
+	{NULL, NULL, NULL, NULL},			     /*SM0_U32*/
+	{NULL, NULL, NULL, NULL},			     /*SM0_S*/
+	{NULL, NULL, NULL, NULL},			     /*SM0_F*/
+	{NULL, NULL, NULL, NULL},			     /*SM0_D*/
+	{(srt_cmp)cmp_F, NULL, NULL, NULL},		     /*SM0_FF*/
+	{(srt_cmp)cmp_D, NULL, NULL, NULL},		     /*SM0_DD*/
+	{(srt_cmp)cmp_D, NULL, NULL, NULL},		     /*SM0_DP*/
+	{(srt_cmp)cmp_D, set_SM_DS, dup_dx, free_dx},	     /*SM0_DS*/
+	{(srt_cmp)cmp_s, set_SM_SD, dup_sx, free_sx}};	     /*SM0_SD*/
+
+S_INLINE srt_tnode *spm_node(const struct SPMapDir *d, size_t elem_size,
+			     srt_tndx i)
+{
+	return (srt_tnode *)(d->b[i >> SPM_BLOCK_BITS]
+			     + (i & SPM_BLOCK_MASK) * elem_size);
+}
+
+S_INLINE uint32_t *spm_rc(const struct SPMapDir *d, size_t elem_size,
+			  srt_tndx i)
+{
+	return (uint32_t *)(d->b[i >> SPM_BLOCK_BITS]
+			    + SPM_BLOCK_ELEMS * elem_size)
+	       + (i & SPM_BLOCK_MASK);
+}
+
+#define SPM_N(m, i) spm_node((m)->d, (m)->elem_size, i)
+#define SPM_RC(m, i) spm_rc((m)->d, (m)->elem_size, i)
+
+S_INLINE srt_bool spm_chk_t(const srt_pmap *m, int t)
+{
+	return m && m->type == t ? S_TRUE : S_FALSE;
+}
+
+S_INLINE srt_bool spm_chk_sx(const srt_pmap *m)
+{
+	return spm_chk_t(m, SM0_SS) || spm_chk_t(m, SM0_SI)
+	       || spm_chk_t(m, SM0_SP) || spm_chk_t(m, SM0_SD);
+}
+
+S_INLINE srt_bool spm_chk_ix(const srt_pmap *m)
+{
+	return spm_chk_t(m, SM0_II) || spm_chk_t(m, SM0_IS)
+	       || spm_chk_t(m, SM0_IP);
+}
+
+S_INLINE srt_bool spm_chk_dx(const srt_pmap *m)
+{
+	return spm_chk_t(m, SM0_DD) || spm_chk_t(m, SM0_DS)
+	       || spm_chk_t(m, SM0_DP);
+}
+
+S_INLINE srt_bool spm_red(const srt_pmap *m, srt_tndx i)
+{
+	return i != ST_NIL && SPM_N(m, i)->x.is_red ? S_TRUE : S_FALSE;
+}
+
+S_INLINE srt_bool spm_red_l(const srt_pmap *m, srt_tndx i)
+{
+	return i != ST_NIL && spm_red(m, SPM_N(m, i)->x.l) ? S_TRUE : S_FALSE;
+}
+
+static const srt_tnode *spm_locate(const srt_pmap *m, const srt_tnode *k)
+{
+	int c;
+	const srt_tnode *n;
+	srt_tndx i = m->root;
+	srt_cmp cmpf = spm_ctx[m->type].cmpf;
+	while (i != ST_NIL) {
+		n = SPM_N(m, i);
+		c = cmpf(n, k);
+		if (!c)
+			return n;
+		i = c > 0 ? n->x.l : n->r;
+	}
+	return NULL;
+}
+
+/*
+ * Node pool (writer side)
+ */
+
+static srt_bool spm_reserve(srt_pmap *m, size_t extra)
+{
+	uint8_t *b;
+	size_t cap, need, max_blocks;
+	struct SPMapDir *d;
+	struct SPMapPool *p = m->p;
+	need = p->next + (extra > p->nfree ? extra - p->nfree : 0);
+	RETURN_IF(need > ST_NDX_MAX, S_FALSE); /* BEHAVIOR: too many nodes */
+	cap = p->nblocks * SPM_BLOCK_ELEMS;
+	while (cap < need) {
+		if (!p->d || p->nblocks == p->d->max_blocks) {
+			max_blocks = p->d ? p->d->max_blocks * 2 : SPM_DIR_MIN;
+			d = (struct SPMapDir *)s_malloc(
+				sizeof(struct SPMapDir)
+				+ (max_blocks - 1) * sizeof(uint8_t *));
+			RETURN_IF(!d, S_FALSE); /* BEHAVIOR: not enough mem. */
+			d->prev = p->d;
+			d->max_blocks = max_blocks;
+			if (p->nblocks)
+				memcpy(d->b, p->d->b,
+				       p->nblocks * sizeof(uint8_t *));
+			p->d = d;
+			m->d = d;
+		}
+		b = (uint8_t *)s_malloc(SPM_BLOCK_ELEMS
+					* (m->elem_size + sizeof(uint32_t)));
+		RETURN_IF(!b, S_FALSE); /* BEHAVIOR: not enough memory */
+		p->d->b[p->nblocks++] = b;
+		cap += SPM_BLOCK_ELEMS;
+	}
+	return S_TRUE;
+}
+
+/* Requires previous spm_reserve() */
+static srt_tndx spm_new_node(srt_pmap *m)
+{
+	srt_tndx i;
+	struct SPMapPool *p = m->p;
+	if (p->free_list != ST_NIL) {
+		i = p->free_list;
+		p->free_list = SPM_N(m, i)->r;
+		p->nfree--;
+	} else {
+		i = p->next++;
+	}
+	*SPM_RC(m, i) = 1;
+	return i;
+}
+
+static void spm_recycle(srt_pmap *m, srt_tndx i)
+{
+	struct SPMapPool *p = m->p;
+	*SPM_RC(m, i) = 0;
+	SPM_N(m, i)->r = p->free_list;
+	p->free_list = i;
+	p->nfree++;
+}
+
+/* Release a node reference, recycling the nodes no longer referenced */
+static void spm_dec(srt_pmap *m, srt_tndx i)
+{
+	srt_tndx r;
+	srt_tnode *n;
+	srt_tree_callback freef = spm_ctx[m->type].freef;
+	while (i != ST_NIL && --*SPM_RC(m, i) == 0) {
+		n = SPM_N(m, i);
+		if (freef)
+			freef(n);
+		spm_dec(m, n->x.l);
+		r = n->r;
+		spm_recycle(m, i);
+		i = r; /* tail */
+	}
+}
+
+/*
+ * Get the node for writing, reached from a node already owned by the map.
+ * If it is shared (some snapshot references it), it is copied: the caller
+ * replaces the reference with the returned index.
+ */
+static srt_tndx spm_own(srt_pmap *m, srt_tndx i)
+{
+	srt_tndx j;
+	srt_tnode *n;
+	srt_tree_callback dupf;
+	uint32_t *rc = SPM_RC(m, i);
+	if (*rc == 1)
+		return i;
+	j = spm_new_node(m);
+	n = SPM_N(m, j);
+	memcpy(n, SPM_N(m, i), m->elem_size);
+	dupf = spm_ctx[m->type].dupf;
+	if (dupf)
+		dupf(n);
+	if (n->x.l != ST_NIL)
+		(*SPM_RC(m, n->x.l))++;
+	if (n->r != ST_NIL)
+		(*SPM_RC(m, n->r))++;
+	(*rc)--;
+	return j;
+}
+
+/*
+ * Left-leaning Red-Black tree (nodes passed to these are already owned)
+ */
+
+static srt_tndx spm_rot_l(srt_pmap *m, srt_tndx h)
+{
+	srt_tnode *hn = SPM_N(m, h), *xn;
+	srt_tndx x = spm_own(m, hn->r);
+	xn = SPM_N(m, x);
+	hn->r = xn->x.l;
+	xn->x.l = h;
+	xn->x.is_red = hn->x.is_red;
+	hn->x.is_red = 1;
+	return x;
+}
+
+static srt_tndx spm_rot_r(srt_pmap *m, srt_tndx h)
+{
+	srt_tnode *hn = SPM_N(m, h), *xn;
+	srt_tndx x = spm_own(m, hn->x.l);
+	xn = SPM_N(m, x);
+	hn->x.l = xn->r;
+	xn->r = h;
+	xn->x.is_red = hn->x.is_red;
+	hn->x.is_red = 1;
+	return x;
+}
+
+static void spm_flip(srt_pmap *m, srt_tndx h)
+{
+	srt_tndx c;
+	srt_tnode *cn, *hn = SPM_N(m, h);
+	hn->x.is_red = !hn->x.is_red;
+	if (hn->x.l != ST_NIL) {
+		c = spm_own(m, hn->x.l);
+		hn->x.l = c;
+		cn = SPM_N(m, c);
+		cn->x.is_red = !cn->x.is_red;
+	}
+	if (hn->r != ST_NIL) {
+		c = spm_own(m, hn->r);
+		hn->r = c;
+		cn = SPM_N(m, c);
+		cn->x.is_red = !cn->x.is_red;
+	}
+}
+
+static srt_tndx spm_fix(srt_pmap *m, srt_tndx h)
+{
+	srt_tnode *hn = SPM_N(m, h);
+	if (spm_red(m, hn->r) && !spm_red(m, hn->x.l)) {
+		h = spm_rot_l(m, h);
+		hn = SPM_N(m, h);
+	}
+	if (spm_red(m, hn->x.l) && spm_red_l(m, hn->x.l)) {
+		h = spm_rot_r(m, h);
+		hn = SPM_N(m, h);
+	}
+	if (spm_red(m, hn->x.l) && spm_red(m, hn->r))
+		spm_flip(m, h);
+	return h;
+}
+
+static srt_tndx spm_move_red_l(srt_pmap *m, srt_tndx h)
+{
+	srt_tnode *hn;
+	spm_flip(m, h);
+	hn = SPM_N(m, h);
+	if (spm_red_l(m, hn->r)) {
+		hn->r = spm_rot_r(m, hn->r);
+		h = spm_rot_l(m, h);
+		spm_flip(m, h);
+	}
+	return h;
+}
+
+static srt_tndx spm_move_red_r(srt_pmap *m, srt_tndx h)
+{
+	spm_flip(m, h);
+	if (spm_red_l(m, SPM_N(m, h)->x.l)) {
+		h = spm_rot_r(m, h);
+		spm_flip(m, h);
+	}
+	return h;
+}
+
+static void spm_set(srt_pmap *m, srt_tnode *n, const srt_tnode *kv,
+		    srt_bool existing)
+{
+	srt_tree_rewrite setf = spm_ctx[m->type].setf;
+	if (setf)
+		setf(n, kv, existing);
+	else
+		memcpy(n + 1, kv + 1, m->elem_size - sizeof(srt_tnode));
+}
+
+static srt_tndx spm_ins(srt_pmap *m, srt_tndx h, const srt_tnode *kv,
+			srt_bool *added)
+{
+	int c;
+	srt_tnode *hn;
+	if (h == ST_NIL) {
+		h = spm_new_node(m);
+		hn = SPM_N(m, h);
+		hn->x.l = ST_NIL;
+		hn->x.is_red = 1;
+		hn->r = ST_NIL;
+		spm_set(m, hn, kv, S_FALSE);
+		*added = S_TRUE;
+		return h;
+	}
+	h = spm_own(m, h);
+	hn = SPM_N(m, h);
+	c = spm_ctx[m->type].cmpf(hn, kv);
+	if (c > 0)
+		hn->x.l = spm_ins(m, hn->x.l, kv, added);
+	else if (c < 0)
+		hn->r = spm_ins(m, hn->r, kv, added);
+	else
+		spm_set(m, hn, kv, S_TRUE);
+	return spm_fix(m, h);
+}
+
+/* Delete the minimum, moving its key and value to 'dst' */
+static srt_tndx spm_del_min(srt_pmap *m, srt_tndx h, srt_tnode *dst)
+{
+	srt_tndx r;
+	srt_tnode *hn;
+	srt_tree_callback freef;
+	h = spm_own(m, h);
+	hn = SPM_N(m, h);
+	if (hn->x.l == ST_NIL) {
+		freef = spm_ctx[m->type].freef;
+		if (freef)
+			freef(dst);
+		memcpy(dst + 1, hn + 1, m->elem_size - sizeof(srt_tnode));
+		r = hn->r;
+		spm_recycle(m, h);
+		return r;
+	}
+	if (!spm_red(m, hn->x.l) && !spm_red_l(m, hn->x.l)) {
+		h = spm_move_red_l(m, h);
+		hn = SPM_N(m, h);
+	}
+	hn->x.l = spm_del_min(m, hn->x.l, dst);
+	return spm_fix(m, h);
+}
+
+/* Requires the key to be in the tree */
+static srt_tndx spm_del(srt_pmap *m, srt_tndx h, const srt_tnode *k)
+{
+	srt_tnode *hn;
+	srt_cmp cmpf = spm_ctx[m->type].cmpf;
+	h = spm_own(m, h);
+	hn = SPM_N(m, h);
+	if (cmpf(hn, k) > 0) {
+		if (!spm_red(m, hn->x.l) && !spm_red_l(m, hn->x.l)) {
+			h = spm_move_red_l(m, h);
+			hn = SPM_N(m, h);
+		}
+		hn->x.l = spm_del(m, hn->x.l, k);
+	} else {
+		if (spm_red(m, hn->x.l)) {
+			h = spm_rot_r(m, h);
+			hn = SPM_N(m, h);
+		}
+		if (!cmpf(hn, k) && hn->r == ST_NIL) {
+			spm_dec(m, h); /* leaf */
+			return ST_NIL;
+		}
+		if (!spm_red(m, hn->r) && !spm_red_l(m, hn->r)) {
+			h = spm_move_red_r(m, h);
+			hn = SPM_N(m, h);
+		}
+		if (!cmpf(hn, k))
+			hn->r = spm_del_min(m, hn->r, hn);
+		else
+			hn->r = spm_del(m, hn->r, k);
+	}
+	return spm_fix(m, h);
+}
+
+static srt_bool spm_insert(srt_pmap *m, const srt_tnode *kv)
+{
+	srt_tndx root;
+	srt_bool added = S_FALSE;
+	RETURN_IF(m->is_snapshot, S_FALSE);
+	RETURN_IF(!spm_reserve(m, SPM_OP_NODES(m->size)), S_FALSE);
+	root = spm_ins(m, m->root, kv, &added);
+	SPM_N(m, root)->x.is_red = 0;
+	m->root = root;
+	if (added)
+		m->size++;
+	return S_TRUE;
+}
+
+static srt_bool spm_delete(srt_pmap *m, const srt_tnode *k)
+{
+	srt_tndx root;
+	srt_tnode *rn;
+	RETURN_IF(m->is_snapshot || !spm_locate(m, k), S_FALSE);
+	RETURN_IF(!spm_reserve(m, SPM_OP_NODES(m->size)), S_FALSE);
+	root = spm_own(m, m->root);
+	rn = SPM_N(m, root);
+	if (!spm_red(m, rn->x.l) && !spm_red(m, rn->r))
+		rn->x.is_red = 1;
+	root = spm_del(m, root, k);
+	if (root != ST_NIL)
+		SPM_N(m, root)->x.is_red = 0;
+	m->root = root;
+	m->size--;
+	return S_TRUE;
+}
+
+/* Free everything (no map nor snapshot using the pool) */
+static void spm_pool_free(struct SPMapPool *p)
+{
+	srt_tndx i;
+	size_t j;
+	srt_pmap *s, *s_next;
+	struct SPMapDir *d, *d_prev;
+	srt_tree_callback freef = spm_ctx[p->type].freef;
+	if (freef)
+		for (i = 0; i < p->next; i++)
+			if (*spm_rc(p->d, p->elem_size, i))
+				freef(spm_node(p->d, p->elem_size, i));
+	for (j = 0; j < p->nblocks; j++)
+		s_free(p->d->b[j]);
+	for (d = p->d; d; d = d_prev) {
+		d_prev = d->prev;
+		s_free(d);
+	}
+	for (s = p->snaps; s; s = s_next) {
+		s_next = s->next;
+		s_free(s);
+	}
+	s_free(p);
+}
+
+static void spm_release(srt_pmap *m)
+{
+	struct SPMapPool *p = m->p;
+	if (m->is_snapshot) {
+		if (S_ATOMIC_DEC(&m->refs) > 0)
+			return;
+		/* the map recycles the nodes, unless it has been freed */
+		if (S_ATOMIC_DEC(&p->refs) == 0)
+			spm_pool_free(p);
+		return;
+	}
+	spm_collect(m);
+	spm_dec(m, m->root);
+	s_free(m);
+	if (S_ATOMIC_DEC(&p->refs) == 0)
+		spm_pool_free(p);
+}
+
+/*
+ * Allocation
+ */
+
+srt_pmap *spm_alloc(enum eSM_Type t, size_t init_size)
+{
+	srt_pmap *m;
+	struct SPMapPool *p;
+	RETURN_IF((unsigned)t >= SM0_NumTypes || !spm_ctx[t].cmpf, NULL);
+	m = (srt_pmap *)s_malloc(sizeof(srt_pmap));
+	p = (struct SPMapPool *)s_malloc(sizeof(struct SPMapPool));
+	if (!m || !p) { /* BEHAVIOR: not enough memory */
+		if (m)
+			s_free(m);
+		if (p)
+			s_free(p);
+		return NULL;
+	}
+	memset(p, 0, sizeof(*p));
+	p->free_list = ST_NIL;
+	p->refs = 1;
+	p->type = (uint8_t)t;
+	p->elem_size = sm_elem_size(t);
+	memset(m, 0, sizeof(*m));
+	m->p = p;
+	m->root = ST_NIL;
+	m->type = p->type;
+	m->elem_size = p->elem_size;
+	if (init_size)
+		spm_reserve(m, init_size); /* BEHAVIOR: grow later if failed */
+	return m;
+}
+
+srt_pmap *spm_snapshot(srt_pmap *m)
+{
+	srt_pmap *s;
+	RETURN_IF(!m || m->is_snapshot, NULL);
+	spm_collect(m);
+	s = (srt_pmap *)s_malloc(sizeof(srt_pmap));
+	RETURN_IF(!s, NULL); /* BEHAVIOR: not enough memory */
+	*s = *m;
+	s->is_snapshot = 1;
+	s->refs = 1;
+	if (s->root != ST_NIL)
+		(*SPM_RC(m, s->root))++;
+	S_ATOMIC_INC(&m->p->refs);
+	s->next = m->p->snaps;
+	m->p->snaps = s;
+	return s;
+}
+
+srt_pmap *spm_ref(srt_pmap *s)
+{
+	RETURN_IF(!s || !s->is_snapshot, NULL);
+	S_ATOMIC_INC(&s->refs);
+	return s;
+}
+
+void spm_free_aux(srt_pmap **m, ...)
+{
+	va_list ap;
+	srt_pmap **next;
+	va_start(ap, m);
+	next = m;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			spm_release(*next);
+			*next = NULL;
+		}
+		next = (srt_pmap **)va_arg(ap, srt_pmap **);
+	}
+	va_end(ap);
+}
+
+size_t spm_collect(srt_pmap *m)
+{
+	size_t nfree0;
+	srt_pmap **s, *s_next;
+	struct SPMapDir *d, *d_prev;
+	struct SPMapPool *p;
+	RETURN_IF(!m || m->is_snapshot, 0);
+	p = m->p;
+	nfree0 = p->nfree;
+	for (s = &p->snaps; *s;) {
+		if (S_ATOMIC_GET(&(*s)->refs) > 0) {
+			s = &(*s)->next;
+			continue;
+		}
+		s_next = (*s)->next;
+		spm_dec(m, (*s)->root);
+		s_free(*s);
+		*s = s_next;
+	}
+	if (!p->snaps && p->d) { /* replaced directories no longer used */
+		for (d = p->d->prev; d; d = d_prev) {
+			d_prev = d->prev;
+			s_free(d);
+		}
+		p->d->prev = NULL;
+	}
+	return p->nfree - nfree0;
+}
+
+size_t spm_nodes(const srt_pmap *m)
+{
+	return m ? m->p->next - m->p->nfree : 0;
+}
+
+/*
+ * Random access
+ */
+
+#define BUILD_SPM_AT(FN, ID, TS, TK, TV)                                       \
+	TV FN(const srt_pmap *m, TK k)                                         \
+	{                                                                      \
+		TS n;                                                          \
+		const TS *nr;                                                  \
+		RETURN_IF(!spm_chk_t(m, ID), 0);                               \
+		n.x.k = k;                                                     \
+		nr = (const TS *)spm_locate(m, (const srt_tnode *)&n);         \
+		return nr ? nr->v : 0; /* BEHAVIOR */                          \
+	}
+
+BUILD_SPM_AT(spm_at_ii32, SM_II32, struct SMapii, int32_t, int32_t)
+BUILD_SPM_AT(spm_at_uu32, SM_UU32, struct SMapuu, uint32_t, uint32_t)
+BUILD_SPM_AT(spm_at_ii, SM_II, struct SMapII, int64_t, int64_t)
+BUILD_SPM_AT(spm_at_ff, SM_FF, struct SMapFF, float, float)
+BUILD_SPM_AT(spm_at_dd, SM_DD, struct SMapDD, double, double)
+BUILD_SPM_AT(spm_at_ip, SM_IP, struct SMapIP, int64_t, const void *)
+BUILD_SPM_AT(spm_at_dp, SM_DP, struct SMapDP, double, const void *)
+
+#define BUILD_SPM_AT_XS(FN, ID, TS, TK)                                        \
+	const srt_string *FN(const srt_pmap *m, TK k)                          \
+	{                                                                      \
+		TS n;                                                          \
+		const TS *nr;                                                  \
+		RETURN_IF(!spm_chk_t(m, ID), ss_void);                         \
+		n.x.k = k;                                                     \
+		nr = (const TS *)spm_locate(m, (const srt_tnode *)&n);         \
+		return nr ? sso1_get(&nr->v) : ss_void;                        \
+	}
+
+BUILD_SPM_AT_XS(spm_at_is, SM_IS, struct SMapIS, int64_t)
+BUILD_SPM_AT_XS(spm_at_ds, SM_DS, struct SMapDS, double)
+
+#define BUILD_SPM_AT_SX(FN, ID, TS, TV, DEF_VAL)                               \
+	TV FN(const srt_pmap *m, const srt_string *k)                          \
+	{                                                                      \
+		TS n;                                                          \
+		const TS *nr;                                                  \
+		RETURN_IF(!spm_chk_t(m, ID), DEF_VAL);                         \
+		sso1_setref(&n.x.k, k);                                        \
+		nr = (const TS *)spm_locate(m, &n.x.n);                        \
+		return nr ? nr->v : DEF_VAL; /* BEHAVIOR */                    \
+	}
+
+BUILD_SPM_AT_SX(spm_at_si, SM_SI, struct SMapSI, int64_t, 0)
+BUILD_SPM_AT_SX(spm_at_sd, SM_SD, struct SMapSD, double, 0)
+BUILD_SPM_AT_SX(spm_at_sp, SM_SP, struct SMapSP, const void *, NULL)
+
+const srt_string *spm_at_ss(const srt_pmap *m, const srt_string *k)
+{
+	struct SMapSS n;
+	const struct SMapSS *nr;
+	RETURN_IF(!spm_chk_t(m, SM_SS), ss_void);
+	sso_setref(&n.s, k, NULL);
+	nr = (const struct SMapSS *)spm_locate(m, &n.n);
+	return nr ? sso_get_s2(&nr->s) : ss_void;
+}
+
+/*
+ * Existence check
+ */
+
+#define BUILD_SPM_COUNT(FN, CHK, TS, TK)                                       \
+	size_t FN(const srt_pmap *m, TK k)                                     \
+	{                                                                      \
+		TS n;                                                          \
+		RETURN_IF(!(CHK), S_FALSE);                                    \
+		n.k = k;                                                       \
+		return spm_locate(m, (const srt_tnode *)&n) ? 1 : 0;           \
+	}
+
+BUILD_SPM_COUNT(spm_count_i32, spm_chk_t(m, SM0_II32), struct SMapi, int32_t)
+BUILD_SPM_COUNT(spm_count_u32, spm_chk_t(m, SM0_UU32), struct SMapu, uint32_t)
+BUILD_SPM_COUNT(spm_count_i, spm_chk_ix(m), struct SMapI, int64_t)
+BUILD_SPM_COUNT(spm_count_f, spm_chk_t(m, SM0_FF), struct SMapF, float)
+BUILD_SPM_COUNT(spm_count_d, spm_chk_dx(m), struct SMapD, double)
+
+size_t spm_count_s(const srt_pmap *m, const srt_string *k)
+{
+	struct SMapS n;
+	RETURN_IF(!spm_chk_sx(m), S_FALSE);
+	sso1_setref(&n.k, k);
+	return spm_locate(m, (const srt_tnode *)&n) ? 1 : 0;
+}
+
+/*
+ * Insert
+ */
+
+#define BUILD_SPM_INSERT(FN, ID, TS, TK, TV)                                   \
+	srt_bool FN(srt_pmap *m, TK k, TV v)                                   \
+	{                                                                      \
+		TS n;                                                          \
+		RETURN_IF(!spm_chk_t(m, ID), S_FALSE);                         \
+		n.x.k = k;                                                     \
+		n.v = v;                                                       \
+		return spm_insert(m, (const srt_tnode *)&n);                   \
+	}
+
+BUILD_SPM_INSERT(spm_insert_ii32, SM_II32, struct SMapii, int32_t, int32_t)
+BUILD_SPM_INSERT(spm_insert_uu32, SM_UU32, struct SMapuu, uint32_t, uint32_t)
+BUILD_SPM_INSERT(spm_insert_ii, SM_II, struct SMapII, int64_t, int64_t)
+BUILD_SPM_INSERT(spm_insert_ff, SM_FF, struct SMapFF, float, float)
+BUILD_SPM_INSERT(spm_insert_dd, SM_DD, struct SMapDD, double, double)
+BUILD_SPM_INSERT(spm_insert_ip, SM_IP, struct SMapIP, int64_t, const void *)
+BUILD_SPM_INSERT(spm_insert_dp, SM_DP, struct SMapDP, double, const void *)
+
+#define BUILD_SPM_INSERT_XS(FN, ID, TS, TK)                                    \
+	srt_bool FN(srt_pmap *m, TK k, const srt_string *v)                    \
+	{                                                                      \
+		TS n;                                                          \
+		RETURN_IF(!spm_chk_t(m, ID), S_FALSE);                         \
+		n.x.k = k;                                                     \
+		sso1_setref(&n.v, v);                                          \
+		return spm_insert(m, (const srt_tnode *)&n);                   \
+	}
+
+BUILD_SPM_INSERT_XS(spm_insert_is, SM_IS, struct SMapIS, int64_t)
+BUILD_SPM_INSERT_XS(spm_insert_ds, SM_DS, struct SMapDS, double)
+
+#define BUILD_SPM_INSERT_SX(FN, ID, TS, TV)                                    \
+	srt_bool FN(srt_pmap *m, const srt_string *k, TV v)                    \
+	{                                                                      \
+		TS n;                                                          \
+		RETURN_IF(!spm_chk_t(m, ID), S_FALSE);                         \
+		sso1_setref(&n.x.k, k);                                        \
+		n.v = v;                                                       \
+		return spm_insert(m, (const srt_tnode *)&n);                   \
+	}
+
+BUILD_SPM_INSERT_SX(spm_insert_si, SM_SI, struct SMapSI, int64_t)
+BUILD_SPM_INSERT_SX(spm_insert_sd, SM_SD, struct SMapSD, double)
+BUILD_SPM_INSERT_SX(spm_insert_sp, SM_SP, struct SMapSP, const void *)
+
+srt_bool spm_insert_ss(srt_pmap *m, const srt_string *k, const srt_string *v)
+{
+	struct SMapSS n;
+	RETURN_IF(!spm_chk_t(m, SM_SS), S_FALSE);
+	sso_setref(&n.s, k, v);
+	return spm_insert(m, &n.n);
+}
+
+/*
+ * Delete
+ */
+
+#define BUILD_SPM_DELETE(FN, CHK, TS, TK)                                      \
+	srt_bool FN(srt_pmap *m, TK k)                                         \
+	{                                                                      \
+		TS n;                                                          \
+		RETURN_IF(!(CHK), S_FALSE);                                    \
+		n.k = k;                                                       \
+		return spm_delete(m, (const srt_tnode *)&n);                   \
+	}
+
+BUILD_SPM_DELETE(spm_delete_i32, spm_chk_t(m, SM0_II32), struct SMapi, int32_t)
+BUILD_SPM_DELETE(spm_delete_u32, spm_chk_t(m, SM0_UU32), struct SMapu,
+		 uint32_t)
+BUILD_SPM_DELETE(spm_delete_i, spm_chk_ix(m), struct SMapI, int64_t)
+BUILD_SPM_DELETE(spm_delete_f, spm_chk_t(m, SM0_FF), struct SMapF, float)
+BUILD_SPM_DELETE(spm_delete_d, spm_chk_dx(m), struct SMapD, double)
+
+srt_bool spm_delete_s(srt_pmap *m, const srt_string *k)
+{
+	struct SMapS n;
+	RETURN_IF(!spm_chk_sx(m), S_FALSE);
+	sso1_setref(&n.k, k);
+	return spm_delete(m, (const srt_tnode *)&n);
+}
+
+/*
+ * Enumeration
+ *
+ * In-order traversal, skipping the subtrees with keys below the lower
+ * bound, and stopping at the first key above the upper bound.
+ */
+
+#define SPM_CMP_N(a, b) ((a) > (b) ? 1 : (a) < (b) ? -1 : 0)
+#define SPM_CMP_S(a, b) ss_cmp(a, b)
+#define SPM_SK(n) sso_get((const srt_stringo *)&((const struct SMapS *)(n))->k)
+
+#define BUILD_SPM_ITR(FN, ID, CALLBACK_T, KEY_T, CMPK, NODE_K, CALLBACK)       \
+	size_t FN(const srt_pmap *m, KEY_T kmin, KEY_T kmax, CALLBACK_T f,     \
+		  void *context)                                               \
+	{                                                                      \
+		size_t np = 0, nelems = 0;                                     \
+		srt_tndx c, p[SPM_STACK_MAX];                                  \
+		const srt_tnode *cn;                                           \
+		RETURN_IF(!spm_chk_t(m, ID), 0);                               \
+		c = m->root;                                                   \
+		for (;;) {                                                     \
+			while (c != ST_NIL && np < SPM_STACK_MAX) {            \
+				cn = SPM_N(m, c);                              \
+				if (CMPK(NODE_K, kmin) < 0) {                  \
+					c = cn->r;                             \
+					continue;                              \
+				}                                              \
+				p[np++] = c;                                   \
+				c = cn->x.l;                                   \
+			}                                                      \
+			if (!np)                                               \
+				break;                                         \
+			cn = SPM_N(m, p[--np]);                                \
+			if (CMPK(NODE_K, kmax) > 0)                            \
+				break;                                         \
+			if (f && !(CALLBACK))                                  \
+				return nelems;                                 \
+			nelems++;                                              \
+			c = cn->r;                                             \
+		}                                                              \
+		return nelems;                                                 \
+	}
+
+BUILD_SPM_ITR(spm_itr_ii32, SM_II32, srt_map_it_ii32, int32_t, SPM_CMP_N,
+	      ((const struct SMapi *)cn)->k,
+	      f(((const struct SMapi *)cn)->k, ((const struct SMapii *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_uu32, SM_UU32, srt_map_it_uu32, uint32_t, SPM_CMP_N,
+	      ((const struct SMapu *)cn)->k,
+	      f(((const struct SMapu *)cn)->k, ((const struct SMapuu *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_ii, SM_II, srt_map_it_ii, int64_t, SPM_CMP_N,
+	      ((const struct SMapI *)cn)->k,
+	      f(((const struct SMapI *)cn)->k, ((const struct SMapII *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_ff, SM_FF, srt_map_it_ff, float, SPM_CMP_N,
+	      ((const struct SMapF *)cn)->k,
+	      f(((const struct SMapF *)cn)->k, ((const struct SMapFF *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_dd, SM_DD, srt_map_it_dd, double, SPM_CMP_N,
+	      ((const struct SMapD *)cn)->k,
+	      f(((const struct SMapD *)cn)->k, ((const struct SMapDD *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_is, SM_IS, srt_map_it_is, int64_t, SPM_CMP_N,
+	      ((const struct SMapI *)cn)->k,
+	      f(((const struct SMapI *)cn)->k,
+		sso1_get(&((const struct SMapIS *)cn)->v), context))
+BUILD_SPM_ITR(spm_itr_ip, SM_IP, srt_map_it_ip, int64_t, SPM_CMP_N,
+	      ((const struct SMapI *)cn)->k,
+	      f(((const struct SMapI *)cn)->k, ((const struct SMapIP *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_ds, SM_DS, srt_map_it_ds, double, SPM_CMP_N,
+	      ((const struct SMapD *)cn)->k,
+	      f(((const struct SMapD *)cn)->k,
+		sso1_get(&((const struct SMapDS *)cn)->v), context))
+BUILD_SPM_ITR(spm_itr_dp, SM_DP, srt_map_it_dp, double, SPM_CMP_N,
+	      ((const struct SMapD *)cn)->k,
+	      f(((const struct SMapD *)cn)->k, ((const struct SMapDP *)cn)->v,
+		context))
+BUILD_SPM_ITR(spm_itr_si, SM_SI, srt_map_it_si, const srt_string *,
+	      SPM_CMP_S, SPM_SK(cn),
+	      f(SPM_SK(cn), ((const struct SMapSI *)cn)->v, context))
+BUILD_SPM_ITR(spm_itr_sd, SM_SD, srt_map_it_sd, const srt_string *,
+	      SPM_CMP_S, SPM_SK(cn),
+	      f(SPM_SK(cn), ((const struct SMapSD *)cn)->v, context))
+BUILD_SPM_ITR(spm_itr_ss, SM_SS, srt_map_it_ss, const srt_string *,
+	      SPM_CMP_S, sso_get(&((const struct SMapSS *)cn)->s),
+	      f(sso_get(&((const struct SMapSS *)cn)->s),
+		sso_get_s2(&((const struct SMapSS *)cn)->s), context))
+BUILD_SPM_ITR(spm_itr_sp, SM_SP, srt_map_it_sp, const srt_string *,
+	      SPM_CMP_S, SPM_SK(cn),
+	      f(SPM_SK(cn), ((const struct SMapSP *)cn)->v, context))
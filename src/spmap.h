@@ -0,0 +1,293 @@
+#ifndef SPMAP_H
+#define SPMAP_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * spmap.h
+ *
+ * #SHORTDOC persistent map handling (key-value storage with O(1) snapshots)
+ *
+ * #DOC Persistent map functions handle key-value storage with versioning:
+ * #DOC taking a snapshot is O(1), and the snapshot keeps the map contents
+ * #DOC of that moment, no matter the changes done later to the map. It is
+ * #DOC implemented as a left-leaning Red-Black tree (O(log n) time
+ * #DOC complexity for insert/read/delete), in a pool of fixed-size node
+ * #DOC blocks shared by the map and its snapshots (node references are
+ * #DOC indexes, as in srt_map). Nodes are reference counted: modifying the
+ * #DOC map copies just the nodes in the changed path that are shared with
+ * #DOC some snapshot (path copying), and the nodes no longer referenced are
+ * #DOC recycled once the snapshots using them are released.
+ * #DOC
+ * #DOC
+ * #DOC Thread safety: the map must be modified by just one thread (the
+ * #DOC writer), which is also the one taking the snapshots. Snapshots are
+ * #DOC read-only, and can be read, referenced (spm_ref()) and released
+ * #DOC (spm_free()) from any thread without locking (atomic counters are
+ * #DOC used for the references). Publishing the snapshot to the readers
+ * #DOC (e.g. through a mutex-protected pointer) is up to the caller. Nodes
+ * #DOC of the released snapshots are recycled by the writer (spm_snapshot(),
+ * #DOC spm_collect(), spm_free()), or by the last snapshot release if the
+ * #DOC map has already been freed.
+ * #DOC
+ * #DOC
+ * #DOC Supported key/value modes: same as srt_map (see enum eSM_Type)
+ * #DOC
+ * #DOC
+ * #DOC Callback types for the spm_itr_*() functions: same as the ones used
+ * #DOC by the sm_itr_*() functions (srt_map_it_*)
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "smap.h"
+
+/*
+ * Structures
+ */
+
+struct SPMapPool; /* node pool, shared by the map and its snapshots */
+struct SPMapDir;  /* node block directory */
+
+struct SPMap {
+	struct SPMapPool *p;
+	const struct SPMapDir *d;
+	size_t size;	     /* number of elements */
+	srt_tndx root;	     /* root node */
+	uint8_t type;	     /* enum eSM_Type0 */
+	uint8_t elem_size;   /* node size */
+	uint8_t is_snapshot; /* read-only */
+	long refs;	     /* snapshot references (atomic) */
+	struct SPMap *next;  /* snapshot list (writer side) */
+};
+
+typedef struct SPMap srt_pmap; /* Opaque structure (accessors are provided) */
+
+/*
+ * Allocation
+ */
+
+/* #API: |Allocate persistent map (heap)|map type; initial reserve|persistent map (NULL if not enough memory)|O(1)|1;2| */
+srt_pmap *spm_alloc(enum eSM_Type t, size_t initial_num_elems_reserve);
+
+/* #API: |Take a read-only snapshot of the map contents, with one reference. BEHAVIOR: it must be called from the thread modifying the map|persistent map|snapshot (NULL if not enough memory or if the input is a snapshot)|O(1)|1;2| */
+srt_pmap *spm_snapshot(srt_pmap *m);
+
+/* #API: |Add a snapshot reference (e.g. for handing it to another thread); every reference has to be released with spm_free()|snapshot|same snapshot (NULL if the input is not a snapshot)|O(1)|1;2| */
+srt_pmap *spm_ref(srt_pmap *s);
+
+/*
+#API: |Free one or more persistent maps or snapshot references|persistent map or snapshot; more persistent maps or snapshots (optional)|-|O(1) for snapshots; O(n) for maps|1;2|
+void spm_free(srt_pmap **m, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define spm_free(...) spm_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define spm_free(m) spm_free_aux(m, S_INVALID_PTR_VARG_TAIL)
+#endif
+void spm_free_aux(srt_pmap **m, ...);
+
+/* #API: |Recycle the nodes used only by released snapshots (this is done also when taking snapshots). BEHAVIOR: it must be called from the thread modifying the map|persistent map|number of nodes recycled|O(s) + O(r), being s the number of snapshots, and r the number of nodes recycled|1;2| */
+size_t spm_collect(srt_pmap *m);
+
+/* #API: |Get map size|persistent map or snapshot|Number of elements|O(1)|1;2| */
+S_INLINE size_t spm_size(const srt_pmap *m)
+{
+	return m ? m->size : 0;
+}
+
+/* #API: |Get map type|persistent map or snapshot|map type (enum eSM_Type)|O(1)|1;2| */
+S_INLINE enum eSM_Type spm_type(const srt_pmap *m)
+{
+	return m ? (enum eSM_Type)m->type : SM_II32;
+}
+
+/* #API: |Check if it is a snapshot|persistent map or snapshot|S_TRUE: snapshot; S_FALSE: map|O(1)|1;2| */
+S_INLINE srt_bool spm_is_snapshot(const srt_pmap *m)
+{
+	return m && m->is_snapshot ? S_TRUE : S_FALSE;
+}
+
+/* #API: |Number of pool nodes in use (map and snapshots not yet recycled); call it from the writer thread|persistent map or snapshot|number of nodes|O(1)|1;2| */
+size_t spm_nodes(const srt_pmap *m);
+
+/*
+ * Random access
+ */
+
+/* #API: |Access to map element (SM_II32)|persistent map or snapshot; key|value|O(log n)|1;2| */
+int32_t spm_at_ii32(const srt_pmap *m, int32_t k);
+
+/* #API: |Access to map element (SM_UU32)|persistent map or snapshot; key|value|O(log n)|1;2| */
+uint32_t spm_at_uu32(const srt_pmap *m, uint32_t k);
+
+/* #API: |Access to map element (SM_II)|persistent map or snapshot; key|value|O(log n)|1;2| */
+int64_t spm_at_ii(const srt_pmap *m, int64_t k);
+
+/* #API: |Access to map element (SM_FF)|persistent map or snapshot; key|value|O(log n)|1;2| */
+float spm_at_ff(const srt_pmap *m, float k);
+
+/* #API: |Access to map element (SM_DD)|persistent map or snapshot; key|value|O(log n)|1;2| */
+double spm_at_dd(const srt_pmap *m, double k);
+
+/* #API: |Access to map element (SM_IS)|persistent map or snapshot; key|value|O(log n)|1;2| */
+const srt_string *spm_at_is(const srt_pmap *m, int64_t k);
+
+/* #API: |Access to map element (SM_IP)|persistent map or snapshot; key|value|O(log n)|1;2| */
+const void *spm_at_ip(const srt_pmap *m, int64_t k);
+
+/* #API: |Access to map element (SM_SI)|persistent map or snapshot; key|value|O(log n)|1;2| */
+int64_t spm_at_si(const srt_pmap *m, const srt_string *k);
+
+/* #API: |Access to map element (SM_SS)|persistent map or snapshot; key|value|O(log n)|1;2| */
+const srt_string *spm_at_ss(const srt_pmap *m, const srt_string *k);
+
+/* #API: |Access to map element (SM_SP)|persistent map or snapshot; key|value|O(log n)|1;2| */
+const void *spm_at_sp(const srt_pmap *m, const srt_string *k);
+
+/* #API: |Access to map element (SM_DS)|persistent map or snapshot; key|value|O(log n)|1;2| */
+const srt_string *spm_at_ds(const srt_pmap *m, double k);
+
+/* #API: |Access to map element (SM_DP)|persistent map or snapshot; key|value|O(log n)|1;2| */
+const void *spm_at_dp(const srt_pmap *m, double k);
+
+/* #API: |Access to map element (SM_SD)|persistent map or snapshot; key|value|O(log n)|1;2| */
+double spm_at_sd(const srt_pmap *m, const srt_string *k);
+
+/*
+ * Existence check
+ */
+
+/* #API: |Map element count/check (SM_II32)|persistent map or snapshot; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t spm_count_i32(const srt_pmap *m, int32_t k);
+
+/* #API: |Map element count/check (SM_UU32)|persistent map or snapshot; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t spm_count_u32(const srt_pmap *m, uint32_t k);
+
+/* #API: |Map element count/check (SM_I*)|persistent map or snapshot; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t spm_count_i(const srt_pmap *m, int64_t k);
+
+/* #API: |Map element count/check (SM_FF)|persistent map or snapshot; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t spm_count_f(const srt_pmap *m, float k);
+
+/* #API: |Map element count/check (SM_D*)|persistent map or snapshot; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t spm_count_d(const srt_pmap *m, double k);
+
+/* #API: |Map element count/check (SM_S*)|persistent map or snapshot; key|S_TRUE: element found; S_FALSE: not in the map|O(log n)|1;2| */
+size_t spm_count_s(const srt_pmap *m, const srt_string *k);
+
+/*
+ * Insert
+ */
+
+/* #API: |Insert into map (SM_II32)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_ii32(srt_pmap *m, int32_t k, int32_t v);
+
+/* #API: |Insert into map (SM_UU32)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_uu32(srt_pmap *m, uint32_t k, uint32_t v);
+
+/* #API: |Insert into map (SM_II)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_ii(srt_pmap *m, int64_t k, int64_t v);
+
+/* #API: |Insert into map (SM_FF)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_ff(srt_pmap *m, float k, float v);
+
+/* #API: |Insert into map (SM_DD)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_dd(srt_pmap *m, double k, double v);
+
+/* #API: |Insert into map (SM_IS)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_is(srt_pmap *m, int64_t k, const srt_string *v);
+
+/* #API: |Insert into map (SM_IP)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_ip(srt_pmap *m, int64_t k, const void *v);
+
+/* #API: |Insert into map (SM_SI)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_si(srt_pmap *m, const srt_string *k, int64_t v);
+
+/* #API: |Insert into map (SM_DS)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_ds(srt_pmap *m, double k, const srt_string *v);
+
+/* #API: |Insert into map (SM_DP)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_dp(srt_pmap *m, double k, const void *v);
+
+/* #API: |Insert into map (SM_SD)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_sd(srt_pmap *m, const srt_string *k, double v);
+
+/* #API: |Insert into map (SM_SS)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_ss(srt_pmap *m, const srt_string *k, const srt_string *v);
+
+/* #API: |Insert into map (SM_SP)|persistent map; key; value|S_TRUE: OK, S_FALSE: insertion error (e.g. not enough memory, or the map is a snapshot)|O(log n)|1;2| */
+srt_bool spm_insert_sp(srt_pmap *m, const srt_string *k, const void *v);
+
+/*
+ * Delete
+ */
+
+/* #API: |Delete map element (SM_II32)|persistent map; key|S_TRUE: found and deleted; S_FALSE: not found (or not enough memory)|O(log n)|1;2| */
+srt_bool spm_delete_i32(srt_pmap *m, int32_t k);
+
+/* #API: |Delete map element (SM_UU32)|persistent map; key|S_TRUE: found and deleted; S_FALSE: not found (or not enough memory)|O(log n)|1;2| */
+srt_bool spm_delete_u32(srt_pmap *m, uint32_t k);
+
+/* #API: |Delete map element (SM_I*)|persistent map; key|S_TRUE: found and deleted; S_FALSE: not found (or not enough memory)|O(log n)|1;2| */
+srt_bool spm_delete_i(srt_pmap *m, int64_t k);
+
+/* #API: |Delete map element (SM_FF)|persistent map; key|S_TRUE: found and deleted; S_FALSE: not found (or not enough memory)|O(log n)|1;2| */
+srt_bool spm_delete_f(srt_pmap *m, float k);
+
+/* #API: |Delete map element (SM_D*)|persistent map; key|S_TRUE: found and deleted; S_FALSE: not found (or not enough memory)|O(log n)|1;2| */
+srt_bool spm_delete_d(srt_pmap *m, double k);
+
+/* #API: |Delete map element (SM_S*)|persistent map; key|S_TRUE: found and deleted; S_FALSE: not found (or not enough memory)|O(log n)|1;2| */
+srt_bool spm_delete_s(srt_pmap *m, const srt_string *k);
+
+/*
+ * Enumeration
+ */
+
+/* #API: |Enumerate map elements in a given key range (SM_II32)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_ii32(const srt_pmap *m, int32_t key_min, int32_t key_max, srt_map_it_ii32 f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_UU32)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_uu32(const srt_pmap *m, uint32_t key_min, uint32_t key_max, srt_map_it_uu32 f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_II)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_ii(const srt_pmap *m, int64_t key_min, int64_t key_max, srt_map_it_ii f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_FF)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_ff(const srt_pmap *m, float key_min, float key_max, srt_map_it_ff f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_DD)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_dd(const srt_pmap *m, double key_min, double key_max, srt_map_it_dd f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_IS)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_is(const srt_pmap *m, int64_t key_min, int64_t key_max, srt_map_it_is f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_IP)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_ip(const srt_pmap *m, int64_t key_min, int64_t key_max, srt_map_it_ip f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_SI)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_si(const srt_pmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_si f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_DS)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_ds(const srt_pmap *m, double key_min, double key_max, srt_map_it_ds f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_DP)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_dp(const srt_pmap *m, double key_min, double key_max, srt_map_it_dp f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_SD)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_sd(const srt_pmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_sd f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_SS)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_ss(const srt_pmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_ss f, void *context);
+
+/* #API: |Enumerate map elements in a given key range (SM_SP)|persistent map or snapshot; key lower bound; key upper bound; callback function; callback function context|Elements processed|O(log n) + O(m)|1;2| */
+size_t spm_itr_sp(const srt_pmap *m, const srt_string *key_min, const srt_string *key_max, srt_map_it_sp f, void *context);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+
+#endif /* #ifndef SPMAP_H */
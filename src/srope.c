@@ -0,0 +1,352 @@
+/*
+ * srope.c
+ *
+ * Rope: chunked string (treap of srt_string chunks).
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "srope.h"
+#include "saux/scommon.h"
+
+/*
+ * Internal functions
+ */
+
+#define SR_NSIZE(t) ((t) ? (t)->size : 0)
+
+static uint32_t sr_prio(srt_rope *r)
+{
+	uint32_t x = r->seed; /* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return r->seed = x;
+}
+
+static void sr_update(struct SRopeNode *t)
+{
+	t->size = SR_NSIZE(t->l) + ss_size(t->s) + SR_NSIZE(t->r);
+}
+
+static struct SRopeNode *sr_node_alloc(srt_rope *r, const char *s, size_t n)
+{
+	struct SRopeNode *t =
+		(struct SRopeNode *)s_malloc(sizeof(struct SRopeNode));
+	RETURN_IF(!t, NULL);
+	t->s = ss_alloc(n);
+	if (ss_max_size(t->s) < n) { /* ss_void or sd_void */
+		s_free(t);
+		return NULL;
+	}
+	ss_cat_cn(&t->s, s, n);
+	t->l = t->r = NULL;
+	t->size = n;
+	t->prio = sr_prio(r);
+	return t;
+}
+
+static void sr_node_free(struct SRopeNode *t)
+{
+	if (t) {
+		sr_node_free(t->l);
+		sr_node_free(t->r);
+		ss_free(&t->s);
+		s_free(t);
+	}
+}
+
+static struct SRopeNode *sr_merge(struct SRopeNode *a, struct SRopeNode *b)
+{
+	RETURN_IF(!a, b);
+	RETURN_IF(!b, a);
+	if (a->prio >= b->prio) {
+		a->r = sr_merge(a->r, b);
+		sr_update(a);
+		return a;
+	}
+	b->l = sr_merge(a, b->l);
+	sr_update(b);
+	return b;
+}
+
+/* Split by byte offset (requires a chunk boundary at 'off', see sr_cut()) */
+static void sr_split(struct SRopeNode *t, size_t off, struct SRopeNode **a,
+		     struct SRopeNode **b)
+{
+	size_t ls;
+	if (!t) {
+		*a = *b = NULL;
+		return;
+	}
+	ls = SR_NSIZE(t->l);
+	if (off <= ls) {
+		sr_split(t->l, off, a, &t->l);
+		sr_update(t);
+		*b = t;
+	} else {
+		sr_split(t->r, off - ls - ss_size(t->s), &t->r, b);
+		sr_update(t);
+		*a = t;
+	}
+}
+
+/* Chunk containing the byte at 'off' (< rope size), with its offset */
+static struct SRopeNode *sr_find(struct SRopeNode *t, size_t off,
+				 size_t *chunk_off)
+{
+	size_t ls, cs;
+	while (t) {
+		ls = SR_NSIZE(t->l);
+		cs = ss_size(t->s);
+		if (off < ls) {
+			t = t->l;
+		} else if (off < ls + cs) {
+			*chunk_off = off - ls;
+			return t;
+		} else {
+			off -= ls + cs;
+			t = t->r;
+		}
+	}
+	return NULL;
+}
+
+/* Add 'delta' to the subtree sizes in the path to the byte at 'off' */
+static void sr_path_add(struct SRopeNode *t, size_t off, size_t delta,
+			srt_bool dec)
+{
+	size_t ls, cs;
+	while (t) {
+		ls = SR_NSIZE(t->l);
+		cs = ss_size(t->s);
+		t->size = dec ? t->size - delta : t->size + delta;
+		if (off < ls) {
+			t = t->l;
+		} else if (off < ls + cs) {
+			return;
+		} else {
+			off -= ls + cs;
+			t = t->r;
+		}
+	}
+}
+
+/* Ensure a chunk boundary at 'off', splitting the chunk if required */
+static srt_bool sr_cut(srt_rope *r, size_t off)
+{
+	size_t co = 0, tail_size;
+	struct SRopeNode *t, *n, *a, *b;
+	t = sr_find(r->root, off, &co);
+	RETURN_IF(!t || !co, S_TRUE); /* boundary already */
+	tail_size = ss_size(t->s) - co;
+	n = sr_node_alloc(r, ss_get_buffer_r(t->s) + co, tail_size);
+	RETURN_IF(!n, S_FALSE);
+	sr_path_add(r->root, off, tail_size, S_TRUE);
+	ss_resize(&t->s, co, 0);
+	sr_split(r->root, off, &a, &b);
+	r->root = sr_merge(sr_merge(a, n), b);
+	return S_TRUE;
+}
+
+/*
+ * Allocation
+ */
+
+srt_rope *sr_alloc(void)
+{
+	srt_rope *r = (srt_rope *)s_malloc(sizeof(srt_rope));
+	RETURN_IF(!r, NULL);
+	r->root = NULL;
+	r->seed = 2463534242u;
+	return r;
+}
+
+void sr_free_aux(srt_rope **r, ...)
+{
+	va_list ap;
+	srt_rope **next;
+	va_start(ap, r);
+	next = r;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			sr_node_free((*next)->root);
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_rope **)va_arg(ap, srt_rope **);
+	}
+	va_end(ap);
+}
+
+void sr_clear(srt_rope *r)
+{
+	if (r) {
+		sr_node_free(r->root);
+		r->root = NULL;
+	}
+}
+
+/*
+ * Editing
+ */
+
+srt_bool sr_insert_cn(srt_rope *r, size_t off, const char *s, size_t s_size)
+{
+	char *p;
+	size_t rs, co = 0, i, n;
+	struct SRopeNode *t, *m, *a, *b;
+	RETURN_IF(!r || (!s && s_size), S_FALSE);
+	RETURN_IF(!s_size, S_TRUE);
+	rs = sr_size(r);
+	if (off > rs)
+		off = rs; /* BEHAVIOR: append */
+	/* Small insertion: into the chunk ending or containing 'off' */
+	t = off ? sr_find(r->root, off - 1, &co) : sr_find(r->root, 0, &co);
+	if (t && ss_size(t->s) + s_size <= SR_CHUNK_MAX) {
+		co = off ? co + 1 : 0;
+		n = ss_size(t->s);
+		ss_resize(&t->s, n + s_size, 0);
+		RETURN_IF(ss_size(t->s) != n + s_size, S_FALSE);
+		p = ss_get_buffer(t->s);
+		memmove(p + co + s_size, p + co, n - co);
+		memcpy(p + co, s, s_size);
+		sr_path_add(r->root, off ? off - 1 : 0, s_size, S_FALSE);
+		return S_TRUE;
+	}
+	/* Large insertion: new chunks */
+	m = NULL;
+	for (i = 0; i < s_size; i += n) {
+		n = S_MIN(s_size - i, SR_CHUNK_MAX);
+		t = sr_node_alloc(r, s + i, n);
+		if (!t) {
+			sr_node_free(m);
+			return S_FALSE;
+		}
+		m = sr_merge(m, t);
+	}
+	if (!sr_cut(r, off)) {
+		sr_node_free(m);
+		return S_FALSE;
+	}
+	sr_split(r->root, off, &a, &b);
+	r->root = sr_merge(sr_merge(a, m), b);
+	return S_TRUE;
+}
+
+srt_bool sr_insert(srt_rope *r, size_t off, const srt_string *s)
+{
+	return sr_insert_cn(r, off, ss_get_buffer_r(s), ss_size(s));
+}
+
+srt_bool sr_cat_rope(srt_rope *r, srt_rope *r2)
+{
+	RETURN_IF(!r || !r2 || r == r2, S_FALSE);
+	r->root = sr_merge(r->root, r2->root);
+	r2->root = NULL;
+	return S_TRUE;
+}
+
+srt_bool sr_erase(srt_rope *r, size_t off, size_t n)
+{
+	char *p;
+	size_t rs, co = 0, cs;
+	struct SRopeNode *t, *a, *m, *b;
+	RETURN_IF(!r, S_FALSE);
+	rs = sr_size(r);
+	RETURN_IF(off >= rs || !n, S_TRUE);
+	n = S_MIN(n, rs - off);
+	/* Erase inside a chunk, not emptying it */
+	t = sr_find(r->root, off, &co);
+	cs = ss_size(t->s);
+	if (co + n <= cs && n < cs) {
+		p = ss_get_buffer(t->s);
+		memmove(p + co, p + co + n, cs - co - n);
+		ss_resize(&t->s, cs - n, 0);
+		sr_path_add(r->root, off, n, S_TRUE);
+		return S_TRUE;
+	}
+	RETURN_IF(!sr_cut(r, off) || !sr_cut(r, off + n), S_FALSE);
+	sr_split(r->root, off, &a, &m);
+	sr_split(m, n, &m, &b);
+	sr_node_free(m);
+	r->root = sr_merge(a, b);
+	return S_TRUE;
+}
+
+/*
+ * Access
+ */
+
+int sr_at(const srt_rope *r, size_t off)
+{
+	size_t co = 0;
+	const struct SRopeNode *t;
+	RETURN_IF(!r, 0);
+	t = sr_find(r->root, off, &co);
+	return t ? (unsigned char)ss_get_buffer_r(t->s)[co] : 0;
+}
+
+srt_string *sr_substr(srt_string **s, const srt_rope *r, size_t off, size_t n)
+{
+	srt_rope_it it;
+	const char *p;
+	size_t ps, rs;
+	RETURN_IF(!s, ss_void);
+	ss_cpy_c(s, ""); /* unshares, unlike ss_clear() */
+	rs = sr_size(r);
+	RETURN_IF(off >= rs || !n, ss_check(s));
+	n = S_MIN(n, rs - off);
+	if (ss_reserve(s, n) < n)
+		return ss_check(s);
+	sr_it_init(&it, r);
+	it.off = off;
+	while (n > 0 && sr_it_next(&it, &p, &ps)) {
+		ps = S_MIN(ps, n);
+		ss_cat_cn(s, p, ps);
+		n -= ps;
+	}
+	return ss_check(s);
+}
+
+srt_string *sr_to_ss(srt_string **s, const srt_rope *r)
+{
+	return sr_substr(s, r, 0, S_NPOS);
+}
+
+void sr_it_init(srt_rope_it *it, const srt_rope *r)
+{
+	if (it) {
+		it->r = r;
+		it->off = 0;
+	}
+}
+
+srt_bool sr_it_next(srt_rope_it *it, const char **buf, size_t *buf_size)
+{
+	size_t co = 0;
+	const struct SRopeNode *t;
+	RETURN_IF(!it || !it->r || !buf || !buf_size, S_FALSE);
+	t = sr_find(it->r->root, it->off, &co);
+	RETURN_IF(!t, S_FALSE);
+	*buf = ss_get_buffer_r(t->s) + co;
+	*buf_size = ss_size(t->s) - co;
+	it->off += *buf_size;
+	return S_TRUE;
+}
+
+ssize_t sr_write(FILE *handle, const srt_rope *r)
+{
+	srt_rope_it it;
+	const char *p;
+	size_t ps, ws = 0;
+	RETURN_IF(!handle, -1);
+	sr_it_init(&it, r);
+	while (sr_it_next(&it, &p, &ps)) {
+		if (fwrite(p, 1, ps, handle) != ps || ferror(handle))
+			return -1;
+		ws += ps;
+	}
+	return (ssize_t)ws;
+}
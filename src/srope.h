@@ -0,0 +1,141 @@
+#ifndef SROPE_H
+#define SROPE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * srope.h
+ *
+ * #SHORTDOC rope: chunked string for huge incremental concatenation and editing
+ *
+ * #DOC Rope functions handle large byte strings stored as a sequence of
+ * #DOC srt_string chunks (up to SR_CHUNK_MAX bytes each) indexed by a
+ * #DOC balanced tree (treap with implicit byte offsets). Unlike srt_string,
+ * #DOC there is no single contiguous block: appending never copies
+ * #DOC previous content, and inserting or erasing in the middle does not
+ * #DOC move the tail, being O(log n) plus the size of the inserted data.
+ * #DOC
+ * #DOC Small insertions are done into the chunk at the insertion point,
+ * #DOC when it has room for them, so e.g. appending bytes one by one
+ * #DOC does not create a chunk per byte.
+ * #DOC
+ * #DOC Two ropes can be concatenated in O(log n), moving the chunks (no
+ * #DOC data copy). Content is accessed chunk by chunk with a zero-copy
+ * #DOC iterator (e.g. for building an iovec array for writev()), written
+ * #DOC to a file with sr_write(), or flattened into a srt_string.
+ *
+ * Copyright (c) 2015-2021 F. Aragon. All rights reserved.
+ * Released under the BSD 3-Clause License (see the doc/LICENSE)
+ */
+
+#include "sstring.h"
+
+/*
+ * Structures
+ */
+
+#define SR_CHUNK_MAX 4096
+
+struct SRopeNode {
+	struct SRopeNode *l, *r; /* treap children */
+	srt_string *s;		 /* chunk */
+	size_t size;		 /* subtree size (bytes) */
+	uint32_t prio;		 /* treap priority */
+};
+
+struct SRope {
+	struct SRopeNode *root;
+	uint32_t seed; /* priority generator state */
+};
+
+typedef struct SRope srt_rope; /* Opaque structure */
+
+struct SRopeIt {
+	const srt_rope *r;
+	size_t off; /* next chunk offset */
+};
+
+typedef struct SRopeIt srt_rope_it;
+
+/*
+ * Allocation
+ */
+
+/* #API: |Allocate rope|-|rope (NULL if not enough memory)|O(1)|1;2| */
+srt_rope *sr_alloc(void);
+
+/*
+#API: |Free one or more ropes|rope; more ropes (optional)|-|O(n)|1;2|
+void sr_free(srt_rope **r, ...)
+*/
+#ifdef S_USE_VA_ARGS
+#define sr_free(...) sr_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#else
+#define sr_free(r) sr_free_aux(r, S_INVALID_PTR_VARG_TAIL)
+#endif
+void sr_free_aux(srt_rope **r, ...);
+
+/* #API: |Get rope size|rope|rope size (bytes)|O(1)|1;2| */
+S_INLINE size_t sr_size(const srt_rope *r)
+{
+	return r && r->root ? r->root->size : 0;
+}
+
+/* #API: |Clear rope content|rope|-|O(n)|1;2| */
+void sr_clear(srt_rope *r);
+
+/*
+ * Editing
+ */
+
+/* #API: |Insert bytes|rope; insertion offset (if greater than the rope size, the bytes are appended); input buffer; input buffer size|S_TRUE: OK; S_FALSE: not enough memory (no changes)|O(log n + m)|1;2| */
+srt_bool sr_insert_cn(srt_rope *r, size_t off, const char *s, size_t s_size);
+
+/* #API: |Insert string|rope; insertion offset (if greater than the rope size, the string is appended); input string|S_TRUE: OK; S_FALSE: not enough memory (no changes)|O(log n + m)|1;2| */
+srt_bool sr_insert(srt_rope *r, size_t off, const srt_string *s);
+
+/* #API: |Append bytes|rope; input buffer; input buffer size|S_TRUE: OK; S_FALSE: not enough memory (no changes)|O(log n + m)|1;2| */
+S_INLINE srt_bool sr_cat_cn(srt_rope *r, const char *s, size_t s_size)
+{
+	return sr_insert_cn(r, S_NPOS, s, s_size);
+}
+
+/* #API: |Append string|rope; input string|S_TRUE: OK; S_FALSE: not enough memory (no changes)|O(log n + m)|1;2| */
+S_INLINE srt_bool sr_cat(srt_rope *r, const srt_string *s)
+{
+	return sr_insert(r, S_NPOS, s);
+}
+
+/* #API: |Append rope, moving its chunks (no data copy)|rope; rope to be appended (left empty, it must be a different rope)|S_TRUE: OK; S_FALSE: invalid input|O(log n)|1;2| */
+srt_bool sr_cat_rope(srt_rope *r, srt_rope *r2);
+
+/* #API: |Erase bytes|rope; offset; number of bytes|S_TRUE: OK; S_FALSE: not enough memory (no changes)|O(log n + erased chunks)|1;2| */
+srt_bool sr_erase(srt_rope *r, size_t off, size_t n);
+
+/*
+ * Access
+ */
+
+/* #API: |Get byte at offset|rope; offset|byte (0 if out of bounds)|O(log n)|1;2| */
+int sr_at(const srt_rope *r, size_t off);
+
+/* #API: |Overwrite string with a rope portion|output string; rope; offset; number of bytes (S_NPOS for up to the end)|output string|O(log n + m)|1;2| */
+srt_string *sr_substr(srt_string **s, const srt_rope *r, size_t off, size_t n);
+
+/* #API: |Overwrite string with the rope content (flatten)|output string; rope|output string|O(n)|1;2| */
+srt_string *sr_to_ss(srt_string **s, const srt_rope *r);
+
+/* #API: |Initialize chunk iterator (the rope must not be modified while iterating)|iterator; rope|-|O(1)|1;2| */
+void sr_it_init(srt_rope_it *it, const srt_rope *r);
+
+/* #API: |Get next chunk (zero-copy)|iterator; output chunk buffer; output chunk size|S_TRUE: chunk available; S_FALSE: end of rope|O(log n)|1;2| */
+srt_bool sr_it_next(srt_rope_it *it, const char **buf, size_t *buf_size);
+
+/* #API: |Write rope to file, chunk by chunk (no flattening)|file handle; rope|Number of bytes written; < 0: error|O(n)|1;2| */
+ssize_t sr_write(FILE *handle, const srt_rope *r);
+
+#ifdef __cplusplus
+} /* extern "C" { */
+#endif
+#endif /* #ifndef SROPE_H */
@@ -12,6 +12,7 @@
 #include "saux/scommon.h"
 #include "saux/senc.h"
 #include "saux/shash.h"
+#include "saux/snum.h"
 #include "saux/ssearch.h"
 
 /*
@@ -48,7 +49,7 @@ size_t dbg_cnt_alloc_calls = 0; /* debug alloc/realloc calls */
 	TYPE *next = s1
 
 #define SS_COPYCAT_AUX(s, cat, TYPE, s1, STRLEN, SS_CAT_XN)                    \
-	for (; s1;) {                                                          \
+	for (; s1 && ss_cow(s, cat);) {                                        \
 		va_start(ap, s1);                                              \
 		while (!s_varg_tail_ptr_tag(next)) { /* last el. tag */        \
 			next = (TYPE *)va_arg(ap, TYPE *);                     \
@@ -223,11 +224,60 @@ static srt_string *ss_reset(srt_string *s)
 	return s;
 }
 
+/*
+ * Shared strings: the reference counter is stored after the data (and the
+ * C terminator), aligned. As shared strings are immutable, its location
+ * does not change while shared.
+ */
+static long *ss_refs_addr(const srt_string *s)
+{
+	size_t off = sdx_header_size(&s->d) + ss_size(s) + 1;
+	off = (off + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+	return (long *)((char *)s + off);
+}
+
+/*
+ * Copy-on-write: called before modifying a string. If shared, and there
+ * are other references, it is replaced by a private copy (or by an empty
+ * string, if 'keep' is false, i.e. the content is going to be
+ * overwritten). The last reference takes the buffer, with no copy.
+ */
+static srt_bool ss_cow(srt_string **s, srt_bool keep)
+{
+	long *refs;
+	size_t ss;
+	srt_string *c;
+	RETURN_IF(!s || !ss_is_shared(*s), S_TRUE);
+	refs = ss_refs_addr(*s);
+	if (S_ATOMIC_GET(refs) > 1) {
+		ss = keep ? ss_size(*s) : 0;
+		c = ss_alloc(ss);
+		RETURN_IF(ss_max_size(c) < ss
+				  || c->d.f.st_mode == SData_VoidData,
+			  S_FALSE); /* not enough memory */
+		if (keep) {
+			memcpy(ss_get_buffer(c), ss_get_buffer_r(*s), ss);
+			ss_set_size(c, ss);
+			set_unicode_size(c, get_unicode_size(*s));
+			set_encoding_errors(c, has_encoding_errors(*s));
+		}
+		if (S_ATOMIC_DEC(refs) > 0) {
+			*s = c;
+			return S_TRUE;
+		}
+		/* Other references released meanwhile: take the buffer */
+		ss_free(&c);
+	}
+	(*s)->d.f.ext_buffer = 0;
+	(*s)->d.f.flag4 = 0;
+	return S_TRUE;
+}
+
 size_t ss_reserve(srt_string **s, size_t max_size)
 {
 	srt_bool full_st;
 	size_t ss, unicode_size, r;
-	RETURN_IF(!s, 0);
+	RETURN_IF(!s || !ss_cow(s, S_TRUE), 0);
 	if (!*s) {
 		*s = ss_alloc(max_size);
 		RETURN_IF(!(*s), 0);
@@ -250,7 +300,7 @@ size_t ss_grow(srt_string **s, size_t extra_size)
 {
 	srt_bool full_st;
 	size_t size, unicode_size, new_size;
-	RETURN_IF(!s, 0);
+	RETURN_IF(!s || !ss_cow(s, S_TRUE), 0);
 	RETURN_IF(!(*s), ss_reserve(s, extra_size));
 	size = ss_size(*s);
 	if (s_size_t_overflow(size, extra_size)) {
@@ -301,7 +351,10 @@ static srt_string *ss_cat_aliasing(srt_string **s, const srt_string *s0,
 	return src == s0 ? ss_cat_cn_raw(s, ss_get_buffer(*s), 0, s0_size,
 					 s0_unicode_size)
 			 : ss_cat_cn_raw(s, ss_get_buffer_r(src), 0,
-					 ss_size(src), get_unicode_size(src));
+					 ss_size(src),
+					 is_unicode_size_cached(src)
+						 ? get_unicode_size(src)
+						 : 0);
 }
 
 static size_t get_cmp_size(const srt_string *s1, const srt_string *s2)
@@ -328,35 +381,50 @@ static size_t ss_utf8_to_wc(const char *s, size_t off, size_t max_off,
 	return csize;
 }
 
-static srt_string *aux_toint(srt_string **s, srt_bool cat, int64_t num)
+/* Number formatted as text (ASCII, 'n' bytes at 'b') */
+static srt_string *aux_tonum(srt_string **s, srt_bool cat, const char *b,
+			     size_t n)
 {
-	int64_t n;
-	char *p, btmp[128];
-	size_t off, digits, at, out_size;
+	size_t at, out_size;
 	ASSERT_RETURN_IF(!s, ss_void);
-	p = btmp + sizeof(btmp) - 1;
-	n = num < 0 ? -num : num;
-	do {
-		*p-- = '0' + n % 10;
-		n /= 10;
-	} while (n);
-	if (num < 0)
-		*p-- = '-';
-	off = (size_t)((p - (char *)btmp) + 1);
-	digits = sizeof(btmp) - off;
+	RETURN_IF(!ss_cow(s, cat), *s);
 	at = (cat && *s) ? ss_size(*s) : 0;
-	SS_OVERFLOW_CHECK(s, at, digits);
-	out_size = s_size_t_add(at, digits, S_NPOS);
+	SS_OVERFLOW_CHECK(s, at, n);
+	out_size = s_size_t_add(at, n, S_NPOS);
 	if (ss_reserve(s, out_size) >= out_size && *s) {
 		if (!cat)
 			ss_reset(*s);
-		memcpy(ss_get_buffer(*s) + at, btmp + off, digits);
+		memcpy(ss_get_buffer(*s) + at, b, n);
 		ss_set_size(*s, out_size);
-		inc_unicode_size(*s, digits);
+		inc_unicode_size(*s, n);
 	}
 	return *s;
 }
 
+static srt_string *aux_toint(srt_string **s, srt_bool cat, int64_t num)
+{
+	char b[SNUM_I64_MAX];
+	return aux_tonum(s, cat, b, snum_i64toa(num, b));
+}
+
+static srt_string *aux_touint(srt_string **s, srt_bool cat, uint64_t num)
+{
+	char b[SNUM_U64_MAX];
+	return aux_tonum(s, cat, b, snum_u64toa(num, b));
+}
+
+static srt_string *aux_todouble(srt_string **s, srt_bool cat, double num)
+{
+	char b[SNUM_DTOA_MAX];
+	return aux_tonum(s, cat, b, snum_dtoa(num, b));
+}
+
+static srt_string *aux_tofloat(srt_string **s, srt_bool cat, float num)
+{
+	char b[SNUM_DTOA_MAX];
+	return aux_tonum(s, cat, b, snum_ftoa(num, b));
+}
+
 static srt_string *aux_toXcase(srt_string **s, srt_bool cat,
 			       const srt_string *src, int32_t (*towX)(int32_t))
 {
@@ -371,6 +439,7 @@ static srt_string *aux_toXcase(srt_string **s, srt_bool cat,
 	size_t i2;
 #endif
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	ss = ss_size(src);
@@ -477,8 +546,14 @@ static srt_string *aux_toXcase(srt_string **s, srt_bool cat,
  * aliasing case without extra memory allocation nor shift.
  */
 
-static srt_string *aux_toenc(srt_string **s, srt_bool cat,
-			     const srt_string *src, srt_enc_f f, srt_enc_f2 f2)
+typedef size_t (*srt_enc_ctx_f)(struct SLzCtx *c, const uint8_t *s, size_t ss,
+			       uint8_t *o);
+
+/* Encoding with 'f', 'f2', or 'fc' (with context 'c') */
+static srt_string *aux_toenc_ctx(srt_string **s, srt_bool cat,
+				 const srt_string *src, srt_enc_f f,
+				 srt_enc_f2 f2, srt_enc_ctx_f fc,
+				 struct SLzCtx *c)
 {
 	srt_bool aliasing;
 	srt_string *src_aux;
@@ -487,6 +562,7 @@ static srt_string *aux_toenc(srt_string **s, srt_bool cat,
 	const unsigned char *src_buf, *s_in;
 	size_t in_size, at, enc_size, out_size;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	aliasing = *s == src ? S_TRUE : S_FALSE;
@@ -494,7 +570,8 @@ static srt_string *aux_toenc(srt_string **s, srt_bool cat,
 	in_size = ss_size(src);
 	at = (cat && *s) ? ss_size(*s) : 0;
 	enc_size = f ? f(src_buf, in_size, NULL)
-		     : f2 ? f2(src_buf, in_size, NULL, 0) : 0;
+		     : f2 ? f2(src_buf, in_size, NULL, 0)
+			  : fc ? fc(c, src_buf, in_size, NULL) : 0;
 	out_size = s_size_t_add(at, enc_size, S_NPOS);
 	if (enc_size > 0 && ss_reserve(s, out_size) >= out_size) {
 		src_aux = NULL;
@@ -503,7 +580,8 @@ static srt_string *aux_toenc(srt_string **s, srt_bool cat,
 			 * For functions not supporting aliasing, use a
 			 * copy for the input
 			 */
-			if (f == senc_lz || f == sdec_lz || f == senc_lzh) {
+			if (f == sdec_lz || f == sdec_lze
+			    || senc_lz_level(f) >= 0 || fc) {
 				ss_cpy(&src_aux, *s);
 				src1 = src_aux;
 			} else
@@ -514,7 +592,8 @@ static srt_string *aux_toenc(srt_string **s, srt_bool cat,
 		s_in = (const unsigned char *)ss_get_buffer_r(src1);
 		s_out = (unsigned char *)ss_get_buffer(*s) + at;
 		enc_size = f ? f(s_in, in_size, s_out)
-			     : f2(s_in, in_size, s_out, enc_size);
+			     : f2 ? f2(s_in, in_size, s_out, enc_size)
+				  : fc(c, s_in, in_size, s_out);
 		if (at == 0) {
 			set_unicode_size_cached(*s, S_TRUE);
 			set_unicode_size(*s, in_size * 2);
@@ -534,6 +613,12 @@ static srt_string *aux_toenc(srt_string **s, srt_bool cat,
 	return ss_check(s);
 }
 
+static srt_string *aux_toenc(srt_string **s, srt_bool cat,
+			     const srt_string *src, srt_enc_f f, srt_enc_f2 f2)
+{
+	return aux_toenc_ctx(s, cat, src, f, f2, NULL, NULL);
+}
+
 static srt_string *aux_erase(srt_string **s, srt_bool cat,
 			     const srt_string *src, size_t off, size_t n)
 {
@@ -541,6 +626,7 @@ static srt_string *aux_erase(srt_string **s, srt_bool cat,
 	srt_bool overflow;
 	size_t ss0, at, src_size, copy_size, out_size;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	ss0 = ss_size(src);
@@ -579,6 +665,7 @@ static srt_string *aux_erase_u(srt_string **s, srt_bool cat,
 	size_t sso0, ss0, head_size, actual_n, cus, cut_size, tail_size,
 		out_size, prefix_usize, at;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	ps = ss_get_buffer_r(src);
@@ -635,6 +722,7 @@ static srt_string *aux_replace(srt_string **s, srt_bool cat,
 	typedef void *(*memcpy_t)(void *, const void *, size_t);
 	memcpy_t f_cpy;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!s1)
 		s1 = ss_void;
 	if (!s2)
@@ -731,6 +819,7 @@ static srt_string *aux_resize(srt_string **s, srt_bool cat,
 	srt_bool aliasing;
 	size_t src_size, at, out_size;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	src_size = ss_size(src);
@@ -770,6 +859,7 @@ static srt_string *aux_resize_u(srt_string **s, srt_bool cat, srt_string *src,
 	size_t at, char_size, current_u_chars, srcs, new_elems, at_inc,
 		out_size, i, actual_unicode_count, head_size;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	at = (cat && *s) ? ss_size(*s) : 0;
@@ -828,6 +918,7 @@ static srt_string *aux_ltrim(srt_string **s, srt_bool cat,
 	srt_bool aliasing;
 	size_t ss, at, cat_usize, i, out_size;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	ss = ss_size(src);
@@ -879,6 +970,7 @@ static srt_string *aux_rtrim(srt_string **s, srt_bool cat,
 	srt_bool aliasing;
 	size_t ss, at, i, nspaces, copy_size, out_size, cat_usize;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src), *s);
 	if (!src)
 		src = ss_void;
 	ss = ss_size(src);
@@ -923,7 +1015,7 @@ static ssize_t aux_read(srt_string **s, srt_bool cat, FILE *h, size_t max_bytes)
 	char *sc;
 	ssize_t l = 0;
 	size_t ss, off, max_off, def_buf, buf_size, cap, l0;
-	if (s && h && max_bytes > 0) {
+	if (s && h && max_bytes > 0 && ss_cow(s, cat)) {
 		ss = ss_size(*s);
 		off = cat ? ss : 0;
 		max_off = s_size_t_overflow(off, max_bytes) ? S_NPOS
@@ -1008,6 +1100,7 @@ static ssize_t aux_read(srt_string **s, srt_bool cat, FILE *h, size_t max_bytes)
 	MK_SS_CODEC(ss_##suffix, f1, f2)
 
 MK_SS_DUP_CPY_CAT(enc_b64, senc_b64, NULL)
+MK_SS_DUP_CPY_CAT(enc_b64url, senc_b64url, NULL)
 MK_SS_DUP_CPY_CAT(enc_hex, senc_hex, NULL)
 MK_SS_DUP_CPY_CAT(enc_HEX, senc_HEX, NULL)
 MK_SS_DUP_CPY_CAT(enc_lz, senc_lz, NULL)
@@ -1021,12 +1114,262 @@ MK_SS_DUP_CPY_CAT(enc_esc_squote, NULL, senc_esc_squote)
 MK_SS_DUP_CPY_CAT(dec_b64, sdec_b64, NULL)
 MK_SS_DUP_CPY_CAT(dec_hex, sdec_hex, NULL)
 MK_SS_DUP_CPY_CAT(dec_lz, sdec_lz, NULL)
+MK_SS_DUP_CPY_CAT(dec_lze, sdec_lze, NULL)
 MK_SS_DUP_CPY_CAT(dec_esc_xml, sdec_esc_xml, NULL)
 MK_SS_DUP_CPY_CAT(dec_esc_json, sdec_esc_json, NULL)
 MK_SS_DUP_CPY_CAT(dec_esc_url, sdec_esc_url, NULL)
 MK_SS_DUP_CPY_CAT(dec_esc_dquote, sdec_esc_dquote, NULL)
 MK_SS_DUP_CPY_CAT(dec_esc_squote, sdec_esc_squote, NULL)
 
+srt_string *ss_cpy_dec_b64_chk(srt_string **s, const srt_string *src,
+			       srt_bool url, size_t *inv_off)
+{
+	srt_bool aliasing;
+	size_t in_size, out_size;
+	if (inv_off)
+		*inv_off = S_NPOS;
+	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, *s == src), *s);
+	if (!src)
+		src = ss_void;
+	aliasing = *s == src ? S_TRUE : S_FALSE; /* safe: forward decoding */
+	in_size = ss_size(src);
+	out_size = sdec_b64_chk(NULL, in_size, NULL, url, NULL);
+	if (ss_reserve(s, out_size) < out_size)
+		return ss_check(s);
+	out_size = sdec_b64_chk(
+		(const uint8_t *)ss_get_buffer_r(aliasing ? *s : src), in_size,
+		(uint8_t *)ss_get_buffer(*s), url, inv_off);
+	ss_set_size(*s, out_size);
+	set_unicode_size_cached(*s, S_FALSE);
+	return ss_check(s);
+}
+
+/*
+ * LZ encoding context
+ */
+
+srt_lz_ctx *ss_lz_ctx_alloc(void)
+{
+	return senc_lz_ctx_alloc();
+}
+
+void ss_lz_ctx_free_aux(srt_lz_ctx **c, ...)
+{
+	va_list ap;
+	srt_lz_ctx **next;
+	va_start(ap, c);
+	next = c;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			senc_lz_ctx_free(*next);
+			*next = NULL;
+		}
+		next = (srt_lz_ctx **)va_arg(ap, srt_lz_ctx **);
+	}
+	va_end(ap);
+}
+
+/* BEHAVIOR: with no context, the same as the functions with no context */
+#define MK_SS_CPY_CAT_CTX(suffix, fc, f)                                       \
+	srt_string *ss_cpy_##suffix##_ctx(srt_string **s,                      \
+					  const srt_string *src,               \
+					  srt_lz_ctx *c)                       \
+	{                                                                      \
+		return c ? aux_toenc_ctx(s, S_FALSE, src, NULL, NULL, fc, c)   \
+			 : aux_toenc(s, S_FALSE, src, f, NULL);                \
+	}                                                                      \
+	srt_string *ss_cat_##suffix##_ctx(srt_string **s,                      \
+					  const srt_string *src,               \
+					  srt_lz_ctx *c)                       \
+	{                                                                      \
+		return c ? aux_toenc_ctx(s, S_TRUE, src, NULL, NULL, fc, c)    \
+			 : aux_toenc(s, S_TRUE, src, f, NULL);                 \
+	}                                                                      \
+	srt_string *ss_##suffix##_ctx(srt_string **s, const srt_string *src,   \
+				      srt_lz_ctx *c)                           \
+	{                                                                      \
+		return ss_cpy_##suffix##_ctx(s, src, c);                       \
+	}
+
+MK_SS_CPY_CAT_CTX(enc_lz, senc_lz_ctx, senc_lz)
+MK_SS_CPY_CAT_CTX(enc_lzh, senc_lzh_ctx, senc_lzh)
+
+/*
+ * LZ compression levels
+ */
+
+srt_string *ss_dup_enc_lz_lvl(const srt_string *src, int level)
+{
+	srt_string *s = NULL;
+	return ss_cpy_enc_lz_lvl(&s, src, level);
+}
+
+srt_string *ss_cpy_enc_lz_lvl(srt_string **s, const srt_string *src,
+			      int level)
+{
+	return aux_toenc(s, S_FALSE, src, senc_lz_lvl_f(level), NULL);
+}
+
+srt_string *ss_cat_enc_lz_lvl(srt_string **s, const srt_string *src,
+			      int level)
+{
+	return aux_toenc(s, S_TRUE, src, senc_lz_lvl_f(level), NULL);
+}
+
+srt_string *ss_enc_lz_lvl(srt_string **s, const srt_string *src, int level)
+{
+	return ss_cpy_enc_lz_lvl(s, src, level);
+}
+
+srt_string *ss_dup_enc_lze(const srt_string *src, int level)
+{
+	srt_string *s = NULL;
+	return ss_cpy_enc_lze(&s, src, level);
+}
+
+srt_string *ss_cpy_enc_lze(srt_string **s, const srt_string *src, int level)
+{
+	return aux_toenc(s, S_FALSE, src, senc_lze_lvl_f(level), NULL);
+}
+
+srt_string *ss_cat_enc_lze(srt_string **s, const srt_string *src, int level)
+{
+	return aux_toenc(s, S_TRUE, src, senc_lze_lvl_f(level), NULL);
+}
+
+srt_string *ss_enc_lze(srt_string **s, const srt_string *src, int level)
+{
+	return ss_cpy_enc_lze(s, src, level);
+}
+
+/*
+ * LZ dictionary compression
+ */
+
+srt_string *ss_lz_dict_train(srt_string **dict, const srt_string *samples,
+			     const size_t *sizes, size_t n, size_t max_size)
+{
+	srt_string *src_aux = NULL;
+	const uint8_t *in;
+	size_t ds;
+	ASSERT_RETURN_IF(!dict, ss_void);
+	RETURN_IF(!ss_cow(dict, *dict == samples), *dict);
+	if (!samples)
+		samples = ss_void;
+	if (*dict == samples) { /* BEHAVIOR: aliasing: copy the samples */
+		ss_cpy(&src_aux, samples);
+		samples = src_aux;
+	}
+	in = (const uint8_t *)ss_get_buffer_r(samples);
+	ds = senc_lz_dict_train(in, ss_size(samples), sizes, n, NULL,
+				max_size);
+	if (ss_reserve(dict, ds) >= ds) {
+		ds = senc_lz_dict_train(in, ss_size(samples), sizes, n,
+					(uint8_t *)ss_get_buffer(*dict),
+					max_size);
+		ss_set_size(*dict, ds);
+		set_unicode_size_cached(*dict, S_FALSE);
+	}
+	if (src_aux)
+		ss_free(&src_aux);
+	return ss_check(dict);
+}
+
+static srt_string *aux_lz_dict(srt_string **s, srt_bool cat,
+			       const srt_string *src, const srt_string *dict,
+			       int level, srt_bool dec)
+{
+	srt_string *src_aux = NULL, *dict_aux = NULL;
+	const uint8_t *in, *d;
+	uint8_t *o;
+	size_t in_size, ds, at, out_size, os;
+	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, cat || *s == src || *s == dict), *s);
+	if (!src)
+		src = ss_void;
+	if (!dict)
+		dict = ss_void;
+	/* BEHAVIOR: aliasing: copy the input */
+	if (*s == src) {
+		ss_cpy(&src_aux, src);
+		src = src_aux;
+	}
+	if (*s == dict) {
+		ss_cpy(&dict_aux, dict);
+		dict = dict_aux;
+	}
+	in = (const uint8_t *)ss_get_buffer_r(src);
+	in_size = ss_size(src);
+	d = (const uint8_t *)ss_get_buffer_r(dict);
+	ds = ss_size(dict);
+	at = (cat && *s) ? ss_size(*s) : 0;
+	os = dec ? sdec_lz_xdict(d, ds, in, in_size, NULL)
+		 : senc_lz_xdict(d, ds, in, in_size, NULL, level);
+	out_size = s_size_t_add(at, os, S_NPOS);
+	if (os > 0 && ss_reserve(s, out_size) >= out_size) {
+		o = (uint8_t *)ss_get_buffer(*s) + at;
+		os = dec ? sdec_lz_xdict(d, ds, in, in_size, o)
+			 : senc_lz_xdict(d, ds, in, in_size, o, level);
+		ss_set_size(*s, at + os);
+		set_unicode_size_cached(*s, S_FALSE);
+	}
+	if (src_aux)
+		ss_free(&src_aux);
+	if (dict_aux)
+		ss_free(&dict_aux);
+	return ss_check(s);
+}
+
+srt_string *ss_dup_enc_lz_dict(const srt_string *src, const srt_string *dict,
+			       int level)
+{
+	srt_string *s = NULL;
+	return ss_cpy_enc_lz_dict(&s, src, dict, level);
+}
+
+srt_string *ss_cpy_enc_lz_dict(srt_string **s, const srt_string *src,
+			       const srt_string *dict, int level)
+{
+	return aux_lz_dict(s, S_FALSE, src, dict, level, S_FALSE);
+}
+
+srt_string *ss_cat_enc_lz_dict(srt_string **s, const srt_string *src,
+			       const srt_string *dict, int level)
+{
+	return aux_lz_dict(s, S_TRUE, src, dict, level, S_FALSE);
+}
+
+srt_string *ss_enc_lz_dict(srt_string **s, const srt_string *src,
+			   const srt_string *dict, int level)
+{
+	return ss_cpy_enc_lz_dict(s, src, dict, level);
+}
+
+srt_string *ss_dup_dec_lz_dict(const srt_string *src, const srt_string *dict)
+{
+	srt_string *s = NULL;
+	return ss_cpy_dec_lz_dict(&s, src, dict);
+}
+
+srt_string *ss_cpy_dec_lz_dict(srt_string **s, const srt_string *src,
+			       const srt_string *dict)
+{
+	return aux_lz_dict(s, S_FALSE, src, dict, 0, S_TRUE);
+}
+
+srt_string *ss_cat_dec_lz_dict(srt_string **s, const srt_string *src,
+			       const srt_string *dict)
+{
+	return aux_lz_dict(s, S_TRUE, src, dict, 0, S_TRUE);
+}
+
+srt_string *ss_dec_lz_dict(srt_string **s, const srt_string *src,
+			   const srt_string *dict)
+{
+	return ss_cpy_dec_lz_dict(s, src, dict);
+}
+
 /*
  * Allocation
  */
@@ -1076,6 +1419,67 @@ const srt_string *ss_ref_buf(srt_string_ref *s_ref, const char *buf,
 	return aux_ss_ref_raw(s_ref, buf, buf_size, S_FALSE);
 }
 
+void ss_free_aux(srt_string **s, ...)
+{
+	va_list ap;
+	srt_string **next;
+	va_start(ap, s);
+	next = s;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && ss_is_shared(*next)) {
+			if (S_ATOMIC_DEC(ss_refs_addr(*next)) == 0)
+				s_free(*next);
+			*next = NULL;
+		} else if (next) {
+			sd_free((srt_data **)next);
+		}
+		next = (srt_string **)va_arg(ap, srt_string **);
+	}
+	va_end(ap);
+}
+
+/*
+ * Shared strings (copy-on-write)
+ */
+
+srt_bool ss_set_shared(srt_string **s)
+{
+	size_t as, rs;
+	srt_string *s2;
+	RETURN_IF(!s || !*s || (*s)->d.f.st_mode == SData_VoidData, S_FALSE);
+	RETURN_IF(ss_is_shared(*s), S_TRUE);
+	RETURN_IF((*s)->d.f.ext_buffer, S_FALSE); /* stack or reference */
+	/*
+	 * BEHAVIOR: the Unicode size is cached before sharing, as no
+	 * writes are allowed afterwards (not even for caching)
+	 */
+	ss_len_u(*s);
+	as = sdx_alloc_size(&(*s)->d) + 1;
+	rs = (size_t)((char *)ss_refs_addr(*s) - (char *)*s) + sizeof(long);
+	if (rs > as) {
+		s2 = (srt_string *)s_realloc(*s, rs);
+		RETURN_IF(!s2, S_FALSE); /* not enough memory */
+		*s = s2;
+	}
+	ss_get_buffer(*s)[ss_size(*s)] = 0; /* for ss_to_c() */
+	*ss_refs_addr(*s) = 1;
+	(*s)->d.f.ext_buffer = 1; /* BEHAVIOR: no resize while shared */
+	(*s)->d.f.flag4 = 1;
+	return S_TRUE;
+}
+
+srt_string *ss_unshare(srt_string **s)
+{
+	RETURN_IF(!s, ss_void);
+	ss_cow(s, S_TRUE);
+	return ss_check(s);
+}
+
+size_t ss_shared_refs(const srt_string *s)
+{
+	return ss_is_shared(s) ? (size_t)S_ATOMIC_GET(ss_refs_addr(s)) : 0;
+}
+
 /*
  * Accessors
  */
@@ -1124,7 +1528,9 @@ size_t ss_len_u(const srt_string *s)
 
 size_t ss_max(const srt_string *s)
 {
-	return !s ? 0 : s->d.f.ext_buffer ? ss_max_size(s) : SS_RANGE;
+	return !s ? 0
+		  : s->d.f.ext_buffer && !ss_is_shared(s) ? ss_max_size(s)
+							  : SS_RANGE;
 }
 
 S_INLINE size_t ss_real_off(const srt_string *s, size_t off)
@@ -1134,12 +1540,15 @@ S_INLINE size_t ss_real_off(const srt_string *s, size_t off)
 
 srt_bool ss_encoding_errors(const srt_string *s)
 {
-	return s && has_encoding_errors(s) ? S_TRUE : S_FALSE;
+	RETURN_IF(!s, S_FALSE);
+	if (!is_unicode_size_cached(s))
+		(void)ss_len_u(s); /* validation, on cold cache */
+	return has_encoding_errors(s) ? S_TRUE : S_FALSE;
 }
 
 void ss_clear_errors(srt_string *s)
 {
-	if (s) {
+	if (s && !ss_is_shared(s)) { /* BEHAVIOR: shared strings unchanged */
 		ss_reset_alloc_errors(s);
 		set_encoding_errors(s, S_FALSE);
 	}
@@ -1153,6 +1562,10 @@ void ss_clear_errors(srt_string *s)
 srt_string *ss_dup(const srt_string *src)
 {
 	srt_string *s = NULL;
+	if (ss_is_shared(src)) {
+		S_ATOMIC_INC(ss_refs_addr(src));
+		return (srt_string *)src;
+	}
 	return ss_cpy(&s, src);
 }
 
@@ -1192,6 +1605,24 @@ srt_string *ss_dup_int(int64_t num)
 	return ss_cpy_int(&s, num);
 }
 
+srt_string *ss_dup_uint(uint64_t num)
+{
+	srt_string *s = NULL;
+	return ss_cpy_uint(&s, num);
+}
+
+srt_string *ss_dup_double(double num)
+{
+	srt_string *s = NULL;
+	return ss_cpy_double(&s, num);
+}
+
+srt_string *ss_dup_float(float num)
+{
+	srt_string *s = NULL;
+	return ss_cpy_float(&s, num);
+}
+
 srt_string *ss_dup_tolower(const srt_string *src)
 {
 	srt_string *s = NULL;
@@ -1295,6 +1726,12 @@ srt_string *ss_cpy(srt_string **s, const srt_string *src)
 {
 	RETURN_IF(!s, ss_void);
 	RETURN_IF(*s == src && ss_check(s), *s); /* aliasing, same string */
+	if (ss_is_shared(src)
+	    && (!*s || !(*s)->d.f.ext_buffer || ss_is_shared(*s))) {
+		ss_free(s);
+		return *s = ss_dup(src);
+	}
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
 	ss_clear(*s);
 	RETURN_IF(!src, *s); /* BEHAVIOR: empty */
 	return ss_cat(s, src);
@@ -1306,6 +1743,7 @@ srt_string *ss_cpy_substr(srt_string **s, const srt_string *src, size_t off,
 	char *ps;
 	size_t ss, copy_size;
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, *s == src), *s);
 	RETURN_IF(!src || !n, ss_reset(*s)); /* BEHAVIOR: empty */
 	if (*s == src) {		     /* aliasing */
 		ps = ss_get_buffer(*s);
@@ -1329,6 +1767,7 @@ srt_string *ss_cpy_substr_u(srt_string **s, const srt_string *src,
 	char *ps;
 	size_t actual_unicode_count, ss, off, n_size, copy_size;
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, *s == src), *s);
 	RETURN_IF(!src || !n, ss_reset(*s)); /* BEHAVIOR: empty */
 	if (*s == src) {		     /* aliasing */
 		ps = ss_get_buffer(*s);
@@ -1358,6 +1797,7 @@ srt_string *ss_cpy_substr_u(srt_string **s, const srt_string *src,
 srt_string *ss_cpy_cn(srt_string **s, const char *src, size_t src_size)
 {
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
 	ss_clear(*s);
 	RETURN_IF(!src || !src_size, *s); /* BEHAVIOR: empty */
 	ss_cat_cn(s, src, src_size);
@@ -1375,6 +1815,7 @@ srt_string *ss_cpy_c_aux(srt_string **s, const char *s1, ...)
 srt_string *ss_cpy_wn(srt_string **s, const wchar_t *src, size_t src_size)
 {
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
 	ss_clear(*s);
 	return ss_cat_wn(s, src, src_size);
 }
@@ -1392,6 +1833,21 @@ srt_string *ss_cpy_int(srt_string **s, int64_t num)
 	return aux_toint(s, S_FALSE, num);
 }
 
+srt_string *ss_cpy_uint(srt_string **s, uint64_t num)
+{
+	return aux_touint(s, S_FALSE, num);
+}
+
+srt_string *ss_cpy_double(srt_string **s, double num)
+{
+	return aux_todouble(s, S_FALSE, num);
+}
+
+srt_string *ss_cpy_float(srt_string **s, float num)
+{
+	return aux_tofloat(s, S_FALSE, num);
+}
+
 srt_string *ss_cpy_tolower(srt_string **s, const srt_string *src)
 {
 	return aux_toXcase(s, S_FALSE, src, fsc_tolower);
@@ -1453,6 +1909,7 @@ srt_string *ss_cpy_printf(srt_string **s, size_t size, const char *fmt, ...)
 {
 	va_list ap;
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
 	RETURN_IF((!size || !fmt) && ss_reset(*s), *s);
 	if (*s) {
 		ss_reserve(s, size);
@@ -1468,6 +1925,7 @@ srt_string *ss_cpy_printf_va(srt_string **s, size_t size, const char *fmt,
 			     va_list ap)
 {
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
 	RETURN_IF((!size || !fmt) && ss_reset(*s), *s);
 	if (*s) {
 		ss_reserve(s, size);
@@ -1479,6 +1937,7 @@ srt_string *ss_cpy_printf_va(srt_string **s, size_t size, const char *fmt,
 srt_string *ss_cpy_char(srt_string **s, int c)
 {
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
 	ss_clear(*s);
 	if (ss_reserve(s, SSU8_MAX_SIZE) >= SSU8_MAX_SIZE)
 		return ss_cat_char(s, c);
@@ -1501,6 +1960,7 @@ srt_string *ss_cat_aux(srt_string **s, const srt_string *s1, ...)
 	const srt_string *next, *s0;
 	size_t extra_size, nargs, ss0, uss0, i;
 	RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_TRUE), *s);
 	if (s1 && ss_size(s1) > 0) {
 		extra_size = nargs = 0;
 		next = s1;
@@ -1538,6 +1998,7 @@ srt_string *ss_cat_substr(srt_string **s, const srt_string *src, size_t sub_off,
 	const char *src_str, *src_aux;
 	size_t src_unicode_size, srcs, sub_size, src_off;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_TRUE), *s);
 	RETURN_IF(!src || !sub_size0, ss_check(s)); /* no changes */
 	src_str = NULL;
 	srcs = ss_size(src);
@@ -1566,6 +2027,7 @@ srt_string *ss_cat_substr_u(srt_string **s, const srt_string *src,
 	const char *psrc;
 	size_t ssrc, off_size, actual_n, copy_size;
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_TRUE), *s);
 	if (src) {
 		psrc = ss_get_buffer_r(src);
 		ssrc = ss_size(src);
@@ -1584,7 +2046,21 @@ srt_string *ss_cat_substr_u(srt_string **s, const srt_string *src,
 
 srt_string *ss_cat_cn(srt_string **s, const char *src, size_t src_size)
 {
-	return ss_cat_cn_raw(s, src, 0, src_size, 0);
+	size_t src_usize, enc_errors;
+	ASSERT_RETURN_IF(!s, ss_void);
+	if (!src || !src_size || (*s && ss_size(*s) > 0))
+		return ss_cat_cn_raw(s, src, 0, src_size, 0);
+	/*
+	 * BEHAVIOR: on copy (e.g. ss_dup_c(), ss_cpy_cn()), the Unicode size
+	 * is computed (vectorized), so both ss_len_u() and
+	 * ss_encoding_errors() become O(1) afterwards.
+	 */
+	enc_errors = 0;
+	src_usize = sc_utf8_count_chars(src, src_size, &enc_errors);
+	ss_cat_cn_raw(s, src, 0, src_size, src_usize);
+	if (enc_errors && ss_size(*s) == src_size)
+		set_encoding_errors(*s, S_TRUE);
+	return *s;
 }
 
 srt_string *ss_cat_c_aux(srt_string **s, const char *s1, ...)
@@ -1602,6 +2078,7 @@ srt_string *ss_cat_wn(srt_string **s, const wchar_t *src, size_t src_size)
 	size_t i, char_count, l;
 	char utf8[SSU8_MAX_SIZE];
 	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_TRUE), *s);
 	if (src && ss_grow(s, src_size * SSU8_MAX_SIZE) && *s) {
 		i = 0;
 		char_count = 0;
@@ -1658,6 +2135,21 @@ srt_string *ss_cat_int(srt_string **s, int64_t num)
 	return aux_toint(s, S_TRUE, num);
 }
 
+srt_string *ss_cat_uint(srt_string **s, uint64_t num)
+{
+	return aux_touint(s, S_TRUE, num);
+}
+
+srt_string *ss_cat_double(srt_string **s, double num)
+{
+	return aux_todouble(s, S_TRUE, num);
+}
+
+srt_string *ss_cat_float(srt_string **s, float num)
+{
+	return aux_tofloat(s, S_TRUE, num);
+}
+
 srt_string *ss_cat_tolower(srt_string **s, const srt_string *src)
 {
 	return aux_toXcase(s, S_TRUE, src, fsc_tolower);
@@ -1733,6 +2225,7 @@ srt_string *ss_cat_printf_va(srt_string **s, size_t size, const char *fmt,
 	size_t off;
 	ASSERT_RETURN_IF(!s, ss_void);
 	S_ASSERT(s && size > 0 && fmt);
+	RETURN_IF(!ss_cow(s, S_TRUE), *s);
 	if (size > 0 && fmt) {
 		off = *s ? ss_size(*s) : 0;
 		if (ss_grow(s, size)) {
@@ -1791,7 +2284,9 @@ srt_bool ss_set_turkish_mode(srt_bool enable_turkish_mode)
 
 void ss_clear(srt_string *s)
 {
-	ss_reset(s);
+	S_ASSERT(!ss_is_shared(s)); /* use ss_cpy_c(&s, "") instead */
+	if (!ss_is_shared(s)) /* BEHAVIOR: shared buffer never written */
+		ss_reset(s);
 }
 
 srt_string *ss_check(srt_string **s)
@@ -1872,6 +2367,8 @@ const char *ss_to_c(const srt_string *s)
 	 * the buffer, ss_get_buffer_r(s) could be used instead.
 	 */
 	RETURN_IF(ss_is_ref(s), ss_is_cref(s) ? ss_get_buffer_r(s) : "");
+	/* Shared strings are already terminated (and can not be written) */
+	RETURN_IF(ss_is_shared(s), ss_get_buffer_r(s));
 	/*
 	 * BEHAVIOR:
 	 * Constness is kept regarding srt_string internal logical state. Said
@@ -1888,6 +2385,24 @@ const char *ss_to_c(const srt_string *s)
 	return buf;
 }
 
+size_t ss_to_int64(const srt_string *s, size_t off, int64_t *v)
+{
+	size_t ss = ss_size(s);
+	ASSERT_RETURN_IF(!v, 0);
+	*v = 0;
+	RETURN_IF(off >= ss, 0);
+	return snum_atoi64(ss_get_buffer_r(s) + off, ss - off, v);
+}
+
+size_t ss_to_double(const srt_string *s, size_t off, double *v)
+{
+	size_t ss = ss_size(s);
+	ASSERT_RETURN_IF(!v, 0);
+	*v = 0;
+	RETURN_IF(off >= ss, 0);
+	return snum_atod(ss_get_buffer_r(s) + off, ss - off, v);
+}
+
 const wchar_t *ss_to_w(const srt_string *s, wchar_t *o, size_t nmax, size_t *n)
 {
 	int32_t c;
@@ -1977,7 +2492,7 @@ size_t ss_findr(const srt_string *s, size_t off, size_t max_off,
 	RETURN_IF(!ss || !ts || (off + ts) > ss, S_NPOS);
 	s0 = ss_get_buffer_r(s);
 	t0 = ss_get_buffer_r(tgt);
-	return ss_find_csum_fast(s0, off, ss, t0, ts);
+	return ss_find_vec(s0, off, ss, t0, ts);
 }
 
 #define SS_FINDRX_AUX_VARS const char *p0, *pm, *p
@@ -2039,33 +2554,325 @@ size_t ss_findr_cn(const srt_string *s, size_t off, size_t max_off,
 	RETURN_IF(!s || !t, S_NPOS);
 	ss = ss_real_off(s, max_off);
 	RETURN_IF(!ss || !ts || (off + ts) > ss, S_NPOS);
-	return ss_find_csum_fast(ss_get_buffer_r(s), off, ss, t, ts);
+	return ss_find_vec(ss_get_buffer_r(s), off, ss, t, ts);
 }
 
-size_t ss_split(const srt_string *src, const srt_string *separator,
-		srt_string_ref out_substrings[], size_t max_refs)
+srt_searcher *ss_searcher_alloc(const srt_string *tgt)
 {
-	const char *p;
-	size_t i, nelems = 0, off, sz, src_size = ss_size(src),
-		  sep_size = ss_size(separator);
-	if (src_size > 0 && sep_size > 0) {
-		p = ss_get_buffer_r(src);
-		for (i = 0; i < src_size;) {
-			off = ss_find(src, i, separator);
-			sz = (off != S_NPOS ? off : src_size) - i;
-			if (nelems < max_refs) {
-				ss_ref_buf(&out_substrings[nelems], p + i, sz);
-				nelems++;
-			} else {
-				/* BEHAVOIR: out of reference space */
-				break;
-			}
-			if (off == S_NPOS) { /* no more separators found */
-				break;
-			}
-			i = off + sep_size;
+	size_t ts = ss_size(tgt);
+	char *t;
+	srt_searcher *sr;
+	RETURN_IF(ts > S_SIZET_MAX - sizeof(srt_searcher), NULL);
+	sr = (srt_searcher *)s_malloc(sizeof(srt_searcher) + ts);
+	RETURN_IF(!sr, NULL);
+	t = (char *)(sr + 1);
+	if (ts)
+		memcpy(t, ss_get_buffer_r(tgt), ts);
+	ss_search_init(sr, t, ts);
+	return sr;
+}
+
+void ss_searcher_free_aux(srt_searcher **sr, ...)
+{
+	va_list ap;
+	srt_searcher **next;
+	va_start(ap, sr);
+	next = sr;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next) {
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_searcher **)va_arg(ap, srt_searcher **);
+	}
+	va_end(ap);
+}
+
+size_t ss_searcher_find(const srt_searcher *sr, const srt_string *s, size_t off)
+{
+	RETURN_IF(!sr || !s, S_NPOS);
+	return ss_search(sr, ss_get_buffer_r(s), off, ss_size(s));
+}
+
+size_t ss_searcher_findr(const srt_searcher *sr, const srt_string *s,
+			 size_t off, size_t max_off)
+{
+	RETURN_IF(!sr || !s, S_NPOS);
+	return ss_search(sr, ss_get_buffer_r(s), off, ss_real_off(s, max_off));
+}
+
+/*
+ * Unicode character index
+ */
+
+srt_uindex *ss_uindex_alloc(size_t step)
+{
+	srt_uindex *ix = (srt_uindex *)s_malloc(sizeof(srt_uindex));
+	RETURN_IF(!ix, NULL);
+	ix->off = (size_t *)s_malloc(sizeof(size_t) * 16);
+	if (!ix->off) {
+		s_free(ix);
+		return NULL;
+	}
+	ix->step = step ? step : SS_UINDEX_STEP;
+	ix->n = 1;
+	ix->max = 16;
+	ix->off[0] = 0;
+	return ix;
+}
+
+void ss_uindex_free_aux(srt_uindex **ix, ...)
+{
+	va_list ap;
+	srt_uindex **next;
+	va_start(ap, ix);
+	next = ix;
+	while (!s_varg_tail_ptr_tag(next)) { /* last element tag */
+		if (next && *next) {
+			s_free((*next)->off);
+			s_free(*next);
+			*next = NULL;
+		}
+		next = (srt_uindex **)va_arg(ap, srt_uindex **);
+	}
+	va_end(ap);
+}
+
+void ss_uindex_invalidate(srt_uindex *ix, size_t byte_off)
+{
+	if (!ix)
+		return;
+	/*
+	 * BEHAVIOR: a character starting up to SSU8_MAX_SIZE - 1 bytes before
+	 * the modification could have been truncated, so the offsets after it
+	 * could change, too
+	 */
+	for (; ix->n > 1 && ix->off[ix->n - 1] + SSU8_MAX_SIZE > byte_off;
+	     ix->n--)
+		;
+}
+
+size_t ss_uindex_off(srt_uindex *ix, const srt_string *s, size_t char_off)
+{
+	size_t *off_aux, ss, k, last, adv, cnt;
+	const char *ps;
+	RETURN_IF(!s, 0);
+	ss = ss_size(s);
+	if (is_unicode_size_cached(s) && get_unicode_size(s) == ss)
+		return S_MIN(char_off, ss); /* single byte characters only */
+	ps = ss_get_buffer_r(s);
+	RETURN_IF(!ix, sc_unicode_count_to_utf8_size(ps, 0, ss, char_off,
+						     NULL));
+	for (; ix->n > 1 && ix->off[ix->n - 1] > ss; ix->n--)
+		; /* BEHAVIOR: string shrunk, without invalidation */
+	k = char_off / ix->step;
+	while (ix->n <= k) {
+		last = ix->off[ix->n - 1];
+		cnt = 0;
+		adv = sc_unicode_count_to_utf8_size(ps, last, ss, ix->step,
+						    &cnt);
+		if (cnt < ix->step)
+			break; /* end of string */
+		if (ix->n == ix->max) {
+			off_aux = (size_t *)s_realloc(
+				ix->off, sizeof(size_t) * ix->max * 2);
+			if (!off_aux)
+				break; /* BEHAVIOR: scan from the last entry */
+			ix->off = off_aux;
+			ix->max *= 2;
 		}
+		ix->off[ix->n++] = last + adv;
+	}
+	k = S_MIN(k, ix->n - 1);
+	return ix->off[k]
+	       + sc_unicode_count_to_utf8_size(ps, ix->off[k], ss,
+					       char_off - k * ix->step, NULL);
+}
+
+srt_string *ss_dup_substr_ux(srt_uindex *ix, const srt_string *src,
+			     size_t char_off, size_t n)
+{
+	srt_string *s = NULL;
+	return ss_cpy_substr_ux(&s, ix, src, char_off, n);
+}
+
+srt_string *ss_cpy_substr_ux(srt_string **s, srt_uindex *ix,
+			     const srt_string *src, size_t char_off, size_t n)
+{
+	RETURN_IF(!s, ss_void);
+	if (*s == src) { /* aliasing: the index would be stale */
+		ss_uindex_invalidate(ix, 0);
+		return ss_cpy_substr_u(s, src, char_off, n);
+	}
+	RETURN_IF(!ss_cow(s, S_FALSE), *s);
+	ss_clear(*s);
+	return ss_cat_substr_ux(s, ix, src, char_off, n);
+}
+
+srt_string *ss_cat_substr_ux(srt_string **s, srt_uindex *ix,
+			     const srt_string *src, size_t char_off, size_t n)
+{
+	const char *psrc;
+	size_t ssrc, off_size, actual_n, copy_size;
+	ASSERT_RETURN_IF(!s, ss_void);
+	RETURN_IF(!ss_cow(s, S_TRUE), *s);
+	if (src) {
+		psrc = ss_get_buffer_r(src);
+		ssrc = ss_size(src);
+		off_size = ss_uindex_off(ix, src, char_off);
+		/* BEHAVIOR: cut out of bounds, append nothing */
+		if (off_size >= ssrc)
+			return ss_check(s);
+		actual_n = 0;
+		copy_size = sc_unicode_count_to_utf8_size(psrc, off_size, ssrc,
+							  n, &actual_n);
+		if (*s == src)
+			ss_uindex_invalidate(ix, ssrc);
+		ss_cat_cn_raw(s, psrc, off_size, copy_size, actual_n);
+	}
+	return ss_check(s);
+}
+
+srt_string *ss_erase_ux(srt_string **s, srt_uindex *ix, size_t char_off,
+			size_t n)
+{
+	srt_bool cached;
+	size_t off, off_end, usize;
+	RETURN_IF(!s || !*s, ss_check(s));
+	off = ss_uindex_off(ix, *s, char_off);
+	off_end = ss_uindex_off(ix, *s, s_size_t_add(char_off, n, S_NPOS));
+	RETURN_IF(off >= off_end, ss_check(s));
+	ss_uindex_invalidate(ix, off);
+	cached = is_unicode_size_cached(*s) ? S_TRUE : S_FALSE;
+	usize = get_unicode_size(*s);
+	ss_erase(s, off, off_end - off);
+	/* Erased full characters: keep the Unicode size cache */
+	if (cached && usize >= char_off) {
+		set_unicode_size_cached(*s, S_TRUE);
+		set_unicode_size(*s, usize - S_MIN(n, usize - char_off));
 	}
+	return *s;
+}
+
+/*
+ * Tokenizer
+ */
+
+static void ss_tok_init0(srt_tok *it, const srt_string *s, int mode)
+{
+	it->p = ss_get_buffer_r(s);
+	it->size = ss_size(s);
+	it->off = 0;
+	it->sep = NULL;
+	it->sep_size = 0;
+	it->mode = (uint8_t)mode;
+	it->nset = 0;
+	memset(it->map, 0, sizeof(it->map));
+}
+
+static void ss_tok_set_add(srt_tok *it, uint8_t c)
+{
+	if (it->map[c >> 3] & (1 << (c & 7)))
+		return;
+	it->map[c >> 3] |= (uint8_t)(1 << (c & 7));
+	if (it->nset < sizeof(it->set))
+		it->set[it->nset] = c;
+	if (it->nset < 255)
+		it->nset++;
+}
+
+void ss_tok_init(srt_tok *it, const srt_string *s, const srt_string *sep)
+{
+	if (!it)
+		return;
+	ss_tok_init0(it, s, SS_TOK_SEP);
+	it->sep = ss_get_buffer_r(sep);
+	it->sep_size = ss_size(sep);
+}
+
+void ss_tok_init_set(srt_tok *it, const srt_string *s, const char *set,
+		     size_t nset)
+{
+	size_t i;
+	if (!it)
+		return;
+	ss_tok_init0(it, s, SS_TOK_SET);
+	for (i = 0; set && i < nset; i++)
+		ss_tok_set_add(it, (uint8_t)set[i]);
+}
+
+void ss_tok_init_cx(srt_tok *it, const srt_string *s, uint8_t c_min,
+		    uint8_t c_max)
+{
+	unsigned c;
+	if (!it)
+		return;
+	ss_tok_init0(it, s, SS_TOK_SET);
+	for (c = c_min; c <= c_max; c++)
+		ss_tok_set_add(it, (uint8_t)c);
+}
+
+void ss_tok_init_lines(srt_tok *it, const srt_string *s)
+{
+	if (it)
+		ss_tok_init0(it, s, SS_TOK_LINE);
+}
+
+static size_t ss_tok_find_set(const srt_tok *it)
+{
+	size_t i;
+	uint8_t c;
+	if (it->nset <= sizeof(it->set))
+		return ss_find_anyof(it->p, it->off, it->size, it->set,
+				     it->nset);
+	for (i = it->off; i < it->size; i++) {
+		c = (uint8_t)it->p[i];
+		if (it->map[c >> 3] & (1 << (c & 7)))
+			return i;
+	}
+	return S_NPOS;
+}
+
+srt_bool ss_tok_next(srt_tok *it, srt_string_ref *ref)
+{
+	const char *p;
+	size_t end, n, sep_size = 1;
+	RETURN_IF(!it || !ref || it->off >= it->size, S_FALSE);
+	switch (it->mode) {
+	case SS_TOK_SEP:
+		sep_size = it->sep_size;
+		end = ss_find_vec(it->p, it->off, it->size, it->sep, sep_size);
+		break;
+	case SS_TOK_SET:
+		end = ss_tok_find_set(it);
+		break;
+	default: /* SS_TOK_LINE */
+		p = (const char *)memchr(it->p + it->off, '\n',
+					 it->size - it->off);
+		end = p ? (size_t)(p - it->p) : S_NPOS;
+		break;
+	}
+	if (end == S_NPOS) {
+		end = it->size;
+		sep_size = 0;
+	}
+	n = end - it->off;
+	if (it->mode == SS_TOK_LINE && sep_size && n && it->p[end - 1] == '\r')
+		n--; /* "\r\n" line end */
+	ss_ref_buf(ref, it->p + it->off, n);
+	it->off = end + sep_size;
+	return S_TRUE;
+}
+
+size_t ss_split(const srt_string *src, const srt_string *separator,
+		srt_string_ref out_substrings[], size_t max_refs)
+{
+	size_t nelems = 0;
+	srt_tok it;
+	RETURN_IF(!ss_size(separator), 0);
+	ss_tok_init(&it, src, separator);
+	while (nelems < max_refs && ss_tok_next(&it, &out_substrings[nelems]))
+		nelems++;
 	return nelems;
 }
 
@@ -2077,7 +2884,7 @@ int ss_printf(srt_string **s, size_t size, const char *fmt, ...)
 {
 	va_list ap;
 	int out_size = -1;
-	if (s && ss_reserve(s, size) >= size) {
+	if (s && ss_cow(s, S_FALSE) && ss_reserve(s, size) >= size) {
 		ss_clear(*s);
 		va_start(ap, fmt);
 		if (ss_cat_printf_va(s, size, fmt, ap))
@@ -2125,7 +2932,9 @@ int ss_ncmpi(const srt_string *s1, size_t s1off, const srt_string *s2, size_t n)
 {
 	const char *s1_str, *s2_str;
 	int res = 0, u1, u2, utf8_cut;
-	size_t s1_size, s2_size, s1_max, s2_max, i, j, chs1, chs2;
+	size_t s1_size, s2_size, s1_max, s2_max, i, j, k, chs1, chs2;
+	/* ASCII blocks compared in bulk, except for the Turkish mode */
+	srt_bool ascii_bulk = fsc_tolower == sc_tolower;
 	S_ASSERT(s1 && s2);
 	if (s1 && s2) {
 		s1_size = ss_size(s1);
@@ -2138,6 +2947,15 @@ int ss_ncmpi(const srt_string *s1, size_t s1off, const srt_string *s2, size_t n)
 		j = 0;
 		u1 = u2 = utf8_cut = 0;
 		for (; i < s1_max && j < s2_max;) {
+			if (ascii_bulk) {
+				k = sc_ascii_ncmpi(s1_str + i, s2_str + j,
+						   S_MIN(s1_max - i, s2_max - j),
+						   &res);
+				i += k;
+				j += k;
+				if (res || i >= s1_max || j >= s2_max)
+					break;
+			}
 			chs1 = ss_utf8_to_wc(s1_str, i, s1_max, &u1, NULL);
 			chs2 = ss_utf8_to_wc(s2_str, j, s2_max, &u2, NULL);
 			if ((i + chs1) > s1_max || (j + chs2) > s2_max) {
@@ -2190,7 +3008,7 @@ int ss_popchar(srt_string **s)
 {
 	size_t off;
 	char *s_str;
-	RETURN_IF(!s || !*s || ss_size(*s) == 0, EOF);
+	RETURN_IF(!s || !*s || ss_size(*s) == 0 || !ss_cow(s, S_TRUE), EOF);
 	off = ss_size(*s) - 1;
 	s_str = ss_get_buffer(*s);
 	for (; off != S_SIZET_MAX; off--) {
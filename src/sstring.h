@@ -18,6 +18,18 @@ extern "C" {
  * #DOC 5 bytes for internal structure, and 5 * sizeof(size_t) for bigger
  * #DOC strings. Unicode size is cached between operations, when possible, so
  * #DOC in those cases UTF-8 string length computation would be O(1).
+ * #DOC
+ * #DOC Shared mode (copy-on-write): a heap string can be made shared with
+ * #DOC ss_set_shared(), becoming an immutable, reference counted buffer.
+ * #DOC Then, ss_dup() and ss_cpy() just increment the reference count
+ * #DOC (O(1), no data copy), and the first modifying function (ss_cat(),
+ * #DOC ss_replace(), etc.) called on any of the references gets a private
+ * #DOC copy first (or takes the buffer, if it is the last reference).
+ * #DOC Reference counting is atomic, so the references can be used and
+ * #DOC freed from different threads. Functions writing through a plain
+ * #DOC 'srt_string *' (ss_clear(), ss_get_buffer(), ss_set_size()) can not
+ * #DOC unshare the string, so they are not valid for shared strings: use
+ * #DOC ss_cpy_c(&s, "") for clearing, or call ss_unshare() first.
  *
  * Copyright (c) 2015-2019 F. Aragon. All rights reserved.
  * Released under the BSD 3-Clause License (see the doc/LICENSE)
@@ -40,7 +52,10 @@ extern "C" {
  *	flag1: Unicode size is cached
  *	flag2: string has UTF-8 encoding errors (e.g. after some operation)
  *	flag3: string reference (built using ss_cref[a]() or ss_ref[a]())
- *	flag4: string reference with C terminator (built using ss_cref[a]())
+ *	flag4: string reference with C terminator (built using ss_cref[a]()),
+ *	       or, if flag3 is not set, shared string (see ss_set_shared()):
+ *	       heap string with ext_buffer set (so it can not be resized)
+ *	       and the reference counter stored after the data
  */
 
 struct SString {
@@ -73,6 +88,43 @@ struct SStringRefRW {
 /* Opaque structures (accessors are provided) */
 typedef struct SString srt_string;
 typedef struct SStringRef srt_string_ref;
+typedef struct SSearch srt_searcher;
+typedef struct SLzCtx srt_lz_ctx;
+
+/*
+ * LZ compression levels (ss_enc_lz_lvl()). Levels above SS_LZ_LEVEL_HIGH
+ * require heap memory (S_MINIMAL builds use SS_LZ_LEVEL_HIGH instead)
+ */
+#define SS_LZ_LEVEL_FAST 0 /* same as ss_enc_lz() */
+#define SS_LZ_LEVEL_HIGH 1 /* same as ss_enc_lzh() */
+#define SS_LZ_LEVEL_MAX 9  /* optimal parsing */
+
+enum eSS_TokMode { SS_TOK_SEP, SS_TOK_SET, SS_TOK_LINE };
+
+struct SSTok {
+	const char *p;	 /* input string buffer */
+	size_t size;	 /* input string size */
+	size_t off;	 /* next token offset */
+	const char *sep; /* separator (SS_TOK_SEP) */
+	size_t sep_size;
+	uint8_t mode;	/* enum eSS_TokMode */
+	uint8_t nset;	/* separator bytes (SS_TOK_SET) */
+	uint8_t set[8]; /* separator bytes, if nset <= 8 */
+	uint8_t map[32]; /* separator byte bitmap */
+};
+
+typedef struct SSTok srt_tok;
+
+#define SS_UINDEX_STEP 256 /* default code points between index entries */
+
+struct SSUIndex {
+	size_t step; /* code points between entries */
+	size_t n;    /* entries built (lazily) */
+	size_t max;  /* entries allocated */
+	size_t *off; /* entry k: byte offset of the code point k * step */
+};
+
+typedef struct SSUIndex srt_uindex;
 
 /*
  * Aux
@@ -86,6 +138,12 @@ extern srt_string *ss_void;
 
 #ifdef S_USE_VA_ARGS
 #define ss_free(...) ss_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#define ss_searcher_free(...)                                                  \
+	ss_searcher_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#define ss_uindex_free(...)                                                    \
+	ss_uindex_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
+#define ss_lz_ctx_free(...)                                                    \
+	ss_lz_ctx_free_aux(__VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
 #define ss_cpy_c(s, ...) ss_cpy_c_aux(s, __VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
 #define ss_cpy_w(s, ...) ss_cpy_w_aux(s, __VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
 #define ss_cat(s, ...) ss_cat_aux(s, __VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
@@ -93,6 +151,9 @@ extern srt_string *ss_void;
 #define ss_cat_w(s, ...) ss_cat_w_aux(s, __VA_ARGS__, S_INVALID_PTR_VARG_TAIL)
 #else
 #define ss_free(s) ss_free_aux(s, S_INVALID_PTR_VARG_TAIL)
+#define ss_searcher_free(sr) ss_searcher_free_aux(sr, S_INVALID_PTR_VARG_TAIL)
+#define ss_uindex_free(ix) ss_uindex_free_aux(ix, S_INVALID_PTR_VARG_TAIL)
+#define ss_lz_ctx_free(c) ss_lz_ctx_free_aux(c, S_INVALID_PTR_VARG_TAIL)
 #define ss_cpy_c(s, a) ss_cpy_c_aux(s, a, S_INVALID_PTR_VARG_TAIL)
 #define ss_cpy_w(s, a) ss_cpy_w_aux(s, a, S_INVALID_PTR_VARG_TAIL)
 #define ss_cat(s, a) ss_cat_aux(s, a, S_INVALID_PTR_VARG_TAIL)
@@ -104,13 +165,14 @@ extern srt_string *ss_void;
  * Generated from template
  */
 
-SD_BUILDFUNCS_DYN(ss, srt_string, 1)
+SD_BUILDFUNCS_DYN_ST(ss, srt_string, 1)
 
+void ss_free_aux(srt_string **s, ...);
 size_t ss_grow(srt_string **c, size_t extra_elems);
 size_t ss_reserve(srt_string **c, size_t max_elems);
 
 /*
-#API: |Free one or more strings (heap)|string;more strings (optional)|-|O(1)|1;2|
+#API: |Free one or more strings (heap). Shared strings are freed when releasing the last reference|string;more strings (optional)|-|O(1)|1;2|
 void ss_free(srt_string **s, ...)
 
 #API: |Reserve space for extra elements (relative to current string size)|string;number of extra elements|extra size allocated|O(1)|1;2|
@@ -198,6 +260,24 @@ S_INLINE const srt_string *ss_ref(const srt_string_ref *s_ref)
 	return &s_ref->s;
 }
 
+/*
+ * Shared strings (copy-on-write)
+ */
+
+/* #API: |Make string shared (immutable, reference counted): ss_dup() and ss_cpy() from it become O(1), and modifying any reference copies it first|string (heap-allocated, not a reference)|S_TRUE: OK (or already shared); S_FALSE: not possible (NULL, stack or reference string) or not enough memory|O(1) if the Unicode size is cached, O(n) if not|1;2| */
+srt_bool ss_set_shared(srt_string **s);
+
+/* #API: |Get a private (not shared) copy of the string, if shared. Required before writing through ss_get_buffer()|string|string (same string if not shared or being the last reference)|O(1) if not shared or being the last reference, O(n) if not|1;2| */
+srt_string *ss_unshare(srt_string **s);
+
+/*
+#API: |Check if string is shared|string|S_TRUE: shared; S_FALSE: not shared|O(1)|1;2|
+srt_bool ss_is_shared(const srt_string *s)
+*/
+
+/* #API: |Get shared string reference count|string|number of references (0: not shared)|O(1)|1;2| */
+size_t ss_shared_refs(const srt_string *s);
+
 /*
  * Accessors
  */
@@ -219,7 +299,7 @@ size_t ss_real_off(const srt_string *s, size_t off);
 srt_bool ss_alloc_errors(const srt_string *s);
 */
 
-/* #API: |Check if string had UTF8 encoding errors|string|S_TRUE: has errors; S_FALSE: no errors|O(1)|1;2| */
+/* #API: |Check if string had UTF8 encoding errors (validating it, if not done yet)|string|S_TRUE: has errors; S_FALSE: no errors|O(1) if cached, O(n) if not previously computed|1;2| */
 srt_bool ss_encoding_errors(const srt_string *s);
 
 /* #API: |Clear allocation/encoding error flags|string|-|O(1)|1;2| */
@@ -229,7 +309,7 @@ void ss_clear_errors(srt_string *s);
  * Allocation from other sources: "dup"
  */
 
-/* #API: |Duplicate string|string|Output result|O(n)|1;2| */
+/* #API: |Duplicate string (for shared strings, it increments the reference count and returns the same string)|string|Output result|O(n); O(1) for shared strings|1;2| */
 srt_string *ss_dup(const srt_string *src);
 
 /* #API: |Duplicate from substring|string;byte offset;number of bytes|output result|O(n)|1;2| */
@@ -253,6 +333,15 @@ srt_string *ss_dup_w(const wchar_t *src);
 /* #API: |Duplicate from integer|integer|output result|O(1)|1;2| */
 srt_string *ss_dup_int(int64_t num);
 
+/* #API: |Duplicate from unsigned integer|unsigned integer|output result|O(1)|1;2| */
+srt_string *ss_dup_uint(uint64_t num);
+
+/* #API: |Duplicate from double (shortest text that converts back to the same value, e.g. "0.1", "1e+21"; "inf", "-inf", "nan")|double|output result|O(1)|1;2| */
+srt_string *ss_dup_double(double num);
+
+/* #API: |Duplicate from float (shortest text that converts back to the same float value)|float|output result|O(1)|1;2| */
+srt_string *ss_dup_float(float num);
+
 /* #API: |Duplicate string with lowercase conversion|string|output result|O(n)|1;2| */
 srt_string *ss_dup_tolower(const srt_string *src);
 
@@ -262,6 +351,9 @@ srt_string *ss_dup_toupper(const srt_string *src);
 /* #API: |Duplicate string with base64 encoding|string|output result|O(n)|1;2| */
 srt_string *ss_dup_enc_b64(const srt_string *src);
 
+/* #API: |Duplicate string with base64 encoding (URL and filename safe alphabet, no padding)|string|output result|O(n)|1;2| */
+srt_string *ss_dup_enc_b64url(const srt_string *src);
+
 /* #API: |Duplicate string with hex encoding|string|output result|O(n)|1;2| */
 srt_string *ss_dup_enc_hex(const srt_string *src);
 
@@ -289,7 +381,7 @@ srt_string *ss_dup_enc_esc_dquote(const srt_string *src);
 /* #API: |Duplicate string escaping ' as ''|string|output result|O(n)|1;2| */
 srt_string *ss_dup_enc_esc_squote(const srt_string *src);
 
-/* #API: |Duplicate string with base64 decoding|string|output result|O(n)|1;2| */
+/* #API: |Duplicate string with base64 decoding (standard or URL alphabet, padding is optional)|string|output result|O(n)|1;2| */
 srt_string *ss_dup_dec_b64(const srt_string *src);
 
 /* #API: |Duplicate string with hex decoding|string|output result|O(n)|1;2| */
@@ -298,6 +390,9 @@ srt_string *ss_dup_dec_hex(const srt_string *src);
 /* #API: |Duplicate string with LZ decoding|string|output result|O(n)|1;2| */
 srt_string *ss_dup_dec_lz(const srt_string *src);
 
+/* #API: |Duplicate string with LZ + entropy decoding (ss_enc_lze())|string|output result|O(n)|1;2| */
+srt_string *ss_dup_dec_lze(const srt_string *src);
+
 /* #API: |Duplicate string with JSON escape decoding|string|output result|O(n)|1;2| */
 srt_string *ss_dup_dec_esc_json(const srt_string *src);
 
@@ -353,7 +448,7 @@ srt_string *ss_dup_read(FILE *handle, size_t max_bytes);
  * Assignment
  */
 
-/* #API: |Overwrite string with a string copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+/* #API: |Overwrite string with a string copy (from a shared string: reference to it, with no data copy, unless the output string is a stack string)|output string; input string|output string reference (optional usage)|O(n); O(1) for shared strings|1;2| */
 srt_string *ss_cpy(srt_string **s, const srt_string *src);
 
 /* #API: |Overwrite string with a substring copy (byte mode)|output string; input string; input string start offset (bytes); number of bytes to be copied|output string reference (optional usage)|O(n)|1;2| */
@@ -377,6 +472,15 @@ srt_string *ss_cpy_wn(srt_string **s, const wchar_t *src, size_t src_size);
 /* #API: |Overwrite string with integer to string copy|output string; integer (any signed integer size)|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_int(srt_string **s, int64_t num);
 
+/* #API: |Overwrite string with unsigned integer to string copy|output string; unsigned integer|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_uint(srt_string **s, uint64_t num);
+
+/* #API: |Overwrite string with double to string copy (shortest round-trip representation)|output string; double|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_double(srt_string **s, double num);
+
+/* #API: |Overwrite string with float to string copy (shortest round-trip representation)|output string; float|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_float(srt_string **s, float num);
+
 /* #API: |Overwrite string with input string lowercase conversion copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_tolower(srt_string **s, const srt_string *src);
 
@@ -386,6 +490,9 @@ srt_string *ss_cpy_toupper(srt_string **s, const srt_string *src);
 /* #API: |Overwrite string with input string base64 encoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_enc_b64(srt_string **s, const srt_string *src);
 
+/* #API: |Overwrite string with input string base64url encoding copy (URL and filename safe alphabet, no padding)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_enc_b64url(srt_string **s, const srt_string *src);
+
 /* #API: |Overwrite string with input string hexadecimal (lowercase) encoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_enc_hex(srt_string **s, const srt_string *src);
 
@@ -413,15 +520,22 @@ srt_string *ss_cpy_enc_esc_dquote(srt_string **s, const srt_string *src);
 /* #API: |Overwrite string with input string escaping ' as ''|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_enc_esc_squote(srt_string **s, const srt_string *src);
 
-/* #API: |Overwrite string with input string base64 decoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+/* #API: |Overwrite string with input string base64 decoding copy (standard or URL alphabet, padding is optional)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_dec_b64(srt_string **s, const srt_string *src);
 
+/* #API: |Overwrite string with input string base64 decoding copy, with validation|output string; input string; S_TRUE: URL and filename safe alphabet, S_FALSE: standard alphabet (padding is optional in both cases); offset of the first invalid character (optional, S_NPOS if input is valid)|output string reference (optional usage): data decoded up to the first invalid quantum|O(n)|1;2| */
+srt_string *ss_cpy_dec_b64_chk(srt_string **s, const srt_string *src,
+			       srt_bool url, size_t *inv_off);
+
 /* #API: |Overwrite string with input string hexadecimal (lowercase) decoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_dec_hex(srt_string **s, const srt_string *src);
 
 /* #API: |Overwrite string with input string LZ decoded copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_dec_lz(srt_string **s, const srt_string *src);
 
+/* #API: |Overwrite string with input string LZ + entropy decoded copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_dec_lze(srt_string **s, const srt_string *src);
+
 /* #API: |Overwrite string with input string JSON escape decoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cpy_dec_esc_json(srt_string **s, const srt_string *src);
 
@@ -516,6 +630,15 @@ srt_string *ss_cat_wn(srt_string **s, const wchar_t *src, size_t src_size);
 /* #API: |Concatenate integer|output string; integer (any signed integer size)|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_int(srt_string **s, int64_t num);
 
+/* #API: |Concatenate unsigned integer|output string; unsigned integer|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_uint(srt_string **s, uint64_t num);
+
+/* #API: |Concatenate double (shortest text that converts back to the same value: fixed notation for decimal exponents from -6 to 20, e.g. "0.1", "100", scientific otherwise, e.g. "1e+21"; "inf", "-inf", "nan"). Locale independent|output string; double|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_double(srt_string **s, double num);
+
+/* #API: |Concatenate float (shortest text that converts back to the same float value). Locale independent|output string; float|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_float(srt_string **s, float num);
+
 /* #API: |Concatenate "lowercased" string|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_tolower(srt_string **s, const srt_string *src);
 
@@ -525,6 +648,9 @@ srt_string *ss_cat_toupper(srt_string **s, const srt_string *src);
 /* #API: |Concatenate string with input string base64 encoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_enc_b64(srt_string **s, const srt_string *src);
 
+/* #API: |Concatenate string with input string base64url encoding copy (URL and filename safe alphabet, no padding)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_enc_b64url(srt_string **s, const srt_string *src);
+
 /* #API: |Concatenate string with input string hexadecimal (lowercase) encoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_enc_hex(srt_string **s, const srt_string *src);
 
@@ -552,7 +678,7 @@ srt_string *ss_cat_enc_esc_dquote(srt_string **s, const srt_string *src);
 /* #API: |Concatenate string escaping ' as ''|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_enc_esc_squote(srt_string **s, const srt_string *src);
 
-/* #API: |Concatenate string with input string base64 decoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+/* #API: |Concatenate string with input string base64 decoding copy (standard or URL alphabet, padding is optional)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_dec_b64(srt_string **s, const srt_string *src);
 
 /* #API: |Concatenate string with input string hexadecimal (lowercase) decoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
@@ -561,6 +687,9 @@ srt_string *ss_cat_dec_hex(srt_string **s, const srt_string *src);
 /* #API: |Concatenate string with input string LZ decoded copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_dec_lz(srt_string **s, const srt_string *src);
 
+/* #API: |Concatenate string with input string LZ + entropy decoded copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_dec_lze(srt_string **s, const srt_string *src);
+
 /* #API: |Concatenate string with input string JSON escape decoding copy|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_cat_dec_esc_json(srt_string **s, const srt_string *src);
 
@@ -625,6 +754,9 @@ srt_string *ss_toupper(srt_string **s);
 /* #API: |Convert to base64|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_enc_b64(srt_string **s, const srt_string *src);
 
+/* #API: |Convert to base64url (URL and filename safe alphabet, no padding)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_enc_b64url(srt_string **s, const srt_string *src);
+
 /* #API: |Convert to hexadecimal (lowercase)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_enc_hex(srt_string **s, const srt_string *src);
 
@@ -652,7 +784,7 @@ srt_string *ss_enc_esc_dquote(srt_string **s, const srt_string *src);
 /* #API: |Convert/escape escaping ' as ''|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_enc_esc_squote(srt_string **s, const srt_string *src);
 
-/* #API: |Decode from base64|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+/* #API: |Decode from base64 (standard or URL alphabet, padding is optional)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_dec_b64(srt_string **s, const srt_string *src);
 
 /* #API: |Decode from hexadecimal (lowercase)|output string; input string|output string reference (optional usage)|O(n)|1;2| */
@@ -661,6 +793,9 @@ srt_string *ss_dec_hex(srt_string **s, const srt_string *src);
 /* #API: |Decode from LZ|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_dec_lz(srt_string **s, const srt_string *src);
 
+/* #API: |Decode from LZ + entropy coding|output string; input string|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_dec_lze(srt_string **s, const srt_string *src);
+
 /* #API: |Unescape from JSON encoding|output string; input string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_dec_esc_json(srt_string **s, const srt_string *src);
 
@@ -679,7 +814,7 @@ srt_string *ss_dec_esc_squote(srt_string **s, const srt_string *src);
 /* #API: |Set Turkish mode locale (related to case conversion)|S_TRUE: enable turkish mode, S_FALSE: disable|S_TRUE: conversion functions OK, S_FALSE: error (missing functions)|O(1)|1;2| */
 srt_bool ss_set_turkish_mode(srt_bool enable_turkish_mode);
 
-/* #API: |Clear string|output string|output string reference (optional usage)|O(n)|1;2| */
+/* #API: |Clear string (not valid for shared strings: use ss_cpy_c(&s, "") instead)|output string|output string reference (optional usage)|O(n)|1;2| */
 void ss_clear(srt_string *s);
 
 /* #API: |Check and fix string (if input string is NULL, replaces it with a empty valid string)|output string|output string reference (optional usage)|O(n)|1;2| */
@@ -709,6 +844,102 @@ srt_string *ss_ltrim(srt_string **s);
 /* #API: |Remove spaces from right side|input/output string|output string reference (optional usage)|O(n)|1;2| */
 srt_string *ss_rtrim(srt_string **s);
 
+/*
+ * LZ encoding context
+ *
+ * Keeps the LZ match hash table between calls, avoiding its allocation
+ * and clearing when compressing many buffers (same output as ss_*_lz()
+ * and ss_*_lzh()). A context must not be used from different threads at
+ * the same time.
+ */
+
+/* #API: |Allocate LZ encoding context|-|context (NULL if not enough memory)|O(1)|1;2| */
+srt_lz_ctx *ss_lz_ctx_alloc(void);
+
+/*
+#API: |Free one or more LZ encoding contexts|context; more contexts (optional)|-|O(1)|1;2|
+void ss_lz_ctx_free(srt_lz_ctx **c, ...)
+*/
+void ss_lz_ctx_free_aux(srt_lz_ctx **c, ...);
+
+/* #API: |Overwrite string with input string LZ encoded copy, using encoding context|output string; input string; context (NULL: no context)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_enc_lz_ctx(srt_string **s, const srt_string *src, srt_lz_ctx *c);
+
+/* #API: |Overwrite string with input string LZ encoded copy (high compression), using encoding context|output string; input string; context (NULL: no context)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_enc_lzh_ctx(srt_string **s, const srt_string *src, srt_lz_ctx *c);
+
+/* #API: |Concatenate string with input string LZ encoded copy, using encoding context|output string; input string; context (NULL: no context)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_enc_lz_ctx(srt_string **s, const srt_string *src, srt_lz_ctx *c);
+
+/* #API: |Concatenate string with input string LZ encoded copy (high compression), using encoding context|output string; input string; context (NULL: no context)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_enc_lzh_ctx(srt_string **s, const srt_string *src, srt_lz_ctx *c);
+
+/* #API: |Convert to LZ, using encoding context|output string; input string; context (NULL: no context)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_enc_lz_ctx(srt_string **s, const srt_string *src, srt_lz_ctx *c);
+
+/* #API: |Convert to LZ (high compression), using encoding context|output string; input string; context (NULL: no context)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_enc_lzh_ctx(srt_string **s, const srt_string *src, srt_lz_ctx *c);
+
+/* #API: |Duplicate string with LZ encoding, using compression level (higher levels: better compression, slower encoding; same decoding speed, using ss_dec_lz())|string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX; 2 to 8: lazy matching with hash chains of increasing depth; 9: optimal parsing)|output result|O(n)|1;2| */
+srt_string *ss_dup_enc_lz_lvl(const srt_string *src, int level);
+
+/* #API: |Overwrite string with input string LZ encoded copy, using compression level|output string; input string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_enc_lz_lvl(srt_string **s, const srt_string *src, int level);
+
+/* #API: |Concatenate string with input string LZ encoded copy, using compression level|output string; input string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_enc_lz_lvl(srt_string **s, const srt_string *src, int level);
+
+/* #API: |Convert to LZ, using compression level|output string; input string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_enc_lz_lvl(srt_string **s, const srt_string *src, int level);
+
+/* #API: |Duplicate string with LZ + entropy encoding (LZ stage with compression level, then Huffman coding of literals, lengths, and distances; better compression than ss_enc_lz_lvl(), slower decoding, using ss_dec_lze())|string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output result|O(n)|1;2| */
+srt_string *ss_dup_enc_lze(const srt_string *src, int level);
+
+/* #API: |Overwrite string with input string LZ + entropy encoded copy|output string; input string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_enc_lze(srt_string **s, const srt_string *src, int level);
+
+/* #API: |Concatenate string with input string LZ + entropy encoded copy|output string; input string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_enc_lze(srt_string **s, const srt_string *src, int level);
+
+/* #API: |Convert to LZ + entropy coding|output string; input string; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_enc_lze(srt_string **s, const srt_string *src, int level);
+
+/*
+ * LZ dictionary compression
+ *
+ * For small strings (e.g. map keys or values) having content in common,
+ * which would not compress alone: a dictionary trained from samples is
+ * used as history for encoding and decoding (it is not stored in the
+ * output, so the same dictionary must be used for decoding).
+ */
+
+/* #API: |Build LZ compression dictionary from samples (most frequent content, placed at the dictionary end)|output dictionary; samples (concatenated); size of every sample; number of samples; maximum dictionary size|output dictionary reference (optional usage)|O(n)|1;2| */
+srt_string *ss_lz_dict_train(srt_string **dict, const srt_string *samples, const size_t *sizes, size_t n, size_t max_size);
+
+/* #API: |Duplicate string with LZ encoding, using dictionary (decoding with ss_dec_lz_dict() and the same dictionary)|string; dictionary; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output result|O(n)|1;2| */
+srt_string *ss_dup_enc_lz_dict(const srt_string *src, const srt_string *dict, int level);
+
+/* #API: |Overwrite string with input string LZ encoded copy, using dictionary|output string; input string; dictionary; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_enc_lz_dict(srt_string **s, const srt_string *src, const srt_string *dict, int level);
+
+/* #API: |Concatenate string with input string LZ encoded copy, using dictionary|output string; input string; dictionary; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_enc_lz_dict(srt_string **s, const srt_string *src, const srt_string *dict, int level);
+
+/* #API: |Convert to LZ, using dictionary|output string; input string; dictionary; level (from SS_LZ_LEVEL_FAST to SS_LZ_LEVEL_MAX)|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_enc_lz_dict(srt_string **s, const srt_string *src, const srt_string *dict, int level);
+
+/* #API: |Duplicate string with LZ decoding, using dictionary (the one used for encoding)|string; dictionary|output result|O(n)|1;2| */
+srt_string *ss_dup_dec_lz_dict(const srt_string *src, const srt_string *dict);
+
+/* #API: |Overwrite string with input string LZ decoded copy, using dictionary|output string; input string; dictionary|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cpy_dec_lz_dict(srt_string **s, const srt_string *src, const srt_string *dict);
+
+/* #API: |Concatenate string with input string LZ decoded copy, using dictionary|output string; input string; dictionary|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_cat_dec_lz_dict(srt_string **s, const srt_string *src, const srt_string *dict);
+
+/* #API: |Convert from LZ, using dictionary|output string; input string; dictionary|output string reference (optional usage)|O(n)|1;2| */
+srt_string *ss_dec_lz_dict(srt_string **s, const srt_string *src, const srt_string *dict);
+
 /*
  * Export
  */
@@ -719,6 +950,12 @@ const char *ss_to_c(const srt_string *s);
 /* #API: |Give a C-compatible zero-ended string reference ("wide char" Unicode mode) (UTF-16 for 16-bit wchar_t, and UTF-32 for 32-bit wchar_t)|input string; output string buffer; output string max characters; output string size|Zero'ended C compatible string reference ("wide char" Unicode mode)|O(n)|1;2| */
 const wchar_t *ss_to_w(const srt_string *s, wchar_t *o, size_t nmax, size_t *n);
 
+/* #API: |Parse integer ("[+-]digits", no white space skipping, out of range values are saturated to INT64_MIN or INT64_MAX)|input string; byte offset; output value (0 if no number found)|Bytes used (0: not a number)|O(n)|1;2| */
+size_t ss_to_int64(const srt_string *s, size_t off, int64_t *v);
+
+/* #API: |Parse floating point number ("[+-]digits[.digits][(e or E)[+-]digits]", "inf", "infinity", "nan", case insensitive; no white space skipping). Correctly rounded, locale independent ('.' as decimal separator)|input string; byte offset; output value (0 if no number found)|Bytes used (0: not a number)|O(n)|1;2| */
+size_t ss_to_double(const srt_string *s, size_t off, double *v);
+
 /*
  * Search
  */
@@ -765,6 +1002,76 @@ size_t ss_findrnb(const srt_string *s, size_t off, size_t max_off);
 /* #API: |Find n bytes|input string; search offset start; max offset (S_NPOS for end of string); target buffer; target buffer size (bytes)|Offset location if found, S_NPOS if not found|O(n)|1;2| */
 size_t ss_findr_cn(const srt_string *s, size_t off, size_t max_off, const char *t, size_t ts);
 
+/* #API: |Build precomputed search object, for finding the same target many times with no per-search setup (the target is copied)|target string|searcher (NULL if not enough memory)|O(m)|1;2| */
+srt_searcher *ss_searcher_alloc(const srt_string *tgt);
+
+/*
+#API: |Free one or more precomputed search objects|searcher; more searchers (optional)|-|O(1)|1;2|
+void ss_searcher_free(srt_searcher **sr, ...)
+*/
+void ss_searcher_free_aux(srt_searcher **sr, ...);
+
+/* #API: |Find precomputed target into string|searcher; input string; search offset start|Offset location if found, S_NPOS if not found|O(n)|1;2| */
+size_t ss_searcher_find(const srt_searcher *sr, const srt_string *s, size_t off);
+
+/* #API: |Find precomputed target into string (in range)|searcher; input string; search offset start; max offset (S_NPOS for end of string)|Offset location if found, S_NPOS if not found|O(n)|1;2| */
+size_t ss_searcher_findr(const srt_searcher *sr, const srt_string *s, size_t off, size_t max_off);
+
+/*
+ * Unicode character index
+ *
+ * Sparse index mapping every Nth code point to its byte offset, for
+ * O(N) Unicode offset lookups on large strings (instead of scanning from
+ * the start of the string on every call). The index belongs to one
+ * string: it is built lazily, as far as the requested offsets. After
+ * modifying the string, ss_uindex_invalidate() must be called with the
+ * first modified byte offset (entries before it are kept). The
+ * ss_*_ux() functions are the ss_*_u() equivalents using the index.
+ * Strings without multi-byte characters need no index entries.
+ */
+
+/* #API: |Allocate Unicode character index|code points between index entries (0 for SS_UINDEX_STEP)|index (NULL if not enough memory)|O(1)|1;2| */
+srt_uindex *ss_uindex_alloc(size_t step);
+
+/*
+#API: |Free one or more Unicode character indexes|index; more indexes (optional)|-|O(1)|1;2|
+void ss_uindex_free(srt_uindex **ix, ...)
+*/
+void ss_uindex_free_aux(srt_uindex **ix, ...);
+
+/* #API: |Invalidate index entries after a string modification|index; first modified byte offset (0 for the whole string)|-|O(1)|1;2| */
+void ss_uindex_invalidate(srt_uindex *ix, size_t byte_off);
+
+/* #API: |Get byte offset of a Unicode character offset (building the index as needed)|index; string; Unicode character offset|byte offset (string size if out of bounds)|O(N) (N: code points between index entries), O(n) the first time|1;2| */
+size_t ss_uindex_off(srt_uindex *ix, const srt_string *s, size_t char_off);
+
+/* #API: |Get substring using Unicode character offsets (indexed)|index; input string; Unicode character offset; substring size (Unicode characters)|output string|O(N + m)|1;2| */
+srt_string *ss_dup_substr_ux(srt_uindex *ix, const srt_string *src, size_t char_off, size_t n);
+
+/* #API: |Overwrite string with a substring, using Unicode character offsets (indexed)|output string; index of the input string; input string; Unicode character offset; substring size (Unicode characters)|output string reference (optional usage)|O(N + m)|1;2| */
+srt_string *ss_cpy_substr_ux(srt_string **s, srt_uindex *ix, const srt_string *src, size_t char_off, size_t n);
+
+/* #API: |Concatenate substring, using Unicode character offsets (indexed)|output string; index of the input string; input string; Unicode character offset; substring size (Unicode characters)|output string reference (optional usage)|O(N + m)|1;2| */
+srt_string *ss_cat_substr_ux(srt_string **s, srt_uindex *ix, const srt_string *src, size_t char_off, size_t n);
+
+/* #API: |Erase portion of a string, using Unicode character offsets (indexed, the index is updated)|input/output string; index of the string; Unicode character offset; number of characters to be erased|output string reference (optional usage)|O(N + n)|1;2| */
+srt_string *ss_erase_ux(srt_string **s, srt_uindex *ix, size_t char_off, size_t n);
+
+/* #API: |Tokenizer: initialize iterator for splitting by a separator (no allocation; input string and separator must be kept while iterating). Consecutive separators give empty tokens, a trailing separator does not|iterator; input string; separator|-|O(1)|1;2| */
+void ss_tok_init(srt_tok *it, const srt_string *s, const srt_string *sep);
+
+/* #API: |Tokenizer: initialize iterator for splitting by any byte of a set|iterator; input string; separator bytes; number of separator bytes|-|O(1)|1;2| */
+void ss_tok_init_set(srt_tok *it, const srt_string *s, const char *set, size_t nset);
+
+/* #API: |Tokenizer: initialize iterator for splitting by any byte in a range (e.g. ss_findcx() ranges)|iterator; input string; separator byte mininum value; separator byte maximum value|-|O(1)|1;2| */
+void ss_tok_init_cx(srt_tok *it, const srt_string *s, uint8_t c_min, uint8_t c_max);
+
+/* #API: |Tokenizer: initialize iterator for splitting lines ("\n" or "\r\n" line ends; a "\r" not followed by "\n" is kept)|iterator; input string|-|O(1)|1;2| */
+void ss_tok_init_lines(srt_tok *it, const srt_string *s);
+
+/* #API: |Tokenizer: get next token|iterator; output token reference|S_TRUE: token found; S_FALSE: no more tokens|O(n)|1;2| */
+srt_bool ss_tok_next(srt_tok *it, srt_string_ref *ref);
+
 /* #API: |Split/tokenize: break string by separators|input string; separator; output substring references; number of output substrings|Number of elements|O(n)|1;2| */
 size_t ss_split(const srt_string *src, const srt_string *separator, srt_string_ref out_substrings[], size_t max_refs);
 
@@ -859,7 +1166,12 @@ S_INLINE srt_bool ss_is_ref(const srt_string *s)
 
 S_INLINE srt_bool ss_is_cref(const srt_string *s)
 {
-	return s && s->d.f.flag4 != 0 ? S_TRUE : S_FALSE;
+	return s && s->d.f.flag3 != 0 && s->d.f.flag4 != 0 ? S_TRUE : S_FALSE;
+}
+
+S_INLINE srt_bool ss_is_shared(const srt_string *s)
+{
+	return s && !s->d.f.flag3 && s->d.f.flag4 != 0 ? S_TRUE : S_FALSE;
 }
 
 S_INLINE char *ss_get_buffer(srt_string *s)
@@ -26,6 +26,14 @@
 #include <unordered_set>
 #endif
 
+#if __cplusplus >= 201103L
+#define S_BENCH_CPP_THREADS
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif
+
 #if (defined(__linux__) || defined(__unix__) || defined(_POSIX_VERSION)) && \
     !defined(__APPLE_CC__)
 #include <time.h>
@@ -1164,6 +1172,91 @@ bool cxx_bitset_popcount10000(size_t count, int tid)
 	return cxx_bitset_popcountN(10000, count, tid);
 }
 
+#ifdef S_BENCH_CPP_THREADS
+
+/*
+ * Concurrent readers: one writer updates a map of S_BENCH_PUB_KEYS elements,
+ * publishing a new version every S_BENCH_PUB_BATCH updates (key -1 holds the
+ * version, and the batch keys are set to it), while the readers take the last
+ * published version and check that the batch is there.
+ */
+
+#define S_BENCH_READERS 4
+#define S_BENCH_PUB_KEYS 100000
+#define S_BENCH_PUB_BATCH 100
+#define S_BENCH_PUB_BASE(v) (((v) - 1) * S_BENCH_PUB_BATCH % S_BENCH_PUB_KEYS)
+
+#define BENCH_READERS(FN, MAP_T, PUB_T, ALLOC, SNAP, GET, AT, INSERT, FREE,  \
+		      MFREE)                                                   \
+	bool FN(size_t count, int tid)                                        \
+	{                                                                     \
+		RETURN_IF(!TIdTest(tid, TId_Base), false);                    \
+		MAP_T *m = ALLOC(SM_II, S_BENCH_PUB_KEYS + 1);                \
+		for (int64_t j = -1; j < S_BENCH_PUB_KEYS; j++)               \
+			INSERT(m, j, 0);                                      \
+		PUB_T pub = SNAP(m);                                          \
+		std::mutex mtx;                                               \
+		std::atomic<bool> done(false);                                \
+		std::atomic<size_t> errors(0);                                \
+		std::vector<std::thread> readers;                             \
+		for (size_t r = 0; r < S_BENCH_READERS; r++)                  \
+			readers.push_back(std::thread([&]() {                 \
+				while (!done) {                               \
+					mtx.lock();                           \
+					PUB_T s = GET(pub);                   \
+					mtx.unlock();                         \
+					int64_t v = AT(s, -1);                \
+					for (int64_t j = 0; v > 0              \
+					     && j < S_BENCH_PUB_BATCH; j++)    \
+						if (AT(s, S_BENCH_PUB_BASE(v)  \
+							      + j) != v)       \
+							errors++;              \
+					FREE(s);                              \
+				}                                             \
+			}));                                                  \
+		for (size_t i = 0; i < count; i += S_BENCH_PUB_BATCH) {       \
+			int64_t v = (int64_t)(i / S_BENCH_PUB_BATCH + 1);     \
+			INSERT(m, -1, v);                                     \
+			for (int64_t j = 0; j < S_BENCH_PUB_BATCH; j++)       \
+				INSERT(m, S_BENCH_PUB_BASE(v) + j, v);        \
+			PUB_T s = SNAP(m);                                    \
+			mtx.lock();                                           \
+			std::swap(pub, s);                                    \
+			mtx.unlock();                                         \
+			FREE(s);                                              \
+		}                                                             \
+		done = true;                                                  \
+		for (size_t r = 0; r < S_BENCH_READERS; r++)                  \
+			readers[r].join();                                    \
+		FREE(pub);                                                    \
+		MFREE(m);                                                     \
+		HOLD_EXEC(tid);                                               \
+		return errors == 0;                                           \
+	}
+
+static void bench_sm_free(srt_map *m)
+{
+	sm_free(&m);
+}
+
+#define BENCH_SPM_FREE(s) spm_free(&s)
+#define BENCH_SPM_INSERT(m, k, v) spm_insert_ii(m, k, v)
+#define BENCH_SM_SNAP(m) std::shared_ptr<srt_map>(sm_dup(m), bench_sm_free)
+#define BENCH_SM_GET(s) (s)
+#define BENCH_SM_AT(s, k) sm_at_ii((s).get(), k)
+#define BENCH_SM_INSERT(m, k, v) sm_insert_ii(&m, k, v)
+#define BENCH_SM_FREE(s) (s).reset()
+#define BENCH_SM_MFREE(m) sm_free(&m)
+
+BENCH_READERS(libsrt_pmap_snapshot_readers, srt_pmap, srt_pmap *, spm_alloc,
+	      spm_snapshot, spm_ref, spm_at_ii, BENCH_SPM_INSERT,
+	      BENCH_SPM_FREE, BENCH_SPM_FREE)
+BENCH_READERS(libsrt_map_dup_readers, srt_map, std::shared_ptr<srt_map>,
+	      sm_alloc, BENCH_SM_SNAP, BENCH_SM_GET, BENCH_SM_AT,
+	      BENCH_SM_INSERT, BENCH_SM_FREE, BENCH_SM_MFREE)
+
+#endif // #ifdef S_BENCH_CPP_THREADS
+
 int main(int argc, char *argv[])
 {
 	BENCH_INIT;
@@ -1365,6 +1458,10 @@ int main(int argc, char *argv[])
 		BENCH_FN(c_string_cat, count[i] / 10, tid[i]);
 		BENCH_FN(cxx_string_cat, count[i] / 10, tid[i]);
 		BENCH_FN(cxx_stringstream_cat, count[i] / 10, tid[i]);
+#ifdef S_BENCH_CPP_THREADS
+		BENCH_FN(libsrt_pmap_snapshot_readers, count[i], tid[i]);
+		BENCH_FN(libsrt_map_dup_readers, count[i], tid[i]);
+#endif
 	}
 	return 0;
 }
@@ -7,13 +7,225 @@
  * Released under the BSD 3-Clause License (see the doc/LICENSE)
  */
 
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define ENC_THREADS
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L /* clock_gettime() */
+#endif
+#include <pthread.h>
+#include <time.h>
+#endif
+
 #include "../src/libsrt.h"
 #include "../src/saux/senc.h" /* for debug stats */
 
+#if defined(ENC_THREADS) && defined(S_ATOMIC_NONE)
+#undef ENC_THREADS /* no atomic counter for distributing the blocks */
+#endif
+#ifdef ENC_THREADS
+#define PAR_INC(p) S_ATOMIC_INC(p)
+#else
+#define PAR_INC(p) (++(*(p)))
+#endif
+
 #define LZHBUF_SIZE S_NPOS /* -ezh high compression: infinite buffer size */
 #define LZBUF_SIZE 1000000 /* -ez fast compression: 1 MB buffer size */
 #define IBUF_SIZE (3 * 4 * 2 * 1024) /* 3 * 4 because of LCM for base64 */
 #define ESC_MAX_SIZE 16 /* maximum size for an escape sequence: 16 bytes */
+#define PAR_SEG_SIZE ((size_t)64 << 20) /* -ezp: 64 MB per container */
+#define PAR_DBITS 16			/* -ezpd: 64 KB dictionary */
+#define PAR_HDR_SIZE 16			/* container header (see slz.h) */
+#define MAX_THREADS 64
+
+/*
+ * Block-parallel LZ compression: every container block is processed by the
+ * first available thread
+ */
+
+struct ParJob {
+	const srt_lz_par *p;
+	const srt_string *in; /* input (encoding) */
+	srt_string **blk;     /* compressed blocks (encoding) */
+	size_t *bs;	      /* compressed block sizes (encoding) */
+	uint8_t *o;	      /* output (decoding) */
+	volatile long next;   /* next block */
+	volatile long err;
+};
+
+static void *par_worker(void *arg)
+{
+	size_t i;
+	struct ParJob *j = (struct ParJob *)arg;
+	for (;;) {
+		i = (size_t)(PAR_INC(&j->next) - 1);
+		if (i >= j->p->nblk)
+			break;
+		if (j->in) {
+			j->bs[i] = slz_par_enc_blk(&j->blk[i], j->p, j->in, i);
+			if (!j->bs[i])
+				PAR_INC(&j->err);
+		} else if (slz_par_dec_blk(j->p, i, j->o + i * j->p->bsize,
+					   i * j->p->bsize)
+			   == S_NPOS) {
+			PAR_INC(&j->err);
+		}
+	}
+	return NULL;
+}
+
+/* Run the job on 'nth' threads, including the calling one */
+static srt_bool par_run(struct ParJob *j, size_t nth)
+{
+	size_t i, n = 0;
+#ifdef ENC_THREADS
+	pthread_t th[MAX_THREADS];
+	j->next = j->err = 0;
+	for (i = 1; i < nth && i < MAX_THREADS; i++)
+		if (!pthread_create(&th[n], NULL, par_worker, j))
+			n++;
+#else
+	j->next = j->err = 0;
+#endif
+	par_worker(j);
+#ifdef ENC_THREADS
+	for (i = 0; i < n; i++)
+		pthread_join(th[i], NULL);
+#else
+	(void)nth;
+	(void)i;
+	(void)n;
+#endif
+	return j->err ? S_FALSE : S_TRUE;
+}
+
+static srt_bool par_enc(srt_string **out, const srt_string *in, unsigned dbits,
+			srt_bool lzh, size_t nth)
+{
+	size_t i;
+	srt_lz_par p;
+	struct ParJob j;
+	srt_bool r = S_FALSE;
+	if (!slz_par_init(&p, ss_size(in), 0, dbits, lzh))
+		return S_FALSE;
+	memset(&j, 0, sizeof(j));
+	j.p = &p;
+	j.in = in;
+	j.blk = (srt_string **)calloc(p.nblk + 1, sizeof(srt_string *));
+	j.bs = (size_t *)malloc((p.nblk + 1) * sizeof(size_t));
+	if (j.blk && j.bs && par_run(&j, nth)) {
+		ss_clear(*out);
+		slz_par_cat_hdr(out, &p, j.bs);
+		for (i = 0; i < p.nblk; i++)
+			ss_cat(out, j.blk[i]);
+		r = S_TRUE;
+	}
+	for (i = 0; j.blk && i < p.nblk; i++)
+		ss_free(&j.blk[i]);
+	free(j.blk);
+	free(j.bs);
+	return r;
+}
+
+static srt_bool par_dec(srt_string **out, const srt_string *c, size_t nth)
+{
+	srt_lz_par p;
+	struct ParJob j;
+	if (!slz_par_open(&p, c) || ss_reserve(out, p.ss) < p.ss)
+		return S_FALSE;
+	memset(&j, 0, sizeof(j));
+	j.p = &p;
+	j.o = (uint8_t *)ss_get_buffer(*out);
+	/* With dictionary, a block requires the previous one decoded */
+	if (!par_run(&j, p.dsize ? 1 : nth))
+		return S_FALSE;
+	ss_set_size(*out, p.ss);
+	return S_TRUE;
+}
+
+/* Read a container from the input */
+static int par_read(srt_string **in, FILE *f)
+{
+	uint64_t ss, cs;
+	size_t nblk, l;
+	const uint8_t *b;
+	ss_cpy_read(in, f, PAR_HDR_SIZE);
+	l = ss_size(*in);
+	if (!l)
+		return 0; /* end of input */
+	b = (const uint8_t *)ss_get_buffer_r(*in);
+	if (l != PAR_HDR_SIZE || b[4] < SLZ_PAR_BBITS_MIN
+	    || b[4] > SLZ_PAR_BBITS_MAX)
+		return -1;
+	ss = S_LD_LE_U64(b + 8);
+	if (ss > PAR_SEG_SIZE * 16)
+		return -1; /* BEHAVIOR: not from this program */
+	nblk = (size_t)((ss + ((uint64_t)1 << b[4]) - 1) >> b[4]);
+	if (nblk) {
+		ss_cat_read(in, f, nblk * 8);
+		if (ss_size(*in) != PAR_HDR_SIZE + nblk * 8)
+			return -1;
+		b = (const uint8_t *)ss_get_buffer_r(*in);
+		cs = S_LD_LE_U64(b + PAR_HDR_SIZE + (nblk - 1) * 8);
+		if (cs > ss * 3 + nblk * 64) /* see senc_lz() */
+			return -1;
+		l = ss_size(*in);
+		ss_cat_read(in, f, (size_t)cs);
+		if (ss_size(*in) != l + cs)
+			return -1;
+	}
+	return 1;
+}
+
+#ifdef ENC_THREADS
+static double enc_time()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Throughput at 1 to 32 threads, for the whole input */
+static int par_bench(srt_string **in)
+{
+	int r = 0;
+	double t0, t1, t2, mb;
+	size_t nth, k, reps, l;
+	srt_string *c = NULL, *d = NULL;
+	do {
+		l = ss_size(*in);
+		ss_cat_read(in, stdin, PAR_SEG_SIZE);
+	} while (ss_size(*in) > l);
+	reps = 1 + (PAR_SEG_SIZE * 4) / (ss_size(*in) + 1);
+	mb = (double)ss_size(*in) * (double)reps / 1e6;
+	fprintf(stderr, "Input: " FMT_ZU " bytes, repeat: " FMT_ZU "\n",
+		ss_size(*in), reps);
+	for (nth = 1; nth <= 32 && !r; nth *= 2) {
+		t0 = enc_time();
+		for (k = 0; k < reps && !r; k++)
+			r = par_enc(&c, *in, 0, S_FALSE, nth) ? 0 : 10;
+		t1 = enc_time();
+		for (k = 0; k < reps && !r; k++)
+			r = par_dec(&d, c, nth) ? 0 : 2;
+		t2 = enc_time();
+		if (!r && ss_cmp(d, *in))
+			r = 2;
+		if (!r)
+			printf("threads: %2u, enc: %8.1f MB/s, "
+			       "dec: %8.1f MB/s, ratio: %.3f\n",
+			       (unsigned)nth, mb / (t1 - t0), mb / (t2 - t1),
+			       (double)ss_size(c) / (double)(ss_size(*in) + 1));
+	}
+	if (r)
+		fprintf(stderr, "Error\n");
+#ifdef S_USE_VA_ARGS
+	ss_free(&c, &d);
+#else
+	ss_free(&c);
+	ss_free(&d);
+#endif
+	return r;
+}
+#endif
 
 static int syntax_error(const char **argv, const int exit_code)
 {
@@ -21,7 +233,9 @@ static int syntax_error(const char **argv, const int exit_code)
 	fprintf(stderr,
 		"Buffer encoding/decoding (libsrt example)\n\n"
 		"Syntax: %s [-eb|-db|-eh|-eH|-dh|-ex|-dx|-ej|-dj|"
-		"-eu|-du|-ez|-dz|-crc32|-adler32|-fnv|-fnv1a]\n\nExamples:\n"
+		"-eu|-du|-ez|-ez0..9|-dz|-eze0..9|-dze|-ezs|-dzs|-ezp|-ezph|"
+		"-ezpd|-dzp|-bzp|-crc32|-adler32|-fnv|-fnv1a] [-j threads]\n\n"
+		"Examples:\n"
 		"%s -eb <in >out.b64\n%s -db <in.b64 >out\n"
 		"%s -eh <in >out.hex\n%s -eH <in >out.HEX\n"
 		"%s -dh <in.hex >out\n%s -dh <in.HEX >out\n"
@@ -30,13 +244,19 @@ static int syntax_error(const char **argv, const int exit_code)
 		"%s -eu <in >out.url.esc\n%s -du <in.url.esc >out\n"
 		"%s -ez <in >in.lz\n%s -dz <in.lz >out\n"
 		"%s -ezh <in >in.lz\n%s -dz <in.lz >out\n"
+		"%s -ez9 <in >in.lz (levels: -ez0 to -ez9)\n"
+		"%s -eze9 <in >in.lze\n%s -dze <in.lze >out\n"
+		"%s -ezs <in >in.lzs\n%s -dzs <in.lzs >out\n"
+		"%s -ezp -j 8 <in >in.lzp\n%s -dzp -j 8 <in.lzp >out\n"
+		"%s -bzp <in (1 to 32 threads -ezp/-dzp benchmark)\n"
 		"%s -crc32 <in\n%s -crc32 <in >out\n"
 		"%s -adler32 <in\n%s -adler32 <in >out\n"
 		"%s -fnv1 <in\n%s -fnv1 <in >out\n"
 		"%s -fnv1a <in\n%s -fnv1a <in >out\n"
 		"%s -mh3_32 <in\n%s -mh3_32 <in >out\n",
 		v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0,
-		v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0);
+		v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0, v0,
+		v0, v0, v0, v0);
 	return exit_code;
 }
 
@@ -46,19 +266,25 @@ int main(int argc, const char **argv)
 	const char *b;
 	srt_string_ref ref;
 	const uint8_t *dlepc;
-	int exit_code = 0, cf;
+	int exit_code = 0, cf, st, par = 0, lzlvl = -1;
 	uint8_t esc, dle[S_PK_U64_MAX_BYTES], *dlep;
 	size_t lmax = 0, li = 0, lo = 0, j, l, l2, ss0, off;
 	uint32_t acc = 0;
 	uint32_t (*f32)(const srt_string *, uint32_t, size_t, size_t) = NULL;
 	srt_string *in = NULL, *out = NULL;
+	srt_lz_enc *zenc = NULL;
+	srt_lz_dec *zdec = NULL;
 	srt_string *(*ss_codec1_f)(srt_string **, const srt_string *) = NULL;
 	srt_string *(*ss_codec2_f)(srt_string **, const srt_string *) = NULL;
 	srt_string *(*ss_codec3_f)(srt_string **, const srt_string *) = NULL;
 	srt_string *(*ss_codec4_f)(srt_string **, const srt_string *) = NULL;
-	size_t lzbufsize = LZBUF_SIZE;
+	size_t lzbufsize = LZBUF_SIZE, nth = 1;
+	unsigned par_dbits = 0;
+	srt_bool par_lzh = S_FALSE, lze = S_FALSE;
 	if (argc < 2)
 		return syntax_error(argv, 1);
+	if (argc >= 4 && !strcmp(argv[2], "-j"))
+		nth = (size_t)S_RANGE(atoi(argv[3]), 1, MAX_THREADS);
 	if (!strncmp(argv[1], "-crc32", 6)) {
 		acc = S_CRC32_INIT;
 		f32 = ss_crc32r;
@@ -107,10 +333,37 @@ int main(int argc, const char **argv)
 	else if (!strncmp(argv[1], "-ezh", 5)) {
 		ss_codec3_f = ss_enc_lzh;
 		lzbufsize = LZHBUF_SIZE;
-	} else if (!strncmp(argv[1], "-ez", 4))
+	} else if (!strncmp(argv[1], "-ez", 3) && argv[1][3] >= '0'
+		   && argv[1][3] <= '9' && !argv[1][4]) {
+		ss_codec3_f = ss_enc_lz;
+		lzlvl = argv[1][3] - '0';
+		lzbufsize = LZHBUF_SIZE;
+	} else if (!strncmp(argv[1], "-eze", 4) && argv[1][4] >= '0'
+		   && argv[1][4] <= '9' && !argv[1][5]) {
+		ss_codec3_f = ss_enc_lz;
+		lzlvl = argv[1][4] - '0';
+		lze = S_TRUE;
+		lzbufsize = LZHBUF_SIZE;
+	} else if (!strncmp(argv[1], "-dze", 5))
+		ss_codec4_f = ss_dec_lze;
+	else if (!strncmp(argv[1], "-ez", 4))
 		ss_codec3_f = ss_enc_lz;
 	else if (!strncmp(argv[1], "-dz", 4))
 		ss_codec4_f = ss_dec_lz;
+	else if (!strncmp(argv[1], "-ezs", 5))
+		zenc = slz_enc_alloc(0, S_TRUE);
+	else if (!strncmp(argv[1], "-dzs", 5))
+		zdec = slz_dec_alloc(0);
+	else if (!strncmp(argv[1], "-ezp", 4)) {
+		par = 7;
+		par_lzh = argv[1][4] == 'h' ? S_TRUE : S_FALSE;
+		par_dbits = argv[1][4] == 'd' ? PAR_DBITS : 0;
+	} else if (!strncmp(argv[1], "-dzp", 5))
+		par = 8;
+#ifdef ENC_THREADS
+	else if (!strncmp(argv[1], "-bzp", 5))
+		return par_bench(&in);
+#endif
 	else
 		return syntax_error(argv, 2);
 	esc = ss_codec2_f == ss_dec_esc_xml
@@ -119,6 +372,8 @@ int main(int argc, const char **argv)
 	cf = ss_codec1_f
 		     ? 1
 		     : ss_codec2_f ? 2 : ss_codec3_f ? 3 : ss_codec4_f ? 4 : 0;
+	if (!cf)
+		cf = zenc ? 5 : zdec ? 6 : par;
 	done = S_FALSE;
 	ss_reserve(&in, IBUF_SIZE);
 	while (!done) {
@@ -166,7 +421,12 @@ int main(int argc, const char **argv)
 				continue;
 			}
 			li += l;
-			ss_codec3_f(&out, in);
+			if (lze)
+				ss_enc_lze(&out, in, lzlvl);
+			else if (lzlvl >= 0)
+				ss_enc_lz_lvl(&out, in, lzlvl);
+			else
+				ss_codec3_f(&out, in);
 			lmax = ss_size(out);
 			dlep = dle;
 			s_st_pk_u64(&dlep, lmax);
@@ -217,13 +477,66 @@ int main(int argc, const char **argv)
 			}
 			ss_codec4_f(&out, in);
 			break;
+		case 5: /* data compression (stream, 1 MB window) */
+			ss_cpy_read(&in, stdin, IBUF_SIZE);
+			l = ss_size(in);
+			li += l;
+			if (!(l ? slz_enc_write(&out, zenc, in)
+				: slz_enc_end(&out, zenc))) {
+				fprintf(stderr, "Not enough memory\n");
+				exit_code = 10;
+				done = S_TRUE;
+				continue;
+			}
+			done = !l;
+			break;
+		case 6: /* data decompression (stream) */
+			ss_cpy_read(&in, stdin, IBUF_SIZE);
+			l = ss_size(in);
+			li += l;
+			st = slz_dec_write(&out, zdec, in);
+			if (st == SLZ_ERROR || (!l && st != SLZ_END)) {
+				fprintf(stderr, "Format error\n");
+				exit_code = 2;
+				done = S_TRUE;
+				continue;
+			}
+			done = st == SLZ_END;
+			break;
+		case 7: /* data compression (block-parallel containers) */
+			ss_cpy_read(&in, stdin, PAR_SEG_SIZE);
+			l = ss_size(in);
+			if (!l) {
+				done = S_TRUE;
+				continue;
+			}
+			li += l;
+			if (!par_enc(&out, in, par_dbits, par_lzh, nth)) {
+				fprintf(stderr, "Not enough memory\n");
+				exit_code = 10;
+				done = S_TRUE;
+				continue;
+			}
+			break;
+		case 8: /* data decompression (block-parallel containers) */
+			st = par_read(&in, stdin);
+			li += ss_size(in);
+			if (st <= 0 || !par_dec(&out, in, nth)) {
+				if (st) {
+					fprintf(stderr, "Format error\n");
+					exit_code = 2;
+				}
+				done = S_TRUE;
+				continue;
+			}
+			break;
 		default:
 			fprintf(stderr, "Logic error\n");
 			exit_code = 8;
 			done = S_TRUE;
 			continue;
 		}
-		if (ss_write(stdout, out, 0, S_NPOS) < 0) {
+		if (ss_size(out) && ss_write(stdout, out, 0, S_NPOS) < 0) {
 			fprintf(stderr, "Write error\n");
 			exit_code = 6;
 			break;
@@ -239,5 +552,7 @@ int main(int argc, const char **argv)
 	ss_free(&in);
 	ss_free(&out);
 #endif
+	slz_enc_free(&zenc);
+	slz_dec_free(&zdec);
 	return exit_code;
 }
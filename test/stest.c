@@ -9,6 +9,7 @@
 
 #include "../src/libsrt.h"
 #include "../src/saux/schar.h"
+#include "../src/saux/senc.h"
 #include "../src/saux/sdbg.h"
 #include "utf8_examples.h"
 #include <locale.h>
@@ -429,6 +430,325 @@ static int test_ss_len_u(const char *a, size_t expected_size)
 	return res;
 }
 
+static size_t test_utf8_count_ref(const char *s, size_t ss, size_t *errors)
+{
+	size_t i, n = 0, cs;
+	unsigned char c;
+	for (i = 0; i < ss; i += cs, n++) {
+		c = (unsigned char)s[i];
+		cs = c >= 0xfe ? 1 : c >= 0xfc ? 6 : c >= 0xf8 ? 5 : c >= 0xf0 ? 4
+		   : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+		if (i + cs > ss) {
+			(*errors)++;
+			cs = 1;
+		}
+	}
+	return n;
+}
+
+static int test_ss_len_u_vec()
+{
+	int res = 0;
+	char b[600];
+	const char *u[] = {"a", " ", U8_C_N_TILDE_D1, U8_EURO_20AC,
+			   U8_HAN_24B62, "\xf8\x88\x80\x80\x80",
+			   "\xfc\x84\x80\x80\x80\x80", "\x80", "\xbf",
+			   "\xfe", "\xff", "\xc3", "\xe2\x82"};
+	size_t i, j, k, n, ss, exp_n, exp_e, e;
+	uint32_t x = 12345;
+	srt_string *s = NULL;
+	srt_string_ref ref;
+	const srt_string *r;
+	/* Mixes of ASCII runs, valid and broken characters */
+	for (i = 0; i < 2000 && !res; i++) {
+		x = x * 1103515245 + 12345;
+		n = 1 + (x >> 16) % 13;
+		for (ss = 0; ss < sizeof(b) - 70;) {
+			x = x * 1103515245 + 12345;
+			k = (x >> 16) % (i % 3 ? 40 : 13);
+			if (k >= 13) {
+				for (j = 0; j < k; j++)
+					b[ss++] = 'a' + (char)j;
+				continue;
+			}
+			k = k % n;
+			for (j = 0; u[k][j]; j++)
+				b[ss++] = u[k][j];
+		}
+		x = x * 1103515245 + 12345;
+		ss -= (x >> 16) % 64; /* any tail, offset in the block */
+		for (j = 0; j < 64 && !res; j += 13) {
+			exp_e = e = 0;
+			exp_n = test_utf8_count_ref(b + j, ss - j, &exp_e);
+			if (sc_utf8_count_chars(b + j, ss - j, &e) != exp_n
+			    || e != exp_e)
+				res |= 1;
+			r = ss_ref_buf(&ref, b + j, ss - j);
+			if (ss_len_u(r) != exp_n
+			    || ss_encoding_errors(r) != (exp_e > 0))
+				res |= 2;
+			ss_cpy_cn(&s, b + j, ss - j);
+			if (ss_encoding_errors(s) != (exp_e > 0)
+			    || ss_len_u(s) != exp_n)
+				res |= 4;
+		}
+	}
+	/* Truncated character, error known on copy */
+	ss_free(&s);
+	s = ss_dup_c("0123456789abcdef0123456789abcdef" U8_HAN_24B62 "\xe2\x82");
+	res |= s && ss_encoding_errors(s) && ss_len_u(s) == 35 ? 0 : 8;
+	ss_free(&s);
+	return res;
+}
+
+static int test_ss_uindex()
+{
+	int res = 0;
+	const char *u[] = {"a", " ", U8_C_N_TILDE_D1, U8_EURO_20AC,
+			   U8_HAN_24B62};
+	size_t i, j, k, ss;
+	uint32_t x = 12345;
+	srt_string *s = ss_alloc(0), *a = ss_alloc(0), *b = ss_alloc(0);
+	srt_uindex *ix = ss_uindex_alloc(7), *ix2 = ss_uindex_alloc(0);
+	if (!s || !a || !b || !ix || !ix2)
+		res = 1;
+	for (i = 0; i < 3000 && !res; i++) {
+		x = x * 1103515245 + 12345;
+		ss_cat_c(&s, u[(x >> 16) % 5]);
+	}
+	ss_cat_cn(&s, "\xe2\x82", 2); /* truncated at the end */
+	ss = ss_size(s);
+	/* Offsets, in random order */
+	for (i = 0; i < 2000 && !res; i++) {
+		x = x * 1103515245 + 12345;
+		k = (x >> 16) % 3100;
+		j = sc_unicode_count_to_utf8_size(ss_get_buffer_r(s), 0, ss, k,
+						  NULL);
+		if (ss_uindex_off(ix, s, k) != j || ss_uindex_off(ix2, s, k) != j
+		    || ss_uindex_off(NULL, s, k) != j)
+			res |= 2;
+		ss_cpy_substr_u(&a, s, k, i % 40);
+		ss_cpy_substr_ux(&b, ix, s, k, i % 40);
+		if (ss_cmp(a, b) || ss_len_u(a) != ss_len_u(b))
+			res |= 4;
+		ss_cpy_c(&a, "x");
+		ss_cpy_c(&b, "x");
+		ss_cat_substr_u(&a, s, k, i % 40);
+		ss_cat_substr_ux(&b, ix, s, k, i % 40);
+		res |= !ss_cmp(a, b) ? 0 : 8;
+	}
+	/* Erase, keeping the index valid */
+	ss_cpy(&a, s);
+	for (i = 0; i < 300 && !res; i++) {
+		x = x * 1103515245 + 12345;
+		k = (x >> 16) % (ss_len_u(a) + 10);
+		ss_erase_u(&a, k, i % 9);
+		ss_erase_ux(&s, ix, k, i % 9);
+		if (ss_cmp(a, s) || ss_len_u(a) != ss_len_u(s))
+			res |= 16;
+		for (j = 0; j < ss_len_u(s) && !res; j += 97)
+			if (ss_uindex_off(ix, s, j)
+			    != sc_unicode_count_to_utf8_size(
+				    ss_get_buffer_r(s), 0, ss_size(s), j, NULL))
+				res |= 32;
+	}
+	/* External modification, and invalidation */
+	ss_cpy_c(&a, U8_HAN_24B62);
+	ss_cat_cn(&s, "\xe2", 1);
+	ss_uindex_invalidate(ix, ss_size(s) - 1);
+	ss_cat_cn(&s, "\x82\xac", 2);
+	ss_uindex_invalidate(ix, ss_size(s) - 2);
+	ss_cpy_substr(&b, s, 0, 5);
+	ss_cat(&b, a);
+	ss_cat_substr(&b, s, 5, S_NPOS);
+	ss_cpy(&s, b); /* insert at byte offset 5 */
+	ss_uindex_invalidate(ix, 5);
+	for (j = 0; j < ss_len_u(s) + 2 && !res; j++)
+		if (ss_uindex_off(ix, s, j)
+		    != sc_unicode_count_to_utf8_size(ss_get_buffer_r(s), 0,
+						     ss_size(s), j, NULL))
+			res |= 64;
+	/* Single byte characters: no index required */
+	ss_cpy_c(&a, "hello world");
+	res |= ss_uindex_off(ix2, a, 6) == 6 && ss_uindex_off(ix2, a, 20) == 11
+		       ? 0
+		       : 128;
+#ifdef S_USE_VA_ARGS
+	ss_free(&s, &a, &b);
+	ss_uindex_free(&ix, &ix2);
+#else
+	ss_free(&s);
+	ss_free(&a);
+	ss_free(&b);
+	ss_uindex_free(&ix);
+	ss_uindex_free(&ix2);
+#endif
+	return res;
+}
+
+static int test_sr_rope()
+{
+	int res = 0;
+	char buf[10000];
+	const char *p;
+	size_t i, k, n, ps;
+	uint32_t x = 54321;
+	srt_rope_it it;
+	srt_string *ref = ss_alloc(0), *a = ss_alloc(0), *b = ss_alloc(0);
+	srt_rope *r = sr_alloc(), *r2 = sr_alloc();
+	if (!ref || !a || !b || !r || !r2)
+		res = 1;
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (char)('a' + i % 26);
+	/* Random editing, compared against a flat string */
+	for (i = 0; i < 2000 && !res; i++) {
+		x = x * 1103515245 + 12345;
+		k = (x >> 16) % (ss_size(ref) + 10);
+		n = i % 7 ? i % 50 : (x >> 8) % sizeof(buf);
+		if (i % 3) {
+			ss_cpy_substr(&a, ref, 0, k);
+			ss_cat_cn(&a, buf + i % 26, n);
+			ss_cat_substr(&a, ref, k, S_NPOS);
+			ss_cpy(&ref, a);
+			res |= sr_insert_cn(r, k, buf + i % 26, n) ? 0 : 2;
+		} else {
+			ss_erase(&ref, k, n);
+			res |= sr_erase(r, k, n) ? 0 : 4;
+		}
+		if (sr_size(r) != ss_size(ref))
+			res |= 8;
+		if (i % 50 == 0 && ss_cmp(sr_to_ss(&b, r), ref))
+			res |= 16;
+	}
+	/* Random access */
+	for (i = 0; i < 500 && !res; i++) {
+		x = x * 1103515245 + 12345;
+		k = (x >> 16) % (ss_size(ref) + 2);
+		if (sr_at(r, k) != ss_at(ref, k))
+			res |= 32;
+		ss_cpy_substr(&a, ref, k, i);
+		if (ss_cmp(sr_substr(&b, r, k, i), a))
+			res |= 64;
+	}
+	/* Shared output string (empty result) */
+	ss_cpy_c(&b, "xyz");
+	if (!ss_set_shared(&b) || ss_size(sr_substr(&b, r, sr_size(r), 1)))
+		res |= 64;
+	/* Zero-copy iteration */
+	ss_clear(a);
+	sr_it_init(&it, r);
+	for (i = 0; sr_it_next(&it, &p, &ps); i++) {
+		if (!ps || ps > SR_CHUNK_MAX)
+			res |= 128;
+		ss_cat_cn(&a, p, ps);
+	}
+	if (ss_cmp(a, ref) || (ss_size(ref) > SR_CHUNK_MAX && i < 2))
+		res |= 256;
+	/* Rope concatenation (chunks moved) */
+	sr_cat(r2, ref);
+	sr_cat_cn(r2, "123", 3);
+	ss_cpy(&a, ref);
+	ss_cat(&a, ref);
+	ss_cat_c(&a, "123");
+	if (!sr_cat_rope(r, r2) || sr_size(r2) != 0 || sr_cat_rope(r, r)
+	    || ss_cmp(sr_to_ss(&b, r), a))
+		res |= 512;
+	sr_clear(r);
+	if (sr_size(r) || !sr_cat_cn(r, "x", 1) || sr_at(r, 0) != 'x')
+		res |= 1024;
+#ifdef S_USE_VA_ARGS
+	ss_free(&ref, &a, &b);
+	sr_free(&r, &r2);
+#else
+	ss_free(&ref);
+	ss_free(&a);
+	ss_free(&b);
+	sr_free(&r);
+	sr_free(&r2);
+#endif
+	return res;
+}
+
+static int test_sin_intern()
+{
+	int res = 0;
+	FILE *f;
+	size_t i, n;
+	uint32_t id;
+	const char *p;
+	srt_string *a = ss_alloc(0), *b = ss_alloc(0);
+	srt_intern *in = sin_alloc(0), *in2 = NULL;
+	if (!a || !b || !in)
+		res = 1;
+	/* Dense IDs, in insertion order, stable across index growth */
+	for (i = 0; i < 1000 && !res; i++) {
+		ss_printf(&a, 100, "str%i", (int)i);
+		if (sin_id(in, a) != i || sin_id(in, a) != i)
+			res |= 2;
+	}
+	if (sin_size(in) != 1000 || sin_id_cn(in, "", 0) != 1000
+	    || sin_id_cn(in, NULL, 0) != 1000 || sin_size(in) != 1001)
+		res |= 4;
+	for (i = 0; i < 1000 && !res; i++) {
+		ss_printf(&a, 100, "str%i", (int)i);
+		p = sin_get(in, (uint32_t)i, &n);
+		if (sin_find(in, a) != i || !p || n != ss_size(a)
+		    || memcmp(p, ss_get_buffer_r(a), n)
+		    || ss_cmp(sin_cpy(&b, in, (uint32_t)i), a)
+		    || ss_cmp(sin_cpy_sync(&b, in, (uint32_t)i), a)
+		    || sin_id_sync(in, a) != i)
+			res |= 8;
+	}
+	if (sin_find(in, ss_crefa("str1000")) != SIN_NONE
+	    || sin_get(in, 1001, NULL) || ss_size(sin_cpy(&b, in, 1001))
+	    || sin_id_sync(in, ss_crefa("str1000")) != 1001)
+		res |= 16;
+	/* Write/read round trip (same IDs) */
+	remove(STEST_FILE);
+	f = fopen(STEST_FILE, S_FOPEN_BINARY_RW_TRUNC);
+	if (f) {
+		if (sin_write(f, in) <= 0)
+			res |= 32;
+		fseek(f, 0, SEEK_SET);
+		in2 = sin_read(f);
+		if (!in2 || sin_size(in2) != sin_size(in))
+			res |= 64;
+		for (i = 0; i < sin_size(in) && in2; i++) {
+			sin_cpy(&a, in, (uint32_t)i);
+			if (sin_find(in2, a) != i
+			    || ss_cmp(sin_cpy(&b, in2, (uint32_t)i), a))
+				res |= 128;
+		}
+		/* Corrupted offset: short read, without the huge allocation */
+		sin_free(&in2);
+		fseek(f, 0, SEEK_SET);
+		if (fwrite("SIN1\1\0\0\0\0\0\0\x7f\0\0\0\0", 1, 16, f)
+			    != 16
+		    || fseek(f, 0, SEEK_SET) || (in2 = sin_read(f)) != NULL)
+			res |= 128;
+		fclose(f);
+		if (remove(STEST_FILE) != 0)
+			res |= 256;
+	} else {
+		res |= 512;
+	}
+	sin_clear(in);
+	id = sin_id(in, ss_crefa("str5"));
+	if (sin_size(in) != 1 || id != 0
+	    || sin_find(in, ss_crefa("str1")) != SIN_NONE)
+		res |= 1024;
+#ifdef S_USE_VA_ARGS
+	ss_free(&a, &b);
+	sin_free(&in, &in2);
+#else
+	ss_free(&a);
+	ss_free(&b);
+	sin_free(&in);
+	sin_free(&in2);
+#endif
+	return res;
+}
+
 /* clang-format off */
 static int test_ss_capacity()
 {
@@ -491,6 +811,89 @@ static int test_ss_dup()
 	return res;
 }
 
+static int test_ss_shared()
+{
+	int res = 0;
+	size_t i;
+	srt_string *a, *b, *c = NULL, *d, *e = ss_alloca(300), *r;
+	srt_string *x = ss_dup_c("xyz" U8_C_N_TILDE_D1);
+	const srt_string *cr = ss_crefa("hello");
+	for (i = 0; i < 2 && !res; i++) {
+		/* i = 0: small string, i = 1: big string */
+		a = ss_dup_c("hello " U8_C_N_TILDE_D1);
+		if (i)
+			ss_resize(&a, 280, 'z');
+		r = ss_dup(a);
+		if (!ss_set_shared(&a) || !ss_is_shared(a)
+		    || ss_shared_refs(a) != 1 || !ss_set_shared(&a))
+			res |= 1;
+		b = ss_dup(a);
+		ss_cpy(&c, a);
+		if (b != a || c != a || ss_shared_refs(a) != 3
+		    || strcmp(ss_to_c(a), ss_to_c(r)) || ss_len_u(b) != ss_len_u(r))
+			res |= 2;
+		/* Copy on write */
+		ss_cat_c(&b, "!");
+		ss_tolower(&c);
+		if (b == a || c == a || ss_shared_refs(a) != 1 || ss_is_shared(b)
+		    || ss_size(b) != ss_size(a) + 1 || ss_cmp(a, r)
+		    || ss_ncmp(a, 0, b, ss_size(a)))
+			res |= 4;
+		/* Aliasing */
+		d = ss_dup(a);
+		ss_cat(&a, a);
+		if (a == d || ss_size(a) != 2 * ss_size(d) || ss_cmp(d, r)
+		    || ss_shared_refs(d) != 1)
+			res |= 8;
+		ss_cpy(&a, d);
+		ss_cpy_substr(&d, d, 1, 3);
+		if (a == d || ss_cmp(a, r) || ss_size(d) != 3
+		    || ss_shared_refs(a) != 1)
+			res |= 16;
+		/* Last reference: buffer taken (no copy) */
+		ss_free(&d);
+		d = a;
+		ss_erase(&a, 0, 1);
+		if (a != d || ss_is_shared(a) || ss_size(a) != ss_size(r) - 1)
+			res |= 32;
+		/* Overwrite a shared string, and copy to a stack string */
+		ss_set_shared(&a);
+		ss_set_shared(&x);
+		d = ss_dup(x);
+		ss_cpy(&d, a);
+		ss_cpy(&e, a);
+		if (d != a || ss_shared_refs(x) != 1 || ss_is_shared(e)
+		    || ss_cmp(e, a) || ss_shared_refs(a) != 2)
+			res |= 64;
+		ss_cpy_c(&d, "abc");
+		if (d == a || strcmp(ss_to_c(d), "abc") || ss_shared_refs(a) != 1)
+			res |= 128;
+		/* Clear a shared string, then append to it */
+		ss_free(&d);
+		d = ss_dup(a);
+		ss_cpy_c(&d, "");
+		ss_cat_c(&d, "xyz");
+		if (d == a || strcmp(ss_to_c(d), "xyz")
+		    || ss_shared_refs(a) != 1 || ss_size(a) != ss_size(r) - 1)
+			res |= 512;
+#ifdef S_USE_VA_ARGS
+		ss_free(&a, &b, &c, &d, &r);
+#else
+		ss_free(&a);
+		ss_free(&b);
+		ss_free(&c);
+		ss_free(&d);
+		ss_free(&r);
+#endif
+	}
+	/* Not allowed */
+	if (ss_set_shared(NULL) || ss_set_shared((srt_string **)&cr)
+	    || ss_set_shared(&e) || ss_is_shared(cr) || !ss_is_cref(cr))
+		res |= 256;
+	ss_free(&x);
+	return res;
+}
+
 static int test_ss_dup_substr()
 {
 	const srt_string *crefa_hello = ss_crefa("hello");
@@ -1463,6 +1866,26 @@ static int test_ss_cat_int(const char *in, int64_t num, const char *expected)
 	TEST_SS_OPCHK(ss_cat_int(&sa, num), in, "", expected);
 }
 
+static int test_ss_cat_uint(const char *in, uint64_t num,
+			    const char *expected)
+{
+	TEST_SS_OPCHK_VARS;
+	TEST_SS_OPCHK(ss_cat_uint(&sa, num), in, "", expected);
+}
+
+static int test_ss_cat_double(const char *in, double num,
+			      const char *expected)
+{
+	TEST_SS_OPCHK_VARS;
+	TEST_SS_OPCHK(ss_cat_double(&sa, num), in, "", expected);
+}
+
+static int test_ss_cat_float(const char *in, float num, const char *expected)
+{
+	TEST_SS_OPCHK_VARS;
+	TEST_SS_OPCHK(ss_cat_float(&sa, num), in, "", expected);
+}
+
 static int test_ss_cat_tolower(const srt_string *a, const srt_string *b,
 			       const srt_string *expected)
 {
@@ -1630,6 +2053,896 @@ static int test_ss_toupper(const char *a, const char *b)
 	TEST_SS_OPCHK(ss_toupper(&sa), a, "", b);
 }
 
+/* Long ASCII runs mixed with non-ASCII characters (vectorized code paths) */
+static int test_ss_case_vec()
+{
+	int res = 0;
+	const char *tu[] = {"A", "M", "Z", "@", "[", "`", "{", "0", " ",
+#ifdef S_MINIMAL /* no Unicode case conversion */
+			    U8_S_N_TILDE_F1, U8_EURO_20AC},
+#else
+			    U8_C_N_TILDE_D1, U8_EURO_20AC},
+#endif
+		   *tl[] = {"a", "m", "z", "@", "[", "`", "{", "0", " ",
+			    U8_S_N_TILDE_F1, U8_EURO_20AC};
+	size_t i, j, k, t, pos;
+	uint32_t x = 12345;
+	char c;
+	srt_string *src = ss_alloc(0), *lo = ss_alloc(0), *up = ss_alloc(0),
+		   *s = NULL, *s2 = NULL;
+	for (i = 0; i < 300 && !res; i++) {
+		ss_clear(src);
+		ss_clear(lo);
+		ss_clear(up);
+		pos = S_NPOS;
+		for (j = 0; j < i % 150; j++) {
+			x = x * 1103515245 + 12345;
+			k = (x >> 16) % 100;
+			t = k < 98 ? (k % 9) : 9 + (k % 2);
+			if ((x >> 8) % 7 == 0)
+				t = (x >> 4) % 3; /* a letter */
+			if (t < 3 && (pos == S_NPOS || (x >> 12) % 4 == 0))
+				pos = ss_size(lo);
+			ss_cat_c(&src, (j % 2 ? tu : tl)[t]);
+			ss_cat_c(&lo, tl[t]);
+			ss_cat_c(&up, tu[t]);
+		}
+		ss_cpy_c(&s, "prefix");
+		ss_cat_tolower(&s, src);
+		ss_cpy_c(&s2, "prefix");
+		ss_cat(&s2, lo);
+		res |= !ss_cmp(s, s2) ? 0 : 1;
+		ss_free(&s);
+		s = ss_dup_tolower(src);
+		res |= !ss_cmp(s, lo) ? 0 : 2;
+		ss_cpy_toupper(&s, src);
+		res |= !ss_cmp(s, up) ? 0 : 4;
+		ss_cpy(&s, src);
+		ss_tolower(&s);
+		res |= !ss_cmp(s, lo) ? 0 : 8;
+		ss_toupper(&s);
+		res |= !ss_cmp(s, up) ? 0 : 16;
+		res |= !ss_cmpi(src, up) && !ss_cmpi(lo, src) ? 0 : 32;
+		if (pos != S_NPOS) {
+			/* Difference after the common prefix */
+			ss_cpy(&s, lo);
+			c = (char)ss_at(s, pos);
+			ss_get_buffer(s)[pos] = c == 'z' ? 'a' : 'z';
+			res |= ss_cmpi(src, s) * (c == 'z' ? 1 : -1) > 0 ? 0 : 64;
+			res |= !ss_ncmpi(src, 0, s, pos) ? 0 : 128;
+		}
+	}
+	/* Non-letters next to the letter ranges are not folded */
+	ss_cpy_c(&s, "0123456789abcde[0123456789abcdef");
+	ss_cpy_c(&s2, "0123456789ABCDE{0123456789ABCDEF");
+	res |= ss_cmpi(s, s2) < 0 && ss_cmpi(s2, s) > 0 ? 0 : 256;
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &lo, &up, &s, &s2);
+#else
+	ss_free(&src);
+	ss_free(&lo);
+	ss_free(&up);
+	ss_free(&s);
+	ss_free(&s2);
+#endif
+	return res;
+}
+
+/* Base64 (vectorized code paths, URL alphabet, no padding, validation) */
+static int test_ss_b64_vec()
+{
+	int res = 0;
+	const char *b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+			  "0123456789+/";
+	char c, *p;
+	size_t i, j, k, n, off;
+	unsigned v;
+	uint32_t x = 12345;
+	srt_string *src = ss_alloc(0), *ref = ss_alloc(0), *url = ss_alloc(0),
+		   *s = ss_alloc(0);
+	for (n = 0; n < 200 && !res; n++) {
+		ss_clear(src);
+		ss_clear(ref);
+		ss_clear(url);
+		for (i = 0; i < n; i++) {
+			x = x * 1103515245 + 12345;
+			c = (char)(x >> 16);
+			ss_cat_cn(&src, &c, 1);
+		}
+		/* Reference encoding */
+		p = ss_get_buffer(src);
+		for (i = 0; i < n; i += 3) {
+			v = (unsigned)(uint8_t)p[i] << 16;
+			v |= i + 1 < n ? (unsigned)(uint8_t)p[i + 1] << 8 : 0;
+			v |= i + 2 < n ? (uint8_t)p[i + 2] : 0;
+			for (j = 0; j < 4; j++) {
+				k = (v >> (18 - 6 * j)) & 0x3f;
+				ss_cat_char(&ref, i + j <= n ? b64[k] : '=');
+				if (i + j <= n)
+					ss_cat_char(&url, k == 62 ? '-'
+							  : k == 63 ? '_'
+								    : b64[k]);
+			}
+		}
+		ss_cpy_enc_b64(&s, src);
+		res |= !ss_cmp(s, ref) ? 0 : 1;
+		ss_cpy(&s, src);
+		ss_enc_b64(&s, s); /* aliasing */
+		res |= !ss_cmp(s, ref) ? 0 : 2;
+		ss_cpy_enc_b64url(&s, src);
+		res |= !ss_cmp(s, url) ? 0 : 4;
+		ss_dec_b64(&s, s); /* aliasing, URL alphabet, no padding */
+		res |= !ss_cmp(s, src) ? 0 : 8;
+		ss_cpy_dec_b64(&s, ref);
+		res |= !ss_cmp(s, src) ? 0 : 16;
+		ss_cpy_dec_b64_chk(&s, ref, S_FALSE, &off);
+		res |= !ss_cmp(s, src) && off == S_NPOS ? 0 : 32;
+		ss_cpy_dec_b64_chk(&s, url, S_TRUE, &off);
+		res |= !ss_cmp(s, src) && off == S_NPOS ? 0 : 64;
+		/* Alphabet mismatch: error at the first '+', '/', '-' or '_' */
+		k = S_MIN(ss_findc(ref, 0, '+'), ss_findc(ref, 0, '/'));
+		k = k < ss_size(ref) ? k : S_NPOS;
+		ss_cpy_dec_b64_chk(&s, ref, S_TRUE, &off);
+		res |= off == k && (k == S_NPOS || ss_size(s) == k / 4 * 3)
+			       ? 0
+			       : 128;
+		k = S_MIN(ss_findc(url, 0, '-'), ss_findc(url, 0, '_'));
+		k = k < ss_size(url) ? k : S_NPOS;
+		ss_cpy_dec_b64_chk(&s, url, S_FALSE, &off);
+		res |= off == k ? 0 : 256;
+		/* Invalid character at random offset */
+		if (n > 0) {
+			k = (x >> 8) % (ss_size(ref) - (n % 3 ? 3 : 0));
+			ss_cpy(&s, ref);
+			ss_get_buffer(s)[k] = (x >> 4) % 2 ? '*' : '\xc1';
+			ss_cpy_dec_b64_chk(&s, s, S_FALSE, &off);
+			res |= off == k && ss_size(s) == k / 4 * 3 ? 0 : 512;
+		}
+	}
+	ss_cpy_dec_b64_chk(&s, ss_crefa("QQ=A"), S_FALSE, &off);
+	res |= off == 3 ? 0 : 1024;
+	ss_cpy_dec_b64_chk(&s, ss_crefa("QUJDQ"), S_FALSE, &off);
+	res |= off == 4 && !ss_cmp(s, ss_crefa("ABC")) ? 0 : 2048;
+	ss_cpy_dec_b64_chk(&s, ss_crefa("QUI"), S_FALSE, &off);
+	res |= off == S_NPOS && !ss_cmp(s, ss_crefa("AB")) ? 0 : 4096;
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &ref, &url, &s);
+#else
+	ss_free(&src);
+	ss_free(&ref);
+	ss_free(&url);
+	ss_free(&s);
+#endif
+	return res;
+}
+
+/*
+ * Reference escaping/hex encoding (0: JSON, 1: XML, 2: URL, 3: double quote,
+ * 4: single quote, 5: hex, 6: HEX)
+ */
+static void test_esc_ref(srt_string **r, const char *p, size_t n, int kind)
+{
+	size_t i;
+	uint8_t c;
+	const char *e, *hu = "0123456789ABCDEF", *hl = "0123456789abcdef",
+		   *hx = kind == 6 ? hu : hl;
+	char h[3];
+	ss_clear(*r);
+	for (i = 0; i < n; i++) {
+		c = (uint8_t)p[i];
+		e = NULL;
+		if (kind == 0)
+			e = c == 8 ? "\\b" : c == 9 ? "\\t" : c == 10 ? "\\n"
+			  : c == 12 ? "\\f" : c == 13 ? "\\r"
+			  : c == '"' ? "\\\"" : c == '\\' ? "\\\\" : NULL;
+		else if (kind == 1)
+			e = c == '"' ? "&quot;" : c == '\'' ? "&apos;"
+			  : c == '&' ? "&amp;" : c == '<' ? "&lt;"
+			  : c == '>' ? "&gt;" : NULL;
+		else if (kind == 3)
+			e = c == '"' ? "\"\"" : NULL;
+		else if (kind == 4)
+			e = c == '\'' ? "''" : NULL;
+		if (e) {
+			ss_cat_c(r, e);
+			continue;
+		}
+		if (kind >= 5
+		    || (kind == 2 && !(c >= 'A' && c <= 'Z')
+			&& !(c >= 'a' && c <= 'z') && !(c >= '0' && c <= '9')
+			&& c != '-' && c != '_' && c != '.' && c != '~')) {
+			h[0] = kind == 2 ? '%' : hx[c >> 4];
+			h[1] = kind == 2 ? hu[c >> 4] : hx[c & 15];
+			h[2] = hu[c & 15];
+			ss_cat_cn(r, h, kind == 2 ? 3 : 2);
+			continue;
+		}
+		ss_cat_cn(r, p + i, 1);
+	}
+}
+
+static int test_ss_esc_vec()
+{
+	int res = 0, kind;
+	const char *sp = "\"'&<>\\\b\t\n\v\f\r-_.~/%Az09 \x7f\x80\xff";
+	char c, *p;
+	size_t i, n;
+	uint32_t x = 12345;
+	srt_string *src = ss_alloc(0), *ref = ss_alloc(0), *s = ss_alloc(0);
+	for (n = 0; n < 300 && !res; n++) {
+		ss_clear(src);
+		for (i = 0; i < n; i++) {
+			x = x * 1103515245 + 12345;
+			/* Random, sparse, dense, dense then clean, or none */
+			switch (n % 5) {
+			case 0:
+				c = (char)(x >> 16);
+				break;
+			case 1:
+				c = (x >> 16) % 64 ? (char)('a' + (x >> 8) % 26)
+						   : sp[(x >> 20) % 26];
+				break;
+			case 2:
+				c = sp[(x >> 16) % 26];
+				break;
+			case 3:
+				c = i < n / 2 ? sp[(x >> 16) % 26]
+					      : (char)('a' + (x >> 8) % 26);
+				break;
+			default:
+				c = (char)('0' + (x >> 16) % 10);
+			}
+			ss_cat_cn(&src, &c, 1);
+		}
+		p = ss_get_buffer(src);
+		for (kind = 0; kind < 7; kind++) {
+			test_esc_ref(&ref, p, n, kind);
+			switch (kind) {
+			case 0:
+				ss_cpy_enc_esc_json(&s, src);
+				break;
+			case 1:
+				ss_cpy_enc_esc_xml(&s, src);
+				break;
+			case 2:
+				ss_cpy_enc_esc_url(&s, src);
+				break;
+			case 3:
+				ss_cpy_enc_esc_dquote(&s, src);
+				break;
+			case 4:
+				ss_cpy_enc_esc_squote(&s, src);
+				break;
+			case 5:
+				ss_cpy_enc_hex(&s, src);
+				break;
+			default:
+				ss_cpy_enc_HEX(&s, src);
+			}
+			res |= !ss_cmp(s, ref) ? 0 : 1 << kind;
+		}
+		/* Aliasing */
+		ss_cpy(&s, src);
+		ss_enc_esc_json(&s, s);
+		test_esc_ref(&ref, p, n, 0);
+		res |= !ss_cmp(s, ref) ? 0 : 0x80;
+		ss_cpy(&s, src);
+		ss_enc_esc_xml(&s, s);
+		test_esc_ref(&ref, p, n, 1);
+		res |= !ss_cmp(s, ref) ? 0 : 0x100;
+		ss_cpy(&s, src);
+		ss_enc_esc_url(&s, s);
+		test_esc_ref(&ref, p, n, 2);
+		res |= !ss_cmp(s, ref) ? 0 : 0x200;
+		ss_cpy(&s, src);
+		ss_enc_esc_dquote(&s, s);
+		test_esc_ref(&ref, p, n, 3);
+		res |= !ss_cmp(s, ref) ? 0 : 0x400;
+		ss_cpy(&s, src);
+		ss_enc_hex(&s, s);
+		test_esc_ref(&ref, p, n, 5);
+		res |= !ss_cmp(s, ref) ? 0 : 0x800;
+		ss_dec_hex(&s, s);
+		res |= !ss_cmp(s, src) ? 0 : 0x1000;
+		test_esc_ref(&ref, p, n, 6);
+		ss_cpy_dec_hex(&s, ref);
+		res |= !ss_cmp(s, src) ? 0 : 0x2000;
+		/* Non-hex character: only its byte is affected */
+		if (n > 0) {
+			i = (x >> 8) % (2 * n);
+			ss_get_buffer(ref)[i] = (x >> 4) % 2 ? 'g' : '\xb0';
+			ss_cpy_dec_hex(&s, ref);
+			ss_get_buffer(s)[i / 2] = p[i / 2];
+			res |= !ss_cmp(s, src) ? 0 : 0x4000;
+		}
+	}
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &ref, &s);
+#else
+	ss_free(&src);
+	ss_free(&ref);
+	ss_free(&s);
+#endif
+	return res;
+}
+
+static int test_ss_enc_lz_ctx()
+{
+	int res = 0;
+	const char *w[] = {"lorem", "ipsum", " ", "dolor", "\n", "sit", "amet"};
+	const size_t sz[] = {0, 3, 5, 17, 100, 1000, 5000, 70000, 300, 40};
+	size_t i, j, r;
+	uint32_t x = 12345;
+	srt_lz_ctx *c = ss_lz_ctx_alloc();
+	srt_string *src = ss_alloc(0), *ref = ss_alloc(0), *s = ss_alloc(0),
+		   *d = ss_alloc(0);
+	if (!c)
+		return 1;
+	for (r = 0; r < 30 && !res; r++) {
+		/* BEHAVIOR: empty output does not overwrite the string */
+		ss_clear(src);
+		ss_clear(ref);
+		ss_clear(s);
+		ss_clear(d);
+		for (i = sz[r % 10]; ss_size(src) < i;) {
+			x = x * 1103515245 + 12345;
+			j = (x >> 16) % 10;
+			if (j < 7)
+				ss_cat_c(&src, w[j]);
+			else
+				ss_cat_int(&src, (int64_t)(x >> 20));
+		}
+		if (r == 20) /* generation counter overflow */
+			c->base = S_SIZET_MAX - 10;
+		ss_cpy_enc_lz(&ref, src);
+		ss_cpy_enc_lz_ctx(&s, src, c);
+		res |= !ss_cmp(s, ref) ? 0 : 2;
+		ss_cpy_dec_lz(&d, s);
+		res |= !ss_cmp(d, src) ? 0 : 4;
+		ss_cpy_enc_lzh(&ref, src);
+		ss_cpy(&s, src);
+		ss_enc_lzh_ctx(&s, s, c); /* aliasing */
+		res |= !ss_cmp(s, ref) ? 0 : 8;
+		ss_cpy_c(&s, "x");
+		ss_cat_enc_lzh_ctx(&s, src, c);
+		ss_cpy_c(&d, "x");
+		ss_cat(&d, ref);
+		res |= !ss_cmp(s, d) ? 0 : 16;
+		ss_clear(s);
+		ss_cpy_enc_lzh_ctx(&s, src, NULL);
+		res |= !ss_cmp(s, ref) ? 0 : 32;
+	}
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &ref, &s, &d);
+#else
+	ss_free(&src);
+	ss_free(&ref);
+	ss_free(&s);
+	ss_free(&d);
+#endif
+	ss_lz_ctx_free(&c);
+	return res | (!c ? 0 : 64);
+}
+
+static int test_ss_enc_lz_lvl()
+{
+	int res = 0, l;
+	const char *w[] = {"lorem", "ipsum", " ", "dolor", "\n", "sit", "amet"};
+	const size_t sz[] = {0, 3, 5, 17, 100, 1000, 70000, 20000, 5000};
+	size_t i, j, r, zs[SS_LZ_LEVEL_MAX + 1];
+	uint32_t x = 12345;
+	srt_string *z, *src = ss_alloc(0), *ref = ss_alloc(0),
+			   *s = ss_alloc(0), *d = ss_alloc(0);
+	for (r = 0; r < 9 && !res; r++) {
+		ss_clear(src);
+		for (i = sz[r]; ss_size(src) < i;) {
+			x = x * 1103515245 + 12345;
+			j = (x >> 16) % 10;
+			if (r == 7) /* binary (incompressible) */
+				ss_cat_char(&src, (int)((x >> 16) & 0xff));
+			else if (j < 7)
+				ss_cat_c(&src, w[j]);
+			else
+				ss_cat_int(&src, (int64_t)(x >> 20));
+		}
+		if (r == 8) { /* long matches */
+			ss_cpy(&ref, src);
+			ss_cat(&src, ref);
+			ss_clear(ref);
+		}
+		for (l = 0; l <= SS_LZ_LEVEL_MAX; l++) {
+			/* BEHAVIOR: empty output does not overwrite */
+			ss_clear(s);
+			ss_clear(d);
+			ss_cpy_enc_lz_lvl(&s, src, l);
+			zs[l] = ss_size(s);
+			ss_cpy_dec_lz(&d, s);
+			res |= !ss_cmp(d, src) ? 0 : 1 << l;
+			ss_cpy_c(&d, "x");
+			ss_cat_enc_lz_lvl(&d, src, l);
+			ss_cpy_c(&ref, "x");
+			ss_cat(&ref, s);
+			res |= !ss_cmp(d, ref) ? 0 : 1 << 10;
+			ss_cpy(&d, src);
+			ss_enc_lz_lvl(&d, d, l); /* aliasing */
+			res |= !ss_cmp(d, s) ? 0 : 1 << 11;
+		}
+		ss_clear(s);
+		ss_clear(ref);
+		ss_cpy_enc_lz(&ref, src);
+		ss_cpy_enc_lz_lvl(&s, src, -1);
+		res |= !ss_cmp(s, ref) ? 0 : 1 << 12;
+		ss_cpy_enc_lzh(&ref, src);
+		ss_cpy_enc_lz_lvl(&s, src, SS_LZ_LEVEL_HIGH);
+		res |= !ss_cmp(s, ref) ? 0 : 1 << 13;
+		z = ss_dup_enc_lz_lvl(src, SS_LZ_LEVEL_MAX + 1);
+		ss_cpy_enc_lz_lvl(&s, src, SS_LZ_LEVEL_MAX);
+		res |= !ss_cmp(z, s) ? 0 : 1 << 14;
+		ss_free(&z);
+#if !defined(S_MINIMAL) && !defined(S_LZ_DONT_ALLOW_HEAP_USAGE)
+		/* higher levels compress better (text, long matches) */
+		if (ss_size(src) >= 1000 && r != 7)
+			res |= zs[9] < zs[5] && zs[5] < zs[2] && zs[2] < zs[1]
+				       ? 0
+				       : 1 << 15;
+#else
+		(void)zs;
+#endif
+	}
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &ref, &s, &d);
+#else
+	ss_free(&src);
+	ss_free(&ref);
+	ss_free(&s);
+	ss_free(&d);
+#endif
+	return res;
+}
+
+static int test_ss_enc_lze()
+{
+	int res = 0, l;
+	const char *w[] = {"lorem", "ipsum", " ", "dolor", "\n", "sit", "amet"};
+	const size_t sz[] = {0, 3, 5, 17, 100, 1000, 70000, 20000};
+	size_t i, j, r, k;
+	uint32_t x = 12345;
+	srt_string *z, *src = ss_alloc(0), *ref = ss_alloc(0),
+			   *s = ss_alloc(0), *d = ss_alloc(0);
+	for (r = 0; r < 8 && !res; r++) {
+		ss_clear(src);
+		for (i = sz[r]; ss_size(src) < i;) {
+			x = x * 1103515245 + 12345;
+			j = (x >> 16) % 10;
+			if (r == 7) /* binary (incompressible) */
+				ss_cat_char(&src, (int)((x >> 16) & 0xff));
+			else if (j < 7)
+				ss_cat_c(&src, w[j]);
+			else
+				ss_cat_int(&src, (int64_t)(x >> 20));
+		}
+		for (l = 0; l <= SS_LZ_LEVEL_MAX; l += 3) {
+			/* BEHAVIOR: empty output does not overwrite */
+			ss_clear(s);
+			ss_clear(d);
+			ss_cpy_enc_lze(&s, src, l);
+			ss_cpy_dec_lze(&d, s);
+			res |= !ss_cmp(d, src) ? 0 : 1;
+			ss_cpy_c(&d, "x");
+			ss_cat_enc_lze(&d, src, l);
+			ss_cpy_c(&ref, "x");
+			ss_cat(&ref, s);
+			res |= !ss_cmp(d, ref) ? 0 : 2;
+			ss_cpy(&d, s);
+			ss_dec_lze(&d, d); /* aliasing */
+			res |= !ss_cmp(d, src) ? 0 : 4;
+			ss_cpy(&d, src);
+			ss_enc_lze(&d, d, l); /* aliasing */
+			res |= !ss_cmp(d, s) ? 0 : 8;
+			z = ss_dup_dec_lze(s);
+			res |= !ss_cmp(z, src) ? 0 : 16;
+			ss_free(&z);
+			/* not bigger than LZ (+1 byte), smaller for text */
+			ss_cpy_enc_lz_lvl(&ref, src, l);
+			res |= ss_size(s) <= ss_size(ref) + 1 ? 0 : 32;
+			if (ss_size(src) >= 1000 && r != 7)
+				res |= ss_size(s) * 10 < ss_size(ref) * 9
+					       ? 0
+					       : 64;
+			/* BEHAVIOR: invalid input (decoding without crash) */
+			for (k = 0; k < 20 && ss_size(s) > 0; k++) {
+				ss_cpy(&d, s);
+				x = x * 1103515245 + 12345;
+				j = (x >> 8) % ss_size(s);
+				if (k & 1)
+					ss_set_size(d, j);
+				else
+					ss_get_buffer(d)[j] ^=
+						(char)(1 << ((x >> 4) & 7));
+				ss_cpy_dec_lze(&ref, d);
+			}
+		}
+	}
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &ref, &s, &d);
+#else
+	ss_free(&src);
+	ss_free(&ref);
+	ss_free(&s);
+	ss_free(&d);
+#endif
+	return res;
+}
+
+/*
+ * LZ decoding with chunk copies: short distances (pattern repetition),
+ * literal runs around the chunk size, and output appended at an offset
+ */
+static int test_ss_dec_lz_wild()
+{
+	int res = 0, l;
+	char c;
+	size_t i, j, n, p, k;
+	uint32_t x = 54321;
+	srt_string *src = ss_alloc(0), *s = ss_alloc(0), *d = ss_alloc(0),
+		   *ref = ss_alloc(0);
+	for (n = 1; n < 3000 && !res; n += 1 + n / 3) {
+		ss_clear(src);
+		while (ss_size(src) < n) {
+			x = x * 1103515245 + 12345;
+			p = 1 + (x >> 16) % 20; /* period */
+			k = (x >> 8) % 70;	/* repeated/literal bytes */
+			for (i = 0; i < p; i++) {
+				x = x * 1103515245 + 12345;
+				c = (char)((x >> 16) & 0xff); /* raw byte */
+				ss_cat_cn(&src, &c, 1);
+			}
+			for (i = 0, j = ss_size(src) - p; i < k && !(x & 1);
+			     i++) {
+				c = ss_get_buffer_r(src)[j + i];
+				ss_cat_cn(&src, &c, 1);
+			}
+		}
+		for (l = 0; l <= SS_LZ_LEVEL_MAX; l++) {
+			ss_clear(d);
+			ss_cpy_enc_lz_lvl(&s, src, l);
+			ss_cpy_dec_lz(&d, s);
+			res |= !ss_cmp(d, src) ? 0 : 1;
+			ss_cpy_c(&d, "prefix");
+			ss_cat_dec_lz(&d, s);
+			ss_cpy_c(&ref, "prefix");
+			ss_cat(&ref, src);
+			res |= !ss_cmp(d, ref) ? 0 : 2;
+			/* BEHAVIOR: invalid input (decoding without crash) */
+			for (k = 0; k < 10 && ss_size(s) > 0; k++) {
+				ss_cpy(&d, s);
+				x = x * 1103515245 + 12345;
+				j = (x >> 8) % ss_size(s);
+				if (k & 1)
+					ss_set_size(d, j);
+				else
+					ss_get_buffer(d)[j] =
+						(char)((x >> 4) & 0xff);
+				ss_cpy_dec_lz(&ref, d);
+			}
+		}
+	}
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &s, &d, &ref);
+#else
+	ss_free(&src);
+	ss_free(&s);
+	ss_free(&d);
+	ss_free(&ref);
+#endif
+	return res;
+}
+
+static void test_lz_dict_rec(srt_string **s, uint32_t *x)
+{
+	const char *w[] = {"alpha", "beta", "gamma", "delta", "true", "false"};
+	size_t i, n;
+	*x = *x * 1103515245 + 12345;
+	n = 1 + (*x >> 16) % 8;
+	ss_cpy_c(s, "{\"id\":");
+	ss_cat_int(s, (int64_t)(*x >> 8));
+	ss_cat_c(s, ",\"type\":\"record\",\"owner\":\"");
+	ss_cat_c(s, w[(*x >> 4) % 4]);
+	ss_cat_c(s, "\",\"items\":[");
+	for (i = 0; i < n; i++) {
+		*x = *x * 1103515245 + 12345;
+		ss_cat_c(s, i ? ",{\"name\":\"" : "{\"name\":\"");
+		ss_cat_c(s, w[(*x >> 16) % 4]);
+		ss_cat_c(s, "\",\"enabled\":");
+		ss_cat_c(s, w[4 + ((*x >> 8) & 1)]);
+		ss_cat_c(s, ",\"value\":");
+		ss_cat_int(s, (int64_t)((*x >> 12) % 10000));
+		ss_cat_c(s, "}");
+	}
+	ss_cat_c(s, "]}");
+}
+
+static int test_ss_lz_dict()
+{
+	int res = 0, l;
+	size_t i, k, j, sizes[64], a = 0, b = 0;
+	uint32_t x = 4321;
+	srt_string *z, *samples = ss_alloc(0), *dict = ss_alloc(0),
+		       *r = ss_alloc(0), *s = ss_alloc(0), *d = ss_alloc(0),
+		       *ref = ss_alloc(0);
+	for (i = 0; i < 64; i++) {
+		test_lz_dict_rec(&r, &x);
+		sizes[i] = ss_size(r);
+		ss_cat(&samples, r);
+	}
+	/* BEHAVIOR: samples fitting in the dictionary are copied */
+	ss_lz_dict_train(&dict, samples, sizes, 64, ss_size(samples));
+	res |= !ss_cmp(dict, samples) ? 0 : 1;
+	/* BEHAVIOR: samples bigger than the input: empty dictionary */
+	sizes[0]++;
+	ss_lz_dict_train(&dict, samples, sizes, 64, 1024);
+	res |= ss_size(dict) == 0 ? 0 : 2;
+	sizes[0]--;
+	ss_lz_dict_train(&dict, samples, sizes, 64, 1024);
+	res |= ss_size(dict) <= 1024 ? 0 : 4;
+	for (i = 0; i < 32 && !res; i++) {
+		test_lz_dict_rec(&r, &x);
+		for (l = 0; l <= SS_LZ_LEVEL_MAX; l += 3) {
+			ss_cpy_enc_lz_dict(&s, r, dict, l);
+			ss_cpy_dec_lz_dict(&d, s, dict);
+			res |= !ss_cmp(d, r) ? 0 : 8;
+			ss_cpy_c(&d, "x");
+			ss_cat_dec_lz_dict(&d, s, dict);
+			ss_cpy_c(&ref, "x");
+			ss_cat(&ref, r);
+			res |= !ss_cmp(d, ref) ? 0 : 16;
+			ss_cpy(&d, r);
+			ss_enc_lz_dict(&d, d, dict, l); /* aliasing */
+			ss_dec_lz_dict(&d, d, dict);	 /* aliasing */
+			res |= !ss_cmp(d, r) ? 0 : 32;
+			z = ss_dup_dec_lz_dict(s, dict);
+			res |= !ss_cmp(z, r) ? 0 : 64;
+			ss_free(&z);
+			/* BEHAVIOR: no dictionary, same as ss_enc_lz_lvl() */
+			ss_cpy_enc_lz_dict(&d, r, NULL, l);
+			ss_cpy_enc_lz_lvl(&ref, r, l);
+			res |= !ss_cmp(d, ref) ? 0 : 128;
+			if (l == SS_LZ_LEVEL_MAX) {
+				a += ss_size(ref);
+				b += ss_size(s);
+			}
+			/* BEHAVIOR: invalid input (decoding without crash) */
+			for (k = 0; k < 8; k++) {
+				ss_cpy(&d, s);
+				x = x * 1103515245 + 12345;
+				j = (x >> 8) % ss_size(s);
+				if (k & 1)
+					ss_set_size(d, j);
+				else
+					ss_get_buffer(d)[j] ^=
+						(char)(1 << ((x >> 4) & 7));
+				ss_cpy_dec_lz_dict(&ref, d, dict);
+				ss_cpy_dec_lz_dict(&ref, d, r);
+			}
+		}
+	}
+#if !defined(S_MINIMAL) && !defined(S_LZ_DONT_ALLOW_HEAP_USAGE)
+	res |= b * 2 < a ? 0 : 256;
+#endif
+#ifdef S_USE_VA_ARGS
+	ss_free(&samples, &dict, &r, &s, &d, &ref);
+#else
+	ss_free(&samples);
+	ss_free(&dict);
+	ss_free(&r);
+	ss_free(&s);
+	ss_free(&d);
+	ss_free(&ref);
+#endif
+	return res;
+}
+
+/* Decode the stream in pieces of pseudo-random size */
+static int test_slz_dec(srt_string **out, srt_lz_dec *d, const srt_string *z,
+			uint32_t *x)
+{
+	int st = SLZ_MORE;
+	size_t i, n, zs = ss_size(z);
+	srt_string *p = ss_alloc(0);
+	for (i = 0; i < zs && st == SLZ_MORE; i += n) {
+		*x = *x * 1103515245 + 12345;
+		n = S_MIN(zs - i, 1 + ((*x >> 16) % 200));
+		ss_cpy_substr(&p, z, i, n);
+		st = slz_dec_write(out, d, p);
+	}
+	ss_free(&p);
+	return st;
+}
+
+static int test_slz_stream()
+{
+	int res = 0;
+	size_t i, j, n;
+	uint32_t x = 1;
+	char *b;
+	srt_bool crc;
+	srt_lz_enc *e = NULL;
+	srt_lz_dec *d = NULL;
+	srt_string *src = ss_alloc(0), *p = ss_alloc(0), *z = ss_alloc(0),
+		   *out = ss_alloc(0);
+	/*
+	 * 300 KB of random data repeated every 1000 bytes, with some changes:
+	 * compressing 4 KB blocks independently would not reach 1/5 ratio
+	 * (1000 random bytes per block), so the window must be kept
+	 */
+	ss_resize(&src, 300000, 0);
+	if (ss_size(src) != 300000)
+		res |= 1;
+	b = ss_get_buffer(src);
+	for (i = 0; i < ss_size(src); i++) {
+		x = x * 1103515245 + 12345;
+		if (i < 1000 || (x >> 16) % 100 == 0)
+			b[i] = (char)(x >> 8);
+		else
+			b[i] = b[i - 1000];
+	}
+	res |= slz_enc_alloc(SLZ_WBITS_MIN - 1, S_FALSE) ? 1 : 0;
+	for (j = 0; j < 2 && !res; j++) {
+		crc = j ? S_TRUE : S_FALSE;
+		e = slz_enc_alloc(SLZ_WBITS_MIN, crc);
+		d = slz_dec_alloc(0);
+		if (!e || !d) {
+			res |= 2;
+			break;
+		}
+		ss_clear(z);
+		for (i = 0; i < ss_size(src); i += n) {
+			x = x * 1103515245 + 12345;
+			n = S_MIN(ss_size(src) - i, (x >> 16) % 1500);
+			ss_cpy_substr(&p, src, i, n);
+			res |= slz_enc_write(&z, e, p) ? 0 : 4;
+			if ((x >> 8) % 16 == 0)
+				res |= slz_enc_flush(&z, e) ? 0 : 8;
+		}
+		res |= slz_enc_end(&z, e) ? 0 : 16;
+		res |= ss_size(z) < ss_size(src) / 5 ? 0 : 32;
+		ss_clear(out);
+		res |= test_slz_dec(&out, d, z, &x) == SLZ_END ? 0 : 64;
+		res |= !ss_cmp(out, src) ? 0 : 128;
+		/* Encoder reuse after the end of the stream */
+		slz_dec_free(&d);
+		d = slz_dec_alloc(0);
+		ss_clear(z);
+		ss_clear(out);
+		ss_cpy_c(&p, "hello, hello, hello");
+		slz_enc_write(&z, e, p);
+		slz_enc_end(&z, e);
+		res |= test_slz_dec(&out, d, z, &x) == SLZ_END ? 0 : 256;
+		res |= !ss_cmp(out, p) ? 0 : 512;
+		slz_dec_free(&d);
+		/* Incomplete stream */
+		d = slz_dec_alloc(0);
+		ss_resize(&z, ss_size(z) - 1, 0);
+		res |= test_slz_dec(&out, d, z, &x) == SLZ_MORE ? 0 : 1024;
+		slz_dec_free(&d);
+		slz_enc_free(&e);
+	}
+	/* Corrupted data (checksum) */
+	if (!res) {
+		d = slz_dec_alloc(0);
+		ss_get_buffer(z)[ss_size(z) / 2] ^= 0x20;
+		res |= test_slz_dec(&out, d, z, &x) == SLZ_ERROR ? 0 : 2048;
+		res |= slz_dec_write(&out, d, p) == SLZ_ERROR ? 0 : 4096;
+		slz_dec_free(&d);
+	}
+	/* Window larger than the decoder limit */
+	e = slz_enc_alloc(SLZ_WBITS_MIN + 1, S_FALSE);
+	d = slz_dec_alloc(SLZ_WBITS_MIN);
+	ss_clear(z);
+	slz_enc_write(&z, e, src);
+	slz_enc_end(&z, e);
+	res |= test_slz_dec(&out, d, z, &x) == SLZ_ERROR ? 0 : 8192;
+	slz_enc_free(&e);
+	slz_dec_free(&d);
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &p, &z, &out);
+#else
+	ss_free(&src);
+	ss_free(&p);
+	ss_free(&z);
+	ss_free(&out);
+#endif
+	return res;
+}
+
+static int test_slz_par()
+{
+	int res = 0;
+	const char *w[] = {"lorem", "ipsum", " ", "dolor", "\n", "sit", "amet"};
+	size_t i, j, k, n, cs0 = 0, bs[80];
+	uint32_t x = 1;
+	uint8_t o[4096 + 16];
+	const char *b;
+	srt_lz_par p, q;
+	srt_string *src = ss_alloc(0), *c = ss_alloc(0), *c2 = ss_alloc(0),
+		   *d = ss_alloc(0), *blk[80];
+	while (ss_size(src) < 300000) {
+		x = x * 1103515245 + 12345;
+		j = (x >> 16) % 10;
+		if (j < 7)
+			ss_cat_c(&src, w[j]);
+		else
+			ss_cat_int(&src, (int64_t)(x >> 24));
+	}
+	b = ss_get_buffer_r(src);
+	res |= !slz_par_init(&p, 1, SLZ_PAR_BBITS_MIN - 1, 0, S_FALSE)
+			       && !slz_par_init(&p, 1, 12, 13, S_FALSE)
+		       ? 0
+		       : 1;
+	for (i = 0; i < 4 && !res; i++) {
+		/* Single thread reference */
+		res |= slz_par_enc(&c, src, 12, i & 1 ? 10 : 0, i >= 2) ? 0 : 2;
+		res |= slz_par_dec(&d, c) && !ss_cmp(d, src) ? 0 : 4;
+		/* Blocks encoded in any order, e.g. from different threads */
+		slz_par_init(&p, ss_size(src), 12, i & 1 ? 10 : 0, i >= 2);
+		res |= p.nblk == 74 ? 0 : 8;
+		for (j = 0; j < p.nblk; j++) {
+			k = p.nblk - 1 - j;
+			blk[k] = ss_alloc(0);
+			bs[k] = slz_par_enc_blk(&blk[k], &p, src, k);
+			res |= bs[k] == ss_size(blk[k]) ? 0 : 16;
+		}
+		ss_clear(c2);
+		slz_par_cat_hdr(&c2, &p, bs);
+		for (j = 0; j < p.nblk; j++) {
+			ss_cat(&c2, blk[j]);
+			ss_free(&blk[j]);
+		}
+		res |= !ss_cmp(c, c2) ? 0 : 32;
+		/* Random access, without writing after the block */
+		res |= slz_par_open(&q, c) && q.nblk == p.nblk ? 0 : 64;
+		for (j = 0; j < q.nblk && !res; j += 7) {
+			memset(o, 0xa5, sizeof(o));
+			n = slz_par_dec_blk(&q, j, o, 0);
+			if (i & 1) /* dictionary required */
+				res |= j == 0 || n == S_NPOS ? 0 : 128;
+			else if (n != S_MIN(4096, ss_size(src) - j * 4096)
+				 || memcmp(o, b + j * 4096, n))
+				res |= 256;
+			k = n == S_NPOS ? sizeof(o) : n;
+			for (; k < sizeof(o); k++)
+				res |= o[k] == 0xa5 ? 0 : 512;
+		}
+		/* Corrupted containers */
+		ss_resize(&c2, ss_size(c2) - 1, 0);
+		res |= !slz_par_dec(&d, c2) && !slz_par_open(&q, c2) ? 0 : 1024;
+		ss_cpy(&c2, c);
+		ss_get_buffer(c2)[16] ^= 1; /* first block end offset */
+		res |= !slz_par_dec(&d, c2) ? 0 : 2048;
+		ss_cpy(&c2, c);
+		ss_get_buffer(c2)[ss_size(c2) - 10] ^= 0x40;
+		res |= !slz_par_dec(&d, c2) || ss_cmp(d, src) ? 0 : 4096;
+		if (i == 0)
+			cs0 = ss_size(c);
+		if (i == 1) /* the dictionary improves the compression */
+			res |= ss_size(c) < cs0 ? 0 : 8192;
+	}
+	/* Empty input, aliasing */
+	ss_clear(d);
+	res |= slz_par_enc(&c, d, 0, 0, S_FALSE) ? 0 : 16384;
+	res |= ss_size(c) == 16 ? 0 : 16384;
+	res |= slz_par_dec(&c, c) && ss_size(c) == 0 ? 0 : 32768;
+#ifdef S_USE_VA_ARGS
+	ss_free(&src, &c, &c2, &d);
+#else
+	ss_free(&src);
+	ss_free(&c);
+	ss_free(&c2);
+	ss_free(&d);
+#endif
+	return res;
+}
+
 static int test_ss_clear(const char *in)
 {
 	srt_string *sa = ss_dup_c(in);
@@ -1691,6 +3004,60 @@ static int test_ss_to_w(const char *in)
 	return res;
 }
 
+static int test_ss_to_int64(const char *in, size_t off, int64_t expected,
+			    size_t expected_len)
+{
+	int64_t v = 1;
+	const srt_string *a = ss_crefa(in);
+	size_t l = ss_to_int64(a, off, &v);
+	return (l == expected_len ? 0 : 1) | (v == expected ? 0 : 2);
+}
+
+static int test_ss_to_double(const char *in, size_t off, double expected,
+			     size_t expected_len)
+{
+	double v = 1;
+	const srt_string *a = ss_crefa(in);
+	size_t l = ss_to_double(a, off, &v);
+	return (l == expected_len ? 0 : 1) | (v == expected ? 0 : 2);
+}
+
+/*
+ * Round trip: random bit patterns (including denormals), formatted and
+ * parsed back, and formatted as float (from the double parsed)
+ */
+static int test_ss_num_rt()
+{
+	int res = 0;
+	size_t i, l;
+	double d, d2;
+	float f, f2;
+	uint32_t y;
+	uint64_t x = 1, z;
+	srt_string *s = ss_alloca(64);
+	for (i = 0; i < 20000 && !res; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		z = (i % 4) ? x : x & 0x800fffffffffffffULL;
+		memcpy(&d, &z, sizeof(d));
+		if (d != d) /* NaN */
+			continue;
+		ss_cpy_double(&s, d);
+		l = ss_to_double(s, 0, &d2);
+		res |= l == ss_size(s) && !memcmp(&d, &d2, sizeof(d)) ? 0 : 1;
+		res |= ss_size(s) <= 25 ? 0 : 2;
+		y = (uint32_t)(z >> 32);
+		memcpy(&f, &y, sizeof(f));
+		if (f != f)
+			continue;
+		ss_cpy_float(&s, f);
+		l = ss_to_double(s, 0, &d2);
+		f2 = (float)d2;
+		res |= l == ss_size(s) && !memcmp(&f, &f2, sizeof(f)) ? 0 : 4;
+		res |= ss_size(s) <= 22 ? 0 : 8;
+	}
+	return res;
+}
+
 static int test_ss_find(const char *a, const char *b, size_t expected_loc)
 {
 	srt_string *sa = ss_dup_c(a), *sb = ss_dup_c(b);
@@ -1705,28 +3072,288 @@ static int test_ss_find(const char *a, const char *b, size_t expected_loc)
 	return res;
 }
 
-static int test_ss_find_misc()
+static int test_ss_find_misc()
+{
+	int res = 0;
+	/*                    01234 56 7 8901234  5             6 */
+	const char *sample = "abc \t \n\r 123zyx" U8_HAN_24B62 "s";
+	const srt_string *a = ss_crefa(sample),
+			 *han = ss_crefa(U8_HAN_24B62 "s"),
+			 *yx = ss_crefa("yx");
+	res |= ss_findb(a, 0) == 3 ? 0 : 1;
+	res |= ss_findrb(a, 0, S_NPOS) == 3 ? 0 : 2;
+	res |= ss_findc(a, 0, 'z') == 12 ? 0 : 4;
+	res |= ss_findrc(a, 0, S_NPOS, 'z') == 12 ? 0 : 8;
+	res |= ss_findu(a, 0, 0x24B62) == 15 ? 0 : 16;
+	res |= ss_findru(a, 0, S_NPOS, 0x24B62) == 15 ? 0 : 32;
+	res |= ss_findcx(a, 0, '0', '9') == 9 ? 0 : 64;
+	res |= ss_findrcx(a, 0, S_NPOS, '0', '9') == 9 ? 0 : 128;
+	res |= ss_findnb(a, 3) == 9 ? 0 : 256;
+	res |= ss_findrnb(a, 3, S_NPOS) == 9 ? 0 : 512;
+	res |= ss_find(a, 0, han) == 15 ? 0 : 1024;
+	res |= ss_findr(a, 0, S_NPOS, yx) == 13 ? 0 : 2048;
+	res |= ss_find_cn(a, 0, "yx", 2) == 13 ? 0 : 4096;
+	res |= ss_findr_cn(a, 0, S_NPOS, "yx", 2) == 13 ? 0 : 8192;
+	return res;
+}
+
+static size_t ss_find_vec_ref(const char *s, size_t off, size_t ss,
+			      const char *t, size_t ts)
+{
+	size_t i;
+	if (!ts)
+		return S_NPOS;
+	for (i = off; i + ts <= ss; i++)
+		if (!memcmp(s + i, t, ts))
+			return i;
+	return S_NPOS;
+}
+
+static int test_ss_find_vec()
+{
+	int res = 0;
+	char *b = (char *)s_malloc(70000);
+	size_t i, j, off, ss, ts, r;
+	uint32_t x = 12345;
+	srt_string *s = ss_alloc(70000);
+	if (!b || !s) {
+		s_free(b);
+		ss_free(&s);
+		return 1;
+	}
+	/* Small alphabet, sizes and offsets crossing the 16/32-byte blocks */
+	for (i = 0; i < 300; i++) {
+		x = x * 1103515245 + 12345;
+		b[i] = 'a' + (char)((x >> 16) % 3);
+	}
+	for (ss = 0; ss < 300 && !res; ss += 7)
+		for (ts = 1; ts < 40 && !res; ts += 3)
+			for (off = 0; off < 40 && !res; off += 5)
+				for (j = 0; j + ts <= ss && !res; j += 11) {
+					ss_cpy_cn(&s, b, ss);
+					r = ss_find_vec_ref(b, off, ss, b + j, ts);
+					if (ss_find_cn(s, off, b + j, ts) != r
+					    || ss_findr_cn(s, off, ss, b + j, ts)
+						       != r)
+						res |= 2;
+				}
+	/* Worst case: many first/last byte candidates ("aaa...ab") */
+	memset(b, 'a', 70000);
+	b[1000] = 'b';
+	ss_cpy_cn(&s, b, 70000);
+	res |= ss_find_cn(s, 0, b + 1000 - 500, 501) == 500 ? 0 : 4;
+	res |= ss_find_cn(s, 501, b + 1000 - 500, 501) == S_NPOS ? 0 : 8;
+	b[1000] = 'a';
+	b[69999] = 'b';
+	ss_cpy_cn(&s, b, 70000);
+	res |= ss_find_cn(s, 0, b + 69999 - 300, 301) == 69699 ? 0 : 16;
+	res |= ss_find_cn(s, 0, "ab", 2) == 69998 ? 0 : 32;
+	res |= ss_find_cn(s, 0, "ba", 2) == S_NPOS ? 0 : 64;
+	s_free(b);
+	ss_free(&s);
+	return res;
+}
+
+static int test_ss_searcher()
+{
+	int res = 0;
+	size_t i, j, k, off, ss = 4000,
+			     tsz[] = {1, 2, 3, 15, 16, 31, 33, 63, 64, 65, 200};
+	uint32_t x = 4321;
+	srt_string *s = ss_alloc(70000), *t = ss_alloc(200);
+	srt_searcher *sr;
+	for (i = 0; i < ss; i++) {
+		x = x * 1103515245 + 12345;
+		ss_cat_char(&s, "aabc"[(x >> 16) % 4]);
+	}
+	for (i = 0; i < sizeof(tsz) / sizeof(tsz[0]) && !res; i++)
+		for (j = 0; j + tsz[i] <= ss && !res; j += 397) {
+			ss_cpy_substr(&t, s, j, tsz[i]);
+			sr = ss_searcher_alloc(t);
+			for (off = 0; off < ss && !res; off += 97) {
+				k = ss_searcher_find(sr, s, off);
+				if (!sr || k != ss_find(s, off, t))
+					res |= 1;
+				k = ss_searcher_findr(sr, s, off, off + 500);
+				if (k != ss_findr(s, off, off + 500, t))
+					res |= 2;
+			}
+			ss_searcher_free(&sr);
+		}
+	/* Worst case (Boyer-Moore-Horspool to Rabin-Karp switch) */
+	ss_cpy_c(&t, "b");
+	for (i = 1; i < 100; i++)
+		ss_cat_char(&t, 'a');
+	ss_clear(s);
+	for (i = 0; i < 70000; i++)
+		ss_cat_char(&s, 'a');
+	sr = ss_searcher_alloc(t);
+	res |= ss_searcher_find(sr, s, 0) == S_NPOS ? 0 : 4;
+	ss_cat(&s, t);
+	res |= ss_searcher_find(sr, s, 0) == 70000 ? 0 : 8;
+	res |= ss_searcher_findr(sr, s, 0, 70099) == S_NPOS ? 0 : 16;
+	res |= ss_searcher_find(NULL, s, 0) == S_NPOS ? 0 : 32;
+	ss_searcher_free(&sr);
+	ss_clear(t);
+	sr = ss_searcher_alloc(t);
+	res |= sr && ss_searcher_find(sr, s, 0) == S_NPOS ? 0 : 64;
+	ss_searcher_free(&sr);
+#ifdef S_USE_VA_ARGS
+	ss_free(&s, &t);
+#else
+	ss_free(&s);
+	ss_free(&t);
+#endif
+	return res;
+}
+
+struct MPatternAcc {
+	size_t count, stop_after;
+	uint64_t h;
+};
+
+static srt_bool mpattern_cb(size_t id, size_t off, void *context)
+{
+	struct MPatternAcc *a = (struct MPatternAcc *)context;
+	a->count++;
+	a->h += (uint64_t)(id + 1) * 1000003 + (uint64_t)off * 7919;
+	return a->stop_after && a->count >= a->stop_after ? S_FALSE : S_TRUE;
+}
+
+static void mpattern_ref(const srt_string *const *p, size_t np,
+			 const srt_string *s, srt_bool icase,
+			 struct MPatternAcc *a)
+{
+	size_t i, j, k, ps, ss = ss_size(s);
+	const char *sb = ss_get_buffer_r(s), *pb;
+	for (i = 0; i < ss; i++)
+		for (j = 0; j < np; j++) {
+			ps = ss_size(p[j]);
+			pb = ss_get_buffer_r(p[j]);
+			if (!ps || i + ps > ss)
+				continue;
+			for (k = 0; k < ps; k++)
+				if (icase ? sc_tolower(sb[i + k])
+						    != sc_tolower(pb[k])
+					  : sb[i + k] != pb[k])
+					break;
+			if (k == ps)
+				mpattern_cb(j, i, a);
+		}
+}
+
+static int test_ss_mpattern_chk(const srt_string *const *p, size_t np,
+				const srt_string *s, int flags)
+{
+	int res = 0;
+	size_t i, cs;
+	struct MPatternAcc a, r, st;
+	srt_mpattern_state ms;
+	srt_string *chunk = ss_alloc(64);
+	srt_mpattern *mp = ss_mpattern_build(p, np, flags);
+	if (!mp || !chunk) {
+		ss_free(&chunk);
+		ss_mpattern_free(&mp);
+		return 1;
+	}
+	memset(&a, 0, sizeof(a));
+	memset(&r, 0, sizeof(r));
+	memset(&st, 0, sizeof(st));
+	mpattern_ref(p, np, s, (flags & SMP_ICASE) ? S_TRUE : S_FALSE, &r);
+	res |= ss_mpattern_find(mp, s, 0, mpattern_cb, &a) == r.count ? 0 : 2;
+	res |= a.count == r.count && a.h == r.h ? 0 : 4;
+	res |= ss_mpattern_find(mp, s, 0, NULL, NULL) == r.count ? 0 : 8;
+	/* Streaming, with matches spanning chunks */
+	ss_mpattern_state_init(&ms);
+	for (i = 0, cs = 1; i < ss_size(s); i += cs, cs = (cs * 5) % 61 + 1) {
+		ss_cpy_substr(&chunk, s, i, cs);
+		ss_mpattern_feed(mp, &ms, chunk, mpattern_cb, &st);
+	}
+	res |= st.count == r.count && st.h == r.h ? 0 : 16;
+	res |= ms.off == ss_size(s) ? 0 : 32;
+	/* Search stop */
+	if (r.count > 1) {
+		memset(&a, 0, sizeof(a));
+		a.stop_after = 1;
+		res |= ss_mpattern_find(mp, s, 0, mpattern_cb, &a) == 1 ? 0
+									 : 64;
+	}
+	ss_free(&chunk);
+	ss_mpattern_free(&mp);
+	return res;
+}
+
+static int test_ss_mpattern()
 {
 	int res = 0;
-	/*                    01234 56 7 8901234  5             6 */
-	const char *sample = "abc \t \n\r 123zyx" U8_HAN_24B62 "s";
-	const srt_string *a = ss_crefa(sample),
-			 *han = ss_crefa(U8_HAN_24B62 "s"),
-			 *yx = ss_crefa("yx");
-	res |= ss_findb(a, 0) == 3 ? 0 : 1;
-	res |= ss_findrb(a, 0, S_NPOS) == 3 ? 0 : 2;
-	res |= ss_findc(a, 0, 'z') == 12 ? 0 : 4;
-	res |= ss_findrc(a, 0, S_NPOS, 'z') == 12 ? 0 : 8;
-	res |= ss_findu(a, 0, 0x24B62) == 15 ? 0 : 16;
-	res |= ss_findru(a, 0, S_NPOS, 0x24B62) == 15 ? 0 : 32;
-	res |= ss_findcx(a, 0, '0', '9') == 9 ? 0 : 64;
-	res |= ss_findrcx(a, 0, S_NPOS, '0', '9') == 9 ? 0 : 128;
-	res |= ss_findnb(a, 3) == 9 ? 0 : 256;
-	res |= ss_findrnb(a, 3, S_NPOS) == 9 ? 0 : 512;
-	res |= ss_find(a, 0, han) == 15 ? 0 : 1024;
-	res |= ss_findr(a, 0, S_NPOS, yx) == 13 ? 0 : 2048;
-	res |= ss_find_cn(a, 0, "yx", 2) == 13 ? 0 : 4096;
-	res |= ss_findr_cn(a, 0, S_NPOS, "yx", 2) == 13 ? 0 : 8192;
+	size_t i, j, np = 0;
+	uint32_t x = 777;
+	char b[256];
+	srt_string *p[600], *s = ss_alloc(8192);
+	const srt_string *const *pc = (const srt_string *const *)p;
+	srt_mpattern *mp;
+	const srt_string *ushers[] = {ss_crefa("he"), ss_crefa("she"),
+				      ss_crefa("his"), ss_crefa("hers")},
+			 *hw[] = {ss_crefa("Hello"), ss_crefa("WORLD"), NULL,
+				  ss_crefa("")};
+	res |= test_ss_mpattern_chk(ushers, 4, ss_crefa("ushers"), 0);
+	res |= test_ss_mpattern_chk(ushers, 4, ss_crefa("ahishers he"), 0)
+		       ? 1 << 7
+		       : 0;
+	mp = ss_mpattern_build(ushers, 4, 0);
+	res |= ss_mpattern_find(mp, ss_crefa("ushers"), 0, NULL, NULL) == 3
+		       ? 0
+		       : 1 << 14;
+	ss_mpattern_free(&mp);
+	mp = ss_mpattern_build(hw, 4, SMP_ICASE);
+	res |= ss_mpattern_size(mp) == 4 ? 0 : 1 << 15;
+	res |= ss_mpattern_find(mp, ss_crefa("hello World HELLO hELLo!"), 0,
+				NULL, NULL)
+			       == 4
+		       ? 0
+		       : 1 << 16;
+	ss_mpattern_free(&mp);
+	res |= test_ss_mpattern_chk(hw, 4, ss_crefa("xhELLOWorldhello"),
+				    SMP_ICASE)
+		       ? 1 << 17
+		       : 0;
+	/* Random patterns over a small alphabet (dense table, prefilter) */
+	for (i = 0; i < 8192; i++) {
+		x = x * 1103515245 + 12345;
+		ss_cat_char(&s, "abcdAB"[(x >> 16) % 6]);
+	}
+	for (; np < 200; np++) {
+		x = x * 1103515245 + 12345;
+		j = 1 + (x >> 16) % 12;
+		for (i = 0; i < j; i++) {
+			x = x * 1103515245 + 12345;
+			b[i] = "abcd"[(x >> 16) % 4];
+		}
+		p[np] = ss_dup_cn(b, j);
+	}
+	res |= test_ss_mpattern_chk(pc, np, s, 0) ? 1 << 24 : 0;
+	res |= test_ss_mpattern_chk(pc, np, s, SMP_ICASE) ? 1 << 25 : 0;
+	/* Many states and all byte values (compressed table) */
+	for (i = 0; i < 256; i++)
+		b[i] = (char)i;
+	p[np++] = ss_dup_cn(b, 256);
+	ss_cat_cn(&s, b, 256);
+	for (; np < 600; np++) {
+		x = x * 1103515245 + 12345;
+		j = 10 + (x >> 16) % 20;
+		for (i = 0; i < j; i++) {
+			x = x * 1103515245 + 12345;
+			b[i] = "abcdAB"[(x >> 16) % 6];
+		}
+		p[np] = ss_dup_cn(b, j);
+	}
+	mp = ss_mpattern_build(pc, np, 0);
+	res |= mp && !mp->dense ? 0 : 1 << 28;
+	ss_mpattern_free(&mp);
+	res |= test_ss_mpattern_chk(pc, np, s, 0) ? 1 << 29 : 0;
+	for (i = 0; i < np; i++)
+		ss_free(&p[i]);
+	ss_free(&s);
 	return res;
 }
 
@@ -1774,6 +3401,70 @@ static int validate_cmp(int res1, int res2)
 		       : 0;
 }
 
+static int test_ss_tok_chk(srt_tok *it, const char *expected)
+{
+	/* expected: tokens separated by '|' */
+	srt_string_ref r;
+	const char *e = expected, *p;
+	size_t n;
+	while (ss_tok_next(it, &r)) {
+		if (!e)
+			return 1;
+		p = strchr(e, '|');
+		n = p ? (size_t)(p - e) : strlen(e);
+		if (ss_size(ss_ref(&r)) != n
+		    || memcmp(ss_get_buffer_r(ss_ref(&r)), e, n))
+			return 2;
+		e = p ? p + 1 : NULL;
+	}
+	return e ? 4 : 0;
+}
+
+static int test_ss_tok()
+{
+	int res = 0;
+	size_t i, n1, n2;
+	uint32_t x = 99;
+	srt_tok it;
+	srt_string_ref subs[512];
+	srt_string *s = ss_alloc(1000);
+	const srt_string *sep = ss_crefa(", ");
+	ss_tok_init(&it, ss_crefa("how are  you"), ss_crefa(" "));
+	res |= test_ss_tok_chk(&it, "how|are||you");
+	ss_tok_init(&it, ss_crefa(", a, b,, c, "), sep);
+	res |= test_ss_tok_chk(&it, "|a|b,|c") << 3;
+	ss_tok_init_set(&it, ss_crefa("a;b c,,d;"), " ,;", 3);
+	res |= test_ss_tok_chk(&it, "a|b|c||d") << 6;
+	ss_tok_init_set(&it, ss_crefa("a;b c,,d-e"), " ,;.:-_!?=", 10);
+	res |= test_ss_tok_chk(&it, "a|b|c||d|e") << 9;
+	ss_tok_init_cx(&it, ss_crefa("ab1cd23e"), '0', '9');
+	res |= test_ss_tok_chk(&it, "ab|cd||e") << 12;
+	ss_tok_init_lines(&it, ss_crefa("a\r\nb\n\nc\r\n\r\nd"));
+	res |= test_ss_tok_chk(&it, "a|b||c||d") << 15;
+	ss_tok_init_lines(&it, ss_crefa(""));
+	res |= ss_tok_next(&it, subs) ? 1 << 18 : 0;
+	/* BEHAVIOR: '\r' is removed only before '\n' */
+	ss_tok_init_lines(&it, ss_crefa("a\r\n\rb\r"));
+	res |= test_ss_tok_chk(&it, "a|\rb\r") << 23;
+	ss_tok_init(&it, ss_crefa("abc"), ss_crefa(""));
+	res |= test_ss_tok_chk(&it, "abc") << 19;
+	/* Same output as ss_split() */
+	for (i = 0; i < 1000; i++) {
+		x = x * 1103515245 + 12345;
+		ss_cat_char(&s, "a, "[(x >> 16) % 3]);
+	}
+	n1 = ss_split(s, sep, subs, 512);
+	ss_tok_init(&it, s, sep);
+	for (n2 = 0; n2 < n1; n2++)
+		if (!ss_tok_next(&it, subs + 511)
+		    || ss_cmp(ss_ref(subs + 511), ss_ref(subs + n2)))
+			break;
+	res |= n1 > 10 && n2 == n1 && !ss_tok_next(&it, subs + 511) ? 0
+								  : 1 << 22;
+	ss_free(&s);
+	return res;
+}
+
 static int test_ss_cmp(const char *a, const char *b, int expected_cmp)
 {
 	srt_string *sa = ss_dup_c(a), *sb = ss_dup_c(b);
@@ -4616,6 +6307,685 @@ static int test_sm_double_rotation()
 	return res;
 }
 
+static srt_bool cback_fm_ii32(int32_t k, int32_t v, void *context)
+{
+	int64_t *prev = (int64_t *)context;
+	if (k <= *prev || v != -k)
+		return S_FALSE;
+	*prev = k;
+	return S_TRUE;
+}
+
+static int test_sm_freeze()
+{
+	size_t i, nelems = 1000;
+	int64_t prev = S_MIN_I64;
+	srt_map *m_ii32 = sm_alloc(SM_II32, nelems), *m_ss = sm_alloc(SM_SS, 0),
+		*m_dd = sm_alloc(SM_DD, 0), *m_is = sm_alloc(SM_IS, 0),
+		*m_i = sm_alloc(SM_II, 0);
+	srt_fmap *f_ii32 = NULL, *f_ss = NULL, *f_dd = NULL, *f_is = NULL,
+		 *f_ss2 = NULL, *f_i = NULL;
+	srt_string *ktmp = ss_alloca(100), *vtmp = ss_alloca(300),
+		   *lower_s = ss_alloca(100), *upper_s = ss_alloca(100);
+	FILE *f;
+	int res = 0;
+	for (i = 0; i < nelems; i++) { /* unordered insertion */
+		int32_t k = (int32_t)((i * 7919) % nelems) * 2;
+		sm_insert_ii32(&m_ii32, k, -k);
+		sm_insert_dd(&m_dd, (double)k / 3, (double)k);
+		ss_printf(&ktmp, 100, "k%04i", (int)(k / 2));
+		ss_printf(&vtmp, 300, "%0*i", (int)(k % 300), (int)k);
+		sm_insert_ss(&m_ss, ktmp, vtmp);
+		sm_insert_is(&m_is, k, vtmp);
+	}
+	f_ii32 = sm_freeze(m_ii32);
+	f_ss = sm_freeze(m_ss);
+	f_dd = sm_freeze(m_dd);
+	f_is = sm_freeze(m_is);
+	f_i = sm_freeze(m_i);
+	if (!f_ii32 || !f_ss || !f_dd || !f_is || !f_i)
+		res |= 1;
+	if (sfm_size(f_ii32) != nelems || sfm_size(f_ss) != nelems
+	    || sfm_size(f_i) != 0 || sfm_type(f_ss) != SM_SS
+	    || sfm_alloc_size(f_ii32) >= sm_alloc_size(m_ii32))
+		res |= 2;
+	for (i = 0; i < nelems * 2 && !res; i++) {
+		int32_t k = (int32_t)i;
+		ss_printf(&ktmp, 100, "k%04i", (int)(i / 2));
+		if (sfm_at_ii32(f_ii32, k) != sm_at_ii32(m_ii32, k)
+		    || sfm_count_i32(f_ii32, k) != sm_count_i32(m_ii32, k)
+		    || sfm_at_dd(f_dd, (double)k / 3)
+			       != sm_at_dd(m_dd, (double)k / 3)
+		    || sfm_count_d(f_dd, (double)k / 3)
+			       != sm_count_d(m_dd, (double)k / 3)
+		    || ss_cmp(sfm_at_ss(f_ss, ktmp), sm_at_ss(m_ss, ktmp))
+		    || ss_cmp(sfm_at_is(f_is, k), sm_at_is(m_is, k))
+		    || sfm_count_i(f_is, k) != sm_count_i(m_is, k))
+			res |= 4;
+	}
+	if (sfm_count_i32(f_ii32, -1) || sfm_count_i32(f_ii32, 2000)
+	    || sfm_at_ii(f_i, 1) || sfm_count_s(f_ss, ss_crefa("k"))
+	    || sfm_count_s(f_ss, ss_crefa("k9999"))
+	    || ss_size(sfm_at_ss(f_ss, ss_crefa("k0000"))) != 1
+	    || sfm_at_ii32(f_ss, 0) || sfm_count_i32(f_ss, 0))
+		res |= 8;
+	ss_cpy_c(&lower_s, "k001"); /* covering "k0010" to "k0019" */
+	ss_cpy_c(&upper_s, "k002");
+	if (sfm_itr_ii32(f_ii32, -100, 10000, cback_fm_ii32, &prev) != nelems
+	    || sfm_itr_ii32(f_ii32, 11, 30, NULL, NULL)
+		       != sm_itr_ii32(m_ii32, 11, 30, NULL, NULL)
+	    || sfm_itr_ii32(f_ii32, 30, 11, NULL, NULL) != 0
+	    || sfm_itr_ss(f_ss, lower_s, upper_s, NULL, NULL) != 10
+	    || sfm_itr_dd(f_dd, 0, 10, NULL, NULL)
+		       != sm_itr_dd(m_dd, 0, 10, NULL, NULL))
+		res |= 16;
+	/*
+	 * Write/read round trip
+	 */
+	remove(STEST_FILE);
+	f = fopen(STEST_FILE, S_FOPEN_BINARY_RW_TRUNC);
+	if (f) {
+		if (sfm_write(f, f_ss)
+		    != (ssize_t)(sfm_alloc_size(f_ss) - sizeof(srt_fmap) + 12
+				 + 3 * sizeof(size_t)))
+			res |= 32;
+		fseek(f, 0, SEEK_SET);
+		f_ss2 = sfm_read(f);
+		if (!f_ss2 || sfm_size(f_ss2) != nelems
+		    || sfm_itr_ss(f_ss2, lower_s, upper_s, NULL, NULL) != 10)
+			res |= 64;
+		for (i = 0; i < nelems && f_ss2; i++) {
+			ss_printf(&ktmp, 100, "k%04i", (int)i);
+			if (ss_cmp(sfm_at_ss(f_ss2, ktmp), sm_at_ss(m_ss, ktmp)))
+				res |= 128;
+		}
+		fclose(f);
+		if (remove(STEST_FILE) != 0)
+			res |= 256;
+	} else {
+		res |= 512;
+	}
+#ifdef S_USE_VA_ARGS
+	sm_free(&m_ii32, &m_ss, &m_dd, &m_is, &m_i);
+	sfm_free(&f_ii32, &f_ss, &f_dd, &f_is, &f_ss2, &f_i);
+#else
+	sm_free(&m_ii32);
+	sm_free(&m_ss);
+	sm_free(&m_dd);
+	sm_free(&m_is);
+	sm_free(&m_i);
+	sfm_free(&f_ii32);
+	sfm_free(&f_ss);
+	sfm_free(&f_dd);
+	sfm_free(&f_is);
+	sfm_free(&f_ss2);
+	sfm_free(&f_i);
+#endif
+	return res;
+}
+
+static srt_bool cback_fm_si(const srt_string *k, int64_t v, void *context)
+{
+	srt_string **prev = (srt_string **)context;
+	if ((ss_size(*prev) && ss_cmp(k, *prev) <= 0)
+	    || v != (int64_t)ss_size(k))
+		return S_FALSE;
+	ss_cpy(prev, k);
+	return S_TRUE;
+}
+
+static int test_sm_freeze_pc()
+{
+	size_t i, nelems = 1000;
+	srt_map *m_si = sm_alloc(SM_SI, 0), *m_ss = sm_alloc(SM_SS, 0),
+		*m_ii = sm_alloc(SM_II, 0), *m_e = sm_alloc(SM_SP, 0);
+	srt_fmap *f_si = NULL, *f_si2 = NULL, *f_ss = NULL, *f_ss2 = NULL,
+		 *f_ii = NULL, *f_e = NULL;
+	srt_string *ktmp = ss_alloca(200), *vtmp = ss_alloca(200),
+		   *lower_s = ss_alloca(200), *upper_s = ss_alloca(200),
+		   *prev = ss_alloca(200);
+	FILE *f;
+	int res = 0;
+	for (i = 0; i < nelems; i++) { /* unordered insertion */
+		size_t j = (i * 7919) % nelems;
+		ss_printf(&ktmp, 200, "/usr/share/doc/package%03i/file%02i.txt",
+			  (int)(j / 20), (int)(j % 20));
+		sm_insert_si(&m_si, ktmp, (int64_t)ss_size(ktmp));
+		ss_printf(&vtmp, 200, "v%0*i", (int)(j % 40), (int)j);
+		sm_insert_ss(&m_ss, ktmp, vtmp);
+	}
+	/* empty key, and keys being a prefix of other keys */
+	sm_insert_si(&m_si, ss_void, 0);
+	sm_insert_si(&m_si, ss_crefa("/usr"), 4);
+	sm_insert_si(&m_si, ss_crefa("/usr/share/doc/package007"), 25);
+	f_si = sm_freeze_pc(m_si);
+	f_si2 = sm_freeze(m_si);
+	f_ss = sm_freeze_pc(m_ss);
+	f_ii = sm_freeze_pc(m_ii);
+	f_e = sm_freeze_pc(m_e);
+	if (!f_si || !f_si2 || !f_ss || f_ii || !f_e || !sfm_is_pc(f_si)
+	    || sfm_is_pc(f_si2) || sfm_size(f_si) != sm_size(m_si)
+	    || sfm_size(f_e) != 0 || sfm_count_s(f_e, ss_void)
+	    || sfm_itr_sp(f_e, ss_void, ss_crefa("z"), NULL, NULL))
+		res |= 1;
+	if (!res && sfm_alloc_size(f_si) * 2 > sfm_alloc_size(f_si2))
+		res |= 2;
+	for (i = 0; i < nelems * 2 && !res; i++) {
+		ss_printf(&ktmp, 200, "/usr/share/doc/package%03i/file%02i.txt",
+			  (int)(i / 20), (int)(i % 20));
+		if (i % 3 == 1)
+			ss_resize(&ktmp, ss_size(ktmp) - i % 7, 0);
+		if (sfm_at_si(f_si, ktmp) != sm_at_si(m_si, ktmp)
+		    || sfm_count_s(f_si, ktmp) != sm_count_s(m_si, ktmp)
+		    || ss_cmp(sfm_at_ss(f_ss, ktmp), sm_at_ss(m_ss, ktmp)))
+			res |= 4;
+	}
+	if (!res
+	    && (sfm_count_s(f_si, ss_void) != 1
+		|| sfm_at_si(f_si, ss_crefa("/usr")) != 4
+		|| sfm_at_si(f_si, ss_crefa("/usr/share/doc/package007")) != 25
+		|| sfm_count_s(f_si, ss_crefa("/us"))
+		|| sfm_count_s(f_si, ss_crefa("/usr/"))
+		|| sfm_count_s(f_si, ss_crefa("~"))))
+		res |= 8;
+	ss_cpy_c(&lower_s, "/usr/share/doc/package007/");
+	ss_cpy_c(&upper_s, "/usr/share/doc/package008");
+	if (!res
+	    && (sfm_itr_si(f_si, ss_void, ss_crefa("~"), cback_fm_si, &prev)
+			!= sm_size(m_si)
+		|| sfm_itr_si(f_si, lower_s, upper_s, NULL, NULL) != 20
+		|| sfm_itr_si(f_si2, lower_s, upper_s, NULL, NULL) != 20
+		|| sfm_itr_si(f_si, ss_crefa("/usr/share/doc/package007/f"),
+			      upper_s, NULL, NULL)
+			   != 20
+		|| sfm_itr_si(f_si, ss_crefa("/usr/share/doc/package007"),
+			      upper_s, NULL, NULL)
+			   != 21
+		|| sfm_itr_si(f_si, upper_s, lower_s, NULL, NULL) != 0
+		|| sfm_itr_ss(f_ss, lower_s, upper_s, NULL, NULL) != 20))
+		res |= 16;
+	/*
+	 * Write/read round trip
+	 */
+	remove(STEST_FILE);
+	f = fopen(STEST_FILE, S_FOPEN_BINARY_RW_TRUNC);
+	if (f) {
+		if (sfm_write(f, f_ss)
+		    != (ssize_t)(sfm_alloc_size(f_ss) - sizeof(srt_fmap) + 12
+				 + 3 * sizeof(size_t)))
+			res |= 32;
+		fseek(f, 0, SEEK_SET);
+		f_ss2 = sfm_read(f);
+		if (!f_ss2 || !sfm_is_pc(f_ss2) || sfm_size(f_ss2) != nelems
+		    || sfm_itr_ss(f_ss2, lower_s, upper_s, NULL, NULL) != 20)
+			res |= 64;
+		for (i = 0; i < nelems && f_ss2; i++) {
+			ss_printf(&ktmp, 200,
+				  "/usr/share/doc/package%03i/file%02i.txt",
+				  (int)(i / 20), (int)(i % 20));
+			if (ss_cmp(sfm_at_ss(f_ss2, ktmp), sm_at_ss(m_ss, ktmp)))
+				res |= 128;
+		}
+		fclose(f);
+		if (remove(STEST_FILE) != 0)
+			res |= 256;
+	} else {
+		res |= 512;
+	}
+#ifdef S_USE_VA_ARGS
+	sm_free(&m_si, &m_ss, &m_ii, &m_e);
+	sfm_free(&f_si, &f_si2, &f_ss, &f_ss2, &f_ii, &f_e);
+#else
+	sm_free(&m_si);
+	sm_free(&m_ss);
+	sm_free(&m_ii);
+	sm_free(&m_e);
+	sfm_free(&f_si);
+	sfm_free(&f_si2);
+	sfm_free(&f_ss);
+	sfm_free(&f_ss2);
+	sfm_free(&f_ii);
+	sfm_free(&f_e);
+#endif
+	return res;
+}
+
+static void sheap_kv(srt_string **k, srt_string **v, size_t i, size_t pass)
+{
+	ss_printf(k, 200, "k%0*i", (int)(i % 90), (int)i);
+	ss_printf(v, 200, "v%0*i", (int)((i * (pass + 3)) % 120), (int)i);
+}
+
+static int test_sm_sheap_chk(const srt_map *m_ss, const srt_map *r_ss,
+			     size_t nelems)
+{
+	size_t i;
+	srt_string *k = ss_alloca(200), *v = ss_alloca(200);
+	if (sm_size(m_ss) != sm_size(r_ss))
+		return 1;
+	for (i = 0; i < nelems; i++) {
+		sheap_kv(&k, &v, i, 0);
+		if (sm_count_s(m_ss, k) != sm_count_s(r_ss, k)
+		    || ss_cmp(sm_at_ss(m_ss, k), sm_at_ss(r_ss, k)))
+			return 2;
+	}
+	return 0;
+}
+
+static int test_sm_sheap()
+{
+	size_t i, pass, nelems = 500;
+	srt_map *m_ss = sm_alloc_sheap(SM_SS, 0), *r_ss = sm_alloc(SM_SS, 0),
+		*m_is = sm_alloc_sheap(SM_IS, 0), *m_si = sm_alloc_sheap(SM_SI, 0),
+		*m_ii = sm_alloc_sheap(SM_II, 10), *m_ss2 = NULL, *m_ss3 = NULL;
+	srt_string *k = ss_alloca(200), *v = ss_alloca(200);
+	int res = 0;
+	for (pass = 0; pass < 2; pass++) /* insert, then overwrite */
+		for (i = 0; i < nelems; i++) {
+			sheap_kv(&k, &v, i, pass);
+			sm_insert_ss(&m_ss, k, v);
+			sm_insert_ss(&r_ss, k, v);
+			sm_insert_is(&m_is, (int64_t)i, v);
+			sm_inc_si(&m_si, k, 1);
+			sm_insert_ii(&m_ii, (int64_t)i, (int64_t)i);
+		}
+	for (i = 0; i < nelems; i += 3) {
+		sheap_kv(&k, &v, i, 0);
+		sm_delete_s(m_ss, k);
+		sm_delete_s(r_ss, k);
+		sm_delete_s(m_si, k);
+		sm_delete_i(m_is, (int64_t)i);
+	}
+	res |= test_sm_sheap_chk(m_ss, r_ss, nelems);
+	for (i = 0; i < nelems && !res; i++) {
+		sheap_kv(&k, &v, i, 1);
+		if (i % 3 ? (ss_cmp(sm_at_is(m_is, (int64_t)i), v)
+			     || sm_at_si(m_si, k) != 2)
+			  : (sm_count_i(m_is, (int64_t)i)
+			     || sm_count_s(m_si, k)))
+			res |= 4;
+	}
+	/* Compaction: duplicate, copy, and shrink */
+	m_ss2 = sm_dup(m_ss);
+	sm_cpy(&m_ss3, m_ss);
+	sm_shrink(&m_ss);
+	sm_shrink(&m_is);
+	sm_shrink(&m_ii);
+	res |= test_sm_sheap_chk(m_ss, r_ss, nelems) << 3;
+	res |= test_sm_sheap_chk(m_ss2, r_ss, nelems) << 5;
+	res |= test_sm_sheap_chk(m_ss3, r_ss, nelems) << 7;
+	sheap_kv(&k, &v, 1, 1);
+	if (ss_cmp(sm_at_is(m_is, 1), v) || sm_at_ii(m_ii, 7) != 7)
+		res |= 1 << 9;
+	/* Bulk release, and reuse */
+	sm_clear(m_ss);
+	sm_clear(r_ss);
+	if (sm_size(m_ss))
+		res |= 1 << 10;
+	for (i = 0; i < nelems; i += 2) {
+		sheap_kv(&k, &v, i, 1);
+		sm_insert_ss(&m_ss, k, v);
+		sm_insert_ss(&r_ss, k, v);
+	}
+	res |= test_sm_sheap_chk(m_ss, r_ss, nelems) << 11;
+#ifdef S_USE_VA_ARGS
+	sm_free(&m_ss, &r_ss, &m_is, &m_si, &m_ii, &m_ss2, &m_ss3);
+#else
+	sm_free(&m_ss);
+	sm_free(&r_ss);
+	sm_free(&m_is);
+	sm_free(&m_si);
+	sm_free(&m_ii);
+	sm_free(&m_ss2);
+	sm_free(&m_ss3);
+#endif
+	return res;
+}
+
+static int test_sm_ss_boundary_kv(const srt_string *k, const srt_string *v)
+{
+	int res = 0, pass;
+	srt_map *m = sm_alloc(SM_SS, 0);
+	srt_hmap *hm = shm_alloc(SHM_SS, 0);
+	const srt_string *ks = ss_crefa("stale_key_stale"),
+			 *vs = ss_crefa("stale_val_stale_val");
+	for (pass = 0; pass < 2 && !res; pass++) { /* new node, stale node */
+		if (pass) {
+			sm_insert_ss(&m, ks, vs);
+			shm_insert_ss(&hm, ks, vs);
+			sm_delete_s(m, ks);
+			shm_delete_s(hm, ks);
+		}
+		if (!sm_insert_ss(&m, k, v) || !shm_insert_ss(&hm, k, v))
+			res |= 1;
+		if (sm_size(m) != 1 || ss_cmp(sm_at_ss(m, k), v)
+		    || !sm_count_s(m, k))
+			res |= 2;
+		if (shm_size(hm) != 1 || ss_cmp(shm_at_ss(hm, k), v)
+		    || !shm_count_s(hm, k))
+			res |= 4;
+		sm_delete_s(m, k);
+		shm_delete_s(hm, k);
+	}
+	sm_free(&m);
+	shm_free(&hm);
+	return res;
+}
+
+/*
+ * Key/value sizes around the in-place limit of two strings, e.g. (0, 37)
+ * and (37, 0)
+ */
+static int test_sm_ss_boundary()
+{
+	int res = 0;
+	size_t n, i, j;
+	srt_string *k = ss_alloca(100), *v = ss_alloca(100);
+	for (n = 30; n <= 45 && !res; n++)
+		for (j = 0; j < 4 && !res; j++) {
+			i = j < 2 ? j : n + 1 - j; /* 0, 1, n - 1, n */
+			ss_cpy_c(&k, "");
+			ss_cpy_c(&v, "");
+			ss_resize(&k, i, 'k');
+			ss_resize(&v, n - i, 'v');
+			res |= test_sm_ss_boundary_kv(k, v);
+		}
+	return res;
+}
+
+static srt_bool cback_siv_i(int64_t s, int64_t e, int64_t v, void *context)
+{
+	int64_t *prev_s = (int64_t *)context;
+	if (s < *prev_s || v != s * 10 + e)
+		return S_FALSE;
+	*prev_s = s;
+	return S_TRUE;
+}
+
+static srt_bool siv_check_max_e(const srt_ivmap *m)
+{
+	size_t i;
+	int64_t max_e;
+	const struct SIvMapI *n, *l, *r;
+	for (i = 0; i < siv_size(m); i++) {
+		n = (const struct SIvMapI *)st_enum_r(m, (srt_tndx)i);
+		l = (const struct SIvMapI *)get_node_r(m, n->n.x.l);
+		r = (const struct SIvMapI *)get_node_r(m, n->n.r);
+		max_e = n->e;
+		if (l && l->max_e > max_e)
+			max_e = l->max_e;
+		if (r && r->max_e > max_e)
+			max_e = r->max_e;
+		if (n->max_e != max_e)
+			return S_FALSE;
+	}
+	return S_TRUE;
+}
+
+static size_t siv_count_overlap_naive(const int64_t *s, const int64_t *e,
+				      const srt_bool *in, size_t n, int64_t qs,
+				      int64_t qe)
+{
+	size_t i, cnt = 0;
+	for (i = 0; i < n; i++)
+		if (in[i] && s[i] <= qe && e[i] >= qs)
+			cnt++;
+	return cnt;
+}
+
+static int test_siv()
+{
+#define TEST_SIV_N 300
+	int64_t s[TEST_SIV_N], e[TEST_SIV_N], v[TEST_SIV_N], prev_s, q;
+	srt_bool in[TEST_SIV_N];
+	double ds[3] = {0.5, 1.5, 2.5}, de[3] = {1.0, 3.0, 2.75};
+	size_t i;
+	int res = 0;
+	srt_ivmap *m = siv_alloc(SIV_I, 0), *mb, *md = siv_build_d(ds, de, NULL, 3),
+		  *mu;
+	for (i = 0; i < TEST_SIV_N; i++) { /* sorted, some repeated starts */
+		s[i] = (int64_t)(i / 2) * 4;
+		e[i] = s[i] + (int64_t)((i * 7919) % 97) + (int64_t)(i % 2);
+		v[i] = s[i] * 10 + e[i];
+		in[i] = S_TRUE;
+	}
+	for (i = 0; i < TEST_SIV_N; i++) { /* unordered insertion */
+		size_t j = (i * 131) % TEST_SIV_N;
+		if (!siv_insert_i(&m, s[j], e[j], v[j]))
+			res |= 1;
+	}
+	mb = siv_build_i(s, e, v, TEST_SIV_N);
+	mu = siv_build_i(e, s, v, TEST_SIV_N); /* invalid intervals */
+	if (siv_size(m) != TEST_SIV_N || siv_size(mb) != TEST_SIV_N
+	    || siv_size(mu) != 2 || !st_assert(m) || !st_assert(mb)
+	    || !siv_check_max_e(m) || !siv_check_max_e(mb)
+	    || siv_insert_i(&m, 5, 4, 0) || siv_insert_d(&m, 1, 2, 0))
+		res |= 2;
+	for (q = -10; q < 700 && !res; q += 3) {
+		size_t n0 = siv_count_overlap_naive(s, e, in, TEST_SIV_N, q, q),
+		       n1 = siv_count_overlap_naive(s, e, in, TEST_SIV_N, q,
+						    q + 20);
+		if (siv_stab_i(m, q, NULL, NULL) != n0
+		    || siv_stab_i(mb, q, NULL, NULL) != n0
+		    || siv_overlap_i(m, q, q + 20, NULL, NULL) != n1
+		    || siv_overlap_i(mb, q, q + 20, NULL, NULL) != n1)
+			res |= 4;
+	}
+	/*
+	 * Delete 2 of every 3 intervals (augmented data is updated on
+	 * rotations and on the delete path)
+	 */
+	for (i = 0; i < TEST_SIV_N; i++) {
+		size_t j = (i * 131) % TEST_SIV_N;
+		if (j % 3) {
+			in[j] = S_FALSE;
+			if (!siv_delete_i(m, s[j], e[j])
+			    || !siv_delete_i(mb, s[j], e[j]))
+				res |= 8;
+		}
+	}
+	if (!st_assert(m) || !st_assert(mb) || !siv_check_max_e(m)
+	    || !siv_check_max_e(mb) || siv_delete_i(m, s[1], e[1])
+	    || siv_count_i(m, s[1], e[1]) || !siv_count_i(m, s[0], e[0])
+	    || siv_at_i(mb, s[3], e[3]) != v[3])
+		res |= 16;
+	for (q = -10; q < 700 && !res; q += 3) {
+		size_t n0 = siv_count_overlap_naive(s, e, in, TEST_SIV_N, q, q),
+		       n1 = siv_count_overlap_naive(s, e, in, TEST_SIV_N, q,
+						    q + 50);
+		prev_s = S_MIN_I64;
+		if (siv_stab_i(m, q, cback_siv_i, &prev_s) != n0
+		    || siv_stab_i(mb, q, NULL, NULL) != n0
+		    || siv_overlap_i(m, q, q + 50, NULL, NULL) != n1
+		    || siv_overlap_i(mb, q, q + 50, NULL, NULL) != n1)
+			res |= 32;
+	}
+	if (siv_stab_d(md, 2.6, NULL, NULL) != 2
+	    || siv_stab_d(md, 0.5, NULL, NULL) != 1
+	    || siv_overlap_d(md, 3.5, 4, NULL, NULL) != 0
+	    || siv_overlap_d(md, 0, 10, NULL, NULL) != 3
+	    || siv_stab_i(md, 1, NULL, NULL) || siv_type(md) != SIV_D)
+		res |= 64;
+#ifdef S_USE_VA_ARGS
+	siv_free(&m, &mb, &md, &mu);
+#else
+	siv_free(&m);
+	siv_free(&mb);
+	siv_free(&md);
+	siv_free(&mu);
+#endif
+	return res;
+#undef TEST_SIV_N
+}
+
+static int test_siv_dup()
+{
+	int64_t i;
+	int res = 0;
+	double ds[2] = {0.5, 1.5}, de[2] = {1.0, 3.0};
+	srt_ivmap *m = siv_alloc(SIV_I, 64), *d, *dd,
+		  *md = siv_build_d(ds, de, NULL, 2);
+	for (i = 0; i < 20; i++) /* spare capacity in the source */
+		siv_insert_i(&m, i * 10, i * 10 + 15, i);
+	d = siv_dup(m);
+	dd = siv_dup(md);
+	if (siv_dup(NULL) || siv_size(d) != 20 || !st_assert(d)
+	    || !siv_check_max_e(d) || siv_stab_i(d, 12, NULL, NULL) != 2
+	    || siv_type(dd) != SIV_D || siv_stab_d(dd, 2.0, NULL, NULL) != 1)
+		res |= 1;
+	for (i = 20; i < 200; i++) /* past the source capacity */
+		if (!siv_insert_i(&d, i * 10, i * 10 + 15, i))
+			res |= 2;
+	for (i = 0; i < 200; i += 2)
+		if (!siv_delete_i(d, i * 10, i * 10 + 15))
+			res |= 4;
+	if (siv_size(d) != 100 || !st_assert(d) || !siv_check_max_e(d)
+	    || siv_at_i(d, 1990, 2005) != 199 || siv_count_i(d, 0, 15)
+	    || siv_stab_i(d, 1995, NULL, NULL) != 1)
+		res |= 8;
+	if (siv_size(m) != 20 || !st_assert(m) || siv_at_i(m, 0, 15) != 0
+	    || siv_stab_i(m, 12, NULL, NULL) != 2)
+		res |= 16;
+#ifdef S_USE_VA_ARGS
+	siv_free(&m, &d, &dd, &md);
+#else
+	siv_free(&m);
+	siv_free(&d);
+	siv_free(&dd);
+	siv_free(&md);
+#endif
+	return res;
+}
+
+static srt_bool cback_spm_ii(int64_t k, int64_t v, void *context)
+{
+	int64_t *prev = (int64_t *)context;
+	(void)v;
+	if (k <= *prev)
+		return S_FALSE;
+	*prev = k;
+	return S_TRUE;
+}
+
+static int test_spm()
+{
+#define TEST_SPM_N 2000
+	size_t i;
+	int64_t k, prev;
+	uint32_t seed = 1;
+	srt_bool had_k[100];
+	srt_pmap *m = spm_alloc(SM_II, 0), *ms = spm_alloc(SM_SS, 0),
+		 *s1 = NULL, *s2, *s3, *ss1;
+	srt_map *r = sm_alloc(SM_II, 0), *r1 = NULL;
+	srt_string *ktmp = ss_alloca(100), *vtmp = ss_alloca(300);
+	int res = 0;
+	if (!m || !ms || !r)
+		return 1;
+	/* random changes, checking a snapshot against a map copy */
+	for (i = 0; i < 3 * TEST_SPM_N; i++) {
+		seed = seed * 1103515245 + 12345;
+		k = (int64_t)((seed >> 8) % TEST_SPM_N);
+		if ((seed >> 4) % 3) {
+			if (!spm_insert_ii(m, k, (int64_t)i))
+				res |= 2;
+			sm_insert_ii(&r, k, (int64_t)i);
+		} else if (spm_delete_i(m, k) != sm_delete_i(r, k)) {
+			res |= 2;
+		}
+		if (i == TEST_SPM_N) {
+			s1 = spm_snapshot(m);
+			r1 = sm_dup(r);
+		}
+	}
+	if (!s1 || spm_size(m) != sm_size(r) || spm_size(s1) != sm_size(r1)
+	    || !spm_is_snapshot(s1) || spm_is_snapshot(m)
+	    || spm_type(s1) != SM_II)
+		res |= 4;
+	for (k = -1; k <= TEST_SPM_N && !res; k++)
+		if (spm_at_ii(m, k) != sm_at_ii(r, k)
+		    || spm_count_i(m, k) != sm_count_i(r, k)
+		    || spm_at_ii(s1, k) != sm_at_ii(r1, k)
+		    || spm_count_i(s1, k) != sm_count_i(r1, k))
+			res |= 8;
+	prev = S_MIN_I64;
+	if (spm_itr_ii(s1, 100, 199, NULL, NULL)
+		    != sm_itr_ii(r1, 100, 199, NULL, NULL)
+	    || spm_itr_ii(s1, S_MIN_I64, S_MAX_I64, cback_spm_ii, &prev)
+		       != sm_size(r1)
+	    || spm_itr_ii(m, 199, 100, NULL, NULL) != 0
+	    || spm_insert_ii(s1, 1, 1) || spm_delete_i(s1, 1)
+	    || spm_snapshot(s1) != NULL || spm_ref(m) != NULL
+	    || spm_at_ii32(m, 1) || spm_insert_ii32(m, 1, 1))
+		res |= 16;
+	/* recycling of the nodes used only by released snapshots */
+	s2 = spm_snapshot(m);
+	s3 = spm_ref(s2);
+	for (k = 0; k < 100; k++) {
+		had_k[k] = spm_count_i(m, k) ? S_TRUE : S_FALSE;
+		spm_delete_i(m, k);
+	}
+	spm_free(&s1);
+	spm_free(&s2);
+	if (s1 || s2 || spm_collect(m) == 0 || spm_nodes(m) <= spm_size(m)
+	    || spm_size(s3) != sm_size(r))
+		res |= 32;
+	for (k = 0; k < 100; k++)
+		if (spm_count_i(m, k) || spm_count_i(s3, k) != had_k[k]
+		    || spm_at_ii(s3, k) != sm_at_ii(r, k))
+			res |= 64;
+	spm_free(&s3);
+	if (spm_collect(m) == 0 || spm_nodes(m) != spm_size(m))
+		res |= 128;
+	/* string nodes: the snapshot keeps the previous values */
+	for (i = 0; i < 200; i++) {
+		ss_printf(&ktmp, 100, "k%03i", (int)i);
+		ss_printf(&vtmp, 300, "%0*i", (int)(i % 60), (int)i);
+		spm_insert_ss(ms, ktmp, vtmp);
+	}
+	ss1 = spm_snapshot(ms);
+	for (i = 0; i < 200; i++) {
+		ss_printf(&ktmp, 100, "k%03i", (int)i);
+		if (i % 2) {
+			ss_printf(&vtmp, 300, "new%0*i", (int)(i % 70),
+				  (int)i);
+			spm_insert_ss(ms, ktmp, vtmp);
+		} else {
+			spm_delete_s(ms, ktmp);
+		}
+	}
+	for (i = 0; i < 200; i++) {
+		ss_printf(&ktmp, 100, "k%03i", (int)i);
+		ss_printf(&vtmp, 300, "%0*i", (int)(i % 60), (int)i);
+		if (ss_cmp(spm_at_ss(ss1, ktmp), vtmp))
+			res |= 256;
+		ss_printf(&vtmp, 300, "new%0*i", (int)(i % 70), (int)i);
+		if (i % 2 ? ss_cmp(spm_at_ss(ms, ktmp), vtmp)
+			  : spm_count_s(ms, ktmp) != 0)
+			res |= 256;
+	}
+	if (spm_itr_ss(ss1, ss_crefa("k010"), ss_crefa("k019"), NULL, NULL)
+		    != 10
+	    || spm_itr_ss(ms, ss_crefa("k010"), ss_crefa("k019"), NULL, NULL)
+		       != 5)
+		res |= 512;
+	/* map released before its snapshot */
+	spm_free(&ms);
+	ss_printf(&ktmp, 100, "k%03i", 150);
+	if (spm_size(ss1) != 200 || ss_size(spm_at_ss(ss1, ktmp)) != 30)
+		res |= 1024;
+	spm_free(&ss1);
+#ifdef S_USE_VA_ARGS
+	spm_free(&m);
+	sm_free(&r, &r1);
+#else
+	spm_free(&m);
+	sm_free(&r);
+	sm_free(&r1);
+#endif
+	return res;
+#undef TEST_SPM_N
+}
+
 static int test_sms()
 {
 	int i, res = 0;
@@ -5078,6 +7448,94 @@ static int test_shm_shrink()
 	return res;
 }
 
+static int test_shm_sheap_chk(const srt_hmap *m_ss, const srt_hmap *r_ss,
+			      size_t nelems)
+{
+	size_t i;
+	srt_string *k = ss_alloca(200), *v = ss_alloca(200);
+	if (shm_size(m_ss) != shm_size(r_ss))
+		return 1;
+	for (i = 0; i < nelems; i++) {
+		sheap_kv(&k, &v, i, 0);
+		if (ss_cmp(shm_at_ss(m_ss, k), shm_at_ss(r_ss, k)))
+			return 2;
+	}
+	return 0;
+}
+
+static int test_shm_sheap()
+{
+	size_t i, pass, nelems = 500;
+	srt_hmap *m_ss = shm_alloc_sheap(SHM_SS, 0),
+		 *r_ss = shm_alloc(SHM_SS, 0),
+		 *m_is = shm_alloc_sheap(SHM_IS, 0),
+		 *m_si = shm_alloc_sheap(SHM_SI, 0),
+		 *m_ii = shm_alloc_sheap(SHM_II, 10), *m_ss2 = NULL,
+		 *m_ss3 = NULL;
+	srt_string *k = ss_alloca(200), *v = ss_alloca(200);
+	int res = 0;
+	for (pass = 0; pass < 2; pass++) /* insert, then overwrite */
+		for (i = 0; i < nelems; i++) {
+			sheap_kv(&k, &v, i, pass);
+			shm_insert_ss(&m_ss, k, v);
+			shm_insert_ss(&r_ss, k, v);
+			shm_insert_is(&m_is, (int64_t)i, v);
+			shm_inc_si(&m_si, k, 1);
+			shm_insert_ii(&m_ii, (int64_t)i, (int64_t)i);
+		}
+	for (i = 0; i < nelems; i += 3) {
+		sheap_kv(&k, &v, i, 0);
+		shm_delete_s(m_ss, k);
+		shm_delete_s(r_ss, k);
+		shm_delete_s(m_si, k);
+		shm_delete_i(m_is, (int64_t)i);
+	}
+	res |= test_shm_sheap_chk(m_ss, r_ss, nelems);
+	for (i = 0; i < nelems && !res; i++) {
+		sheap_kv(&k, &v, i, 1);
+		if (i % 3 ? (ss_cmp(shm_at_is(m_is, (int64_t)i), v)
+			     || shm_at_si(m_si, k) != 2)
+			  : (shm_count_i(m_is, (int64_t)i)
+			     || shm_count_s(m_si, k)))
+			res |= 4;
+	}
+	/* Compaction: duplicate, copy, and shrink */
+	m_ss2 = shm_dup(m_ss);
+	shm_cpy(&m_ss3, m_ss);
+	shm_shrink(&m_ss);
+	shm_shrink(&m_is);
+	shm_shrink(&m_ii);
+	res |= test_shm_sheap_chk(m_ss, r_ss, nelems) << 3;
+	res |= test_shm_sheap_chk(m_ss2, r_ss, nelems) << 5;
+	res |= test_shm_sheap_chk(m_ss3, r_ss, nelems) << 7;
+	sheap_kv(&k, &v, 1, 1);
+	if (ss_cmp(shm_at_is(m_is, 1), v) || shm_at_ii(m_ii, 7) != 7)
+		res |= 1 << 9;
+	/* Bulk release, and reuse */
+	shm_clear(m_ss);
+	shm_clear(r_ss);
+	if (shm_size(m_ss))
+		res |= 1 << 10;
+	for (i = 0; i < nelems; i += 2) {
+		sheap_kv(&k, &v, i, 1);
+		shm_insert_ss(&m_ss, k, v);
+		shm_insert_ss(&r_ss, k, v);
+	}
+	res |= test_shm_sheap_chk(m_ss, r_ss, nelems) << 11;
+#ifdef S_USE_VA_ARGS
+	shm_free(&m_ss, &r_ss, &m_is, &m_si, &m_ii, &m_ss2, &m_ss3);
+#else
+	shm_free(&m_ss);
+	shm_free(&r_ss);
+	shm_free(&m_is);
+	shm_free(&m_si);
+	shm_free(&m_ii);
+	shm_free(&m_ss2);
+	shm_free(&m_ss3);
+#endif
+	return res;
+}
+
 #define TEST_SHM_DUP_VARS(m, atype, r)                                         \
 	srt_hmap *m = shm_alloc(atype, r), *m##2 = shm_alloca(atype, r),       \
 		 *m##b = NULL, *m##2b = NULL
@@ -6352,10 +8810,15 @@ int main()
 				U8_C_S_CEDILLA_15E U8_S_S_CEDILLA_15F
 					U8_CENT_00A2 U8_EURO_20AC U8_HAN_24B62,
 		11)); /* Unicode chrs */
+	STEST_ASSERT(test_ss_len_u_vec());
+	STEST_ASSERT(test_ss_uindex());
+	STEST_ASSERT(test_sr_rope());
+	STEST_ASSERT(test_sin_intern());
 	STEST_ASSERT(test_ss_capacity());
 	STEST_ASSERT(test_ss_len_left());
 	STEST_ASSERT(test_ss_max());
 	STEST_ASSERT(test_ss_dup());
+	STEST_ASSERT(test_ss_shared());
 	STEST_ASSERT(test_ss_dup_substr());
 	STEST_ASSERT(test_ss_dup_substr_u());
 	STEST_ASSERT(test_ss_dup_cn());
@@ -6371,6 +8834,8 @@ int main()
 		test_ss_dup_int(9223372036854775807LL, "9223372036854775807"));
 	STEST_ASSERT(test_ss_dup_int(-9223372036854775807LL,
 				     "-9223372036854775807"));
+	STEST_ASSERT(test_ss_dup_int(-9223372036854775807LL - 1,
+				     "-9223372036854775808"));
 	stmp = ss_alloca(128);
 #define MK_TEST_SS_DUP_CPY_CAT(encc, decc, a, b)                               \
 	{                                                                      \
@@ -6480,6 +8945,28 @@ int main()
 	STEST_ASSERT(test_ss_cat_wn());
 	STEST_ASSERT(test_ss_cat_w(L"hello", L"all"));
 	STEST_ASSERT(test_ss_cat_int("prefix", 1, "prefix1"));
+	STEST_ASSERT(test_ss_cat_uint("", 0, "0"));
+	STEST_ASSERT(test_ss_cat_uint("x", 18446744073709551615ULL,
+				      "x18446744073709551615"));
+	STEST_ASSERT(test_ss_cat_double("x", 0.1, "x0.1"));
+	STEST_ASSERT(test_ss_cat_double("", 100, "100"));
+	STEST_ASSERT(test_ss_cat_double("", -12.5, "-12.5"));
+	STEST_ASSERT(test_ss_cat_double("", 0, "0"));
+	STEST_ASSERT(test_ss_cat_double("", -1e-300 * 1e-300, "-0"));
+	STEST_ASSERT(test_ss_cat_double("", 1e21, "1e+21"));
+	STEST_ASSERT(test_ss_cat_double("", 1e20, "100000000000000000000"));
+	STEST_ASSERT(test_ss_cat_double("", 1e-6, "0.000001"));
+	STEST_ASSERT(test_ss_cat_double("", 2.5e-7, "2.5e-7"));
+	STEST_ASSERT(test_ss_cat_double("", 1.0 / 3, "0.3333333333333333"));
+	STEST_ASSERT(test_ss_cat_double("", 5e-324, "5e-324"));
+	STEST_ASSERT(test_ss_cat_double("", 1.7976931348623157e308,
+					"1.7976931348623157e+308"));
+	STEST_ASSERT(test_ss_cat_double("", 1e300 * 1e300, "inf"));
+	STEST_ASSERT(test_ss_cat_double("", -1e300 * 1e300, "-inf"));
+	STEST_ASSERT(test_ss_cat_float("", 0.1f, "0.1"));
+	STEST_ASSERT(test_ss_cat_float("", 16777216.0f, "16777216"));
+	STEST_ASSERT(test_ss_cat_float("", 3.4028235e38f, "3.4028235e+38"));
+	STEST_ASSERT(test_ss_cat_float("", 1.4e-45f, "1e-45"));
 	STEST_ASSERT(test_ss_cat_erase("x", "hello", 2, 2, "xheo"));
 	STEST_ASSERT(test_ss_cat_erase_u());
 	STEST_ASSERT(
@@ -6497,6 +8984,16 @@ int main()
 				     "abcdefghijklmnopqrstuvwxyz"));
 	STEST_ASSERT(test_ss_toupper("aBcDeFgHiJkLmNoPqRsTuVwXyZ",
 				     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
+	STEST_ASSERT(test_ss_case_vec());
+	STEST_ASSERT(test_ss_b64_vec());
+	STEST_ASSERT(test_ss_esc_vec());
+	STEST_ASSERT(test_ss_enc_lz_ctx());
+	STEST_ASSERT(test_ss_enc_lz_lvl());
+	STEST_ASSERT(test_ss_enc_lze());
+	STEST_ASSERT(test_ss_dec_lz_wild());
+	STEST_ASSERT(test_ss_lz_dict());
+	STEST_ASSERT(test_slz_stream());
+	STEST_ASSERT(test_slz_par());
 #if !defined(S_MINIMAL)
 	STEST_ASSERT(test_ss_tolower(U8_C_N_TILDE_D1, U8_S_N_TILDE_F1));
 	STEST_ASSERT(test_ss_toupper(U8_S_N_TILDE_F1, U8_C_N_TILDE_D1));
@@ -6534,10 +9031,50 @@ int main()
 	if (unicode_support)
 		STEST_ASSERT(test_ss_to_w("hello" U8_C_N_TILDE_D1));
 #endif
+	STEST_ASSERT(test_ss_to_int64("", 0, 0, 0));
+	STEST_ASSERT(test_ss_to_int64("-", 0, 0, 0));
+	STEST_ASSERT(test_ss_to_int64("12abc", 0, 12, 2));
+	STEST_ASSERT(test_ss_to_int64("x=-34", 2, -34, 3));
+	STEST_ASSERT(test_ss_to_int64("x=-34", 9, 0, 0));
+	STEST_ASSERT(test_ss_to_int64(" 1", 0, 0, 0));
+	STEST_ASSERT(test_ss_to_int64("+9223372036854775807", 0,
+				      9223372036854775807LL, 20));
+	STEST_ASSERT(test_ss_to_int64("-9223372036854775808", 0,
+				      -9223372036854775807LL - 1, 20));
+	STEST_ASSERT(test_ss_to_int64("99999999999999999999", 0,
+				      9223372036854775807LL, 20));
+	STEST_ASSERT(test_ss_to_double("", 0, 0, 0));
+	STEST_ASSERT(test_ss_to_double(".", 0, 0, 0));
+	STEST_ASSERT(test_ss_to_double("-.5", 0, -0.5, 3));
+	STEST_ASSERT(test_ss_to_double("1.", 0, 1, 2));
+	STEST_ASSERT(test_ss_to_double("1e", 0, 1, 1));
+	STEST_ASSERT(test_ss_to_double("1e+x", 0, 1, 1));
+	STEST_ASSERT(test_ss_to_double("x 2.5E-3;", 2, 0.0025, 6));
+	STEST_ASSERT(test_ss_to_double("0.1", 0, 0.1, 3));
+	STEST_ASSERT(test_ss_to_double("000123.4560000", 0, 123.456, 14));
+	STEST_ASSERT(test_ss_to_double("9007199254740993", 0,
+				       9007199254740992.0, 16));
+	STEST_ASSERT(test_ss_to_double("9007199254740993.000000000000000001", 0,
+				       9007199254740994.0, 35));
+	STEST_ASSERT(test_ss_to_double("2.2250738585072011e-308", 0,
+				       2.2250738585072011e-308, 23));
+	STEST_ASSERT(test_ss_to_double("2.4703282292062328e-324", 0, 5e-324,
+				       23));
+	STEST_ASSERT(test_ss_to_double("2.4703282292062327e-324", 0, 0, 23));
+	STEST_ASSERT(test_ss_to_double("1.7976931348623158e308", 0,
+				       1.7976931348623157e308, 22));
+	STEST_ASSERT(test_ss_to_double("1e999", 0, 1e300 * 1e300, 5));
+	STEST_ASSERT(test_ss_to_double("-Infinity", 0, -1e300 * 1e300, 9));
+	STEST_ASSERT(test_ss_to_double("infinit", 0, 1e300 * 1e300, 3));
+	STEST_ASSERT(test_ss_num_rt());
 	STEST_ASSERT(test_ss_find("full text", "text", 5));
 	STEST_ASSERT(test_ss_find("full text", "hello", S_NPOS));
 	STEST_ASSERT(test_ss_find_misc());
+	STEST_ASSERT(test_ss_find_vec());
+	STEST_ASSERT(test_ss_searcher());
+	STEST_ASSERT(test_ss_mpattern());
 	STEST_ASSERT(test_ss_split());
+	STEST_ASSERT(test_ss_tok());
 	STEST_ASSERT(test_ss_cmp("hello", "hello2", -1));
 	STEST_ASSERT(test_ss_cmp("hello2", "hello", 1));
 	STEST_ASSERT(test_ss_cmp("hello", "hello", 0));
@@ -6689,6 +9226,13 @@ int main()
 	STEST_ASSERT(test_sm_itr());
 	STEST_ASSERT(test_sm_sort_to_vectors());
 	STEST_ASSERT(test_sm_double_rotation());
+	STEST_ASSERT(test_sm_freeze());
+	STEST_ASSERT(test_sm_freeze_pc());
+	STEST_ASSERT(test_sm_sheap());
+	STEST_ASSERT(test_sm_ss_boundary());
+	STEST_ASSERT(test_siv());
+	STEST_ASSERT(test_siv_dup());
+	STEST_ASSERT(test_spm());
 	/*
 	 * Set
 	 */
@@ -6707,6 +9251,7 @@ int main()
 	STEST_ASSERT(test_shm_alloc_dd());
 	STEST_ASSERT(test_shm_alloca_dd());
 	STEST_ASSERT(test_shm_shrink());
+	STEST_ASSERT(test_shm_sheap());
 	STEST_ASSERT(test_shm_dup());
 	STEST_ASSERT(test_shm_cpy());
 	STEST_ASSERT(test_shm_count_u());